@@ -0,0 +1,347 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <linux/falloc.h>
+#include <algorithm>
+
+#include "heap_safe.h"
+#include "async_direct_file.h"
+
+
+using namespace std;
+
+
+cAsyncDirectFile::cAsyncDirectFile(unsigned queueDepth, size_t readAheadSize) {
+	this->fd = -1;
+	this->direct = false;
+	this->queueDepth = queueDepth;
+	this->readAheadSize = alignSize(readAheadSize);
+	#ifdef HAVE_LIBURING
+	this->ringOk = false;
+	#endif
+	this->pendingWrites = 0;
+	this->writeEnd = 0;
+	this->error = false;
+	this->window = NULL;
+	this->windowCapacity = 0;
+	this->windowOffset = 0;
+	this->windowSize = 0;
+	this->readAheadRequest = NULL;
+	this->readAheadDone = false;
+	this->readAheadResult = 0;
+}
+
+cAsyncDirectFile::~cAsyncDirectFile() {
+	this->close();
+}
+
+bool cAsyncDirectFile::open(const char *fileName, bool write, u_int64_t preallocSize) {
+	this->fileName = fileName;
+	int flags = write ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY;
+	this->fd = ::open(fileName, flags | O_DIRECT, 0600);
+	this->direct = this->fd >= 0;
+	if(this->fd < 0 && errno == EINVAL) {
+		// filesystem without O_DIRECT support (tmpfs)
+		syslog(LOG_NOTICE, "packetbuffer: O_DIRECT is not supported for %s - use page cache", fileName);
+		this->fd = ::open(fileName, flags, 0600);
+	}
+	if(this->fd < 0) {
+		syslog(LOG_ERR, "packetbuffer: open %s for %s failed: %s", fileName, write ? "write" : "read", strerror(errno));
+		return(false);
+	}
+	if(write && preallocSize) {
+		fallocate(this->fd, FALLOC_FL_KEEP_SIZE, 0, preallocSize);
+	}
+	#ifdef HAVE_LIBURING
+	int rsltInit = io_uring_queue_init(this->queueDepth, &this->ring, 0);
+	if(rsltInit == 0) {
+		this->ringOk = true;
+	} else {
+		static bool logged = false;
+		if(!logged) {
+			syslog(LOG_NOTICE, "packetbuffer: io_uring_queue_init failed: %s - use synchronous io", strerror(-rsltInit));
+			logged = true;
+		}
+	}
+	#endif
+	this->writeEnd = 0;
+	this->error = false;
+	return(true);
+}
+
+void cAsyncDirectFile::close() {
+	if(this->fd < 0) {
+		return;
+	}
+	this->waitWrites();
+	if(this->readAheadRequest) {
+		this->waitReadAhead();
+		freeBuffer(this->readAheadRequest->buffer);
+		delete this->readAheadRequest;
+		this->readAheadRequest = NULL;
+	}
+	#ifdef HAVE_LIBURING
+	if(this->ringOk) {
+		io_uring_queue_exit(&this->ring);
+		this->ringOk = false;
+	}
+	#endif
+	::close(this->fd);
+	this->fd = -1;
+	if(this->window) {
+		freeBuffer(this->window);
+		this->window = NULL;
+	}
+	this->windowCapacity = 0;
+	this->windowOffset = 0;
+	this->windowSize = 0;
+}
+
+bool cAsyncDirectFile::write(u_char *buffer, size_t size, u_int64_t offset) {
+	#ifdef HAVE_LIBURING
+	if(this->ringOk) {
+		this->reapCompletions(false);
+		while(this->pendingWrites >= this->queueDepth) {
+			this->reapCompletions(true);
+		}
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&this->ring);
+		if(!sqe) {
+			io_uring_submit(&this->ring);
+			this->reapCompletions(true);
+			sqe = io_uring_get_sqe(&this->ring);
+		}
+		if(sqe) {
+			sRequest *request = new FILE_LINE(0) sRequest;
+			request->buffer = buffer;
+			request->size = size;
+			request->offset = offset;
+			request->read = false;
+			io_uring_prep_write(sqe, this->fd, buffer, size, offset);
+			io_uring_sqe_set_data(sqe, request);
+			io_uring_submit(&this->ring);
+			++this->pendingWrites;
+			this->pendingWriteRequests[offset] = request;
+			this->writeEnd = max(this->writeEnd, offset + size);
+			return(!this->error);
+		}
+	}
+	#endif
+	size_t writed = 0;
+	while(writed < size) {
+		ssize_t rsltWrite = pwrite(this->fd, buffer + writed, size - writed, offset + writed);
+		if(rsltWrite <= 0) {
+			if(rsltWrite < 0 && errno == EINTR) {
+				continue;
+			}
+			syslog(LOG_ERR, "packetbuffer: write to %s failed: %s", this->fileName.c_str(), strerror(errno));
+			this->error = true;
+			break;
+		}
+		writed += rsltWrite;
+	}
+	if(!this->error) {
+		this->writeEnd = max(this->writeEnd, offset + size);
+	}
+	freeBuffer(buffer);
+	return(!this->error);
+}
+
+bool cAsyncDirectFile::waitWrites() {
+	#ifdef HAVE_LIBURING
+	while(this->ringOk && this->pendingWrites) {
+		this->reapCompletions(true);
+	}
+	#endif
+	return(!this->error);
+}
+
+u_int64_t cAsyncDirectFile::getCompletedSize() {
+	#ifdef HAVE_LIBURING
+	if(this->ringOk && this->pendingWrites) {
+		this->reapCompletions(false);
+	}
+	#endif
+	// the file is written sequentially - completed is everything before the oldest pending write
+	return(this->pendingWriteRequests.size() ?
+		this->pendingWriteRequests.begin()->first :
+		this->writeEnd);
+}
+
+u_char *cAsyncDirectFile::getPendingWriteBuffer(u_int64_t offset, size_t *size) {
+	map<u_int64_t, sRequest*>::iterator iter = this->pendingWriteRequests.find(offset);
+	if(iter == this->pendingWriteRequests.end()) {
+		return(NULL);
+	}
+	if(size) {
+		*size = iter->second->size;
+	}
+	return(iter->second->buffer);
+}
+
+u_char *cAsyncDirectFile::read(u_int64_t offset, size_t size, u_int64_t fileSize) {
+	if(offset + size > fileSize) {
+		return(NULL);
+	}
+	if(!this->window ||
+	   offset < this->windowOffset || offset + size > this->windowOffset + this->windowSize) {
+		bool inReadAhead = false;
+		if(this->readAheadRequest) {
+			if(this->waitReadAhead() && this->readAheadResult > 0 &&
+			   offset >= this->readAheadRequest->offset &&
+			   offset + size <= this->readAheadRequest->offset + this->readAheadResult) {
+				u_char *window = this->window;
+				size_t windowCapacity = this->windowCapacity;
+				this->window = this->readAheadRequest->buffer;
+				this->windowCapacity = this->readAheadRequest->size;
+				this->windowOffset = this->readAheadRequest->offset;
+				this->windowSize = this->readAheadResult;
+				this->readAheadRequest->buffer = window;
+				this->readAheadRequest->size = windowCapacity;
+				inReadAhead = true;
+			}
+			if(this->readAheadRequest->buffer) {
+				freeBuffer(this->readAheadRequest->buffer);
+			}
+			delete this->readAheadRequest;
+			this->readAheadRequest = NULL;
+		}
+		if(!inReadAhead) {
+			u_int64_t readOffset = alignOffset(offset);
+			// window must not cover part of file with writes in progress - it would keep holes / old data
+			size_t readSize = min(max(alignSize(offset + size - readOffset), this->readAheadSize),
+					      alignSize((size_t)(fileSize - readOffset)));
+			if(this->windowCapacity < readSize) {
+				if(this->window) {
+					freeBuffer(this->window);
+				}
+				this->window = allocBuffer(readSize);
+				this->windowCapacity = readSize;
+			}
+			this->windowOffset = readOffset;
+			this->windowSize = 0;
+			if(!this->readSync(this->window, readSize, readOffset) ||
+			   offset + size > this->windowOffset + this->windowSize) {
+				syslog(LOG_ERR, "packetbuffer: read from %s failed (offset %lu, size %zd)",
+				       this->fileName.c_str(), (unsigned long)offset, size);
+				this->windowSize = 0;
+				return(NULL);
+			}
+		}
+	}
+	if(!this->readAheadRequest &&
+	   !(this->windowSize % ASYNC_DIRECT_FILE_ALIGN) &&
+	   this->windowOffset + this->windowSize < fileSize) {
+		this->readAhead(this->windowOffset + this->windowSize, fileSize);
+	}
+	return(this->window + (offset - this->windowOffset));
+}
+
+u_char *cAsyncDirectFile::allocBuffer(size_t size) {
+	void *buffer = NULL;
+	if(posix_memalign(&buffer, ASYNC_DIRECT_FILE_ALIGN, alignSize(size))) {
+		return(NULL);
+	}
+	return((u_char*)buffer);
+}
+
+void cAsyncDirectFile::freeBuffer(u_char *buffer) {
+	free(buffer);
+}
+
+bool cAsyncDirectFile::readSync(u_char *buffer, size_t size, u_int64_t offset) {
+	size_t readed = 0;
+	while(readed < size) {
+		ssize_t rsltRead = pread(this->fd, buffer + readed, size - readed, offset + readed);
+		if(rsltRead < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return(false);
+		}
+		if(rsltRead == 0) {
+			break;
+		}
+		readed += rsltRead;
+	}
+	this->windowSize = readed;
+	return(true);
+}
+
+void cAsyncDirectFile::readAhead(u_int64_t offset, u_int64_t fileSize) {
+	#ifdef HAVE_LIBURING
+	if(!this->ringOk) {
+		return;
+	}
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&this->ring);
+	if(!sqe) {
+		return;
+	}
+	size_t size = min(this->readAheadSize, alignSize((size_t)(fileSize - offset)));
+	sRequest *request = new FILE_LINE(0) sRequest;
+	request->buffer = allocBuffer(size);
+	request->size = size;
+	request->offset = offset;
+	request->read = true;
+	this->readAheadRequest = request;
+	this->readAheadDone = false;
+	this->readAheadResult = 0;
+	io_uring_prep_read(sqe, this->fd, request->buffer, size, offset);
+	io_uring_sqe_set_data(sqe, request);
+	io_uring_submit(&this->ring);
+	#endif
+}
+
+bool cAsyncDirectFile::waitReadAhead() {
+	#ifdef HAVE_LIBURING
+	while(this->ringOk && this->readAheadRequest && !this->readAheadDone) {
+		this->reapCompletions(true);
+	}
+	return(this->readAheadDone);
+	#else
+	return(false);
+	#endif
+}
+
+bool cAsyncDirectFile::reapCompletions(bool wait) {
+	bool rslt = false;
+	#ifdef HAVE_LIBURING
+	while(true) {
+		struct io_uring_cqe *cqe;
+		int rsltCqe = wait && !rslt ?
+			       io_uring_wait_cqe(&this->ring, &cqe) :
+			       io_uring_peek_cqe(&this->ring, &cqe);
+		if(rsltCqe < 0) {
+			if(rsltCqe == -EINTR && wait && !rslt) {
+				continue;
+			}
+			break;
+		}
+		sRequest *request = (sRequest*)io_uring_cqe_get_data(cqe);
+		int res = cqe->res;
+		io_uring_cqe_seen(&this->ring, cqe);
+		this->completeRequest(request, res);
+		rslt = true;
+	}
+	#endif
+	return(rslt);
+}
+
+void cAsyncDirectFile::completeRequest(sRequest *request, int rslt) {
+	if(request->read) {
+		this->readAheadDone = true;
+		this->readAheadResult = rslt;
+		return;
+	}
+	if(rslt < 0 || (size_t)rslt != request->size) {
+		syslog(LOG_ERR, "packetbuffer: async write to %s failed: %s",
+		       this->fileName.c_str(), rslt < 0 ? strerror(-rslt) : "short write");
+		this->error = true;
+	}
+	--this->pendingWrites;
+	this->pendingWriteRequests.erase(request->offset);
+	freeBuffer(request->buffer);
+	delete request;
+}
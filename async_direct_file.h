@@ -0,0 +1,95 @@
+#ifndef ASYNC_DIRECT_FILE_H
+#define ASYNC_DIRECT_FILE_H
+
+
+#include <string>
+#include <map>
+#include <sys/types.h>
+
+#include "config.h"
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+
+#define ASYNC_DIRECT_FILE_ALIGN 4096
+
+
+/*
+ * File opened with O_DIRECT (bypasses page cache) for packetbuffer disk spill.
+ * Writes are asynchronous through io_uring - the buffer is passed over and
+ * freed after completion. Reads are served from read-ahead window, the next
+ * window is requested asynchronously when the current one is used. Reads never
+ * go past fileSize given by the caller - it has to be the completed part of the
+ * file (getCompletedSize of the writing instance), writes can complete out of order.
+ * Without liburing the same is done synchronously by pwrite / pread.
+ * Offsets and write sizes have to be aligned to ASYNC_DIRECT_FILE_ALIGN.
+ * One instance is used either for writes or for reads by one thread at a time.
+ */
+class cAsyncDirectFile {
+public:
+	struct sRequest {
+		u_char *buffer;
+		size_t size;
+		u_int64_t offset;
+		bool read;
+	};
+public:
+	cAsyncDirectFile(unsigned queueDepth = 64, size_t readAheadSize = 4 * 1024 * 1024);
+	~cAsyncDirectFile();
+	bool open(const char *fileName, bool write, u_int64_t preallocSize = 0);
+	void close();
+	bool isOpen() {
+		return(fd >= 0);
+	}
+	bool write(u_char *buffer, size_t size, u_int64_t offset);
+	bool waitWrites();
+	u_int64_t getCompletedSize();
+	u_char *getPendingWriteBuffer(u_int64_t offset, size_t *size);
+	u_char *read(u_int64_t offset, size_t size, u_int64_t fileSize);
+	unsigned getPendingWrites() {
+		return(pendingWrites);
+	}
+	bool isError() {
+		return(error);
+	}
+	static u_char *allocBuffer(size_t size);
+	static void freeBuffer(u_char *buffer);
+	static size_t alignSize(size_t size) {
+		return((size + ASYNC_DIRECT_FILE_ALIGN - 1) & ~(size_t)(ASYNC_DIRECT_FILE_ALIGN - 1));
+	}
+	static u_int64_t alignOffset(u_int64_t offset) {
+		return(offset & ~(u_int64_t)(ASYNC_DIRECT_FILE_ALIGN - 1));
+	}
+private:
+	bool readSync(u_char *buffer, size_t size, u_int64_t offset);
+	void readAhead(u_int64_t offset, u_int64_t fileSize);
+	bool waitReadAhead();
+	bool reapCompletions(bool wait);
+	void completeRequest(sRequest *request, int rslt);
+private:
+	std::string fileName;
+	int fd;
+	bool direct;
+	unsigned queueDepth;
+	size_t readAheadSize;
+	#ifdef HAVE_LIBURING
+	struct io_uring ring;
+	bool ringOk;
+	#endif
+	unsigned pendingWrites;
+	std::map<u_int64_t, sRequest*> pendingWriteRequests;
+	u_int64_t writeEnd;
+	bool error;
+	u_char *window;
+	size_t windowCapacity;
+	u_int64_t windowOffset;
+	size_t windowSize;
+	sRequest *readAheadRequest;
+	bool readAheadDone;
+	int readAheadResult;
+};
+
+
+#endif //ASYNC_DIRECT_FILE_H
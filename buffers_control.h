@@ -9,6 +9,8 @@ public:
 		pcap_store_queue__sizeOfBlocksInMemory = 0;
 		PcapQueue_readFromFifo__blockStoreTrash_size = 0;
 		AsyncClose__sizeOfDataInMemory = 0;
+		pcap_block_pool__allocSize = 0;
+		pcap_block_pool__useSize = 0;
 		PcapQueue_readFromFifo__blockStoreTrash_minTime = -1;
 		PcapQueue_readFromFifo__blockStoreTrash_maxTime = -1;
 	}
@@ -66,11 +68,34 @@ public:
 	void sub__AsyncClose__sizeOfDataInMemory(size_t size) {
 		__sync_fetch_and_sub(&this->AsyncClose__sizeOfDataInMemory, size);
 	}
+	//pcap_block_pool (recycled buffers of blocks - included in sizes above if used)
+	u_int64_t get__pcap_block_pool__allocSize() {
+		return(this->pcap_block_pool__allocSize);
+	}
+	void add__pcap_block_pool__allocSize(size_t size) {
+		__sync_fetch_and_add(&this->pcap_block_pool__allocSize, size);
+	}
+	void sub__pcap_block_pool__allocSize(size_t size) {
+		__sync_fetch_and_sub(&this->pcap_block_pool__allocSize, size);
+	}
+	u_int64_t get__pcap_block_pool__useSize() {
+		return(this->pcap_block_pool__useSize);
+	}
+	void add__pcap_block_pool__useSize(size_t size) {
+		__sync_fetch_and_add(&this->pcap_block_pool__useSize, size);
+	}
+	void sub__pcap_block_pool__useSize(size_t size) {
+		__sync_fetch_and_sub(&this->pcap_block_pool__useSize, size);
+	}
 	//
 	bool check__pcap_store_queue__push() {
 		return(check() &&
 		       pcap_store_queue__sizeOfBlocksInMemory + PcapQueue_readFromFifo__blockStoreTrash_size < max_buffer_mem * 0.9);
 	}
+	bool check__pcap_store_queue__push_reserve() {
+		return(check() &&
+		       pcap_store_queue__sizeOfBlocksInMemory + PcapQueue_readFromFifo__blockStoreTrash_size < max_buffer_mem);
+	}
 	bool check__AsyncClose__add(size_t add) {
 		return((check() &&
 		        AsyncClose__sizeOfDataInMemory + add < max_buffer_mem * 0.9) ||
@@ -93,6 +118,11 @@ public:
 	double getPercUseAsync() {
 		return((double)AsyncClose__sizeOfDataInMemory / (max_buffer_mem * 0.9) * 100);
 	}
+	double getPercUsePool() {
+		return(pcap_block_pool__allocSize ?
+			(double)pcap_block_pool__useSize / pcap_block_pool__allocSize * 100 :
+			0);
+	}
 	//
 	void PcapQueue_readFromFifo__blockStoreTrash_time_set(unsigned long time) {
 		if(PcapQueue_readFromFifo__blockStoreTrash_minTime == (unsigned long)-1 ||
@@ -118,6 +148,8 @@ private:
 	volatile u_int64_t pcap_store_queue__sizeOfBlocksInMemory;
 	volatile u_int64_t PcapQueue_readFromFifo__blockStoreTrash_size;
 	volatile u_int64_t AsyncClose__sizeOfDataInMemory;
+	volatile u_int64_t pcap_block_pool__allocSize;
+	volatile u_int64_t pcap_block_pool__useSize;
 	unsigned long PcapQueue_readFromFifo__blockStoreTrash_minTime;
 	unsigned long PcapQueue_readFromFifo__blockStoreTrash_maxTime;
 };
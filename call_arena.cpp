@@ -0,0 +1,143 @@
+#include <sstream>
+#include <iomanip>
+
+#include "tools.h"
+#include "call_arena.h"
+
+
+using namespace std;
+
+
+#define CALL_ARENA_ALIGN_SIZE(size) (((size) + CALL_ARENA_ALIGN - 1) & ~(size_t)(CALL_ARENA_ALIGN - 1))
+#define CALL_ARENA_CHUNK_HEADER_SIZE CALL_ARENA_ALIGN_SIZE(sizeof(sChunk))
+
+
+bool cCallArena::enable = false;
+size_t cCallArena::chunkSize = CALL_ARENA_CHUNK_SIZE;
+volatile u_int64_t cCallArena::stat_calls = 0;
+volatile u_int64_t cCallArena::stat_allocs = 0;
+volatile u_int64_t cCallArena::stat_alloc_bytes = 0;
+volatile u_int64_t cCallArena::stat_chunk_bytes = 0;
+volatile u_int64_t cCallArena::stat_heap_allocs = 0;
+volatile u_int64_t cCallArena::stat_destroy_arena_count = 0;
+volatile u_int64_t cCallArena::stat_destroy_arena_us = 0;
+volatile u_int64_t cCallArena::stat_destroy_heap_count = 0;
+volatile u_int64_t cCallArena::stat_destroy_heap_us = 0;
+
+
+cCallArena::cCallArena() {
+	chunks = NULL;
+	allocCount = 0;
+	allocBytes = 0;
+	_sync = 0;
+}
+
+cCallArena::~cCallArena() {
+	release();
+}
+
+void cCallArena::setEnable(bool enable, size_t expectedContentSize) {
+	cCallArena::enable = enable;
+	if(expectedContentSize) {
+		chunkSize = CALL_ARENA_CHUNK_HEADER_SIZE + CALL_ARENA_ALIGN_SIZE(expectedContentSize);
+	}
+}
+
+void *cCallArena::alloc(size_t size) {
+	if(!enable) {
+		__sync_fetch_and_add(&stat_heap_allocs, 1);
+		return(NULL);
+	}
+	size = CALL_ARENA_ALIGN_SIZE(size);
+	lock();
+	if(!chunks || chunks->used + size > chunks->size) {
+		// chunks grow linearly - the unused rest of a chunk is overhead of each call
+		size_t chunkSize = cCallArena::chunkSize;
+		if(chunkSize < CALL_ARENA_CHUNK_HEADER_SIZE + size) {
+			chunkSize = CALL_ARENA_CHUNK_HEADER_SIZE + size;
+		}
+		sChunk *chunk = (sChunk*)(new FILE_LINE(0) u_char[chunkSize]);
+		chunk->next = chunks;
+		chunk->size = chunkSize;
+		chunk->used = CALL_ARENA_CHUNK_HEADER_SIZE;
+		chunks = chunk;
+		if(!allocCount) {
+			__sync_fetch_and_add(&stat_calls, 1);
+		}
+		__sync_fetch_and_add(&stat_chunk_bytes, chunkSize);
+	}
+	void *ptr = (u_char*)chunks + chunks->used;
+	chunks->used += size;
+	++allocCount;
+	allocBytes += size;
+	unlock();
+	__sync_fetch_and_add(&stat_allocs, 1);
+	__sync_fetch_and_add(&stat_alloc_bytes, size);
+	return(ptr);
+}
+
+bool cCallArena::contains(void *ptr) {
+	if(!ptr) {
+		return(false);
+	}
+	lock();
+	for(sChunk *chunk = chunks; chunk; chunk = chunk->next) {
+		if((u_char*)ptr >= (u_char*)chunk + CALL_ARENA_CHUNK_HEADER_SIZE &&
+		   (u_char*)ptr < (u_char*)chunk + chunk->used) {
+			unlock();
+			return(true);
+		}
+	}
+	unlock();
+	return(false);
+}
+
+void cCallArena::release() {
+	lock();
+	while(chunks) {
+		sChunk *next = chunks->next;
+		delete [] (u_char*)chunks;
+		chunks = next;
+	}
+	unlock();
+}
+
+void cCallArena::addDestroyStat(u_int64_t time_us, bool arena) {
+	if(arena) {
+		__sync_fetch_and_add(&stat_destroy_arena_count, 1);
+		__sync_fetch_and_add(&stat_destroy_arena_us, time_us);
+	} else {
+		__sync_fetch_and_add(&stat_destroy_heap_count, 1);
+		__sync_fetch_and_add(&stat_destroy_heap_us, time_us);
+	}
+}
+
+string cCallArena::getStatString() {
+	ostringstream outStr;
+	outStr << fixed << setprecision(1)
+	       << left << setw(35) << "call_arena calls" << " : "
+	       << right << setw(16) << stat_calls << endl
+	       << left << setw(35) << "call_arena allocs" << " : "
+	       << right << setw(16) << stat_allocs << endl
+	       << left << setw(35) << "call_arena allocs per call" << " : "
+	       << right << setw(16) << (stat_calls ? (double)stat_allocs / stat_calls : 0.) << endl
+	       << left << setw(35) << "call_arena alloc bytes" << " : "
+	       << right << setw(16) << addThousandSeparators(stat_alloc_bytes) << endl
+	       << left << setw(35) << "call_arena chunk bytes" << " : "
+	       << right << setw(16) << addThousandSeparators(stat_chunk_bytes) << endl
+	       << left << setw(35) << "call_arena chunk bytes per call" << " : "
+	       << right << setw(16) << (stat_calls ? (double)stat_chunk_bytes / stat_calls : 0.) << endl
+	       << left << setw(35) << "call_arena chunk size" << " : "
+	       << right << setw(16) << chunkSize << endl
+	       << left << setw(35) << "call_arena heap allocs" << " : "
+	       << right << setw(16) << stat_heap_allocs << endl
+	       << left << setw(35) << "calls_deletequeue arena calls" << " : "
+	       << right << setw(16) << stat_destroy_arena_count << endl
+	       << left << setw(35) << "calls_deletequeue arena avg us" << " : "
+	       << right << setw(16) << (stat_destroy_arena_count ? (double)stat_destroy_arena_us / stat_destroy_arena_count : 0.) << endl
+	       << left << setw(35) << "calls_deletequeue heap calls" << " : "
+	       << right << setw(16) << stat_destroy_heap_count << endl
+	       << left << setw(35) << "calls_deletequeue heap avg us" << " : "
+	       << right << setw(16) << (stat_destroy_heap_count ? (double)stat_destroy_heap_us / stat_destroy_heap_count : 0.) << endl;
+	return(outStr.str());
+}
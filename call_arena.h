@@ -0,0 +1,79 @@
+#ifndef CALL_ARENA_H
+#define CALL_ARENA_H
+
+
+#include <new>
+#include <string>
+#include <sys/types.h>
+
+#include "sync.h"
+
+
+#define CALL_ARENA_CHUNK_SIZE (16 * 1024)
+#define CALL_ARENA_ALIGN 16
+
+
+/*
+ * Per-call bump allocator for sub-objects with lifetime of call (rtp streams, srtp contexts).
+ * Memory is taken from chunks allocated on demand and released at once with the call.
+ * Chunk is sized for expected content of typical call (setEnable) and further chunks have the same size,
+ * memory of objects destroyed before the end of call (removeRTP) is not reused.
+ * Objects must be destroyed by destroy (destructor only) - alloc returns NULL when arena is disabled
+ * and the caller uses the heap, destroy recognizes such objects by contains and deletes them.
+ */
+class cCallArena {
+private:
+	struct sChunk {
+		sChunk *next;
+		size_t size;
+		size_t used;
+	};
+public:
+	cCallArena();
+	~cCallArena();
+	void *alloc(size_t size);
+	bool contains(void *ptr);
+	template<class T> void destroy(T *obj) {
+		if(contains(obj)) {
+			obj->~T();
+		} else {
+			delete obj;
+		}
+	}
+	void release();
+	u_int32_t getAllocCount() {
+		return(allocCount);
+	}
+	static void setEnable(bool enable, size_t expectedContentSize = 0);
+	static bool isEnable() {
+		return(enable);
+	}
+	static void addDestroyStat(u_int64_t time_us, bool arena);
+	static std::string getStatString();
+private:
+	void lock() {
+		__SYNC_LOCK_USLEEP(_sync, 10);
+	}
+	void unlock() {
+		__SYNC_UNLOCK(_sync);
+	}
+private:
+	sChunk *chunks;
+	u_int32_t allocCount;
+	u_int64_t allocBytes;
+	volatile int _sync;
+	static bool enable;
+	static size_t chunkSize;
+	static volatile u_int64_t stat_calls;
+	static volatile u_int64_t stat_allocs;
+	static volatile u_int64_t stat_alloc_bytes;
+	static volatile u_int64_t stat_chunk_bytes;
+	static volatile u_int64_t stat_heap_allocs;
+	static volatile u_int64_t stat_destroy_arena_count;
+	static volatile u_int64_t stat_destroy_arena_us;
+	static volatile u_int64_t stat_destroy_heap_count;
+	static volatile u_int64_t stat_destroy_heap_us;
+};
+
+
+#endif //CALL_ARENA_H
@@ -165,6 +165,8 @@ extern int opt_rtpfromsdp_onlysip;
 extern int opt_rtpfromsdp_onlysip_skinny;
 extern int opt_rtp_check_both_sides_by_sdp;
 extern int opt_hash_modify_queue_length_ms;
+extern bool opt_rtp_hash_lockfree;
+extern bool opt_cleanup_timer_wheel;
 extern int opt_mysql_enable_multiple_rows_insert;
 extern int opt_mysql_max_multiple_rows_insert;
 extern PreProcessPacket *preProcessPacketCallX[];
@@ -289,6 +291,7 @@ Call_abstract::Call_abstract(int call_type, u_int64_t time_us) {
 	user_data = NULL;
 	user_data_type = 0;
 	chunkBuffersCount = 0;
+	cleanup_timer.data = this;
 }
 
 bool 
@@ -519,8 +522,8 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 	first_response_200_time_us = 0;
 	a_ua[0] = '\0';
 	b_ua[0] = '\0';
-	memset(rtpmap, 0, sizeof(rtpmap));
-	memset(rtpmap_used_flags, 0, sizeof(rtpmap_used_flags));
+	setMedia(NULL);
+	__sync_fetch_and_add(&stat_calls, 1);
 	rtp_cur[0] = NULL;
 	rtp_cur[1] = NULL;
 	rtp_prev[0] = NULL;
@@ -581,6 +584,7 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 	rtppacketsinqueue = 0;
 	end_call_rtp = 0;
 	end_call_hash_removed = 0;
+	end_call_hash_rcu_epoch = 0;
 	push_call_to_calls_queue = 0;
 	push_register_to_registers_queue = 0;
 	message = NULL;
@@ -696,6 +700,9 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 }
 
 u_int64_t Call::counter_s = 0;
+sCallMedia Call::media_empty;
+volatile u_int64_t Call::stat_calls = 0;
+volatile u_int64_t Call::stat_calls_media = 0;
 
 void
 Call::hashRemove(struct timeval *ts, bool useHashQueueCounter) {
@@ -893,7 +900,7 @@ Call::removeRTP() {
 	for(int i = 0; i < MAX_SSRC_PER_CALL; i++) {
 	// lets check whole array as there can be holes due rtp[0] <=> rtp[1] swaps in mysql rutine
 		if(rtp[i]) {
-			delete rtp[i];
+			arena.destroy(rtp[i]);
 			rtp[i] = NULL;
 		}
 	}
@@ -926,7 +933,7 @@ Call::~Call(){
 	for(int i = 0; i < MAX_SSRC_PER_CALL; i++) {
 		// lets check whole array as there can be holes due rtp[0] <=> rtp[1] swaps in mysql rutine
 		if(rtp[i]) {
-			delete rtp[i];
+			arena.destroy(rtp[i]);
 		}
 	}
 	
@@ -967,8 +974,23 @@ Call::~Call(){
 	}
 	
 	for(map<int, class RTPsecure*>::iterator iter = rtp_secure_map.begin(); iter != rtp_secure_map.end(); iter++) {
-		delete iter->second;
+		arena.destroy(iter->second);
+	}
+	
+	if(media) {
+		delete media;
+		__sync_fetch_and_sub(&stat_calls_media, 1);
 	}
+	__sync_fetch_and_sub(&stat_calls, 1);
+}
+
+void
+Call::setMedia(sCallMedia *media) {
+	this->media = media;
+	sCallMedia *media_use = media ? media : &media_empty;
+	ip_port = media_use->ip_port;
+	rtpmap = media_use->rtpmap;
+	rtpmap_used_flags = media_use->rtpmap_used_flags;
 }
 
 void
@@ -1031,6 +1053,7 @@ Call::add_ip_port(vmIP sip_src_addr, vmIP addr, ip_port_call_info::eTypeAddr typ
 		return -1;
 	}
 
+	allocMedia();
 	this->ip_port[ipport_n].sip_src_addr = sip_src_addr;
 	this->ip_port[ipport_n].addr = addr;
 	this->ip_port[ipport_n].type_addr = type_addr;
@@ -1315,7 +1338,10 @@ Call::read_rtcp(packet_s *packetS, int iscaller, char enable_save_packet) {
 		   this->ip_port[index_call_ip_port_by_src].rtp_crypto_config_list &&
 		   this->ip_port[index_call_ip_port_by_src].rtp_crypto_config_list->size()) {
 			if(!rtp_secure_map[index_call_ip_port_by_src]) {
-				rtp_secure_map[index_call_ip_port_by_src] = 
+				void *rtp_secure_mem = arena.alloc(sizeof(RTPsecure));
+				rtp_secure_map[index_call_ip_port_by_src] = rtp_secure_mem ?
+					new (rtp_secure_mem) RTPsecure(opt_use_libsrtp ? RTPsecure::mode_libsrtp : RTPsecure::mode_native,
+								       this, index_call_ip_port_by_src) :
 					new FILE_LINE(0) RTPsecure(opt_use_libsrtp ? RTPsecure::mode_libsrtp : RTPsecure::mode_native,
 								   this, index_call_ip_port_by_src);
 				if(sverb.log_srtp_callid && !log_srtp_callid) {
@@ -1404,6 +1430,7 @@ Call::_read_rtp(packet_s *packetS, int iscaller, bool find_by_dest, bool stream_
 
 	if(first_rtp_time_us == 0) {
 		first_rtp_time_us = getTimeUS(packetS->header_pt);
+		calltable->cleanupTimerUpdate(this);
 	}
 	
 	unsigned int curSSRC;
@@ -1605,7 +1632,10 @@ read:
 			while(__sync_lock_test_and_set(&rtplock, 1)) {
 				USLEEP(100);
 			}
-			rtp[ssrc_n] = new FILE_LINE(0) RTP(packetS->sensor_id_(), packetS->sensor_ip);
+			void *rtp_mem = arena.alloc(sizeof(RTP));
+			rtp[ssrc_n] = rtp_mem ?
+					new (rtp_mem) RTP(packetS->sensor_id_(), packetS->sensor_ip) :
+					new FILE_LINE(0) RTP(packetS->sensor_id_(), packetS->sensor_ip);
 			rtp[ssrc_n]->call_owner = this;
 			rtp[ssrc_n]->ssrc2 = curSSRC;
 			rtp[ssrc_n]->ssrc_index = ssrc_n; 
@@ -1705,7 +1735,10 @@ read:
 		}
 		*/
 		
-		rtp[ssrc_n] = new FILE_LINE(1001) RTP(packetS->sensor_id_(), packetS->sensor_ip);
+		void *rtp_mem = arena.alloc(sizeof(RTP));
+		rtp[ssrc_n] = rtp_mem ?
+				new (rtp_mem) RTP(packetS->sensor_id_(), packetS->sensor_ip) :
+				new FILE_LINE(1001) RTP(packetS->sensor_id_(), packetS->sensor_ip);
 		if(exists_crypto_suite_key && 
 		   (opt_srtp_rtp_decrypt || 
 		    (opt_srtp_rtp_audio_decrypt && (flags & FLAG_SAVEAUDIO)) || 
@@ -1721,7 +1754,10 @@ read:
 			   this->ip_port[index_call_ip_port_by_src].rtp_crypto_config_list &&
 			   this->ip_port[index_call_ip_port_by_src].rtp_crypto_config_list->size()) {
 				if(!rtp_secure_map[index_call_ip_port_by_src]) {
-					rtp_secure_map[index_call_ip_port_by_src] = 
+					void *rtp_secure_mem = arena.alloc(sizeof(RTPsecure));
+					rtp_secure_map[index_call_ip_port_by_src] = rtp_secure_mem ?
+						new (rtp_secure_mem) RTPsecure(opt_use_libsrtp ? RTPsecure::mode_libsrtp : RTPsecure::mode_native,
+									       this, index_call_ip_port_by_src) :
 						new FILE_LINE(0) RTPsecure(opt_use_libsrtp ? RTPsecure::mode_libsrtp : RTPsecure::mode_native,
 									   this, index_call_ip_port_by_src);
 					if(sverb.log_srtp_callid && !log_srtp_callid) {
@@ -1782,7 +1818,9 @@ read:
 		if(opt_rtpmap_by_callerd) {
 			unsigned index_rtpmap = isFillRtpMap(iscaller) ? iscaller : !iscaller;
 			memcpy(this->rtp[ssrc_n]->rtpmap, rtpmap[index_rtpmap], MAX_RTPMAP * sizeof(RTPMAP));
-			rtpmap_used_flags[index_rtpmap] = true;
+			if(media) {
+				rtpmap_used_flags[index_rtpmap] = true;
+			}
 		} else {
 			if(rtp[ssrc_n]->index_call_ip_port >= 0 && isFillRtpMap(rtp[ssrc_n]->index_call_ip_port)) {
 				memcpy(this->rtp[ssrc_n]->rtpmap, rtpmap[rtp[ssrc_n]->index_call_ip_port], MAX_RTPMAP * sizeof(RTPMAP));
@@ -3593,12 +3631,14 @@ void Call::removeCallIdMap() {
 		callMAPIT = ((Calltable*)calltable)->calls_listMAP.find(call_id);
 		if(callMAPIT != ((Calltable*)calltable)->calls_listMAP.end()) {
 			((Calltable*)calltable)->calls_listMAP.erase(callMAPIT);
+			((Calltable*)calltable)->calls_by_call_id.remove(call_id);
 		}
 		if(call_id_alternative) {
 			for(map<string, bool>::iterator iter = call_id_alternative->begin(); iter != call_id_alternative->end(); iter++) {
 				callMAPIT = ((Calltable*)calltable)->calls_listMAP.find(iter->first);
 				if(callMAPIT != ((Calltable*)calltable)->calls_listMAP.end()) {
 					((Calltable*)calltable)->calls_listMAP.erase(callMAPIT);
+					((Calltable*)calltable)->calls_by_call_id.remove(iter->first);
 				}
 			}
 		}
@@ -7769,6 +7809,33 @@ Call::dump(){
 	printf("-end call dump  %p----------------------------\n", this);
 }
 
+string
+Call::getMemoryStatString() {
+	u_int64_t calls = stat_calls;
+	u_int64_t calls_media = stat_calls_media;
+	size_t bytes_before = sizeof(Call) + sizeof(sCallMedia)
+			      - sizeof(ip_port_call_info*) - sizeof(sCallMedia*) - sizeof(RTPMAP(*)[MAX_RTPMAP]) - sizeof(bool*);
+	ostringstream outStr;
+	outStr << fixed << setprecision(0)
+	       << left << setw(35) << "call bytes before hot/cold split" << " : "
+	       << right << setw(16) << bytes_before << endl
+	       << left << setw(35) << "call hot bytes" << " : "
+	       << right << setw(16) << sizeof(Call) << endl
+	       << left << setw(35) << "call media (cold) bytes" << " : "
+	       << right << setw(16) << sizeof(sCallMedia) << endl
+	       << left << setw(35) << "calls" << " : "
+	       << right << setw(16) << calls << endl
+	       << left << setw(35) << "calls with media" << " : "
+	       << right << setw(16) << calls_media << endl
+	       << left << setw(35) << "call avg bytes" << " : "
+	       << right << setw(16) << (calls ? (double)(calls * sizeof(Call) + calls_media * sizeof(sCallMedia)) / calls : 0.) << endl
+	       << left << setw(35) << "calls bytes (before split)" << " : "
+	       << right << setw(16) << addThousandSeparators(calls * bytes_before) << endl
+	       << left << setw(35) << "calls bytes" << " : "
+	       << right << setw(16) << addThousandSeparators(calls * sizeof(Call) + calls_media * sizeof(sCallMedia)) << endl;
+	return(outStr.str());
+}
+
 void Call::atFinish() {
 	if(!(typeIs(INVITE) || typeIs(MESSAGE))) {
 		return;
@@ -8267,6 +8334,7 @@ void Ss7::processData(packet_s_stack *packetS, sParseData *data) {
 		break;
 	}
 	last_time_us = getTimeUS(packetS->header_pt);
+	calltable->cleanupTimerUpdate(this);
 	if(!pcap.isOpen()) {
 		string pathfilename = get_pathfilename(tsf_ss7);
 		pcap.open(tsf_ss7, pathfilename.c_str(), useHandle, useDlt);
@@ -8281,6 +8349,7 @@ void Ss7::processData(packet_s_stack *packetS, sParseData *data) {
 }
 
 void Ss7::pushToQueue(string *ss7_id) {
+	calltable->cleanupTimerRelease(this, &calltable->ss7_timer_wheel);
 	calltable->lock_process_ss7_queue();
 	calltable->ss7_queue.push_back(this);
 	calltable->unlock_process_ss7_queue();
@@ -8431,6 +8500,107 @@ void Ss7::init() {
 }
 
 
+cCallIdTable::cCallIdTable() {
+	for(unsigned i = 0; i < CALLID_TABLE_SHARDS; i++) {
+		shards[i].size = CALLID_TABLE_SHARD_INIT_SIZE;
+		shards[i].items = new FILE_LINE(0) sItem[shards[i].size];
+		memset(shards[i].items, 0, sizeof(sItem) * shards[i].size);
+		shards[i].count = 0;
+		shards[i]._sync = 0;
+	}
+}
+
+cCallIdTable::~cCallIdTable() {
+	for(unsigned i = 0; i < CALLID_TABLE_SHARDS; i++) {
+		for(unsigned j = 0; j < shards[i].size; j++) {
+			if(shards[i].items[j].key) {
+				delete [] shards[i].items[j].key;
+			}
+		}
+		delete [] shards[i].items;
+	}
+}
+
+void cCallIdTable::set(sShard *shard, const char *key, unsigned length, u_int32_t hash, Call *call) {
+	unsigned mask = shard->size - 1;
+	unsigned pos = hash & mask;
+	while(shard->items[pos].key) {
+		sItem *item = &shard->items[pos];
+		if(item->hash == hash && item->length == length && !memcmp(item->key, key, length)) {
+			item->call = call;
+			return;
+		}
+		pos = (pos + 1) & mask;
+	}
+	if((shard->count + 1) * 2 > shard->size) {
+		resize(shard, shard->size * 2);
+		mask = shard->size - 1;
+		pos = hash & mask;
+		while(shard->items[pos].key) {
+			pos = (pos + 1) & mask;
+		}
+	}
+	sItem *item = &shard->items[pos];
+	item->key = new FILE_LINE(0) char[length ? length : 1];
+	memcpy(item->key, key, length);
+	item->length = length;
+	item->hash = hash;
+	item->call = call;
+	++shard->count;
+}
+
+void cCallIdTable::remove(sShard *shard, const char *key, unsigned length, u_int32_t hash) {
+	unsigned mask = shard->size - 1;
+	unsigned pos = hash & mask;
+	while(true) {
+		sItem *item = &shard->items[pos];
+		if(!item->key) {
+			return;
+		}
+		if(item->hash == hash && item->length == length && !memcmp(item->key, key, length)) {
+			break;
+		}
+		pos = (pos + 1) & mask;
+	}
+	delete [] shard->items[pos].key;
+	// backward shift - following items of the cluster are moved to keep them reachable without tombstones
+	unsigned hole = pos;
+	unsigned next = pos;
+	while(true) {
+		next = (next + 1) & mask;
+		if(!shard->items[next].key) {
+			break;
+		}
+		unsigned home = shard->items[next].hash & mask;
+		if(((next - home) & mask) >= ((next - hole) & mask)) {
+			shard->items[hole] = shard->items[next];
+			hole = next;
+		}
+	}
+	memset(&shard->items[hole], 0, sizeof(sItem));
+	--shard->count;
+}
+
+void cCallIdTable::resize(sShard *shard, unsigned new_size) {
+	sItem *old_items = shard->items;
+	unsigned old_size = shard->size;
+	shard->items = new FILE_LINE(0) sItem[new_size];
+	memset(shard->items, 0, sizeof(sItem) * new_size);
+	shard->size = new_size;
+	unsigned mask = new_size - 1;
+	for(unsigned i = 0; i < old_size; i++) {
+		if(old_items[i].key) {
+			unsigned pos = old_items[i].hash & mask;
+			while(shard->items[pos].key) {
+				pos = (pos + 1) & mask;
+			}
+			shard->items[pos] = old_items[i];
+		}
+	}
+	delete [] old_items;
+}
+
+
 /* constructor */
 Calltable::Calltable(SqlDb *sqlDb) {
 	/*
@@ -8452,6 +8622,13 @@ Calltable::Calltable(SqlDb *sqlDb) {
 	memset(calls_hash, 0x0, sizeof(calls_hash));
 	#endif
 	_sync_lock_calls_hash = 0;
+	#if NEW_RTP_FIND__NODES || NEW_RTP_FIND__PORT_NODES || NEW_RTP_FIND__MAP_LIST || HASH_RTP_FIND__LIST
+	calls_hash_lockfree = false;
+	#else
+	calls_hash_lockfree = opt_rtp_hash_lockfree;
+	#endif
+	// calls_list with alternative call-ids is walked in full
+	cleanup_timer_wheel = opt_cleanup_timer_wheel && !opt_call_id_alternative[0];
 	_sync_lock_calls_listMAP = 0;
 	_sync_lock_calls_mergeMAP = 0;
 	_sync_lock_registers_listMAP = 0;
@@ -9004,14 +9181,14 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 						if(prev) {
 							prev->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							node_call = prev->next;
 							continue;
 						} else {
 							//removing first node
 							node->calls = node->calls->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							node_call = node->calls;
 							continue;
 						}
@@ -9026,11 +9203,18 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 				}
 				if(!found) {
 					if(opt_sdp_multiplication == 0 && count == 1 && node->calls && node->calls->call) {
-						--node->calls->call->rtp_ip_port_counter;
-						node->calls->call = call;
-						node->calls->iscaller = iscaller;
-						node->calls->is_rtcp = is_rtcp;
-						node->calls->sdp_flags = sdp_flags;
+						// replaced by new item - lock-free readers can use the previous one
+						node_call_rtp *node_call_old = node->calls;
+						node_call_rtp *node_call_new = new FILE_LINE(1007) node_call_rtp;
+						node_call_new->next = node_call_old->next;
+						node_call_new->call = call;
+						node_call_new->iscaller = iscaller;
+						node_call_new->is_rtcp = is_rtcp;
+						node_call_new->sdp_flags = sdp_flags;
+						__sync_synchronize();
+						node->calls = node_call_new;
+						--node_call_old->call->rtp_ip_port_counter;
+						hashFree(node_call_old);
 						++call->rtp_ip_port_counter;
 					} else {
 						if(opt_sdp_multiplication > 0 && count >= opt_sdp_multiplication) {
@@ -9069,6 +9253,7 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 						node_call_new->sdp_flags = sdp_flags;
 
 						//insert at first position
+						__sync_synchronize();
 						node->calls = node_call_new;
 						++call->rtp_ip_port_counter;
 					}
@@ -9107,6 +9292,7 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 		node->port = port;
 		node->next = calls_hash[h];
 		node->calls = node_call;
+		__sync_synchronize();
 		calls_hash[h] = node;
 	#endif
 	++call->rtp_ip_port_counter;
@@ -9338,12 +9524,12 @@ Calltable::_hashRemove(Call *call, vmIP addr, vmPort port, bool rtcp, bool use_l
 						if (prev_call == NULL) {
 							node->calls = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							++removeCounter;
 						} else {
 							prev_call->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							++removeCounter;
 						}
 						break;
@@ -9361,10 +9547,10 @@ Calltable::_hashRemove(Call *call, vmIP addr, vmPort port, bool rtcp, bool use_l
 				// node now contains no calls so we can remove it 
 				if (prev == NULL) {
 					calls_hash[h] = node->next;
-					delete node;
+					hashFree(node);
 				} else {
 					prev->next = node->next;
-					delete node;
+					hashFree(node);
 				}
 			}
 			break;
@@ -9454,12 +9640,12 @@ Calltable::_hashRemove(Call *call, bool use_lock) {
 						if(prev_node_call == NULL) {
 							node->calls = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							node_call = node->calls; 
 						} else {
 							prev_node_call->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashFree(node_call);
 							node_call = prev_node_call->next;
 						}
 					} else {
@@ -9477,11 +9663,11 @@ Calltable::_hashRemove(Call *call, bool use_lock) {
 			) {
 				if(prev_node == NULL) {
 					calls_hash[h] = node->next;
-					delete node;
+					hashFree(node);
 					node = calls_hash[h];
 				} else {
 					prev_node->next = node->next;
-					delete node;
+					hashFree(node);
 					node = prev_node->next;
 				}
 			} else {
@@ -9523,6 +9709,9 @@ Calltable::_applyHashModifyQueue(struct timeval *ts, bool setBegin, bool use_loc
 					--iter->call->hash_queue_counter;
 				}
 			}
+			if(calls_hash_lockfree) {
+				calls_hash_rcu.reclaim();
+			}
 			if (use_lock_calls_hash) unlock_calls_hash();
 			hash_modify_queue.clear();
 			hash_modify_queue_begin_ms = 0;
@@ -9911,8 +10100,11 @@ Calltable::destroyCallsIfPcapsClosed() {
 		for(size_t i = 0; i < size;) {
 			Call *call = this->calls_deletequeue[i];
 			if(call->isPcapsClose() && call->isEmptyChunkBuffersCount()) {
+				u_int64_t destroy_start_us = getTimeUS();
+				bool destroy_arena = call->arena.getAllocCount() > 0;
 				call->destroyCall();
 				delete call;
+				cCallArena::addDestroyStat(getTimeUS() - destroy_start_us, destroy_arena);
 				this->calls_deletequeue.erase(this->calls_deletequeue.begin() + i);
 				--size;
 			} else {
@@ -10234,15 +10426,23 @@ Calltable::add(int call_type, char *call_id, unsigned long call_id_len, vector<s
 		lock_registers_listMAP();
 		registers_listMAP[call_idS] = newcall;
 		registers_counter++;
+		if(cleanup_timer_wheel) {
+			cleanupTimerAdd(&registers_timer_wheel, &newcall->cleanup_timer, getCleanupTimeRegister(newcall), TIME_US_TO_S(time_us));
+		}
 		unlock_registers_listMAP();
 	} else {
 		lock_calls_listMAP();
 		calls_listMAP[call_idS] = newcall;
+		calls_by_call_id.set(call_idS, newcall);
+		if(cleanup_timer_wheel) {
+			cleanupTimerAdd(&calls_timer_wheel, &newcall->cleanup_timer, getCleanupTime(newcall), TIME_US_TO_S(time_us));
+		}
 		if(opt_call_id_alternative[0]) {
 			calls_list.push_back(newcall);
 			if(call_id_alternative) {
 				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
 					calls_listMAP[(*call_id_alternative)[i]] = newcall;
+					calls_by_call_id.set((*call_id_alternative)[i], newcall);
 				}
 			}
 		}
@@ -10261,6 +10461,9 @@ Calltable::add_ss7(packet_s_stack *packetS, Ss7::sParseData *data) {
 	string ss7_id = data->ss7_id();
 	lock_ss7_listMAP();
 	ss7_listMAP[ss7_id] = newss7;
+	if(cleanup_timer_wheel) {
+		cleanupTimerAdd(&ss7_timer_wheel, &newss7->cleanup_timer, getCleanupTimeSs7(newss7), packetS->header_pt->ts.tv_sec);
+	}
 	unlock_ss7_listMAP();
 	return(newss7);
 }
@@ -10302,6 +10505,148 @@ Calltable::add_mgcp(sMgcpRequest *request, time_t time, vmIP saddr, vmPort sport
 }
 
 
+u_int32_t
+Calltable::getCleanupTime(Call *call) {
+	// the same conditions as in cleanup_calls_isClose - the earliest time when some of them is met
+	if(call->force_close ||
+	   !(call->typeIs(SKINNY_NEW) ||
+	     call->typeIs(MGCP) ||
+	     call->in_preprocess_queue_before_process_packet <= 0)) {
+		return(0);
+	}
+	u_int32_t first_packet_time_s = call->get_first_packet_time_s();
+	u_int32_t last_packet_time_s = call->get_last_packet_time_s();
+	u_int32_t cleanupTime = first_packet_time_s + absolute_timeout + 1;
+	if(call->destroy_call_at != 0) {
+		cleanupTime = min(cleanupTime, (u_int32_t)call->destroy_call_at);
+	}
+	if(call->destroy_call_at_bye != 0) {
+		cleanupTime = min(cleanupTime, (u_int32_t)call->destroy_call_at_bye);
+	}
+	if(call->destroy_call_at_bye_confirmed != 0) {
+		cleanupTime = min(cleanupTime, (u_int32_t)call->destroy_call_at_bye_confirmed);
+	}
+	if(call->first_rtp_time_us) {
+		cleanupTime = min(cleanupTime, last_packet_time_s + rtptimeout + 1);
+	} else {
+		cleanupTime = min(cleanupTime, first_packet_time_s + sipwithoutrtptimeout + 1);
+		if(!call->seenRES18X && !call->seenRES2XX) {
+			cleanupTime = min(cleanupTime, first_packet_time_s + 300 + 1);
+		}
+	}
+	if(call->oneway == 1) {
+		cleanupTime = min(cleanupTime, last_packet_time_s + opt_onewaytimeout + 1);
+	}
+	return(cleanupTime);
+}
+
+u_int32_t
+Calltable::getCleanupTimeRegister(Call *reg) {
+	if(reg->force_close) {
+		return(0);
+	}
+	u_int32_t first_packet_time_s = reg->get_first_packet_time_s();
+	u_int32_t cleanupTime = first_packet_time_s + absolute_timeout + 1;
+	if(reg->destroy_call_at != 0) {
+		cleanupTime = min(cleanupTime, (u_int32_t)reg->destroy_call_at);
+	}
+	if(!reg->seenRES18X && !reg->seenRES2XX) {
+		cleanupTime = min(cleanupTime, first_packet_time_s + 300 + 1);
+	}
+	if(reg->oneway == 1) {
+		cleanupTime = min(cleanupTime, reg->get_last_packet_time_s() + opt_onewaytimeout + 1);
+	}
+	return(cleanupTime);
+}
+
+u_int32_t
+Calltable::getCleanupTimeSs7(Ss7 *ss7) {
+	if(ss7->last_message_type == Ss7::rlc) {
+		return(0);
+	}
+	return(TIME_US_TO_S(ss7->last_time_us) + absolute_timeout + 1);
+}
+
+void
+Calltable::_cleanupTimerUpdate(cTimerWheel *wheel, cTimerWheel::sItem *item, u_int32_t expire) {
+	if(item->isScheduled() && expire >= item->expire) {
+		return;
+	}
+	wheel->lock();
+	if(item->isScheduled()) {
+		if(expire < item->expire) {
+			wheel->add(item, expire);
+		}
+	} else if(item->expired) {
+		// in processing of cleanup - it is checked again in the next pass
+		item->dirty = true;
+	}
+	wheel->unlock();
+}
+
+void
+Calltable::cleanupTimerAdd(cTimerWheel *wheel, cTimerWheel::sItem *item, u_int32_t expire, u_int32_t time) {
+	wheel->lock();
+	wheel->init(time);
+	wheel->add(item, expire);
+	wheel->unlock();
+}
+
+bool
+Calltable::cleanup_calls_isClose(Call *call, struct timeval *currtime) {
+	bool closeCall = false;
+	if(!currtime || call->force_close) {
+		closeCall = true;
+		if(!is_read_from_file()) {
+			call->force_terminate = true;
+		}
+	} else if(call->typeIs(SKINNY_NEW) ||
+		  call->typeIs(MGCP) ||
+		  call->in_preprocess_queue_before_process_packet <= 0 ||
+		  (!is_read_from_file() &&
+		   (call->in_preprocess_queue_before_process_packet_at[0] && call->in_preprocess_queue_before_process_packet_at[0] < currtime->tv_sec - 300 &&
+		    call->in_preprocess_queue_before_process_packet_at[1] && call->in_preprocess_queue_before_process_packet_at[1] < (getTimeMS_rdtsc() / 1000) - 300))) {
+		if(call->destroy_call_at != 0 && call->destroy_call_at <= currtime->tv_sec) {
+			closeCall = true;
+		} else if((call->destroy_call_at_bye != 0 && call->destroy_call_at_bye <= currtime->tv_sec) ||
+			  (call->destroy_call_at_bye_confirmed != 0 && call->destroy_call_at_bye_confirmed <= currtime->tv_sec)) {
+			closeCall = true;
+			call->bye_timeout_exceeded = true;
+		} else if(call->first_rtp_time_us &&
+			  currtime->tv_sec - call->get_last_packet_time_s() > rtptimeout) {
+			closeCall = true;
+			call->rtp_timeout_exceeded = true;
+		} else if(!call->first_rtp_time_us &&
+			  currtime->tv_sec - call->get_first_packet_time_s() > sipwithoutrtptimeout) {
+			closeCall = true;
+			call->sipwithoutrtp_timeout_exceeded = true;
+		} else if(currtime->tv_sec - call->get_first_packet_time_s() > absolute_timeout) {
+			closeCall = true;
+			call->absolute_timeout_exceeded = true;
+		} else if(currtime->tv_sec - call->get_first_packet_time_s() > 300 &&
+			  !call->seenRES18X && !call->seenRES2XX && !call->first_rtp_time_us) {
+			closeCall = true;
+			call->zombie_timeout_exceeded = true;
+		}
+		if(!closeCall &&
+		   (call->oneway == 1 && (currtime->tv_sec - call->get_last_packet_time_s() > opt_onewaytimeout))) {
+			closeCall = true;
+			call->oneway_timeout_exceeded = true;
+		}
+	}
+	return(closeCall);
+}
+
+bool
+Calltable::cleanup_calls_reject(Call *call, struct timeval *currtime, bool forceClose) {
+	++call->attemptsClose;
+	call->removeFindTables(currtime, true);
+	return((currtime || !forceClose) &&
+	       ((opt_hash_modify_queue_length_ms && call->hash_queue_counter > 0) ||
+		(calls_hash_lockfree && !hashReadersLeftCall(call)) ||
+		call->rtppacketsinqueue != 0));
+}
+
 /* iterate all calls in table which are 5 minutes inactive and save them into SQL 
  * ic currtime = 0, save it immediatly
 */
@@ -10332,14 +10677,57 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 	}
 	Call* call;
 	lock_calls_listMAP();
-	Call **closeCalls = new FILE_LINE(1012) Call*[calls_list_count() + calls_by_stream_callid_listMAP.size()];
+	bool useTimerWheel = cleanup_timer_wheel && currtime;
+	vector<cTimerWheel::sItem*> expiredCalls;
+	if(useTimerWheel) {
+		calls_timer_wheel.lock();
+		calls_timer_wheel.expire(currtime->tv_sec, &expiredCalls);
+		calls_timer_wheel.unlock();
+	}
+	Call **closeCalls = new FILE_LINE(1012) Call*[(useTimerWheel ? expiredCalls.size() : calls_list_count()) + calls_by_stream_callid_listMAP.size()];
 	unsigned int closeCalls_count = 0;
 	int rejectedCalls_count = 0;
 	
+	// only calls with expired deadline - others are not touched
+	for(unsigned i = 0; i < expiredCalls.size(); i++) {
+		call = (Call*)(Call_abstract*)expiredCalls[i]->data;
+		u_int32_t callIdHash = cCallIdTable::hash(call->call_id.c_str(), call->call_id.length());
+		cCallIdTable::sShard *callIdShard = calls_by_call_id.getShard(callIdHash);
+		calls_by_call_id.lock(callIdShard);
+		bool closeCall = cleanup_calls_isClose(call, currtime);
+		bool rejectCall = false;
+		if(closeCall && cleanup_calls_reject(call, currtime, forceClose)) {
+			closeCall = false;
+			rejectCall = true;
+			++rejectedCalls_count;
+		}
+		if(closeCall) {
+			if(call->listening_worker_run) {
+				*call->listening_worker_run = 0;
+			}
+			closeCalls[closeCalls_count++] = call;
+			map<string, Call*>::iterator callMAPIT = calls_listMAP.find(call->call_id);
+			if(callMAPIT != calls_listMAP.end() && callMAPIT->second == call) {
+				calls_by_call_id.remove(callIdShard, callMAPIT->first.c_str(), callMAPIT->first.length(), callIdHash);
+				calls_listMAP.erase(callMAPIT);
+			}
+			call->removeMergeCalls();
+			cleanupTimerRelease(call, &calls_timer_wheel);
+		} else {
+			calls_timer_wheel.lock();
+			calls_timer_wheel.add(&call->cleanup_timer,
+					      rejectCall || call->cleanup_timer.dirty ? 
+					       currtime->tv_sec + 1 :
+					       getCleanupTime(call));
+			calls_timer_wheel.unlock();
+		}
+		calls_by_call_id.unlock(callIdShard);
+	}
+	
 	list<Call*>::iterator callIT1;
 	map<string, Call*>::iterator callMAPIT1;
 	map<sStreamIds2, Call*>::iterator callMAPIT2;
-	for(int passTypeCall = 0; passTypeCall < 2; passTypeCall++) {
+	for(int passTypeCall = useTimerWheel ? 1 : 0; passTypeCall < 2; passTypeCall++) {
 		int typeCall = passTypeCall == 0 ? INVITE : MGCP;
 		if(typeCall == INVITE) {
 			if(opt_call_id_alternative[0]) {
@@ -10355,8 +10743,16 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 			 callIT1 != calltable->calls_list.end() :
 			 callMAPIT1 != calltable->calls_listMAP.end()) : 
 		       callMAPIT2 != calltable->calls_by_stream_callid_listMAP.end()) {
+			cCallIdTable::sShard *callIdShard = NULL;
+			u_int32_t callIdHash = 0;
 			if(typeCall == INVITE) {
 				call = opt_call_id_alternative[0] ? *callIT1 : callMAPIT1->second;
+				if(!opt_call_id_alternative[0]) {
+					// find_by_call_id (without alternative call-ids) uses only lock of shard
+					callIdHash = cCallIdTable::hash(callMAPIT1->first.c_str(), callMAPIT1->first.length());
+					callIdShard = calls_by_call_id.getShard(callIdHash);
+					calls_by_call_id.lock(callIdShard);
+				}
 			} else {
 				call = (*callMAPIT2).second;
 			}
@@ -10367,55 +10763,10 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 				syslog(LOG_NOTICE, "Calltable::cleanup - try callid %s", call->call_id.c_str());
 			}
 			// rtptimeout seconds of inactivity will save this call and remove from call table
-			bool closeCall = false;
-			if(!currtime || call->force_close) {
-				closeCall = true;
-				if(!is_read_from_file()) {
-					call->force_terminate = true;
-				}
-			} else if(call->typeIs(SKINNY_NEW) ||
-				  call->typeIs(MGCP) ||
-				  call->in_preprocess_queue_before_process_packet <= 0 ||
-				  (!is_read_from_file() &&
-				   (call->in_preprocess_queue_before_process_packet_at[0] && call->in_preprocess_queue_before_process_packet_at[0] < currtime->tv_sec - 300 &&
-				    call->in_preprocess_queue_before_process_packet_at[1] && call->in_preprocess_queue_before_process_packet_at[1] < (getTimeMS_rdtsc() / 1000) - 300))) {
-				if(call->destroy_call_at != 0 && call->destroy_call_at <= currtime->tv_sec) {
-					closeCall = true;
-				} else if((call->destroy_call_at_bye != 0 && call->destroy_call_at_bye <= currtime->tv_sec) ||
-					  (call->destroy_call_at_bye_confirmed != 0 && call->destroy_call_at_bye_confirmed <= currtime->tv_sec)) {
-					closeCall = true;
-					call->bye_timeout_exceeded = true;
-				} else if(call->first_rtp_time_us &&
-					  currtime->tv_sec - call->get_last_packet_time_s() > rtptimeout) {
-					closeCall = true;
-					call->rtp_timeout_exceeded = true;
-				} else if(!call->first_rtp_time_us &&
-					  currtime->tv_sec - call->get_first_packet_time_s() > sipwithoutrtptimeout) {
-					closeCall = true;
-					call->sipwithoutrtp_timeout_exceeded = true;
-				} else if(currtime->tv_sec - call->get_first_packet_time_s() > absolute_timeout) {
-					closeCall = true;
-					call->absolute_timeout_exceeded = true;
-				} else if(currtime->tv_sec - call->get_first_packet_time_s() > 300 &&
-					  !call->seenRES18X && !call->seenRES2XX && !call->first_rtp_time_us) {
-					closeCall = true;
-					call->zombie_timeout_exceeded = true;
-				}
-				if(!closeCall &&
-				   (call->oneway == 1 && (currtime->tv_sec - call->get_last_packet_time_s() > opt_onewaytimeout))) {
-					closeCall = true;
-					call->oneway_timeout_exceeded = true;
-				}
-			}
-			if(closeCall) {
-				++call->attemptsClose;
-				call->removeFindTables(currtime, true);
-				if((currtime || !forceClose) &&
-				   ((opt_hash_modify_queue_length_ms && call->hash_queue_counter > 0) ||
-				    call->rtppacketsinqueue != 0)) {
-					closeCall = false;
-					++rejectedCalls_count;
-				}
+			bool closeCall = cleanup_calls_isClose(call, currtime);
+			if(closeCall && cleanup_calls_reject(call, currtime, forceClose)) {
+				closeCall = false;
+				++rejectedCalls_count;
 			}
 			if(closeCall) {
 				if(call->listening_worker_run) {
@@ -10423,10 +10774,12 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 				}
 				closeCalls[closeCalls_count++] = call;
 				if(typeCall == INVITE) {
+					cleanupTimerRelease(call, &calls_timer_wheel);
 					if(opt_call_id_alternative[0]) {
 						calls_list.erase(callIT1++);
 						call->removeCallIdMap();
 					} else {
+						calls_by_call_id.remove(callIdShard, callMAPIT1->first.c_str(), callMAPIT1->first.length(), callIdHash);
 						calls_listMAP.erase(callMAPIT1++);
 					}
 					call->removeMergeCalls();
@@ -10446,6 +10799,9 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 					++callMAPIT2;
 				}
 			}
+			if(callIdShard) {
+				calls_by_call_id.unlock(callIdShard);
+			}
 		}
 	}
 	unlock_calls_listMAP();
@@ -10507,6 +10863,93 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 	return rejectedCalls_count;
 }
 
+bool
+Calltable::cleanup_registers_isClose(Call *reg, struct timeval *currtime) {
+	if(verbosity > 2) {
+		reg->dump();
+	}
+	if(verbosity && verbosityE > 1) {
+		syslog(LOG_NOTICE, "Calltable::cleanup - try callid %s", reg->call_id.c_str());
+	}
+	// rtptimeout seconds of inactivity will save this call and remove from call table
+	bool closeReg = false;
+	if(!currtime || reg->force_close) {
+		closeReg = true;
+		if(!is_read_from_file()) {
+			reg->force_terminate = true;
+		}
+	} else {
+		if(reg->destroy_call_at != 0 && reg->destroy_call_at <= currtime->tv_sec) {
+			closeReg = true;
+		} else if(currtime->tv_sec - reg->get_first_packet_time_s() > absolute_timeout) {
+			closeReg = true;
+			reg->absolute_timeout_exceeded = true;
+		} else if(currtime->tv_sec - reg->get_first_packet_time_s() > 300 &&
+			  !reg->seenRES18X && !reg->seenRES2XX) {
+			closeReg = true;
+			reg->zombie_timeout_exceeded = true;
+		}
+		if(!closeReg &&
+		   (reg->oneway == 1 && (currtime->tv_sec - reg->get_last_packet_time_s() > opt_onewaytimeout))) {
+			closeReg = true;
+			reg->oneway_timeout_exceeded = true;
+		}
+	}
+	return(closeReg);
+}
+
+void
+Calltable::cleanup_registers_close(Call *reg, struct timeval *currtime) {
+	if(verbosity && verbosityE > 1) {
+		syslog(LOG_NOTICE, "Calltable::cleanup - callid %s", reg->call_id.c_str());
+	}
+	// Close RTP dump file ASAP to save file handles
+	if(!currtime && is_terminating()) {
+		reg->getPcap()->close();
+		reg->getPcapSip()->close();
+	}
+
+	if(!currtime) {
+		/* we are saving calls because of terminating SIGTERM and we dont know 
+		 * if the call ends successfully or not. So we dont want to confuse monitoring
+		 * applications which reports unterminated calls so mark this call as sighup */
+		reg->sighup = true;
+		if(verbosity > 2)
+			syslog(LOG_NOTICE, "Set call->sighup\n");
+	}
+	/* move call to queue for mysql processing */
+	if(reg->push_register_to_registers_queue) {
+		syslog(LOG_WARNING,"try to duplicity push call %s to registers_queue", reg->call_id.c_str());
+	} else {
+		reg->push_register_to_registers_queue = 1;
+		if(opt_sip_register == 1) {
+			extern Registers registers;
+			if(reg->msgcount <= 1 || 
+			   reg->lastSIPresponseNum == 401 || reg->lastSIPresponseNum == 403 || reg->lastSIPresponseNum == 404) {
+				reg->regstate = 2;
+			}
+			if(reg->regstate != 2 ||
+			   !opt_register_timeout_disable_save_failed) {
+				registers.add(reg);
+			}
+			reg->getPcap()->close();
+			reg->getPcapSip()->close();
+			lock_registers_deletequeue();
+			registers_deletequeue.push_back(reg);
+			unlock_registers_deletequeue();
+		} else {
+			lock_registers_queue();
+			registers_queue.push_back(reg);
+			unlock_registers_queue();
+		}
+	}
+	if(opt_enable_fraud && currtime) {
+		fraudEndCall(reg, *currtime);
+	}
+	extern u_int64_t counter_registers_clean;
+	++counter_registers_clean;
+}
+
 int
 Calltable::cleanup_registers(struct timeval *currtime) {
 
@@ -10515,90 +10958,40 @@ Calltable::cleanup_registers(struct timeval *currtime) {
 	}
 	Call* reg;
 	lock_registers_listMAP();
-	for (map<string, Call*>::iterator registerMAPIT = registers_listMAP.begin(); registerMAPIT != registers_listMAP.end();) {
-		reg = (*registerMAPIT).second;
-		if(verbosity > 2) {
-			reg->dump();
-		}
-		if(verbosity && verbosityE > 1) {
-			syslog(LOG_NOTICE, "Calltable::cleanup - try callid %s", reg->call_id.c_str());
-		}
-		// rtptimeout seconds of inactivity will save this call and remove from call table
-		bool closeReg = false;
-		if(!currtime || reg->force_close) {
-			closeReg = true;
-			if(!is_read_from_file()) {
-				reg->force_terminate = true;
-			}
-		} else {
-			if(reg->destroy_call_at != 0 && reg->destroy_call_at <= currtime->tv_sec) {
-				closeReg = true;
-			} else if(currtime->tv_sec - reg->get_first_packet_time_s() > absolute_timeout) {
-				closeReg = true;
-				reg->absolute_timeout_exceeded = true;
-			} else if(currtime->tv_sec - reg->get_first_packet_time_s() > 300 &&
-				  !reg->seenRES18X && !reg->seenRES2XX) {
-				closeReg = true;
-				reg->zombie_timeout_exceeded = true;
-			}
-			if(!closeReg &&
-			   (reg->oneway == 1 && (currtime->tv_sec - reg->get_last_packet_time_s() > opt_onewaytimeout))) {
-				closeReg = true;
-				reg->oneway_timeout_exceeded = true;
-			}
-		}
-		if(closeReg) {
-			if(verbosity && verbosityE > 1) {
-				syslog(LOG_NOTICE, "Calltable::cleanup - callid %s", reg->call_id.c_str());
-			}
-			// Close RTP dump file ASAP to save file handles
-			if(!currtime && is_terminating()) {
-				reg->getPcap()->close();
-				reg->getPcapSip()->close();
-			}
-
-			if(!currtime) {
-				/* we are saving calls because of terminating SIGTERM and we dont know 
-				 * if the call ends successfully or not. So we dont want to confuse monitoring
-				 * applications which reports unterminated calls so mark this call as sighup */
-				reg->sighup = true;
-				if(verbosity > 2)
-					syslog(LOG_NOTICE, "Set call->sighup\n");
-			}
-			/* move call to queue for mysql processing */
-			if(reg->push_register_to_registers_queue) {
-				syslog(LOG_WARNING,"try to duplicity push call %s to registers_queue", reg->call_id.c_str());
+	if(cleanup_timer_wheel && currtime) {
+		vector<cTimerWheel::sItem*> expiredRegisters;
+		registers_timer_wheel.lock();
+		registers_timer_wheel.expire(currtime->tv_sec, &expiredRegisters);
+		registers_timer_wheel.unlock();
+		for(unsigned i = 0; i < expiredRegisters.size(); i++) {
+			reg = (Call*)(Call_abstract*)expiredRegisters[i]->data;
+			if(cleanup_registers_isClose(reg, currtime)) {
+				map<string, Call*>::iterator registerMAPIT = registers_listMAP.find(reg->call_id);
+				if(registerMAPIT != registers_listMAP.end() && registerMAPIT->second == reg) {
+					registers_listMAP.erase(registerMAPIT);
+				}
+				cleanupTimerRelease(reg, &registers_timer_wheel);
+				// register can be destroyed after pushing to queue
+				cleanup_registers_close(reg, currtime);
 			} else {
-				reg->push_register_to_registers_queue = 1;
-				if(opt_sip_register == 1) {
-					extern Registers registers;
-					if(reg->msgcount <= 1 || 
-					   reg->lastSIPresponseNum == 401 || reg->lastSIPresponseNum == 403 || reg->lastSIPresponseNum == 404) {
-						reg->regstate = 2;
-					}
-					if(reg->regstate != 2 ||
-					   !opt_register_timeout_disable_save_failed) {
-						registers.add(reg);
-					}
-					reg->getPcap()->close();
-					reg->getPcapSip()->close();
-					lock_registers_deletequeue();
-					registers_deletequeue.push_back(reg);
-					unlock_registers_deletequeue();
-				} else {
-					lock_registers_queue();
-					registers_queue.push_back(reg);
-					unlock_registers_queue();
-				}
+				registers_timer_wheel.lock();
+				registers_timer_wheel.add(&reg->cleanup_timer,
+							  reg->cleanup_timer.dirty ?
+							   currtime->tv_sec + 1 :
+							   getCleanupTimeRegister(reg));
+				registers_timer_wheel.unlock();
 			}
-			registers_listMAP.erase(registerMAPIT++);
-			if(opt_enable_fraud && currtime) {
-				fraudEndCall(reg, *currtime);
+		}
+	} else {
+		for (map<string, Call*>::iterator registerMAPIT = registers_listMAP.begin(); registerMAPIT != registers_listMAP.end();) {
+			reg = (*registerMAPIT).second;
+			if(cleanup_registers_isClose(reg, currtime)) {
+				registers_listMAP.erase(registerMAPIT++);
+				cleanupTimerRelease(reg, &registers_timer_wheel);
+				cleanup_registers_close(reg, currtime);
+			} else {
+				++registerMAPIT;
 			}
-			extern u_int64_t counter_registers_clean;
-			++counter_registers_clean;
-		} else {
-			++registerMAPIT;
 		}
 	}
 	unlock_registers_listMAP();
@@ -10615,16 +11008,41 @@ Calltable::cleanup_registers(struct timeval *currtime) {
 int Calltable::cleanup_ss7( struct timeval *currtime ) {
 	lock_process_ss7_listmap();
 	lock_ss7_listMAP();
-	map<string, Ss7*>::iterator iter;
-	for(iter = ss7_listMAP.begin(); iter != ss7_listMAP.end(); ) {
-		if(iter->second->last_message_type == Ss7::rlc || 
-		   !currtime ||
-		   (currtime->tv_sec - TIME_US_TO_S(iter->second->last_time_us)) > absolute_timeout) {
-			iter->second->pushToQueue();
-			ss7_listMAP.erase(iter++);
-			continue;
+	if(cleanup_timer_wheel && currtime) {
+		vector<cTimerWheel::sItem*> expiredSs7;
+		ss7_timer_wheel.lock();
+		ss7_timer_wheel.expire(currtime->tv_sec, &expiredSs7);
+		ss7_timer_wheel.unlock();
+		for(unsigned i = 0; i < expiredSs7.size(); i++) {
+			Ss7 *ss7 = (Ss7*)(Call_abstract*)expiredSs7[i]->data;
+			if(ss7->last_message_type == Ss7::rlc || 
+			   (currtime->tv_sec - TIME_US_TO_S(ss7->last_time_us)) > absolute_timeout) {
+				map<string, Ss7*>::iterator iter = ss7_listMAP.find(ss7->ss7_id());
+				if(iter != ss7_listMAP.end() && iter->second == ss7) {
+					ss7_listMAP.erase(iter);
+				}
+				ss7->pushToQueue();
+			} else {
+				ss7_timer_wheel.lock();
+				ss7_timer_wheel.add(&ss7->cleanup_timer,
+						    ss7->cleanup_timer.dirty ?
+						     currtime->tv_sec + 1 :
+						     getCleanupTimeSs7(ss7));
+				ss7_timer_wheel.unlock();
+			}
+		}
+	} else {
+		map<string, Ss7*>::iterator iter;
+		for(iter = ss7_listMAP.begin(); iter != ss7_listMAP.end(); ) {
+			if(iter->second->last_message_type == Ss7::rlc || 
+			   !currtime ||
+			   (currtime->tv_sec - TIME_US_TO_S(iter->second->last_time_us)) > absolute_timeout) {
+				iter->second->pushToQueue();
+				ss7_listMAP.erase(iter++);
+				continue;
+			}
+			iter++;
 		}
-		iter++;
 	}
 	unlock_ss7_listMAP();
 	unlock_process_ss7_listmap();
@@ -10663,6 +11081,7 @@ void Call::saveregister(struct timeval *currtime) {
 		return;
 	} else {
 		((Calltable*)calltable)->registers_listMAP.erase(registerMAPIT);
+		((Calltable*)calltable)->cleanupTimerRelease(this, &((Calltable*)calltable)->registers_timer_wheel);
 	}
 	((Calltable*)calltable)->unlock_registers_listMAP();
 	extern u_int64_t counter_registers_clean;
@@ -43,6 +43,9 @@
 #include "voipmonitor.h"
 #include "tools_fifo_buffer.h"
 #include "record_array.h"
+#include "rcu.h"
+#include "timer_wheel.h"
+#include "call_arena.h"
 
 #define MAX_IP_PER_CALL 40	//!< total maxumum of SDP sessions for one call-id
 #define MAX_SSRC_PER_CALL 40	//!< total maxumum of SDP sessions for one call-id
@@ -329,6 +332,21 @@ struct ip_port_call_info {
 	bool canceled;
 };
 
+/*
+ * Cold part of Call with sdp media (ip:port of streams and their rtpmaps).
+ * Allocated with the first sdp media of call - calls without sdp (OPTIONS, SUBSCRIBE, MESSAGE, ...)
+ * keep only the hot part of Call.
+ */
+struct sCallMedia {
+	sCallMedia() {
+		memset(rtpmap, 0, sizeof(rtpmap));
+		memset(rtpmap_used_flags, 0, sizeof(rtpmap_used_flags));
+	}
+	ip_port_call_info ip_port[MAX_IP_PER_CALL];
+	RTPMAP rtpmap[MAX_IP_PER_CALL][MAX_RTPMAP]; //!< rtpmap for every rtp stream
+	bool rtpmap_used_flags[MAX_IP_PER_CALL];
+};
+
 struct raws_t {
 	int ssrc_index;
 	int rawiterator;
@@ -417,6 +435,12 @@ class Call_abstract {
 public:
 	Call_abstract(int call_type, u_int64_t time_us);
 	virtual ~Call_abstract() {
+		if(cleanup_timer.isScheduled()) {
+			cTimerWheel *wheel = cleanup_timer.wheel;
+			wheel->lock();
+			wheel->remove(&cleanup_timer);
+			wheel->unlock();
+		}
 		alloc_flag = 0;
 	}
 	int getTypeBase() { return(type_base); }
@@ -477,6 +501,8 @@ public:
 	volatile unsigned int flags;
 	void *user_data;
 	int user_data_type;
+	// deadline of cleanup (cleanup_timer_wheel)
+	cTimerWheel::sItem cleanup_timer;
 protected:
 	list<u_int64_t> tarPosSip;
 	list<u_int64_t> tarPosRtp;
@@ -676,6 +702,7 @@ public:
 	RTP *rtp[MAX_SSRC_PER_CALL];		//!< array of RTP streams
 	RTP *rtpab[2];
 	map<int, class RTPsecure*> rtp_secure_map;
+	cCallArena arena;		//!< memory of rtp streams and srtp contexts
 	volatile int rtplock;
 	unsigned long call_id_len;	//!< length of call-id 	
 	string call_id;	//!< call-id from SIP session
@@ -721,8 +748,9 @@ public:
 	bool sighup;			//!< true if call is saving during sighup
 	char a_ua[1024];		//!< caller user agent 
 	char b_ua[1024];		//!< callee user agent 
-	RTPMAP rtpmap[MAX_IP_PER_CALL][MAX_RTPMAP]; //!< rtpmap for every rtp stream
-	bool rtpmap_used_flags[MAX_IP_PER_CALL];
+	// point into media or into empty media (read only) until the first sdp media is added
+	RTPMAP (*rtpmap)[MAX_RTPMAP];	//!< rtpmap for every rtp stream
+	bool *rtpmap_used_flags;
 	RTP *lastcallerrtp;		//!< last RTP stream from caller
 	RTP *lastcalledrtp;		//!< last RTP stream from called
 	vmIP saddr;		//!< source IP address of first INVITE
@@ -765,6 +793,7 @@ public:
 	volatile unsigned int rtppacketsinqueue;
 	volatile int end_call_rtp;
 	volatile int end_call_hash_removed;
+	u_int64_t end_call_hash_rcu_epoch;
 	volatile int push_call_to_calls_queue;
 	volatile int push_register_to_registers_queue;
 	unsigned int ps_drop;
@@ -1229,6 +1258,8 @@ public:
 
 	void dump();
 
+	static string getMemoryStatString();
+
 	bool isFillRtpMap(int index) {
 		for(int i = 0; i < MAX_RTPMAP; i++) {
 			if(rtpmap[index][i].is_set()) {
@@ -1637,7 +1668,18 @@ public:
 	}
 
 private:
-	ip_port_call_info ip_port[MAX_IP_PER_CALL];
+	void setMedia(sCallMedia *media);
+	void allocMedia() {
+		if(!media) {
+			setMedia(new FILE_LINE(0) sCallMedia);
+			__sync_fetch_and_add(&stat_calls_media, 1);
+		}
+	}
+	ip_port_call_info *ip_port;
+	sCallMedia *media;
+	static sCallMedia media_empty;
+	static volatile u_int64_t stat_calls;
+	static volatile u_int64_t stat_calls_media;
 	bool callerd_confirm_rtp_by_both_sides_sdp[2];
 	bool exists_crypto_suite_key;
 	bool log_srtp_callid;
@@ -1867,6 +1909,89 @@ struct sChartsCallData {
 };
 
 
+/**
+  * Index of calls by call-id (and alternative call-ids) used by find_by_call_id.
+  * Hash of call-id is computed once (packet_s_process keeps it), each shard has own lock
+  * and open addressing table (linear probing), lookup is without temporary string.
+  * calls_listMAP remains for iteration (cleanup, manager) - both are modified under lock_calls_listMAP.
+*/
+
+#define CALLID_TABLE_SHARDS_BITS 6
+#define CALLID_TABLE_SHARDS (1 << CALLID_TABLE_SHARDS_BITS)
+#define CALLID_TABLE_SHARD_INIT_SIZE 256
+
+class cCallIdTable {
+public:
+	struct sItem {
+		char *key;
+		u_int32_t length;
+		u_int32_t hash;
+		Call *call;
+	};
+	struct sShard {
+		sItem *items;
+		unsigned size;
+		unsigned count;
+		volatile int _sync;
+	};
+public:
+	cCallIdTable();
+	~cCallIdTable();
+	static inline u_int32_t hash(const char *key, unsigned length) {
+		u_int32_t hash = 2166136261u;
+		for(unsigned i = 0; i < length; i++) {
+			hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+		}
+		hash ^= hash >> 15;
+		hash *= 0x85EBCA6B;
+		hash ^= hash >> 13;
+		return(hash);
+	}
+	inline sShard *getShard(u_int32_t hash) {
+		return(&shards[hash >> (32 - CALLID_TABLE_SHARDS_BITS)]);
+	}
+	inline void lock(sShard *shard) {
+		__SYNC_LOCK_USLEEP(shard->_sync, 10);
+	}
+	inline void unlock(sShard *shard) {
+		__SYNC_UNLOCK(shard->_sync);
+	}
+	// find, set and remove with shard - caller holds lock of shard
+	inline Call *find(sShard *shard, const char *key, unsigned length, u_int32_t hash) {
+		unsigned mask = shard->size - 1;
+		unsigned pos = hash & mask;
+		while(shard->items[pos].key) {
+			sItem *item = &shard->items[pos];
+			if(item->hash == hash && item->length == length && !memcmp(item->key, key, length)) {
+				return(item->call);
+			}
+			pos = (pos + 1) & mask;
+		}
+		return(NULL);
+	}
+	void set(sShard *shard, const char *key, unsigned length, u_int32_t hash, Call *call);
+	void remove(sShard *shard, const char *key, unsigned length, u_int32_t hash);
+	void set(const string &key, Call *call) {
+		u_int32_t hash = this->hash(key.c_str(), key.length());
+		sShard *shard = getShard(hash);
+		lock(shard);
+		set(shard, key.c_str(), key.length(), hash, call);
+		unlock(shard);
+	}
+	void remove(const string &key) {
+		u_int32_t hash = this->hash(key.c_str(), key.length());
+		sShard *shard = getShard(hash);
+		lock(shard);
+		remove(shard, key.c_str(), key.length(), hash);
+		unlock(shard);
+	}
+private:
+	void resize(sShard *shard, unsigned new_size);
+private:
+	sShard shards[CALLID_TABLE_SHARDS];
+};
+
+
 /**
   * This class implements operations on Call list
 */
@@ -1918,6 +2043,7 @@ public:
 	queue<string> files_sqlqueue; //!< this queue is used for asynchronous storing CDR by the worker thread
 	list<Call*> calls_list;
 	map<string, Call*> calls_listMAP;
+	cCallIdTable calls_by_call_id;
 	map<sStreamIds2, Call*> calls_by_stream_callid_listMAP;
 	map<sStreamId2, Call*> calls_by_stream_id2_listMAP;
 	map<sStreamId, Call*> calls_by_stream_listMAP;
@@ -1926,6 +2052,9 @@ public:
 	map<d_item<vmIP>, Call*> skinny_ipTuples;
 	map<unsigned int, Call*> skinny_partyID;
 	map<string, Ss7*> ss7_listMAP;
+	cTimerWheel calls_timer_wheel;
+	cTimerWheel registers_timer_wheel;
+	cTimerWheel ss7_timer_wheel;
 
 	/**
 	 * @brief constructor
@@ -2016,40 +2145,65 @@ public:
 	 *
 	 * @return reference of the Call if found, otherwise return NULL
 	*/
-	Call *find_by_call_id(char *call_id, unsigned long call_id_len, vector<string> *call_id_alternative, time_t time) {
+	Call *find_by_call_id(char *call_id, unsigned long call_id_len, vector<string> *call_id_alternative, time_t time,
+			      u_int32_t call_id_hash = 0) {
 		extern char opt_call_id_alternative[256];
 		Call *rslt_call = NULL;
-		string call_idS = call_id_len ? string(call_id, call_id_len) : string(call_id);
+		if(!call_id_len) {
+			call_id_len = strlen(call_id);
+		}
+		if(!call_id_hash) {
+			call_id_hash = cCallIdTable::hash(call_id, call_id_len);
+		}
+		if(!opt_call_id_alternative[0]) {
+			// only lock of shard - cleanup_calls removes call from shard under the same lock
+			cCallIdTable::sShard *shard = calls_by_call_id.getShard(call_id_hash);
+			calls_by_call_id.lock(shard);
+			rslt_call = calls_by_call_id.find(shard, call_id, call_id_len, call_id_hash);
+			if(rslt_call && time) {
+				__sync_add_and_fetch(&rslt_call->in_preprocess_queue_before_process_packet, 1);
+				rslt_call->in_preprocess_queue_before_process_packet_at[0] = time;
+				rslt_call->in_preprocess_queue_before_process_packet_at[1] = getTimeMS_rdtsc() / 1000;
+			}
+			calls_by_call_id.unlock(shard);
+			return(rslt_call);
+		}
 		lock_calls_listMAP();
-		map<string, Call*>::iterator callMAPIT = calls_listMAP.find(call_idS);
-		if(opt_call_id_alternative[0]) {
-			if(callMAPIT == calls_listMAP.end() && call_id_alternative) {
-				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
-					callMAPIT = calls_listMAP.find((*call_id_alternative)[i]);
-					if(callMAPIT != calls_listMAP.end()) {
-						break;
-					}
+		cCallIdTable::sShard *shard = calls_by_call_id.getShard(call_id_hash);
+		calls_by_call_id.lock(shard);
+		rslt_call = calls_by_call_id.find(shard, call_id, call_id_len, call_id_hash);
+		calls_by_call_id.unlock(shard);
+		if(!rslt_call && call_id_alternative) {
+			for(unsigned i = 0; i < call_id_alternative->size(); i++) {
+				string *call_id_alt = &(*call_id_alternative)[i];
+				u_int32_t call_id_alt_hash = cCallIdTable::hash(call_id_alt->c_str(), call_id_alt->length());
+				shard = calls_by_call_id.getShard(call_id_alt_hash);
+				calls_by_call_id.lock(shard);
+				rslt_call = calls_by_call_id.find(shard, call_id_alt->c_str(), call_id_alt->length(), call_id_alt_hash);
+				calls_by_call_id.unlock(shard);
+				if(rslt_call) {
+					break;
 				}
 			}
 		}
-		if(callMAPIT != calls_listMAP.end()) {
-			rslt_call = callMAPIT->second;
-			if(opt_call_id_alternative[0]) {
-				rslt_call->call_id_alternative_lock();
-				if(call_idS != rslt_call->call_id) {
-					calls_listMAP[call_idS] = rslt_call;
-					(*rslt_call->call_id_alternative)[call_idS] = true;
-				}
-				if(call_id_alternative) {
-					for(unsigned i = 0; i < call_id_alternative->size(); i++) {
-						if((*call_id_alternative)[i] != rslt_call->call_id) {
-							calls_listMAP[(*call_id_alternative)[i]] = rslt_call;
-							(*rslt_call->call_id_alternative)[(*call_id_alternative)[i]] = true;
-						}
+		if(rslt_call) {
+			rslt_call->call_id_alternative_lock();
+			if(rslt_call->call_id.length() != call_id_len || memcmp(rslt_call->call_id.c_str(), call_id, call_id_len)) {
+				string call_idS = string(call_id, call_id_len);
+				calls_listMAP[call_idS] = rslt_call;
+				calls_by_call_id.set(call_idS, rslt_call);
+				(*rslt_call->call_id_alternative)[call_idS] = true;
+			}
+			if(call_id_alternative) {
+				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
+					if((*call_id_alternative)[i] != rslt_call->call_id) {
+						calls_listMAP[(*call_id_alternative)[i]] = rslt_call;
+						calls_by_call_id.set((*call_id_alternative)[i], rslt_call);
+						(*rslt_call->call_id_alternative)[(*call_id_alternative)[i]] = true;
 					}
 				}
-				rslt_call->call_id_alternative_unlock();
 			}
+			rslt_call->call_id_alternative_unlock();
 			if(time) {
 				__sync_add_and_fetch(&rslt_call->in_preprocess_queue_before_process_packet, 1);
 				rslt_call->in_preprocess_queue_before_process_packet_at[0] = time;
@@ -2192,6 +2346,37 @@ public:
 	int cleanup_calls( struct timeval *currtime, bool forceClose = false, const char *file = NULL, int line = 0);
 	int cleanup_registers( struct timeval *currtime);
 	int cleanup_ss7( struct timeval *currtime );
+	
+	/**
+	 * @brief deadlines of cleanup in timer wheels (cleanup_timer_wheel) - cleanup passes check only expired items
+	 *
+	*/
+	u_int32_t getCleanupTime(Call *call);
+	u_int32_t getCleanupTimeRegister(Call *reg);
+	u_int32_t getCleanupTimeSs7(Ss7 *ss7);
+	inline void cleanupTimerUpdate(Call *call) {
+		if(cleanup_timer_wheel &&
+		   (call->cleanup_timer.isScheduled() || call->cleanup_timer.expired)) {
+			if(call->typeIs(REGISTER)) {
+				_cleanupTimerUpdate(&registers_timer_wheel, &call->cleanup_timer, getCleanupTimeRegister(call));
+			} else {
+				_cleanupTimerUpdate(&calls_timer_wheel, &call->cleanup_timer, getCleanupTime(call));
+			}
+		}
+	}
+	inline void cleanupTimerUpdate(Ss7 *ss7) {
+		if(cleanup_timer_wheel &&
+		   (ss7->cleanup_timer.isScheduled() || ss7->cleanup_timer.expired)) {
+			_cleanupTimerUpdate(&ss7_timer_wheel, &ss7->cleanup_timer, getCleanupTimeSs7(ss7));
+		}
+	}
+	inline void cleanupTimerRelease(Call_abstract *call, cTimerWheel *wheel) {
+		if(cleanup_timer_wheel) {
+			wheel->lock();
+			wheel->release(&call->cleanup_timer);
+			wheel->unlock();
+		}
+	}
 
 	/**
 	 * @brief add call to hash table
@@ -2393,10 +2578,59 @@ public:
 	void unlock_calls_hash() {
 		__sync_lock_release(&this->_sync_lock_calls_hash);
 	}
+	// readers of calls_hash - lock-free (rtp_hash_lockfree) or under lock_calls_hash
+	inline bool lock_calls_hash_read() {
+		if(calls_hash_lockfree && calls_hash_rcu.readLock()) {
+			return(true);
+		}
+		lock_calls_hash();
+		return(false);
+	}
+	inline void unlock_calls_hash_read(bool lockfree) {
+		if(lockfree) {
+			calls_hash_rcu.readUnlock();
+		} else {
+			unlock_calls_hash();
+		}
+	}
+	// true after lock-free readers which could find call before removing from calls_hash finished
+	bool hashReadersLeftCall(Call *call) {
+		if(!call->end_call_hash_rcu_epoch) {
+			call->end_call_hash_rcu_epoch = calls_hash_rcu.advanceEpoch();
+		}
+		return(calls_hash_rcu.isQuiescent(call->end_call_hash_rcu_epoch));
+	}
 	
 	void addSystemCommand(const char *command);
 	
 private:
+	// nodes unlinked from calls_hash - with lock-free readers they are freed after read sections end
+	inline void hashFree(node_call_rtp *node_call) {
+		if(calls_hash_lockfree) {
+			calls_hash_rcu.retire(node_call, hashFreeNodeCall);
+		} else {
+			delete node_call;
+		}
+	}
+	inline void hashFree(node_call_rtp_ip_port *node) {
+		if(calls_hash_lockfree) {
+			calls_hash_rcu.retire(node, hashFreeNode);
+		} else {
+			delete node;
+		}
+	}
+	static void hashFreeNodeCall(void *node_call) {
+		delete (node_call_rtp*)node_call;
+	}
+	static void hashFreeNode(void *node) {
+		delete (node_call_rtp_ip_port*)node;
+	}
+	void _cleanupTimerUpdate(cTimerWheel *wheel, cTimerWheel::sItem *item, u_int32_t expire);
+	void cleanupTimerAdd(cTimerWheel *wheel, cTimerWheel::sItem *item, u_int32_t expire, u_int32_t time);
+	bool cleanup_calls_isClose(Call *call, struct timeval *currtime);
+	bool cleanup_calls_reject(Call *call, struct timeval *currtime, bool forceClose);
+	bool cleanup_registers_isClose(Call *reg, struct timeval *currtime);
+	void cleanup_registers_close(Call *reg, struct timeval *currtime);
 	/*
 	pthread_mutex_t qlock;		//!< mutex locking calls_queue
 	pthread_mutex_t qaudiolock;	//!< mutex locking calls_audioqueue
@@ -2419,6 +2653,9 @@ private:
 	#else
 	node_call_rtp_ip_port *calls_hash[MAXNODE];
 	#endif
+	cRcu calls_hash_rcu;
+	bool calls_hash_lockfree;
+	bool cleanup_timer_wheel;
 	volatile int _sync_lock_calls_hash;
 	volatile int _sync_lock_calls_listMAP;
 	volatile int _sync_lock_calls_mergeMAP;
@@ -0,0 +1,161 @@
+#include <string.h>
+#include <sstream>
+
+#include "heap_safe.h"
+#include "dedup.h"
+
+
+using namespace std;
+
+
+static u_int32_t crc32c_table[256];
+static volatile int dedup_hash_use_sse42 = -1;
+
+static struct sCrc32cTableInit {
+	sCrc32cTableInit() {
+		for(unsigned i = 0; i < 256; i++) {
+			u_int32_t crc = i;
+			for(unsigned j = 0; j < 8; j++) {
+				crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+			}
+			crc32c_table[i] = crc;
+		}
+	}
+} crc32c_table_init;
+
+static inline u_int64_t load_u64(const u_char *data) {
+	u_int64_t v;
+	memcpy(&v, data, sizeof(v));
+	return(v);
+}
+
+static inline u_int32_t crc32c_sw_u8(u_int32_t crc, u_char v) {
+	return(crc32c_table[(crc ^ v) & 0xFF] ^ (crc >> 8));
+}
+
+static inline u_int32_t crc32c_sw_u64(u_int32_t crc, u_int64_t v) {
+	for(unsigned i = 0; i < 8; i++) {
+		crc = crc32c_table[(crc ^ v) & 0xFF] ^ (crc >> 8);
+		v >>= 8;
+	}
+	return(crc);
+}
+
+static inline u_int64_t dedup_hash_finish(u_int32_t a, u_int32_t b) {
+	u_int64_t hash = ((u_int64_t)~a << 32) | (u_int32_t)~b;
+	if(!(hash & 0xFFFF)) {
+		hash |= 1;
+	}
+	return(hash);
+}
+
+static u_int64_t dedup_hash_sw(const u_char *data, size_t length) {
+	u_int32_t a = 0xFFFFFFFF ^ (u_int32_t)length;
+	u_int32_t b = 0x9E3779B9;
+	while(length >= 16) {
+		a = crc32c_sw_u64(a, load_u64(data));
+		b = crc32c_sw_u64(b, load_u64(data + 8));
+		data += 16;
+		length -= 16;
+	}
+	if(length >= 8) {
+		a = crc32c_sw_u64(a, load_u64(data));
+		data += 8;
+		length -= 8;
+	}
+	while(length) {
+		b = crc32c_sw_u8(b, *data);
+		++data;
+		--length;
+	}
+	return(dedup_hash_finish(a, b));
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static u_int64_t dedup_hash_sse42(const u_char *data, size_t length) {
+	// two independent lanes hide latency of crc32 instruction
+	u_int64_t a = 0xFFFFFFFF ^ (u_int32_t)length;
+	u_int64_t b = 0x9E3779B9;
+	while(length >= 16) {
+		a = __builtin_ia32_crc32di(a, load_u64(data));
+		b = __builtin_ia32_crc32di(b, load_u64(data + 8));
+		data += 16;
+		length -= 16;
+	}
+	if(length >= 8) {
+		a = __builtin_ia32_crc32di(a, load_u64(data));
+		data += 8;
+		length -= 8;
+	}
+	u_int32_t b32 = b;
+	while(length) {
+		b32 = __builtin_ia32_crc32qi(b32, *data);
+		++data;
+		--length;
+	}
+	return(dedup_hash_finish(a, b32));
+}
+#endif
+
+u_int64_t dedup_hash(const void *data, size_t length) {
+	#if defined(__x86_64__)
+	if(dedup_hash_use_sse42 < 0) {
+		__builtin_cpu_init();
+		dedup_hash_use_sse42 = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+	}
+	if(dedup_hash_use_sse42) {
+		return(dedup_hash_sse42((const u_char*)data, length));
+	}
+	#endif
+	return(dedup_hash_sw((const u_char*)data, length));
+}
+
+
+list<cDedupTable*> cDedupTable::instances;
+cDedupTable::sStat cDedupTable::stat_removed;
+cDedupTable::sStat cDedupTable::stat_last;
+volatile int cDedupTable::_sync_instances = 0;
+
+cDedupTable::cDedupTable(unsigned setsBits, u_int32_t windowMS) {
+	this->setsMask = (1u << setsBits) - 1;
+	// sets are aligned to cache line
+	this->buffer = new FILE_LINE(0) u_char[sizeof(sSet) * (this->setsMask + 1) + 64];
+	memset(this->buffer, 0, sizeof(sSet) * (this->setsMask + 1) + 64);
+	this->sets = (sSet*)(((unsigned long)this->buffer + 63) & ~63ul);
+	this->window_us = windowMS * 1000ull;
+	memset(&this->stat, 0, sizeof(this->stat));
+	lock_instances();
+	instances.push_back(this);
+	unlock_instances();
+}
+
+cDedupTable::~cDedupTable() {
+	lock_instances();
+	instances.remove(this);
+	stat_removed.lookups += this->stat.lookups;
+	stat_removed.hits += this->stat.hits;
+	stat_removed.collisions += this->stat.collisions;
+	stat_removed.expired += this->stat.expired;
+	unlock_instances();
+	delete [] this->buffer;
+}
+
+string cDedupTable::getStatString() {
+	lock_instances();
+	sStat sum = stat_removed;
+	for(list<cDedupTable*>::iterator iter = instances.begin(); iter != instances.end(); iter++) {
+		sum.lookups += (*iter)->stat.lookups;
+		sum.hits += (*iter)->stat.hits;
+		sum.collisions += (*iter)->stat.collisions;
+		sum.expired += (*iter)->stat.expired;
+	}
+	ostringstream outStr;
+	outStr << "l:" << (sum.lookups - stat_last.lookups)
+	       << " h:" << (sum.hits - stat_last.hits)
+	       << " c:" << (sum.collisions - stat_last.collisions)
+	       << " e:" << (sum.expired - stat_last.expired);
+	stat_last = sum;
+	unlock_instances();
+	return(outStr.str());
+}
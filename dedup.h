@@ -0,0 +1,123 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+
+#include <string>
+#include <list>
+#include <string.h>
+#include <sys/types.h>
+
+
+/*
+ * Fast non-cryptographic hash of packet content for deduplication.
+ * Two interleaved CRC32C lanes give 64 bits; SSE4.2 crc32 instruction is used
+ * when cpu supports it, software fallback returns identical values.
+ * Low 16 bits of result are never zero (zero md5[0] means "not calculated").
+ */
+u_int64_t dedup_hash(const void *data, size_t length);
+
+/*
+ * Hash is stored in md5 field of packet header by 16-bit words, lowest word first,
+ * so md5[0] is the low (never zero) word independently of byte order.
+ */
+inline void dedup_hash_to_md5(u_int64_t hash, uint16_t *md5) {
+	uint16_t words[8];
+	for(unsigned i = 0; i < 4; i++) {
+		words[i] = (uint16_t)(hash >> (i * 16));
+		words[i + 4] = 0;
+	}
+	memcpy(md5, words, sizeof(words));
+}
+
+inline u_int64_t dedup_hash_from_md5(uint16_t *md5) {
+	uint16_t words[4];
+	memcpy(words, md5, sizeof(words));
+	u_int64_t hash = 0;
+	for(unsigned i = 0; i < 4; i++) {
+		hash |= (u_int64_t)words[i] << (i * 16);
+	}
+	return(hash);
+}
+
+
+/*
+ * Set-associative table of recently seen packet hashes.
+ * Packet is duplicate if the same hash was seen within time window
+ * (packet time, 0 = unlimited). On miss the hash replaces empty, expired or
+ * the oldest way of the set. Not thread safe - one instance per thread.
+ */
+class cDedupTable {
+public:
+	enum eWays {
+		ways = 4
+	};
+	struct sEntry {
+		u_int64_t hash;
+		u_int64_t time_us;
+	};
+	struct sSet {
+		sEntry way[ways];
+	};
+	struct sStat {
+		u_int64_t lookups;
+		u_int64_t hits;
+		u_int64_t collisions;
+		u_int64_t expired;
+	};
+public:
+	cDedupTable(unsigned setsBits, u_int32_t windowMS);
+	~cDedupTable();
+	inline bool check(u_int64_t hash, u_int64_t time_us) {
+		++this->stat.lookups;
+		sSet *set = &this->sets[(hash ^ (hash >> 29)) & this->setsMask];
+		sEntry *victim = &set->way[0];
+		for(unsigned i = 0; i < ways; i++) {
+			sEntry *entry = &set->way[i];
+			if(entry->hash == hash) {
+				if(!this->window_us ||
+				   (time_us > entry->time_us ? time_us - entry->time_us : entry->time_us - time_us) <= this->window_us) {
+					++this->stat.hits;
+					return(true);
+				}
+				++this->stat.expired;
+				entry->time_us = time_us;
+				return(false);
+			}
+			if(!entry->hash) {
+				if(victim->hash) {
+					victim = entry;
+				}
+			} else if(victim->hash && entry->time_us < victim->time_us) {
+				victim = entry;
+			}
+		}
+		if(victim->hash &&
+		   (!this->window_us || victim->time_us + this->window_us >= time_us)) {
+			++this->stat.collisions;
+		}
+		victim->hash = hash;
+		victim->time_us = time_us;
+		return(false);
+	}
+	static std::string getStatString();
+private:
+	static void lock_instances() {
+		while(__sync_lock_test_and_set(&_sync_instances, 1));
+	}
+	static void unlock_instances() {
+		__sync_lock_release(&_sync_instances);
+	}
+private:
+	u_char *buffer;
+	sSet *sets;
+	u_int32_t setsMask;
+	u_int64_t window_us;
+	sStat stat;
+	static std::list<cDedupTable*> instances;
+	static sStat stat_removed;
+	static sStat stat_last;
+	static volatile int _sync_instances;
+};
+
+
+#endif //DEDUP_H
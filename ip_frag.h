@@ -5,6 +5,11 @@
 
 #include "header_packet.h"
 
+
+#define IPFRAG_QUEUE_SLOTS 8
+#define IPFRAG_TABLE_INIT_SIZE 256
+
+
 struct ip_frag_s {
 	sHeaderPacket *header_packet;
 	void *header_packet_pqout;
@@ -15,20 +20,89 @@ struct ip_frag_s {
 	u_int16_t iphdr_len;
 };
 
-typedef map<unsigned int, ip_frag_s*> ip_frag_queue_t;
-typedef map<unsigned int, ip_frag_s*>::iterator ip_frag_queue_it_t;
+struct ip_frag_key {
+	inline bool operator == (const ip_frag_key &other) const {
+		return(this->id == other.id &&
+		       this->proto == other.proto &&
+		       this->saddr == other.saddr &&
+		       this->daddr == other.daddr);
+	}
+	inline u_int32_t hash() {
+		u_int32_t hash = this->saddr.getHashNumber() * 0x9E3779B1 ^ this->daddr.getHashNumber();
+		hash ^= this->id * 0x85EBCA6B ^ this->proto;
+		hash ^= hash >> 16;
+		hash *= 0x45D9F3B;
+		hash ^= hash >> 16;
+		return(hash);
+	}
+	vmIP saddr;
+	vmIP daddr;
+	u_int32_t id;
+	u_int8_t proto;
+};
 
-struct ip_frag_queue : ip_frag_queue_t {
+/*
+ * Fragments of one datagram sorted by offset. Short queues use preallocated slots,
+ * longer ones move to heap array.
+ */
+struct ip_frag_queue {
 	ip_frag_queue() {
+		frags = slots;
+		capacity = IPFRAG_QUEUE_SLOTS;
+		count = 0;
 		has_last = false;
 	}
+	~ip_frag_queue() {
+		if(frags != slots) {
+			delete [] frags;
+		}
+	}
+	void reset() {
+		if(frags != slots) {
+			delete [] frags;
+			frags = slots;
+			capacity = IPFRAG_QUEUE_SLOTS;
+		}
+		count = 0;
+		has_last = false;
+	}
+	unsigned size() {
+		return(count);
+	}
+	ip_frag_s *begin() {
+		return(frags);
+	}
+	ip_frag_s *end() {
+		return(frags + count);
+	}
+	ip_frag_s *insert(u_int32_t offset);
+	ip_frag_key key;
+	u_int32_t hash;
+	ip_frag_s slots[IPFRAG_QUEUE_SLOTS];
+	ip_frag_s *frags;
+	unsigned count;
+	unsigned capacity;
 	bool has_last;
 };
 
+/*
+ * Fragment queues in open addressing table (linear probing) keyed by (src, dst, id, protocol).
+ * Released queues are kept for reuse.
+ */
 struct ipfrag_data_s {
-	map<vmIP, map<unsigned int, ip_frag_queue*> > ip_frag_stream;
-	map<vmIP, map<unsigned int, ip_frag_queue*> >::iterator ip_frag_streamIT;
-	map<unsigned int, ip_frag_queue*>::iterator ip_frag_streamITinner;
+	ipfrag_data_s();
+	~ipfrag_data_s();
+	ip_frag_queue *get(ip_frag_key *key);
+	void remove(ip_frag_queue *queue);
+	unsigned size() {
+		return(count);
+	}
+	ip_frag_queue **table;
+	unsigned table_size;
+	unsigned count;
+	vector<ip_frag_queue*> free_queues;
+private:
+	void resize(unsigned new_size);
 };
 
 void ipfrag_prune(unsigned int tv_sec, bool all, ipfrag_data_s *ipfrag_data,
@@ -0,0 +1,188 @@
+#include <string.h>
+#include <sstream>
+#include <iomanip>
+
+#include "tools.h"
+#include "latency_stat.h"
+
+
+using namespace std;
+
+
+static const char *latencyStatStageNames[][2] = {
+	{ "block", "blk" },
+	{ "t2", "t2" },
+	{ "detach", "d" },
+	{ "sip", "s" },
+	{ "extend", "e" },
+	{ "call", "c" },
+	{ "callx", "cx" },
+	{ "register", "g" },
+	{ "sip_other", "so" },
+	{ "pp_rtp", "r" },
+	{ "other", "o" },
+	{ "rtp", "rtp" },
+	{ "save", "save" }
+};
+
+
+u_int32_t cLatencyStat::sampleMask = 1023;
+__thread u_int32_t cLatencyStat::sampleCounter[_ls_max];
+__thread cLatencyStat::sThreadHistograms *cLatencyStat::threadHistograms = NULL;
+pthread_key_t cLatencyStat::threadHistogramsKey;
+vector<cLatencyStat::sThreadHistograms*> cLatencyStat::allThreadHistograms;
+volatile int cLatencyStat::_sync_threads = 0;
+u_int64_t (*cLatencyStat::lastBuckets)[LATENCY_STAT_BUCKETS] = NULL;
+cLatencyStat::sStageStat cLatencyStat::stageStat[_ls_max];
+volatile int cLatencyStat::_sync_stat = 0;
+
+
+void cLatencyStat::init(int sampling) {
+	u_int32_t _sampling = 1;
+	while(sampling > 0 && _sampling < (u_int32_t)sampling && _sampling < (1u << 30)) {
+		_sampling <<= 1;
+	}
+	sampleMask = _sampling - 1;
+	pthread_key_create(&threadHistogramsKey, releaseThreadHistograms);
+	lastBuckets = new FILE_LINE(0) u_int64_t[_ls_max][LATENCY_STAT_BUCKETS];
+	memset(lastBuckets, 0, sizeof(u_int64_t) * _ls_max * LATENCY_STAT_BUCKETS);
+	memset(stageStat, 0, sizeof(stageStat));
+}
+
+void cLatencyStat::evaluate() {
+	if(!opt_latency_stat || !lastBuckets) {
+		return;
+	}
+	u_int64_t (*buckets)[LATENCY_STAT_BUCKETS] = new FILE_LINE(0) u_int64_t[_ls_max][LATENCY_STAT_BUCKETS];
+	memset(buckets, 0, sizeof(u_int64_t) * _ls_max * LATENCY_STAT_BUCKETS);
+	__SYNC_LOCK(_sync_threads);
+	for(unsigned i = 0; i < allThreadHistograms.size(); i++) {
+		for(unsigned j = 0; j < _ls_max; j++) {
+			for(unsigned k = 0; k < LATENCY_STAT_BUCKETS; k++) {
+				buckets[j][k] += allThreadHistograms[i]->buckets[j][k];
+			}
+		}
+	}
+	__SYNC_UNLOCK(_sync_threads);
+	__SYNC_LOCK(_sync_stat);
+	for(unsigned j = 0; j < _ls_max; j++) {
+		u_int64_t count = 0;
+		u_int64_t max = 0;
+		for(unsigned k = 0; k < LATENCY_STAT_BUCKETS; k++) {
+			u_int64_t diff = buckets[j][k] - lastBuckets[j][k];
+			lastBuckets[j][k] = buckets[j][k];
+			buckets[j][k] = diff;
+			if(diff) {
+				count += diff;
+				max = getBucketValue(k);
+			}
+		}
+		stageStat[j].count = count;
+		stageStat[j].p50 = getPercentile(buckets[j], count, 50);
+		stageStat[j].p90 = getPercentile(buckets[j], count, 90);
+		stageStat[j].p99 = getPercentile(buckets[j], count, 99);
+		stageStat[j].p999 = getPercentile(buckets[j], count, 99.9);
+		stageStat[j].max = max;
+	}
+	__SYNC_UNLOCK(_sync_stat);
+	delete [] buckets;
+}
+
+string cLatencyStat::getStatString() {
+	if(!opt_latency_stat) {
+		return("");
+	}
+	ostringstream outStr;
+	outStr << fixed << setprecision(1);
+	__SYNC_LOCK(_sync_stat);
+	for(unsigned j = 0; j < _ls_max; j++) {
+		if(stageStat[j].count) {
+			outStr << (outStr.tellp() ? " " : "LAT[")
+			       << latencyStatStageNames[j][1] << ":"
+			       << stageStat[j].p50 / 1000. << "/"
+			       << stageStat[j].p99 / 1000.;
+		}
+	}
+	__SYNC_UNLOCK(_sync_stat);
+	if(outStr.tellp()) {
+		outStr << "]ms";
+	}
+	return(outStr.str());
+}
+
+string cLatencyStat::getJson() {
+	ostringstream outStr;
+	outStr << "{";
+	if(opt_latency_stat) {
+		__SYNC_LOCK(_sync_stat);
+		outStr << "\"sampling\": \"" << (sampleMask + 1) << "\"";
+		for(unsigned j = 0; j < _ls_max; j++) {
+			outStr << ",\"" << latencyStatStageNames[j][0] << "\": {"
+			       << "\"count\": \"" << stageStat[j].count << "\","
+			       << "\"p50_us\": \"" << stageStat[j].p50 << "\","
+			       << "\"p90_us\": \"" << stageStat[j].p90 << "\","
+			       << "\"p99_us\": \"" << stageStat[j].p99 << "\","
+			       << "\"p999_us\": \"" << stageStat[j].p999 << "\","
+			       << "\"max_us\": \"" << stageStat[j].max << "\""
+			       << "}";
+		}
+		__SYNC_UNLOCK(_sync_stat);
+	}
+	outStr << "}";
+	return(outStr.str());
+}
+
+void cLatencyStat::_add(eStage stage, u_int64_t captureTimeUS) {
+	sThreadHistograms *histograms = threadHistograms;
+	if(!histograms) {
+		histograms = getThreadHistograms();
+	}
+	u_int64_t nowUS = getTimeUS();
+	histograms->buckets[stage][getBucket(nowUS > captureTimeUS ? nowUS - captureTimeUS : 0)]++;
+}
+
+cLatencyStat::sThreadHistograms *cLatencyStat::getThreadHistograms() {
+	sThreadHistograms *histograms = NULL;
+	__SYNC_LOCK(_sync_threads);
+	for(unsigned i = 0; i < allThreadHistograms.size(); i++) {
+		if(!allThreadHistograms[i]->used) {
+			histograms = allThreadHistograms[i];
+			break;
+		}
+	}
+	if(!histograms) {
+		histograms = new FILE_LINE(0) sThreadHistograms;
+		memset(histograms, 0, sizeof(sThreadHistograms));
+		allThreadHistograms.push_back(histograms);
+	}
+	histograms->used = true;
+	__SYNC_UNLOCK(_sync_threads);
+	// slot is returned to pool at the end of the thread, counters remain
+	pthread_setspecific(threadHistogramsKey, histograms);
+	threadHistograms = histograms;
+	return(histograms);
+}
+
+void cLatencyStat::releaseThreadHistograms(void *threadHistograms) {
+	__SYNC_LOCK(_sync_threads);
+	((sThreadHistograms*)threadHistograms)->used = false;
+	__SYNC_UNLOCK(_sync_threads);
+}
+
+u_int64_t cLatencyStat::getPercentile(u_int64_t *buckets, u_int64_t count, double perc) {
+	if(!count) {
+		return(0);
+	}
+	u_int64_t limit = (u_int64_t)(count * perc / 100);
+	if(limit >= count) {
+		limit = count - 1;
+	}
+	u_int64_t sum = 0;
+	for(unsigned k = 0; k < LATENCY_STAT_BUCKETS; k++) {
+		sum += buckets[k];
+		if(sum > limit) {
+			return(getBucketValue(k));
+		}
+	}
+	return(0);
+}
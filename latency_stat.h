@@ -0,0 +1,102 @@
+#ifndef LATENCY_STAT_H
+#define LATENCY_STAT_H
+
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+
+
+// log-linear buckets - 8 sub-buckets per power of two (max relative error 12.5%)
+#define LATENCY_STAT_SUB_BITS 3
+#define LATENCY_STAT_SUB_COUNT (1 << LATENCY_STAT_SUB_BITS)
+#define LATENCY_STAT_BUCKETS ((64 - LATENCY_STAT_SUB_BITS + 1) * LATENCY_STAT_SUB_COUNT)
+
+
+extern int opt_latency_stat;
+
+
+/*
+ * Sampled latency of packets between capture (pcap header timestamp) and stages
+ * of processing. Each thread writes to own histograms (single writer, no locks),
+ * pcapStat sums histograms of all threads and evaluates percentiles from difference
+ * against previous evaluation.
+ */
+class cLatencyStat {
+public:
+	enum eStage {
+		_ls_block,
+		_ls_t2,
+		_ls_pp_detach,
+		_ls_pp_sip,
+		_ls_pp_extend,
+		_ls_pp_call,
+		_ls_pp_callx,
+		_ls_pp_register,
+		_ls_pp_sip_other,
+		_ls_pp_rtp,
+		_ls_pp_other,
+		_ls_rtp,
+		_ls_save,
+		_ls_max
+	};
+	struct sThreadHistograms {
+		u_int64_t buckets[_ls_max][LATENCY_STAT_BUCKETS];
+		volatile bool used;
+	};
+	struct sStageStat {
+		u_int64_t count;
+		u_int64_t p50;
+		u_int64_t p90;
+		u_int64_t p99;
+		u_int64_t p999;
+		u_int64_t max;
+	};
+public:
+	static void init(int sampling);
+	static inline void add(eStage stage, u_int64_t captureTimeUS) {
+		if(!opt_latency_stat ||
+		   (++sampleCounter[stage] & sampleMask)) {
+			return;
+		}
+		_add(stage, captureTimeUS);
+	}
+	static void evaluate();
+	static std::string getStatString();
+	static std::string getJson();
+private:
+	static void _add(eStage stage, u_int64_t captureTimeUS);
+	static sThreadHistograms *getThreadHistograms();
+	static void releaseThreadHistograms(void *threadHistograms);
+	static inline unsigned getBucket(u_int64_t value) {
+		if(value < LATENCY_STAT_SUB_COUNT) {
+			return(value);
+		}
+		unsigned msb = 63 - __builtin_clzll(value);
+		return((msb - LATENCY_STAT_SUB_BITS + 1) * LATENCY_STAT_SUB_COUNT +
+		       ((value >> (msb - LATENCY_STAT_SUB_BITS)) & (LATENCY_STAT_SUB_COUNT - 1)));
+	}
+	static inline u_int64_t getBucketValue(unsigned bucket) {
+		if(bucket < LATENCY_STAT_SUB_COUNT) {
+			return(bucket);
+		}
+		unsigned msb = bucket / LATENCY_STAT_SUB_COUNT + LATENCY_STAT_SUB_BITS - 1;
+		return((u_int64_t)(LATENCY_STAT_SUB_COUNT + bucket % LATENCY_STAT_SUB_COUNT) << (msb - LATENCY_STAT_SUB_BITS));
+	}
+	static u_int64_t getPercentile(u_int64_t *buckets, u_int64_t count, double perc);
+private:
+	static u_int32_t sampleMask;
+	// per stage - thread with more stages per packet would sample only some of them with common counter
+	static __thread u_int32_t sampleCounter[_ls_max];
+	static __thread sThreadHistograms *threadHistograms;
+	static pthread_key_t threadHistogramsKey;
+	static std::vector<sThreadHistograms*> allThreadHistograms;
+	static volatile int _sync_threads;
+	static u_int64_t (*lastBuckets)[LATENCY_STAT_BUCKETS];
+	static sStageStat stageStat[_ls_max];
+	static volatile int _sync_stat;
+};
+
+
+#endif //LATENCY_STAT_H
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sstream>
+#include <iomanip>
+#include <arpa/inet.h>
+
+#include "tools.h"
+#include "load_generator.h"
+
+
+using namespace std;
+
+
+#define LOAD_GENERATOR_ETH_HEADER_LENGTH 14
+#define LOAD_GENERATOR_IP_HEADER_LENGTH 20
+#define LOAD_GENERATOR_UDP_HEADER_LENGTH 8
+#define LOAD_GENERATOR_HEADERS_LENGTH (LOAD_GENERATOR_ETH_HEADER_LENGTH + LOAD_GENERATOR_IP_HEADER_LENGTH + LOAD_GENERATOR_UDP_HEADER_LENGTH)
+#define LOAD_GENERATOR_RTP_HEADER_LENGTH 12
+#define LOAD_GENERATOR_SIP_PORT 5060
+#define LOAD_GENERATOR_RING_MS 500
+
+
+static cLoadGenerator::sCodec loadGeneratorCodecs[] = {
+	{ 0, "PCMU", 160, 20 },
+	{ 3, "GSM", 33, 20 },
+	{ 4, "G723", 24, 30 },
+	{ 8, "PCMA", 160, 20 },
+	{ 9, "G722", 160, 20 },
+	{ 18, "G729", 20, 20 }
+};
+
+
+volatile u_int64_t cLoadGenerator::stat_all_packets = 0;
+volatile u_int64_t cLoadGenerator::stat_all_calls = 0;
+volatile u_int64_t cLoadGenerator::stat_all_drops = 0;
+volatile int cLoadGenerator::stat_all_active_calls = 0;
+volatile bool cLoadGenerator::drops_begin = false;
+volatile double cLoadGenerator::ramp_cps_stop = 0;
+
+
+cLoadGenerator::cLoadGenerator(int index, int countThreads,
+			       unsigned cps, unsigned calls, const char *codecs, double lossPerc, unsigned cpsRamp) {
+	this->index = index;
+	this->countThreads = max(countThreads, 1);
+	this->cps = max(cps, 1u);
+	this->calls = max(calls, 1u);
+	this->lossPerc = lossPerc;
+	this->cpsRamp = cpsRamp;
+	// concurrent calls = calls per second * duration of call
+	this->callDurationUS = max((u_int64_t)this->calls * 1000000ull / this->cps, 1000000ull);
+	this->codecsWeightSum = 0;
+	this->parseCodecs(codecs);
+	this->startUS = 0;
+	this->nextCallUS = 0;
+	this->callCounter = 0;
+	this->randSeed = 0x9E3779B9 ^ (index + 1);
+	this->stat_packets = 0;
+	this->stat_drops = 0;
+}
+
+bool cLoadGenerator::nextPacket(u_int64_t nowUS, pcap_pkthdr *header, u_char *packet, u_int32_t snaplen) {
+	if(!this->startUS) {
+		this->startUS = nowUS;
+		// threads start shifted so that calls are spread evenly
+		this->nextCallUS = nowUS + (u_int64_t)(1000000. / this->cps * this->index);
+	}
+	while(true) {
+		if(this->nextCallUS <= nowUS &&
+		   (this->events.empty() || this->nextCallUS <= this->events.top().timeUS)) {
+			this->startCall(this->nextCallUS);
+			this->nextCallUS += (u_int64_t)(1000000. * this->countThreads / this->getActCps(this->nextCallUS));
+		}
+		if(this->events.empty() || this->events.top().timeUS > nowUS) {
+			return(false);
+		}
+		sEvent event = this->events.top();
+		this->events.pop();
+		if(this->createPacket(&event, header, packet, snaplen)) {
+			++this->stat_packets;
+			__sync_fetch_and_add(&stat_all_packets, 1);
+			return(true);
+		}
+	}
+}
+
+void cLoadGenerator::addDrops(u_int32_t drops) {
+	if(!drops) {
+		return;
+	}
+	if(!drops_begin) {
+		ramp_cps_stop = this->getActCps(getTimeUS());
+		drops_begin = true;
+	}
+	this->stat_drops += drops;
+	__sync_fetch_and_add(&stat_all_drops, drops);
+}
+
+void cLoadGenerator::getStat(u_int64_t *packets, u_int64_t *drops) {
+	*packets = this->stat_packets;
+	*drops = this->stat_drops;
+}
+
+string cLoadGenerator::getStatString(int statPeriod, bool *dropsBegin) {
+	static u_int64_t last_packets = 0;
+	static u_int64_t last_calls = 0;
+	static u_int64_t last_drops = 0;
+	u_int64_t packets = stat_all_packets;
+	u_int64_t calls = stat_all_calls;
+	u_int64_t drops = stat_all_drops;
+	if(statPeriod <= 0) {
+		statPeriod = 1;
+	}
+	ostringstream outStr;
+	outStr << fixed
+	       << "GEN["
+	       << (packets - last_packets) / statPeriod << "p/s "
+	       << (calls - last_calls) / statPeriod << "c/s "
+	       << stat_all_active_calls << "c";
+	if(drops > last_drops) {
+		outStr << " d" << (drops - last_drops);
+	}
+	outStr << "]";
+	*dropsBegin = drops > last_drops && last_drops == 0;
+	last_packets = packets;
+	last_calls = calls;
+	last_drops = drops;
+	return(outStr.str());
+}
+
+void cLoadGenerator::startCall(u_int64_t timeUS) {
+	u_int32_t callIndex;
+	if(this->freeSlots.size()) {
+		callIndex = this->freeSlots.back();
+		this->freeSlots.pop_back();
+	} else {
+		callIndex = this->callsSlots.size();
+		this->callsSlots.resize(callIndex + 1);
+	}
+	sCall *call = &this->callsSlots[callIndex];
+	call->id = ++this->callCounter;
+	u_int32_t ipIndex = call->id & 0xFFFF;
+	u_int32_t portIndex = (call->id >> 16) % 25000;
+	call->callerIp = 0x0A000000 | ((this->index & 0x3F) << 16) | ipIndex;
+	call->calledIp = 0x0A400000 | ((this->index & 0x3F) << 16) | ipIndex;
+	call->callerRtpPort = 10000 + portIndex * 2;
+	call->calledRtpPort = 10000 + portIndex * 2;
+	call->codec = this->getRandomCodec();
+	for(int i = 0; i < 2; i++) {
+		call->rtpSeq[i] = rand_r(&this->randSeed) & 0xFFFF;
+		call->rtpTimestamp[i] = rand_r(&this->randSeed);
+		call->rtpSsrc[i] = rand_r(&this->randSeed);
+	}
+	u_int64_t connectUS = timeUS + LOAD_GENERATOR_RING_MS * 1000;
+	call->endUS = connectUS + this->callDurationUS;
+	sEvent event;
+	event.callIndex = callIndex;
+	event.timeUS = timeUS; event.type = _ev_invite; this->events.push(event);
+	event.timeUS = timeUS + 1000; event.type = _ev_trying; this->events.push(event);
+	event.timeUS = timeUS + 2000; event.type = _ev_ringing; this->events.push(event);
+	event.timeUS = connectUS; event.type = _ev_ok; this->events.push(event);
+	event.timeUS = connectUS + 1000; event.type = _ev_ack; this->events.push(event);
+	event.timeUS = connectUS + 2000; event.type = _ev_rtp_caller; this->events.push(event);
+	event.timeUS = connectUS + 2500; event.type = _ev_rtp_called; this->events.push(event);
+	event.timeUS = call->endUS; event.type = _ev_bye; this->events.push(event);
+	event.timeUS = call->endUS + 1000; event.type = _ev_bye_ok; this->events.push(event);
+	__sync_fetch_and_add(&stat_all_calls, 1);
+	__sync_fetch_and_add(&stat_all_active_calls, 1);
+}
+
+void cLoadGenerator::endCall(u_int32_t callIndex) {
+	this->freeSlots.push_back(callIndex);
+	__sync_fetch_and_sub(&stat_all_active_calls, 1);
+}
+
+bool cLoadGenerator::createPacket(sEvent *event, pcap_pkthdr *header, u_char *packet, u_int32_t snaplen) {
+	sCall *call = &this->callsSlots[event->callIndex];
+	unsigned dataLength = 0;
+	u_int32_t srcIp, dstIp;
+	u_int16_t srcPort, dstPort;
+	bool rslt = true;
+	if(event->type == _ev_rtp_caller || event->type == _ev_rtp_called) {
+		int direction = event->type == _ev_rtp_caller ? 0 : 1;
+		if(direction == 0) {
+			srcIp = call->callerIp; dstIp = call->calledIp;
+			srcPort = call->callerRtpPort; dstPort = call->calledRtpPort;
+		} else {
+			srcIp = call->calledIp; dstIp = call->callerIp;
+			srcPort = call->calledRtpPort; dstPort = call->callerRtpPort;
+		}
+		if(event->timeUS + call->codec->ptimeMS * 1000 < call->endUS) {
+			sEvent nextEvent = *event;
+			nextEvent.timeUS += call->codec->ptimeMS * 1000;
+			this->events.push(nextEvent);
+		}
+		++call->rtpSeq[direction];
+		call->rtpTimestamp[direction] += call->codec->ptimeMS * 8;
+		if(this->lossPerc > 0 &&
+		   rand_r(&this->randSeed) < this->lossPerc / 100 * RAND_MAX) {
+			return(false);
+		}
+		dataLength = LOAD_GENERATOR_RTP_HEADER_LENGTH + call->codec->payloadLength;
+		if(LOAD_GENERATOR_HEADERS_LENGTH + dataLength > snaplen) {
+			return(false);
+		}
+		u_char *rtp = packet + LOAD_GENERATOR_HEADERS_LENGTH;
+		rtp[0] = 0x80;
+		rtp[1] = call->codec->payload;
+		*(u_int16_t*)(rtp + 2) = htons(call->rtpSeq[direction]);
+		*(u_int32_t*)(rtp + 4) = htonl(call->rtpTimestamp[direction]);
+		*(u_int32_t*)(rtp + 8) = htonl(call->rtpSsrc[direction]);
+		memset(rtp + LOAD_GENERATOR_RTP_HEADER_LENGTH, call->codec->payload == 0 ? 0xFF : 0xD5, call->codec->payloadLength);
+	} else {
+		bool fromCaller = event->type == _ev_invite || event->type == _ev_ack || event->type == _ev_bye;
+		srcIp = fromCaller ? call->callerIp : call->calledIp;
+		dstIp = fromCaller ? call->calledIp : call->callerIp;
+		srcPort = dstPort = LOAD_GENERATOR_SIP_PORT;
+		if(snaplen <= LOAD_GENERATOR_HEADERS_LENGTH) {
+			rslt = false;
+		} else {
+			dataLength = this->createSipMessage(call, (eEventType)event->type,
+							    (char*)packet + LOAD_GENERATOR_HEADERS_LENGTH, snaplen - LOAD_GENERATOR_HEADERS_LENGTH);
+			rslt = dataLength > 0;
+		}
+		if(event->type == _ev_bye_ok) {
+			this->endCall(event->callIndex);
+		}
+		if(!rslt) {
+			return(false);
+		}
+	}
+	this->createUdpHeaders(packet, srcIp, dstIp, srcPort, dstPort, dataLength);
+	header->ts.tv_sec = event->timeUS / 1000000;
+	header->ts.tv_usec = event->timeUS % 1000000;
+	header->caplen = LOAD_GENERATOR_HEADERS_LENGTH + dataLength;
+	header->len = header->caplen;
+	return(true);
+}
+
+unsigned cLoadGenerator::createSipMessage(sCall *call, eEventType type, char *buffer, unsigned bufferLength) {
+	char callerIpStr[INET_ADDRSTRLEN];
+	char calledIpStr[INET_ADDRSTRLEN];
+	u_int32_t ip;
+	ip = htonl(call->callerIp);
+	inet_ntop(AF_INET, &ip, callerIpStr, sizeof(callerIpStr));
+	ip = htonl(call->calledIp);
+	inet_ntop(AF_INET, &ip, calledIpStr, sizeof(calledIpStr));
+	u_int32_t callerNumber = 1000000 + call->id;
+	u_int32_t calledNumber = 2000000 + call->id;
+	char sdp[512];
+	unsigned sdpLength = 0;
+	if(type == _ev_invite || type == _ev_ok) {
+		sdpLength = this->createSdp(call, type == _ev_invite, sdp, sizeof(sdp));
+	}
+	const char *method = NULL;
+	const char *response = NULL;
+	unsigned cseq = 1;
+	switch(type) {
+	case _ev_invite: method = "INVITE"; break;
+	case _ev_trying: response = "100 Trying"; break;
+	case _ev_ringing: response = "180 Ringing"; break;
+	case _ev_ok: response = "200 OK"; break;
+	case _ev_ack: method = "ACK"; break;
+	case _ev_bye: method = "BYE"; cseq = 2; break;
+	case _ev_bye_ok: response = "200 OK"; cseq = 2; break;
+	default: return(0);
+	}
+	int length;
+	if(method) {
+		length = snprintf(buffer, bufferLength,
+				  "%s sip:%u@%s SIP/2.0\r\n"
+				  "Via: SIP/2.0/UDP %s:%u;branch=z9hG4bK%x%x\r\n"
+				  "Max-Forwards: 70\r\n"
+				  "From: <sip:%u@%s>;tag=%x\r\n"
+				  "To: <sip:%u@%s>%s%s\r\n"
+				  "Call-ID: %x-%u@loadgen\r\n"
+				  "CSeq: %u %s\r\n"
+				  "Contact: <sip:%u@%s:%u>\r\n"
+				  "%s"
+				  "Content-Length: %u\r\n"
+				  "\r\n"
+				  "%s",
+				  method, calledNumber, calledIpStr,
+				  callerIpStr, LOAD_GENERATOR_SIP_PORT, call->id, cseq,
+				  callerNumber, callerIpStr, call->rtpSsrc[0],
+				  calledNumber, calledIpStr, type == _ev_invite ? "" : ";tag=", type == _ev_invite ? "" : intToString(call->rtpSsrc[1]).c_str(),
+				  call->rtpSsrc[0], call->id,
+				  cseq, method,
+				  callerNumber, callerIpStr, LOAD_GENERATOR_SIP_PORT,
+				  sdpLength ? "Content-Type: application/sdp\r\n" : "",
+				  sdpLength,
+				  sdpLength ? sdp : "");
+	} else {
+		length = snprintf(buffer, bufferLength,
+				  "SIP/2.0 %s\r\n"
+				  "Via: SIP/2.0/UDP %s:%u;branch=z9hG4bK%x%x\r\n"
+				  "From: <sip:%u@%s>;tag=%x\r\n"
+				  "To: <sip:%u@%s>%s%s\r\n"
+				  "Call-ID: %x-%u@loadgen\r\n"
+				  "CSeq: %u %s\r\n"
+				  "%s"
+				  "Content-Length: %u\r\n"
+				  "\r\n"
+				  "%s",
+				  response,
+				  callerIpStr, LOAD_GENERATOR_SIP_PORT, call->id, cseq,
+				  callerNumber, callerIpStr, call->rtpSsrc[0],
+				  calledNumber, calledIpStr, type == _ev_trying ? "" : ";tag=", type == _ev_trying ? "" : intToString(call->rtpSsrc[1]).c_str(),
+				  call->rtpSsrc[0], call->id,
+				  cseq, cseq == 1 ? "INVITE" : "BYE",
+				  sdpLength ? "Content-Type: application/sdp\r\n" : "",
+				  sdpLength,
+				  sdpLength ? sdp : "");
+	}
+	if(length <= 0 || (unsigned)length >= bufferLength) {
+		return(0);
+	}
+	return(length);
+}
+
+unsigned cLoadGenerator::createSdp(sCall *call, bool caller, char *buffer, unsigned bufferLength) {
+	char ipStr[INET_ADDRSTRLEN];
+	u_int32_t ip = htonl(caller ? call->callerIp : call->calledIp);
+	inet_ntop(AF_INET, &ip, ipStr, sizeof(ipStr));
+	int length = snprintf(buffer, bufferLength,
+			      "v=0\r\n"
+			      "o=- %u 1 IN IP4 %s\r\n"
+			      "s=-\r\n"
+			      "c=IN IP4 %s\r\n"
+			      "t=0 0\r\n"
+			      "m=audio %u RTP/AVP %u\r\n"
+			      "a=rtpmap:%u %s/%u\r\n"
+			      "a=ptime:%u\r\n",
+			      call->id, ipStr,
+			      ipStr,
+			      caller ? call->callerRtpPort : call->calledRtpPort, call->codec->payload,
+			      call->codec->payload, call->codec->name, 8000,
+			      call->codec->ptimeMS);
+	if(length <= 0 || (unsigned)length >= bufferLength) {
+		return(0);
+	}
+	return(length);
+}
+
+void cLoadGenerator::createUdpHeaders(u_char *packet, u_int32_t srcIp, u_int32_t dstIp, u_int16_t srcPort, u_int16_t dstPort, unsigned dataLength) {
+	// ethernet
+	static const u_char srcMac[] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+	static const u_char dstMac[] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+	memcpy(packet, dstMac, 6);
+	memcpy(packet + 6, srcMac, 6);
+	*(u_int16_t*)(packet + 12) = htons(0x0800);
+	// ipv4
+	u_char *ip = packet + LOAD_GENERATOR_ETH_HEADER_LENGTH;
+	ip[0] = 0x45;
+	ip[1] = 0;
+	*(u_int16_t*)(ip + 2) = htons(LOAD_GENERATOR_IP_HEADER_LENGTH + LOAD_GENERATOR_UDP_HEADER_LENGTH + dataLength);
+	*(u_int16_t*)(ip + 4) = htons(this->stat_packets & 0xFFFF);
+	*(u_int16_t*)(ip + 6) = htons(0x4000);
+	ip[8] = 64;
+	ip[9] = IPPROTO_UDP;
+	*(u_int16_t*)(ip + 10) = 0;
+	*(u_int32_t*)(ip + 12) = htonl(srcIp);
+	*(u_int32_t*)(ip + 16) = htonl(dstIp);
+	u_int32_t sum = 0;
+	for(int i = 0; i < LOAD_GENERATOR_IP_HEADER_LENGTH; i += 2) {
+		sum += *(u_int16_t*)(ip + i);
+	}
+	while(sum >> 16) {
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	*(u_int16_t*)(ip + 10) = ~sum;
+	// udp - without checksum
+	u_char *udp = ip + LOAD_GENERATOR_IP_HEADER_LENGTH;
+	*(u_int16_t*)(udp) = htons(srcPort);
+	*(u_int16_t*)(udp + 2) = htons(dstPort);
+	*(u_int16_t*)(udp + 4) = htons(LOAD_GENERATOR_UDP_HEADER_LENGTH + dataLength);
+	*(u_int16_t*)(udp + 6) = 0;
+}
+
+void cLoadGenerator::parseCodecs(const char *codecs) {
+	vector<string> items = split(codecs ? codecs : "", ",", true);
+	for(unsigned i = 0; i < items.size(); i++) {
+		int payload = atoi(items[i].c_str());
+		size_t weightPos = items[i].find(':');
+		unsigned weight = weightPos != string::npos ? atoi(items[i].c_str() + weightPos + 1) : 1;
+		for(unsigned j = 0; j < sizeof(loadGeneratorCodecs) / sizeof(loadGeneratorCodecs[0]); j++) {
+			if(loadGeneratorCodecs[j].payload == payload && weight) {
+				this->codecs.push_back(&loadGeneratorCodecs[j]);
+				this->codecsWeight.push_back(weight);
+				this->codecsWeightSum += weight;
+				break;
+			}
+		}
+	}
+	if(!this->codecs.size()) {
+		for(unsigned j = 0; j < sizeof(loadGeneratorCodecs) / sizeof(loadGeneratorCodecs[0]); j++) {
+			if(loadGeneratorCodecs[j].payload == 8) {
+				this->codecs.push_back(&loadGeneratorCodecs[j]);
+				this->codecsWeight.push_back(1);
+				this->codecsWeightSum = 1;
+			}
+		}
+	}
+}
+
+const cLoadGenerator::sCodec *cLoadGenerator::getRandomCodec() {
+	if(this->codecs.size() == 1) {
+		return(this->codecs[0]);
+	}
+	unsigned weight = rand_r(&this->randSeed) % this->codecsWeightSum;
+	for(unsigned i = 0; i < this->codecs.size(); i++) {
+		if(weight < this->codecsWeight[i]) {
+			return(this->codecs[i]);
+		}
+		weight -= this->codecsWeight[i];
+	}
+	return(this->codecs[0]);
+}
+
+double cLoadGenerator::getActCps(u_int64_t nowUS) {
+	if(!this->cpsRamp) {
+		return(this->cps);
+	}
+	if(drops_begin && ramp_cps_stop > 0) {
+		return(ramp_cps_stop);
+	}
+	return(this->cps + this->cpsRamp * (double)((nowUS - this->startUS) / (LOAD_GENERATOR_RAMP_PERIOD_S * 1000000ull)));
+}
@@ -0,0 +1,110 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+
+#include <queue>
+#include <string>
+#include <vector>
+#include <pcap.h>
+#include <sys/types.h>
+
+
+#define LOAD_GENERATOR_RAMP_PERIOD_S 10
+
+
+/*
+ * Synthetic SIP/RTP traffic for capacity measurement without NIC.
+ * Each read thread owns one instance which creates calls at the configured rate
+ * (INVITE / 100 / 180 / 200 + SDP / ACK, RTP in both directions, BYE / 200)
+ * and writes the packets (ethernet / ipv4 / udp) directly into the block store.
+ * Packets are timed by wall clock so the rest of the pipeline sees live traffic.
+ * Blocks which can not be pushed to packetbuffer are dropped and counted like
+ * interface drops. With ramp the rate of calls is raised every
+ * LOAD_GENERATOR_RAMP_PERIOD_S until the first drops.
+ */
+class cLoadGenerator {
+public:
+	struct sCodec {
+		u_int8_t payload;
+		const char *name;
+		u_int16_t payloadLength;
+		u_int16_t ptimeMS;
+	};
+	enum eEventType {
+		_ev_invite,
+		_ev_trying,
+		_ev_ringing,
+		_ev_ok,
+		_ev_ack,
+		_ev_rtp_caller,
+		_ev_rtp_called,
+		_ev_bye,
+		_ev_bye_ok
+	};
+	struct sCall {
+		u_int32_t id;
+		u_int32_t callerIp;
+		u_int32_t calledIp;
+		u_int16_t callerRtpPort;
+		u_int16_t calledRtpPort;
+		const sCodec *codec;
+		u_int16_t rtpSeq[2];
+		u_int32_t rtpTimestamp[2];
+		u_int32_t rtpSsrc[2];
+		u_int64_t endUS;
+	};
+	struct sEvent {
+		u_int64_t timeUS;
+		u_int32_t callIndex;
+		u_int8_t type;
+		bool operator < (const sEvent &other) const {
+			return(timeUS > other.timeUS);
+		}
+	};
+public:
+	cLoadGenerator(int index, int countThreads,
+		       unsigned cps, unsigned calls, const char *codecs, double lossPerc, unsigned cpsRamp);
+	bool nextPacket(u_int64_t nowUS, pcap_pkthdr *header, u_char *packet, u_int32_t snaplen);
+	void addDrops(u_int32_t drops);
+	void getStat(u_int64_t *packets, u_int64_t *drops);
+	static std::string getStatString(int statPeriod, bool *dropsBegin);
+private:
+	void startCall(u_int64_t timeUS);
+	void endCall(u_int32_t callIndex);
+	bool createPacket(sEvent *event, pcap_pkthdr *header, u_char *packet, u_int32_t snaplen);
+	unsigned createSipMessage(sCall *call, eEventType type, char *buffer, unsigned bufferLength);
+	unsigned createSdp(sCall *call, bool caller, char *buffer, unsigned bufferLength);
+	void createUdpHeaders(u_char *packet, u_int32_t srcIp, u_int32_t dstIp, u_int16_t srcPort, u_int16_t dstPort, unsigned dataLength);
+	void parseCodecs(const char *codecs);
+	const sCodec *getRandomCodec();
+	double getActCps(u_int64_t nowUS);
+private:
+	int index;
+	int countThreads;
+	unsigned cps;
+	unsigned calls;
+	double lossPerc;
+	unsigned cpsRamp;
+	u_int64_t callDurationUS;
+	std::vector<const sCodec*> codecs;
+	std::vector<unsigned> codecsWeight;
+	unsigned codecsWeightSum;
+	std::vector<sCall> callsSlots;
+	std::vector<u_int32_t> freeSlots;
+	std::priority_queue<sEvent> events;
+	u_int64_t startUS;
+	u_int64_t nextCallUS;
+	u_int32_t callCounter;
+	unsigned randSeed;
+	u_int64_t stat_packets;
+	u_int64_t stat_drops;
+	static volatile u_int64_t stat_all_packets;
+	static volatile u_int64_t stat_all_calls;
+	static volatile u_int64_t stat_all_drops;
+	static volatile int stat_all_active_calls;
+	static volatile bool drops_begin;
+	static volatile double ramp_cps_stop;
+};
+
+
+#endif //LOAD_GENERATOR_H
@@ -48,6 +48,7 @@
 #include "server.h"
 #include "filter_mysql.h"
 #include "charts.h"
+#include "latency_stat.h"
 
 #ifndef FREEBSD
 #include <malloc.h>
@@ -2658,6 +2659,7 @@ int Mgmt_d_close_call(Mgmt_params *params) {
 		for(list<Call*>::iterator callIT = calltable->calls_list.begin(); callIT != calltable->calls_list.end(); ++callIT) {
 			if(!strcmp((*callIT)->fbasename, fbasename)) {
 				(*callIT)->force_close = true;
+				calltable->cleanupTimerUpdate(*callIT);
 				rslt = fbasename + string(" close");
 				break;
 			}
@@ -2666,6 +2668,7 @@ int Mgmt_d_close_call(Mgmt_params *params) {
 		for(map<string, Call*>::iterator callMAPIT = calltable->calls_listMAP.begin(); callMAPIT != calltable->calls_listMAP.end(); ++callMAPIT) {
 			if(!strcmp((callMAPIT->second)->fbasename, fbasename)) {
 				(callMAPIT->second)->force_close = true;
+				calltable->cleanupTimerUpdate(callMAPIT->second);
 				rslt = fbasename + string(" close");
 				break;
 			}
@@ -4155,7 +4158,8 @@ int Mgmt_sniffer_stat(Mgmt_params *params) {
 	outStrStat << "\"count_live_sniffers\": \"" << countLiveSniffers << "\",";
 	outStrStat << "\"upgrade_by_git\": \"" << opt_upgrade_by_git << "\",";
 	outStrStat << "\"use_new_config\": \"" << useNewCONFIG << "\",";
-	outStrStat << "\"terminating_error\": \"" << terminating_error << "\"";
+	outStrStat << "\"terminating_error\": \"" << terminating_error << "\",";
+	outStrStat << "\"latency\": " << cLatencyStat::getJson();
 	outStrStat << "}";
 	outStrStat << endl;
 	string outStrStatStr = outStrStat.str();
@@ -4419,6 +4423,8 @@ int Mgmt_memory_stat(Mgmt_params *params) {
 		return(0);
 	}
 	string rsltMemoryStat = getMemoryStat();
+	rsltMemoryStat += cCallArena::getStatString();
+	rsltMemoryStat += Call::getMemoryStatString();
 	return(params->sendString(&rsltMemoryStat));
 }
 
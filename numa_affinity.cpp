@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sstream>
+
+#include "tools_define.h"
+#include "numa_affinity.h"
+
+
+using namespace std;
+
+
+// memory policy constants (numaif.h is part of libnuma)
+#define NUMA_AFFINITY_MPOL_DEFAULT 0
+#define NUMA_AFFINITY_MPOL_PREFERRED 1
+
+
+bool cNumaAffinity::enable = false;
+bool cNumaAffinity::partition = false;
+int cNumaAffinity::primaryNode = -1;
+vector<int> cNumaAffinity::nodesCpus[NUMA_AFFINITY_MAX_NODES];
+map<string, int> cNumaAffinity::interfacesNodes;
+vector<int> cNumaAffinity::interfacesNodesList;
+
+
+bool cNumaAffinity::init(vector<string> *interfaces, bool partition) {
+	#ifndef FREEBSD
+	unsigned countNodes = 0;
+	for(int node = 0; node < NUMA_AFFINITY_MAX_NODES; node++) {
+		if(readNodeCpus(node, &nodesCpus[node]) && nodesCpus[node].size()) {
+			++countNodes;
+		}
+	}
+	if(countNodes < 2) {
+		syslog(LOG_NOTICE, "numa affinity: single node system - disabled");
+		return(false);
+	}
+	ostringstream outStr;
+	for(unsigned i = 0; i < interfaces->size(); i++) {
+		int node = readInterfaceNode((*interfaces)[i].c_str());
+		if(node >= 0 && (node >= NUMA_AFFINITY_MAX_NODES || !nodesCpus[node].size())) {
+			node = -1;
+		}
+		interfacesNodes[(*interfaces)[i]] = node;
+		outStr << (i ? ", " : "") << (*interfaces)[i] << ":" << node;
+		if(node >= 0) {
+			bool exists = false;
+			for(unsigned j = 0; j < interfacesNodesList.size(); j++) {
+				if(interfacesNodesList[j] == node) {
+					exists = true;
+					break;
+				}
+			}
+			if(!exists) {
+				interfacesNodesList.push_back(node);
+			}
+		}
+	}
+	if(!interfacesNodesList.size()) {
+		syslog(LOG_NOTICE, "numa affinity: node of interfaces (%s) is unknown - disabled", outStr.str().c_str());
+		return(false);
+	}
+	primaryNode = interfacesNodesList[0];
+	cNumaAffinity::partition = partition && interfacesNodesList.size() > 1;
+	enable = true;
+	// threads created later inherit the policy - allocations of main thread (qrings, stacks) go to the primary node
+	setMemPolicy(primaryNode);
+	syslog(LOG_NOTICE, "numa affinity: interfaces (%s), primary node %i%s",
+	       outStr.str().c_str(), primaryNode, cNumaAffinity::partition ? ", rtp threads partitioned" : "");
+	return(true);
+	#else
+	return(false);
+	#endif
+}
+
+int cNumaAffinity::getInterfaceNode(const char *interface) {
+	if(!enable) {
+		return(-1);
+	}
+	map<string, int>::iterator iter = interfacesNodes.find(interface);
+	if(iter != interfacesNodes.end() && iter->second >= 0) {
+		return(iter->second);
+	}
+	return(primaryNode);
+}
+
+int cNumaAffinity::getRtpThreadNode(int threadNum) {
+	if(!enable) {
+		return(-1);
+	}
+	if(partition && threadNum > 0) {
+		return(interfacesNodesList[(threadNum - 1) % interfacesNodesList.size()]);
+	}
+	return(primaryNode);
+}
+
+bool cNumaAffinity::bindThread(int node) {
+	if(!enable || node < 0 || node >= NUMA_AFFINITY_MAX_NODES || !nodesCpus[node].size()) {
+		return(false);
+	}
+	#ifndef FREEBSD
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	for(unsigned i = 0; i < nodesCpus[node].size(); i++) {
+		CPU_SET(nodesCpus[node][i], &cpuset);
+	}
+	if(pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+		syslog(LOG_NOTICE, "numa affinity: failed set cpu affinity to node %i", node);
+		return(false);
+	}
+	return(setMemPolicy(node));
+	#else
+	return(false);
+	#endif
+}
+
+int cNumaAffinity::setAllocNode(int node) {
+	if(!enable || node < 0) {
+		return(-1);
+	}
+	int prevNode = getMemPolicyNode();
+	if(prevNode != node) {
+		setMemPolicy(node);
+	}
+	return(prevNode);
+}
+
+void cNumaAffinity::restoreAllocNode(int prevNode) {
+	if(!enable) {
+		return;
+	}
+	if(getMemPolicyNode() != prevNode) {
+		setMemPolicy(prevNode);
+	}
+}
+
+int cNumaAffinity::readInterfaceNode(const char *interface, int depth) {
+	char path[1024];
+	snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", interface);
+	FILE *file = fopen(path, "r");
+	if(file) {
+		int node = -1;
+		if(fscanf(file, "%i", &node) != 1) {
+			node = -1;
+		}
+		fclose(file);
+		return(node);
+	}
+	// vlan, bond, bridge - node of lower devices
+	if(depth < 4) {
+		snprintf(path, sizeof(path), "/sys/class/net/%s", interface);
+		DIR *dir = opendir(path);
+		if(dir) {
+			int node = -1;
+			dirent *de;
+			while(node < 0 && (de = readdir(dir)) != NULL) {
+				if(!strncmp(de->d_name, "lower_", 6)) {
+					node = readInterfaceNode(de->d_name + 6, depth + 1);
+				}
+			}
+			closedir(dir);
+			return(node);
+		}
+	}
+	return(-1);
+}
+
+bool cNumaAffinity::readNodeCpus(int node, vector<int> *cpus) {
+	char path[1024];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%i/cpulist", node);
+	FILE *file = fopen(path, "r");
+	if(!file) {
+		return(false);
+	}
+	char buff[4096];
+	if(!fgets(buff, sizeof(buff), file)) {
+		fclose(file);
+		return(false);
+	}
+	fclose(file);
+	// format: 0-7,16-23
+	char *pos = buff;
+	while(*pos) {
+		char *end;
+		long from = strtol(pos, &end, 10);
+		if(end == pos) {
+			break;
+		}
+		long to = from;
+		pos = end;
+		if(*pos == '-') {
+			to = strtol(pos + 1, &end, 10);
+			pos = end;
+		}
+		for(long cpu = from; cpu <= to && cpu < CPU_SETSIZE; cpu++) {
+			cpus->push_back(cpu);
+		}
+		if(*pos == ',') {
+			++pos;
+		} else {
+			break;
+		}
+	}
+	return(true);
+}
+
+bool cNumaAffinity::setMemPolicy(int node) {
+	#ifndef FREEBSD
+	unsigned long nodemask = 0;
+	int mode = NUMA_AFFINITY_MPOL_DEFAULT;
+	if(node >= 0 && node < NUMA_AFFINITY_MAX_NODES) {
+		nodemask = 1ul << node;
+		mode = NUMA_AFFINITY_MPOL_PREFERRED;
+	}
+	if(syscall(SYS_set_mempolicy, mode, mode == NUMA_AFFINITY_MPOL_DEFAULT ? NULL : &nodemask, sizeof(nodemask) * 8 + 1) != 0) {
+		syslog(LOG_NOTICE, "numa affinity: failed set memory policy to node %i", node);
+		return(false);
+	}
+	return(true);
+	#else
+	return(false);
+	#endif
+}
+
+int cNumaAffinity::getMemPolicyNode() {
+	#ifndef FREEBSD
+	int mode = NUMA_AFFINITY_MPOL_DEFAULT;
+	unsigned long nodemask = 0;
+	if(syscall(SYS_get_mempolicy, &mode, &nodemask, sizeof(nodemask) * 8 + 1, NULL, 0) == 0 &&
+	   mode == NUMA_AFFINITY_MPOL_PREFERRED && nodemask) {
+		return(__builtin_ctzl(nodemask));
+	}
+	#endif
+	return(-1);
+}
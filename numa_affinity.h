@@ -0,0 +1,52 @@
+#ifndef NUMA_AFFINITY_H
+#define NUMA_AFFINITY_H
+
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+#define NUMA_AFFINITY_MAX_NODES 64
+
+
+/*
+ * Placement of threads and their memory to NUMA nodes of capturing interfaces.
+ * Node of interface is taken from sysfs (vlan / bond interfaces by their lower devices).
+ * Capture threads (t0) run on cpus of node of own interface, other packet processing
+ * threads (t1, t2, preprocess, rtp) run on the primary node (node of the first interface).
+ * In partition mode rtp threads are distributed to all nodes with interfaces.
+ * Memory allocated by bound thread is preferred from its node (thread memory policy),
+ * memory allocated for other thread (qrings) can be placed by setAllocNode / restoreAllocNode.
+ * Without libnuma - syscalls are used directly.
+ */
+class cNumaAffinity {
+public:
+	static bool init(std::vector<std::string> *interfaces, bool partition);
+	static bool isEnable() {
+		return(enable);
+	}
+	static int getInterfaceNode(const char *interface);
+	static int getPrimaryNode() {
+		return(enable ? primaryNode : -1);
+	}
+	static int getRtpThreadNode(int threadNum);
+	static bool bindThread(int node);
+	static int setAllocNode(int node);
+	static void restoreAllocNode(int prevNode);
+private:
+	static int readInterfaceNode(const char *interface, int depth = 0);
+	static bool readNodeCpus(int node, std::vector<int> *cpus);
+	static bool setMemPolicy(int node);
+	static int getMemPolicyNode();
+private:
+	static bool enable;
+	static bool partition;
+	static int primaryNode;
+	static std::vector<int> nodesCpus[NUMA_AFFINITY_MAX_NODES];
+	static std::map<std::string, int> interfacesNodes;
+	static std::vector<int> interfacesNodesList;
+};
+
+
+#endif //NUMA_AFFINITY_H
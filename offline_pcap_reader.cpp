@@ -0,0 +1,633 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "tools.h"
+#include "offline_pcap_reader.h"
+
+
+#define OFFLINE_PCAP_MAGIC		0xa1b2c3d4
+#define OFFLINE_PCAP_MAGIC_NSEC		0xa1b23c4d
+#define OFFLINE_PCAP_ZSTD_IN_BUFFER	(128 * 1024)
+
+
+using namespace std;
+
+
+struct sOfflinePcapRecordHeader {
+	u_int32_t ts_sec;
+	u_int32_t ts_usec;
+	u_int32_t caplen;
+	u_int32_t len;
+};
+
+
+void *_cOfflinePcapReader_workerThreadFunction(void *arg);
+
+static bool compareFilesByFirstTime(cOfflinePcapReader::sFile *file1, cOfflinePcapReader::sFile *file2) {
+	return(file1->firstTimeUS < file2->firstTimeUS);
+}
+
+
+cOfflinePcapReader::sFile::sFile(const char *fileName) {
+	this->fileName = fileName;
+	this->type = _st_na;
+	this->dlt = -1;
+	this->swapped = false;
+	this->nsec = false;
+	this->snaplen = 0;
+	this->firstTimeUS = 0;
+	this->opened = false;
+	this->active = false;
+	this->busy = 0;
+	this->eof = false;
+	this->fd = -1;
+	this->map = NULL;
+	this->mapSize = 0;
+	this->mapOffset = 0;
+	this->gz = NULL;
+	this->zstdFile = NULL;
+	#ifdef HAVE_LIBZSTD
+	this->zstdStream = NULL;
+	memset(&this->zstdIn, 0, sizeof(this->zstdIn));
+	this->zstdInBuffer = NULL;
+	#endif
+	this->pcap = NULL;
+	memset(&this->pendingHeader, 0, sizeof(this->pendingHeader));
+	this->pendingPacket = NULL;
+	this->pending = false;
+	this->_sync_batches = 0;
+	this->mergeBatch = NULL;
+	this->mergeIndex = 0;
+}
+
+
+cOfflinePcapReader::cOfflinePcapReader(unsigned threads) {
+	this->threads = max(threads, 1u);
+	this->activateIndex = 0;
+	this->dlt = -1;
+	this->terminating = false;
+}
+
+cOfflinePcapReader::~cOfflinePcapReader() {
+	this->close();
+}
+
+bool cOfflinePcapReader::open(const char *files, string *error) {
+	vector<string> fileNames = getFiles(files);
+	for(unsigned i = 0; i < fileNames.size(); i++) {
+		sFile *file = new FILE_LINE(0) sFile(fileNames[i].c_str());
+		string probeError;
+		if(!this->probe(file, &probeError)) {
+			syslog(LOG_ERR, "read from file: skip %s: %s", fileNames[i].c_str(), probeError.c_str());
+			delete file;
+			continue;
+		}
+		if(this->files.size() && file->dlt != this->dlt) {
+			syslog(LOG_ERR, "read from file: skip %s: link type %i differs from %i", fileNames[i].c_str(), file->dlt, this->dlt);
+			delete file;
+			continue;
+		}
+		if(!this->files.size()) {
+			this->dlt = file->dlt;
+		}
+		this->files.push_back(file);
+	}
+	if(!this->files.size()) {
+		if(error) {
+			*error = "no readable pcap file in " + string(files);
+		}
+		return(false);
+	}
+	stable_sort(this->files.begin(), this->files.end(), compareFilesByFirstTime);
+	for(unsigned i = 0; i < this->threads; i++) {
+		pthread_t thread;
+		vm_pthread_create("offline pcap reader",
+				  &thread, NULL, _cOfflinePcapReader_workerThreadFunction, this, __FILE__, __LINE__);
+		this->workerThreads.push_back(thread);
+	}
+	return(true);
+}
+
+void cOfflinePcapReader::close() {
+	this->terminating = true;
+	for(unsigned i = 0; i < this->workerThreads.size(); i++) {
+		pthread_join(this->workerThreads[i], NULL);
+	}
+	this->workerThreads.clear();
+	for(unsigned i = 0; i < this->files.size(); i++) {
+		this->finishFile(this->files[i]);
+		delete this->files[i];
+	}
+	this->files.clear();
+	this->activateIndex = 0;
+	this->terminating = false;
+}
+
+int cOfflinePcapReader::next(pcap_pkthdr **header, const u_char **packet) {
+	*header = NULL;
+	*packet = NULL;
+	while(!this->terminating) {
+		sFile *minFile = NULL;
+		u_int64_t minTimeUS = 0;
+		for(unsigned i = 0; i < this->activateIndex; i++) {
+			sFile *file = this->files[i];
+			if(!file->active) {
+				continue;
+			}
+			if(!this->fillMergeBatch(file)) {
+				this->finishFile(file);
+				continue;
+			}
+			pcap_pkthdr *fileHeader = &file->mergeBatch->packets[file->mergeIndex].header;
+			u_int64_t timeUS = fileHeader->ts.tv_sec * 1000000ull + fileHeader->ts.tv_usec;
+			if(!minFile || timeUS < minTimeUS) {
+				minFile = file;
+				minTimeUS = timeUS;
+			}
+		}
+		if(this->activateIndex < this->files.size() &&
+		   (!minFile || this->files[this->activateIndex]->firstTimeUS <= minTimeUS)) {
+			this->activateFiles(minFile ? minTimeUS : this->files[this->activateIndex]->firstTimeUS);
+			continue;
+		}
+		if(!minFile) {
+			return(-2);
+		}
+		sPacket *minPacket = &minFile->mergeBatch->packets[minFile->mergeIndex];
+		*header = &minPacket->header;
+		*packet = minPacket->packet;
+		// the batch is released by the next call - after the caller has processed the packet
+		++minFile->mergeIndex;
+		return(1);
+	}
+	return(-2);
+}
+
+vector<string> cOfflinePcapReader::getFiles(const char *files) {
+	vector<string> rslt;
+	vector<string> items = split(files, "@@", true);
+	for(unsigned i = 0; i < items.size(); i++) {
+		if(items[i].empty()) {
+			continue;
+		}
+		struct stat fileStat;
+		if(stat(items[i].c_str(), &fileStat) == 0 && S_ISDIR(fileStat.st_mode)) {
+			vector<string> dirFiles;
+			DIR *dp = opendir(items[i].c_str());
+			if(dp) {
+				dirent *de;
+				while((de = readdir(dp)) != NULL) {
+					if(de->d_name[0] == '.') {
+						continue;
+					}
+					string dirFile = items[i] + "/" + de->d_name;
+					if(stat(dirFile.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+						dirFiles.push_back(dirFile);
+					}
+				}
+				closedir(dp);
+			}
+			sort(dirFiles.begin(), dirFiles.end());
+			rslt.insert(rslt.end(), dirFiles.begin(), dirFiles.end());
+		} else {
+			rslt.push_back(items[i]);
+		}
+	}
+	return(rslt);
+}
+
+bool cOfflinePcapReader::openSource(sFile *file, string *error) {
+	if(file->type == _st_na) {
+		u_char magic[4];
+		int fd = ::open(file->fileName.c_str(), O_RDONLY);
+		if(fd < 0) {
+			*error = string("open failed: ") + strerror(errno);
+			return(false);
+		}
+		ssize_t magicLength = ::read(fd, magic, sizeof(magic));
+		::close(fd);
+		if(magicLength >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+			file->type = _st_gzip;
+		#ifdef HAVE_LIBZSTD
+		} else if(magicLength == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+			file->type = _st_zstd;
+		#endif
+		} else {
+			file->type = _st_mmap;
+		}
+	}
+	switch(file->type) {
+	case _st_mmap: {
+		file->fd = ::open(file->fileName.c_str(), O_RDONLY);
+		struct stat fileStat;
+		if(file->fd < 0 || fstat(file->fd, &fileStat) != 0) {
+			*error = string("open failed: ") + strerror(errno);
+			this->closeSource(file);
+			return(false);
+		}
+		file->mapSize = fileStat.st_size;
+		if(file->mapSize < sizeof(pcap_file_header)) {
+			*error = "file is too short";
+			this->closeSource(file);
+			return(false);
+		}
+		file->map = (u_char*)mmap(NULL, file->mapSize, PROT_READ, MAP_PRIVATE, file->fd, 0);
+		if(file->map == MAP_FAILED) {
+			file->map = NULL;
+			*error = string("mmap failed: ") + strerror(errno);
+			this->closeSource(file);
+			return(false);
+		}
+		madvise(file->map, file->mapSize, MADV_SEQUENTIAL);
+		file->mapOffset = 0;
+		}
+		break;
+	case _st_gzip:
+		file->gz = gzopen(file->fileName.c_str(), "rb");
+		if(!file->gz) {
+			*error = string("gzopen failed: ") + strerror(errno);
+			return(false);
+		}
+		gzbuffer(file->gz, 256 * 1024);
+		break;
+	case _st_zstd:
+		#ifdef HAVE_LIBZSTD
+		file->zstdFile = fopen(file->fileName.c_str(), "rb");
+		if(!file->zstdFile) {
+			*error = string("open failed: ") + strerror(errno);
+			return(false);
+		}
+		file->zstdStream = ZSTD_createDStream();
+		ZSTD_initDStream(file->zstdStream);
+		file->zstdInBuffer = new FILE_LINE(0) u_char[OFFLINE_PCAP_ZSTD_IN_BUFFER];
+		file->zstdIn.src = file->zstdInBuffer;
+		file->zstdIn.size = 0;
+		file->zstdIn.pos = 0;
+		#endif
+		break;
+	case _st_libpcap: {
+		char errbuf[PCAP_ERRBUF_SIZE];
+		file->pcap = pcap_open_offline_zip(file->fileName.c_str(), errbuf);
+		if(!file->pcap) {
+			*error = errbuf;
+			return(false);
+		}
+		file->dlt = pcap_datalink(file->pcap);
+		file->snaplen = pcap_snapshot(file->pcap);
+		file->opened = true;
+		}
+		return(true);
+	default:
+		return(false);
+	}
+	file->opened = true;
+	pcap_file_header fileHeader;
+	bool fileHeaderOk = false;
+	if(file->type == _st_mmap) {
+		memcpy(&fileHeader, file->map, sizeof(fileHeader));
+		file->mapOffset = sizeof(fileHeader);
+		fileHeaderOk = true;
+	} else {
+		fileHeaderOk = this->readSource(file, &fileHeader, sizeof(fileHeader));
+	}
+	if(fileHeaderOk) {
+		if(fileHeader.magic == OFFLINE_PCAP_MAGIC || fileHeader.magic == OFFLINE_PCAP_MAGIC_NSEC) {
+			file->swapped = false;
+		} else if(fileHeader.magic == bswap_32(OFFLINE_PCAP_MAGIC) || fileHeader.magic == bswap_32(OFFLINE_PCAP_MAGIC_NSEC)) {
+			file->swapped = true;
+			fileHeader.magic = bswap_32(fileHeader.magic);
+			fileHeader.snaplen = bswap_32(fileHeader.snaplen);
+			fileHeader.linktype = bswap_32(fileHeader.linktype);
+		} else {
+			fileHeaderOk = false;
+		}
+	}
+	if(!fileHeaderOk) {
+		// pcapng or unknown format - let libpcap decide
+		this->closeSource(file);
+		file->type = _st_libpcap;
+		return(this->openSource(file, error));
+	}
+	file->nsec = fileHeader.magic == OFFLINE_PCAP_MAGIC_NSEC;
+	file->dlt = fileHeader.linktype & 0x0FFFFFFF;
+	file->snaplen = fileHeader.snaplen;
+	return(true);
+}
+
+void cOfflinePcapReader::closeSource(sFile *file) {
+	if(file->map) {
+		munmap(file->map, file->mapSize);
+		file->map = NULL;
+	}
+	if(file->fd >= 0) {
+		::close(file->fd);
+		file->fd = -1;
+	}
+	file->mapSize = 0;
+	file->mapOffset = 0;
+	if(file->gz) {
+		gzclose(file->gz);
+		file->gz = NULL;
+	}
+	if(file->zstdFile) {
+		fclose(file->zstdFile);
+		file->zstdFile = NULL;
+	}
+	#ifdef HAVE_LIBZSTD
+	if(file->zstdStream) {
+		ZSTD_freeDStream(file->zstdStream);
+		file->zstdStream = NULL;
+	}
+	if(file->zstdInBuffer) {
+		delete [] file->zstdInBuffer;
+		file->zstdInBuffer = NULL;
+	}
+	#endif
+	if(file->pcap) {
+		pcap_close(file->pcap);
+		file->pcap = NULL;
+	}
+	file->pending = false;
+	file->pendingPacket = NULL;
+	file->opened = false;
+}
+
+bool cOfflinePcapReader::readSource(sFile *file, void *buffer, size_t length) {
+	size_t readed = 0;
+	if(file->type == _st_gzip) {
+		while(readed < length) {
+			int rsltRead = gzread(file->gz, (u_char*)buffer + readed, length - readed);
+			if(rsltRead <= 0) {
+				return(false);
+			}
+			readed += rsltRead;
+		}
+		return(true);
+	}
+	#ifdef HAVE_LIBZSTD
+	if(file->type == _st_zstd) {
+		while(readed < length) {
+			if(file->zstdIn.pos >= file->zstdIn.size) {
+				size_t rsltRead = fread(file->zstdInBuffer, 1, OFFLINE_PCAP_ZSTD_IN_BUFFER, file->zstdFile);
+				if(!rsltRead) {
+					return(false);
+				}
+				file->zstdIn.size = rsltRead;
+				file->zstdIn.pos = 0;
+			}
+			ZSTD_outBuffer out = { (u_char*)buffer + readed, length - readed, 0 };
+			size_t rsltDecompress = ZSTD_decompressStream(file->zstdStream, &out, &file->zstdIn);
+			if(ZSTD_isError(rsltDecompress)) {
+				syslog(LOG_ERR, "read from file: zstd decompress %s failed: %s", file->fileName.c_str(), ZSTD_getErrorName(rsltDecompress));
+				return(false);
+			}
+			readed += out.pos;
+		}
+		return(true);
+	}
+	#endif
+	return(false);
+}
+
+bool cOfflinePcapReader::readPacketHeader(sFile *file, const u_char *data, pcap_pkthdr *header) {
+	sOfflinePcapRecordHeader record;
+	memcpy(&record, data, sizeof(record));
+	if(file->swapped) {
+		record.ts_sec = bswap_32(record.ts_sec);
+		record.ts_usec = bswap_32(record.ts_usec);
+		record.caplen = bswap_32(record.caplen);
+		record.len = bswap_32(record.len);
+	}
+	if(record.caplen > OFFLINE_PCAP_READER_BATCH_SIZE) {
+		syslog(LOG_ERR, "read from file: %s is corrupted (caplen %u)", file->fileName.c_str(), record.caplen);
+		return(false);
+	}
+	header->ts.tv_sec = record.ts_sec;
+	header->ts.tv_usec = file->nsec ? record.ts_usec / 1000 : record.ts_usec;
+	header->caplen = record.caplen;
+	header->len = record.len;
+	return(true);
+}
+
+bool cOfflinePcapReader::probe(sFile *file, string *error) {
+	if(!this->openSource(file, error)) {
+		return(false);
+	}
+	bool rslt = true;
+	pcap_pkthdr header;
+	memset(&header, 0, sizeof(header));
+	if(file->type == _st_mmap) {
+		if(file->mapOffset + sizeof(sOfflinePcapRecordHeader) <= file->mapSize) {
+			rslt = this->readPacketHeader(file, file->map + file->mapOffset, &header);
+		}
+	} else if(file->type == _st_libpcap) {
+		pcap_pkthdr *pcapHeader;
+		const u_char *pcapPacket;
+		if(pcap_next_ex(file->pcap, &pcapHeader, &pcapPacket) > 0) {
+			header = *pcapHeader;
+		}
+	} else {
+		u_char record[sizeof(sOfflinePcapRecordHeader)];
+		if(this->readSource(file, record, sizeof(record))) {
+			rslt = this->readPacketHeader(file, record, &header);
+		}
+	}
+	if(!rslt) {
+		*error = "bad first packet header";
+	}
+	file->firstTimeUS = header.ts.tv_sec * 1000000ull + header.ts.tv_usec;
+	this->closeSource(file);
+	return(rslt);
+}
+
+bool cOfflinePcapReader::decodeBatch(sFile *file) {
+	if(!file->opened) {
+		string error;
+		if(!this->openSource(file, &error)) {
+			syslog(LOG_ERR, "read from file: reopen %s failed: %s", file->fileName.c_str(), error.c_str());
+			file->eof = true;
+			return(false);
+		}
+	}
+	sBatch *batch = new FILE_LINE(0) sBatch;
+	bool eof = false;
+	if(file->type == _st_mmap) {
+		size_t batchEnd = file->mapOffset + OFFLINE_PCAP_READER_BATCH_SIZE;
+		while(file->mapOffset < batchEnd) {
+			sPacket packet;
+			if(file->mapOffset + sizeof(sOfflinePcapRecordHeader) > file->mapSize ||
+			   !this->readPacketHeader(file, file->map + file->mapOffset, &packet.header) ||
+			   file->mapOffset + sizeof(sOfflinePcapRecordHeader) + packet.header.caplen > file->mapSize) {
+				eof = true;
+				break;
+			}
+			packet.packet = file->map + file->mapOffset + sizeof(sOfflinePcapRecordHeader);
+			file->mapOffset += sizeof(sOfflinePcapRecordHeader) + packet.header.caplen;
+			batch->packets.push_back(packet);
+		}
+	} else {
+		batch->data = new FILE_LINE(0) u_char[OFFLINE_PCAP_READER_BATCH_SIZE];
+		while(true) {
+			if(!file->pending) {
+				if(file->type == _st_libpcap) {
+					pcap_pkthdr *pcapHeader;
+					const u_char *pcapPacket;
+					if(pcap_next_ex(file->pcap, &pcapHeader, &pcapPacket) <= 0) {
+						eof = true;
+						break;
+					}
+					file->pendingHeader = *pcapHeader;
+					file->pendingPacket = pcapPacket;
+				} else {
+					u_char record[sizeof(sOfflinePcapRecordHeader)];
+					if(!this->readSource(file, record, sizeof(record)) ||
+					   !this->readPacketHeader(file, record, &file->pendingHeader)) {
+						eof = true;
+						break;
+					}
+				}
+				file->pending = true;
+			}
+			if(batch->dataUsed + file->pendingHeader.caplen > OFFLINE_PCAP_READER_BATCH_SIZE) {
+				break;
+			}
+			sPacket packet;
+			packet.header = file->pendingHeader;
+			packet.packet = batch->data + batch->dataUsed;
+			if(file->pendingPacket) {
+				memcpy(batch->data + batch->dataUsed, file->pendingPacket, packet.header.caplen);
+			} else if(!this->readSource(file, batch->data + batch->dataUsed, packet.header.caplen)) {
+				eof = true;
+				break;
+			}
+			batch->dataUsed += packet.header.caplen;
+			batch->packets.push_back(packet);
+			file->pending = false;
+			file->pendingPacket = NULL;
+		}
+	}
+	__SYNC_LOCK(file->_sync_batches);
+	file->batches.push_back(batch);
+	__SYNC_UNLOCK(file->_sync_batches);
+	if(eof) {
+		file->eof = true;
+	}
+	return(true);
+}
+
+cOfflinePcapReader::sBatch *cOfflinePcapReader::popBatch(sFile *file) {
+	sBatch *batch = NULL;
+	__SYNC_LOCK(file->_sync_batches);
+	if(file->batches.size()) {
+		batch = file->batches.front();
+		file->batches.pop_front();
+	}
+	__SYNC_UNLOCK(file->_sync_batches);
+	return(batch);
+}
+
+void cOfflinePcapReader::activateFiles(u_int64_t timeUS) {
+	while(this->activateIndex < this->files.size() &&
+	      this->files[this->activateIndex]->firstTimeUS <= timeUS) {
+		this->files[this->activateIndex]->active = true;
+		++this->activateIndex;
+	}
+}
+
+void cOfflinePcapReader::finishFile(sFile *file) {
+	file->active = false;
+	file->eof = true;
+	__sync_synchronize();
+	// worker holding busy can still decode from the source - teardown is done with busy acquired,
+	// a worker which acquires busy after the release sees eof
+	while(__sync_lock_test_and_set(&file->busy, 1)) {
+		USLEEP(10);
+	}
+	if(file->mergeBatch) {
+		delete file->mergeBatch;
+		file->mergeBatch = NULL;
+	}
+	sBatch *batch;
+	while((batch = this->popBatch(file)) != NULL) {
+		delete batch;
+	}
+	this->closeSource(file);
+	__sync_lock_release(&file->busy);
+}
+
+bool cOfflinePcapReader::fillMergeBatch(sFile *file) {
+	if(file->mergeBatch) {
+		if(file->mergeIndex < file->mergeBatch->packets.size()) {
+			return(true);
+		}
+		delete file->mergeBatch;
+		file->mergeBatch = NULL;
+	}
+	unsigned usleepCounter = 0;
+	while(!this->terminating) {
+		bool eof = file->eof;
+		sBatch *batch = this->popBatch(file);
+		if(batch) {
+			if(batch->packets.size()) {
+				file->mergeBatch = batch;
+				file->mergeIndex = 0;
+				return(true);
+			}
+			delete batch;
+			continue;
+		}
+		if(eof) {
+			// eof is set after the last batch is pushed
+			return(false);
+		}
+		USLEEP_C(20, usleepCounter++);
+	}
+	return(false);
+}
+
+void *cOfflinePcapReader::workerThreadFunction() {
+	unsigned usleepCounter = 0;
+	while(!this->terminating) {
+		bool decoded = false;
+		// files in merge first, then prefetch of next files
+		unsigned limit = min(this->activateIndex + this->threads, (unsigned)this->files.size());
+		for(unsigned i = 0; i < limit && !decoded; i++) {
+			sFile *file = this->files[i];
+			if(file->eof) {
+				continue;
+			}
+			if(__sync_lock_test_and_set(&file->busy, 1)) {
+				continue;
+			}
+			if(!file->eof) {
+				__SYNC_LOCK(file->_sync_batches);
+				unsigned countBatches = file->batches.size();
+				__SYNC_UNLOCK(file->_sync_batches);
+				if(countBatches < OFFLINE_PCAP_READER_MAX_BATCHES_PER_FILE) {
+					this->decodeBatch(file);
+					decoded = true;
+				}
+			}
+			__sync_lock_release(&file->busy);
+		}
+		if(decoded) {
+			usleepCounter = 0;
+		} else {
+			USLEEP_C(100, usleepCounter++);
+		}
+	}
+	return(NULL);
+}
+
+
+void *_cOfflinePcapReader_workerThreadFunction(void *arg) {
+	return(((cOfflinePcapReader*)arg)->workerThreadFunction());
+}
@@ -0,0 +1,130 @@
+#ifndef OFFLINE_PCAP_READER_H
+#define OFFLINE_PCAP_READER_H
+
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <pcap.h>
+#include <zlib.h>
+
+#include "config.h"
+
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+
+#define OFFLINE_PCAP_READER_BATCH_SIZE (2 * 1024 * 1024)
+#define OFFLINE_PCAP_READER_MAX_BATCHES_PER_FILE 4
+
+
+/*
+ * Reading of pcap files (-r) without temporary files and in parallel.
+ * Plain pcap files are mmaped, gzip and zstd files are decompressed as stream.
+ * Other formats (pcapng) are read by libpcap.
+ * Files are decoded by pool of worker threads to batches and packets are
+ * returned merged by timestamp - files are activated by time of first packet
+ * so only files with overlapping time are open together (plus prefetch).
+ */
+class cOfflinePcapReader {
+public:
+	enum eSourceType {
+		_st_na,
+		_st_mmap,
+		_st_gzip,
+		_st_zstd,
+		_st_libpcap
+	};
+	struct sPacket {
+		pcap_pkthdr header;
+		const u_char *packet;
+	};
+	struct sBatch {
+		sBatch() {
+			data = NULL;
+			dataUsed = 0;
+		}
+		~sBatch() {
+			if(data) {
+				delete [] data;
+			}
+		}
+		u_char *data;
+		size_t dataUsed;
+		std::vector<sPacket> packets;
+	};
+	struct sFile {
+		sFile(const char *fileName);
+		std::string fileName;
+		eSourceType type;
+		int dlt;
+		bool swapped;
+		bool nsec;
+		u_int32_t snaplen;
+		u_int64_t firstTimeUS;
+		bool opened;
+		bool active;
+		volatile int busy;
+		volatile bool eof;
+		// source
+		int fd;
+		u_char *map;
+		size_t mapSize;
+		size_t mapOffset;
+		gzFile gz;
+		FILE *zstdFile;
+		#ifdef HAVE_LIBZSTD
+		ZSTD_DStream *zstdStream;
+		ZSTD_inBuffer zstdIn;
+		u_char *zstdInBuffer;
+		#endif
+		pcap_t *pcap;
+		// packet header read but not yet stored (batch was full)
+		pcap_pkthdr pendingHeader;
+		const u_char *pendingPacket;
+		bool pending;
+		// decoded batches
+		std::deque<sBatch*> batches;
+		volatile int _sync_batches;
+		// merge position
+		sBatch *mergeBatch;
+		size_t mergeIndex;
+	};
+public:
+	cOfflinePcapReader(unsigned threads = 4);
+	~cOfflinePcapReader();
+	bool open(const char *files, std::string *error);
+	void close();
+	int next(pcap_pkthdr **header, const u_char **packet);
+	int getDlt() {
+		return(dlt);
+	}
+	unsigned getCountFiles() {
+		return(files.size());
+	}
+	static std::vector<std::string> getFiles(const char *files);
+private:
+	bool openSource(sFile *file, std::string *error);
+	void closeSource(sFile *file);
+	bool readSource(sFile *file, void *buffer, size_t length);
+	bool readPacketHeader(sFile *file, const u_char *data, pcap_pkthdr *header);
+	bool probe(sFile *file, std::string *error);
+	bool decodeBatch(sFile *file);
+	sBatch *popBatch(sFile *file);
+	void activateFiles(u_int64_t timeUS);
+	void finishFile(sFile *file);
+	bool fillMergeBatch(sFile *file);
+	void *workerThreadFunction();
+private:
+	unsigned threads;
+	std::vector<sFile*> files;
+	volatile unsigned activateIndex;
+	int dlt;
+	std::vector<pthread_t> workerThreads;
+	volatile bool terminating;
+friend void *_cOfflinePcapReader_workerThreadFunction(void *arg);
+};
+
+
+#endif //OFFLINE_PCAP_READER_H
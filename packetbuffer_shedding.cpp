@@ -0,0 +1,185 @@
+#include <syslog.h>
+#include <sstream>
+
+#include "tools.h"
+#include "buffers_control.h"
+#include "pcap_queue_block.h"
+#include "sniff_inline.h"
+#include "packetbuffer_shedding.h"
+
+
+using namespace std;
+
+
+extern cBuffersControl buffersControl;
+extern char *sipportmatrix;
+
+
+bool cPacketbufferShedding::enable = false;
+volatile int cPacketbufferShedding::level = _shl_none;
+int cPacketbufferShedding::payloadPerc = 0;
+int cPacketbufferShedding::unrecordedPerc = 0;
+volatile u_int64_t cPacketbufferShedding::stat_payload_packets = 0;
+volatile u_int64_t cPacketbufferShedding::stat_payload_bytes = 0;
+volatile u_int64_t cPacketbufferShedding::stat_unrecorded_packets = 0;
+volatile u_int64_t cPacketbufferShedding::stat_strip_blocks = 0;
+volatile u_int64_t cPacketbufferShedding::stat_strip_packets = 0;
+volatile u_int64_t cPacketbufferShedding::stat_strip_compressed_blocks = 0;
+
+
+void cPacketbufferShedding::init(int payloadPerc, int unrecordedPerc) {
+	cPacketbufferShedding::payloadPerc = payloadPerc > 0 ? payloadPerc : 100;
+	cPacketbufferShedding::unrecordedPerc = unrecordedPerc > 0 ? unrecordedPerc : 100;
+	enable = true;
+	syslog(LOG_NOTICE, "packetbuffer load shedding: rtp payload from %i%%, rtp of unrecorded calls from %i%%",
+	       cPacketbufferShedding::payloadPerc, cPacketbufferShedding::unrecordedPerc);
+}
+
+bool cPacketbufferShedding::stripRtp(pcap_block_store *block, bool uncompressed) {
+	if(!enable || block->size_compress || !block->count) {
+		return(false);
+	}
+	size_t headerSize = block->hm == pcap_block_store::plus2 ? sizeof(pcap_pkthdr_plus2) : sizeof(pcap_pkthdr_plus);
+	size_t count = 0;
+	size_t size = 0;
+	size_t size_packets = 0;
+	for(size_t i = 0; i < block->count; i++) {
+		pcap_pkthdr_plus *header = block->get_header(i);
+		u_char *packet = block->get_packet(i);
+		u_int header_ip_offset = block->hm == pcap_block_store::plus2 ?
+					  (((pcap_pkthdr_plus2*)header)->detect_headers ? ((pcap_pkthdr_plus2*)header)->header_ip_first_offset : (u_int)-1) :
+					  header->header_ip_offset;
+		// first packet is always kept - block must not be empty
+		if(i && getRtpHeaderLength(packet, header->get_caplen(), header_ip_offset, header->dlink ? header->dlink : block->dlink) > 0) {
+			continue;
+		}
+		size_t itemSize = headerSize + header->get_caplen();
+		if(block->offsets[i] != size) {
+			memmove(block->block + size, block->block + block->offsets[i], itemSize);
+		}
+		block->offsets[count] = size;
+		size += itemSize;
+		size_packets += header->get_caplen();
+		++count;
+	}
+	if(count < block->count) {
+		__sync_fetch_and_add(&stat_strip_blocks, 1);
+		__sync_fetch_and_add(&stat_strip_packets, block->count - count);
+		if(uncompressed) {
+			__sync_fetch_and_add(&stat_strip_compressed_blocks, 1);
+		}
+		block->count = count;
+		block->size = size;
+		block->size_packets = size_packets;
+	}
+	return(true);
+}
+
+string cPacketbufferShedding::getStatString() {
+	u_int64_t payload_packets = __sync_lock_test_and_set(&stat_payload_packets, 0);
+	u_int64_t payload_bytes = __sync_lock_test_and_set(&stat_payload_bytes, 0);
+	u_int64_t unrecorded_packets = __sync_lock_test_and_set(&stat_unrecorded_packets, 0);
+	u_int64_t strip_blocks = __sync_lock_test_and_set(&stat_strip_blocks, 0);
+	u_int64_t strip_packets = __sync_lock_test_and_set(&stat_strip_packets, 0);
+	u_int64_t strip_compressed_blocks = __sync_lock_test_and_set(&stat_strip_compressed_blocks, 0);
+	if(!payload_packets && !unrecorded_packets && !strip_blocks) {
+		return("");
+	}
+	ostringstream outStr;
+	outStr << "shed[";
+	bool first = true;
+	if(payload_packets) {
+		outStr << "p:" << payload_packets << "/" << (payload_bytes / 1024) << "kB";
+		first = false;
+	}
+	if(unrecorded_packets) {
+		outStr << (first ? "" : "|") << "u:" << unrecorded_packets;
+		first = false;
+	}
+	if(strip_blocks) {
+		outStr << (first ? "" : "|") << "b:" << strip_blocks << "/" << strip_packets;
+		if(strip_compressed_blocks) {
+			outStr << "/c" << strip_compressed_blocks;
+		}
+	}
+	outStr << "] ";
+	return(outStr.str());
+}
+
+void cPacketbufferShedding::_updateLevel() {
+	double perc = buffersControl.getPercUsePB();
+	int newLevel = perc >= unrecordedPerc ? _shl_rtp_unrecorded :
+		       perc >= payloadPerc ? _shl_rtp_payload :
+		       _shl_none;
+	if(newLevel != level) {
+		syslog(LOG_NOTICE, "packetbuffer load shedding: level %i -> %i (packetbuffer use %.0lf%%)", level, newLevel, perc);
+		level = newLevel;
+	}
+}
+
+void cPacketbufferShedding::_cutRtpPayload(pcap_pkthdr_plus *header, u_char *packet, u_int header_ip_offset, int dlink) {
+	u_int32_t caplen = header->get_caplen();
+	int rtpHeaderLength = getRtpHeaderLength(packet, caplen, header_ip_offset, dlink);
+	if(rtpHeaderLength > 0 && (u_int32_t)rtpHeaderLength < caplen) {
+		header->set_caplen(rtpHeaderLength);
+		__sync_fetch_and_add(&stat_payload_packets, 1);
+		__sync_fetch_and_add(&stat_payload_bytes, caplen - rtpHeaderLength);
+	}
+}
+
+int cPacketbufferShedding::getRtpHeaderLength(u_char *packet, u_int32_t caplen, u_int header_ip_offset, int dlink) {
+	if(header_ip_offset == (u_int)-1) {
+		sll_header *header_sll;
+		ether_header *header_eth;
+		int protocol;
+		u_int16_t vlan;
+		header_ip_offset = 0;
+		if(!parseEtherHeader(dlink, packet,
+				     header_sll, header_eth, NULL,
+				     header_ip_offset, protocol, vlan) ||
+		   !(protocol == ETHERTYPE_IP || (VM_IPV6_B && protocol == ETHERTYPE_IPV6))) {
+			return(-1);
+		}
+	}
+	if(header_ip_offset + sizeof(iphdr2) > caplen) {
+		return(-1);
+	}
+	iphdr2 *header_ip = (iphdr2*)(packet + header_ip_offset);
+	if(header_ip->get_protocol() != IPPROTO_UDP) {
+		return(-1);
+	}
+	u_int16_t frag_data = header_ip->get_frag_data();
+	if(header_ip->is_more_frag(frag_data) || header_ip->get_frag_offset(frag_data)) {
+		return(-1);
+	}
+	u_int header_udp_offset = header_ip_offset + header_ip->get_hdr_size();
+	u_int rtp_offset = header_udp_offset + sizeof(udphdr2);
+	if(rtp_offset + 12 > caplen) {
+		return(-1);
+	}
+	udphdr2 *header_udp = (udphdr2*)(packet + header_udp_offset);
+	if(sipportmatrix[header_udp->get_source().getPort()] || sipportmatrix[header_udp->get_dest().getPort()]) {
+		return(-1);
+	}
+	u_char *rtp = packet + rtp_offset;
+	// version 2, without padding (padding length is in the last byte of payload)
+	if((rtp[0] & 0xE0) != 0x80) {
+		return(-1);
+	}
+	// rtcp (rtcp-mux) is kept
+	u_int8_t payload_type = rtp[1] & 0x7F;
+	if(payload_type >= 72 && payload_type <= 76) {
+		return(-1);
+	}
+	u_int rtp_header_length = 12 + (rtp[0] & 0x0F) * 4;
+	if(rtp[0] & 0x10) {
+		if(rtp_offset + rtp_header_length + 4 > caplen) {
+			return(-1);
+		}
+		rtp_header_length += 4 + ntohs(*(u_int16_t*)(rtp + rtp_header_length + 2)) * 4;
+	}
+	if(rtp_offset + rtp_header_length > caplen) {
+		return(-1);
+	}
+	return(rtp_offset + rtp_header_length);
+}
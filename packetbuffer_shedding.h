@@ -0,0 +1,75 @@
+#ifndef PACKETBUFFER_SHEDDING_H
+#define PACKETBUFFER_SHEDDING_H
+
+
+#include <string>
+#include <sys/types.h>
+
+
+struct pcap_pkthdr_plus;
+struct pcap_block_store;
+
+
+/*
+ * Graceful degradation when packetbuffer (max_buffer_mem) is near its limit.
+ * Level is derived from use of packetbuffer at each pushed block:
+ *   rtp_payload    - capture threads cut rtp packets behind rtp header (statistics are kept, payload is lost)
+ *   rtp_unrecorded - rtp of calls without saving rtp is not processed (only rtcp)
+ * Blocks that do not fit into packetbuffer are stripped of rtp (also compressed blocks) and pushed into the reserve (10% of max_buffer_mem),
+ * so sip and other signalling is not lost together with rtp.
+ */
+class cPacketbufferShedding {
+public:
+	enum eLevel {
+		_shl_none,
+		_shl_rtp_payload,
+		_shl_rtp_unrecorded
+	};
+public:
+	static void init(int payloadPerc, int unrecordedPerc);
+	static bool isEnable() {
+		return(enable);
+	}
+	static inline void updateLevel() {
+		if(enable) {
+			_updateLevel();
+		}
+	}
+	static inline int getLevel() {
+		return(level);
+	}
+	static inline void cutRtpPayload(pcap_pkthdr_plus *header, u_char *packet, u_int header_ip_offset, int dlink) {
+		if(level >= _shl_rtp_payload) {
+			_cutRtpPayload(header, packet, header_ip_offset, dlink);
+		}
+	}
+	static inline bool skipRtpUnrecorded(bool recorded) {
+		if(level >= _shl_rtp_unrecorded && !recorded) {
+			__sync_fetch_and_add(&stat_unrecorded_packets, 1);
+			return(true);
+		}
+		return(false);
+	}
+	// removes rtp packets from uncompressed block, true if the block is without rtp
+	// uncompressed - block was compressed and its owner compresses it again (statistics only)
+	static bool stripRtp(pcap_block_store *block, bool uncompressed = false);
+	static std::string getStatString();
+private:
+	static void _updateLevel();
+	static void _cutRtpPayload(pcap_pkthdr_plus *header, u_char *packet, u_int header_ip_offset, int dlink);
+	static int getRtpHeaderLength(u_char *packet, u_int32_t caplen, u_int header_ip_offset, int dlink);
+private:
+	static bool enable;
+	static volatile int level;
+	static int payloadPerc;
+	static int unrecordedPerc;
+	static volatile u_int64_t stat_payload_packets;
+	static volatile u_int64_t stat_payload_bytes;
+	static volatile u_int64_t stat_unrecorded_packets;
+	static volatile u_int64_t stat_strip_blocks;
+	static volatile u_int64_t stat_strip_packets;
+	static volatile u_int64_t stat_strip_compressed_blocks;
+};
+
+
+#endif //PACKETBUFFER_SHEDDING_H
@@ -0,0 +1,117 @@
+#include <syslog.h>
+
+#include "tools.h"
+#include "buffers_control.h"
+#include "tcmalloc_hugetables.h"
+#include "pcap_block_pool.h"
+
+
+using namespace std;
+
+
+extern cBuffersControl buffersControl;
+
+
+cPcapBlockPool *cPcapBlockPool::blocks = NULL;
+cPcapBlockPool *cPcapBlockPool::offsets = NULL;
+
+
+cPcapBlockPool::cPcapBlockPool(const char *name, size_t itemSize, u_int64_t maxSize) {
+	this->name = name;
+	this->itemSize = (itemSize + PCAP_BLOCK_POOL_ITEM_ALIGN - 1) / PCAP_BLOCK_POOL_ITEM_ALIGN * PCAP_BLOCK_POOL_ITEM_ALIGN;
+	this->slabSize = (this->itemSize * PCAP_BLOCK_POOL_SLAB_MIN_ITEMS + PCAP_BLOCK_POOL_SLAB_ALIGN - 1) / PCAP_BLOCK_POOL_SLAB_ALIGN * PCAP_BLOCK_POOL_SLAB_ALIGN;
+	this->maxSize = maxSize;
+	this->allocSize = 0;
+	this->useItems = 0;
+	this->mapFailed = false;
+	this->_sync = 0;
+	this->_sync_slab = 0;
+	this->freeItems.reserve(maxSize / this->itemSize + this->slabSize / this->itemSize);
+}
+
+cPcapBlockPool::~cPcapBlockPool() {
+	for(unsigned i = 0; i < this->slabs.size(); i++) {
+		munmap_hugepage(this->slabs[i], this->slabSize);
+	}
+	buffersControl.sub__pcap_block_pool__allocSize(this->allocSize);
+	buffersControl.sub__pcap_block_pool__useSize((u_int64_t)this->useItems * this->itemSize);
+}
+
+void *cPcapBlockPool::alloc() {
+	void *item = NULL;
+	while(!item) {
+		__SYNC_LOCK(this->_sync);
+		if(this->freeItems.size()) {
+			item = this->freeItems.back();
+			this->freeItems.pop_back();
+		}
+		__SYNC_UNLOCK(this->_sync);
+		if(!item && !this->addSlab()) {
+			return(NULL);
+		}
+	}
+	__sync_fetch_and_add(&this->useItems, 1);
+	buffersControl.add__pcap_block_pool__useSize(this->itemSize);
+	return(item);
+}
+
+void cPcapBlockPool::free(void *item) {
+	__SYNC_LOCK(this->_sync);
+	this->freeItems.push_back(item);
+	__SYNC_UNLOCK(this->_sync);
+	__sync_fetch_and_sub(&this->useItems, 1);
+	buffersControl.sub__pcap_block_pool__useSize(this->itemSize);
+}
+
+bool cPcapBlockPool::addSlab() {
+	if(this->mapFailed) {
+		return(false);
+	}
+	__SYNC_LOCK(this->_sync_slab);
+	// other thread could add slab while waiting for lock
+	__SYNC_LOCK(this->_sync);
+	bool existsFreeItem = this->freeItems.size() > 0;
+	__SYNC_UNLOCK(this->_sync);
+	if(existsFreeItem) {
+		__SYNC_UNLOCK(this->_sync_slab);
+		return(true);
+	}
+	if(this->allocSize + this->slabSize > this->maxSize) {
+		__SYNC_UNLOCK(this->_sync_slab);
+		return(false);
+	}
+	size_t mmapSize = 0;
+	u_char *slab = (u_char*)mmap_hugepage(-1, 0, false,
+					      this->slabSize, NULL, &mmapSize,
+					      PCAP_BLOCK_POOL_SLAB_ALIGN, sysconf(_SC_PAGESIZE),
+					      true, NULL);
+	if(!slab) {
+		this->mapFailed = true;
+		__SYNC_UNLOCK(this->_sync_slab);
+		syslog(LOG_NOTICE, "packetbuffer pool %s: failed map slab (%lu B) - heap is used", this->name.c_str(), this->slabSize);
+		return(false);
+	}
+	this->slabs.push_back(slab);
+	this->allocSize += this->slabSize;
+	buffersControl.add__pcap_block_pool__allocSize(this->slabSize);
+	unsigned countItems = this->slabSize / this->itemSize;
+	__SYNC_LOCK(this->_sync);
+	for(unsigned i = 0; i < countItems; i++) {
+		this->freeItems.push_back(slab + (size_t)i * this->itemSize);
+	}
+	__SYNC_UNLOCK(this->_sync);
+	__SYNC_UNLOCK(this->_sync_slab);
+	return(true);
+}
+
+void cPcapBlockPool::init(size_t blockSize, size_t offsetsSize, u_int64_t maxSize) {
+	if(blocks) {
+		return;
+	}
+	blocks = new FILE_LINE(0) cPcapBlockPool("blocks", blockSize, maxSize);
+	// offsets are small (count of packets in block), pool is limited to proportional part
+	offsets = new FILE_LINE(0) cPcapBlockPool("offsets", offsetsSize,
+						  max(maxSize / blockSize * offsetsSize, (u_int64_t)PCAP_BLOCK_POOL_SLAB_ALIGN));
+	syslog(LOG_NOTICE, "packetbuffer pool: block %lu B, offsets %lu B, limit %" int_64_format_prefix "lu MB",
+	       blocks->itemSize, offsets->itemSize, maxSize / 1024 / 1024);
+}
@@ -0,0 +1,79 @@
+#ifndef PCAP_BLOCK_POOL_H
+#define PCAP_BLOCK_POOL_H
+
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+
+#define PCAP_BLOCK_POOL_SLAB_ALIGN (2 * 1024 * 1024)
+#define PCAP_BLOCK_POOL_SLAB_MIN_ITEMS 8
+#define PCAP_BLOCK_POOL_ITEM_ALIGN 64
+
+
+/*
+ * Recycling pool of fixed size buffers of pcap_block_store (packet block and initial offsets).
+ * Buffers are cut from slabs mapped on 2MB boundary with MADV_HUGEPAGE and after destroy
+ * of block store (destroyBlocksThreadFunction) they return to free list instead of heap.
+ * Slabs are never unmapped - pool grows up to the limit (max_buffer_mem), above the limit
+ * or if slab can't be mapped callers allocate from heap.
+ */
+class cPcapBlockPool {
+public:
+	cPcapBlockPool(const char *name, size_t itemSize, u_int64_t maxSize);
+	~cPcapBlockPool();
+	void *alloc();
+	void free(void *item);
+	size_t getItemSize() {
+		return(itemSize);
+	}
+	u_int64_t getAllocSize() {
+		return(allocSize);
+	}
+	u_int64_t getUseSize() {
+		return((u_int64_t)useItems * itemSize);
+	}
+public:
+	static void init(size_t blockSize, size_t offsetsSize, u_int64_t maxSize);
+	static bool isEnable() {
+		return(blocks != NULL);
+	}
+	static inline u_char *allocBlock(size_t size) {
+		if(!blocks || size > blocks->itemSize) {
+			return(NULL);
+		}
+		return((u_char*)blocks->alloc());
+	}
+	static inline void freeBlock(u_char *block) {
+		blocks->free(block);
+	}
+	static inline u_int32_t *allocOffsets(size_t count) {
+		if(!offsets || count * sizeof(u_int32_t) > offsets->itemSize) {
+			return(NULL);
+		}
+		return((u_int32_t*)offsets->alloc());
+	}
+	static inline void freeOffsets(u_int32_t *offsets) {
+		cPcapBlockPool::offsets->free(offsets);
+	}
+private:
+	bool addSlab();
+private:
+	std::string name;
+	size_t itemSize;
+	size_t slabSize;
+	u_int64_t maxSize;
+	std::vector<void*> slabs;
+	std::vector<void*> freeItems;
+	volatile u_int64_t allocSize;
+	volatile u_int32_t useItems;
+	volatile bool mapFailed;
+	volatile int _sync;
+	volatile int _sync_slab;
+	static cPcapBlockPool *blocks;
+	static cPcapBlockPool *offsets;
+};
+
+
+#endif //PCAP_BLOCK_POOL_H
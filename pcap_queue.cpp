@@ -15,6 +15,7 @@
 #include <vector>
 #include <dirent.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
 
 #include <snappy-c.h>
 #ifdef HAVE_LIBLZ4
@@ -39,6 +40,11 @@
 #include "ssl_dssl.h"
 #include "tcmalloc_hugetables.h"
 #include "heap_chunk.h"
+#include "zstd_sip_dictionary.h"
+#include "latency_stat.h"
+#include "numa_affinity.h"
+#include "pcap_block_pool.h"
+#include "packetbuffer_shedding.h"
 
 #ifndef FREEBSD
 #include <malloc.h>
@@ -164,6 +170,7 @@ void *_PcapQueue_readFromInterfaceThread_threadFunction(void *arg);
 void *_PcapQueue_readFromFifo_destroyBlocksThreadFunction(void *arg);
 void *_PcapQueue_readFromFifo_socketServerThreadFunction(void *arg);
 void *_PcapQueue_readFromFifo_connectionThreadFunction(void *arg);
+void *_PcapQueue_readFromFifo_ioThreadFunction(void *arg);
 
 static bool __config_ENABLE_TOGETHER_READ_WRITE_FILE	= false;
 
@@ -189,7 +196,11 @@ int opt_pcap_queue_compress				= -1;
 pcap_block_store::compress_method opt_pcap_queue_compress_method 
 							= pcap_block_store::snappy;
 int opt_pcap_queue_compress_ratio = 100;
+string opt_pcap_queue_compress_zstd_dictionary;
+int opt_pcap_queue_compress_zstd_level			= 1;
+int opt_pcap_queue_compress_threads			= 0;
 string opt_pcap_queue_disk_folder;
+int opt_pcap_queue_file_direct_io			= 0;
 ip_port opt_pcap_queue_send_to_ip_port;
 ip_port opt_pcap_queue_receive_from_ip_port;
 int opt_pcap_queue_receive_from_port;
@@ -206,13 +217,34 @@ int opt_pcap_queue_dequeu_method			= 2;
 int opt_pcap_queue_use_blocks				= 0;
 int opt_pcap_queue_use_blocks_auto_enable		= 0;
 int opt_pcap_queue_use_blocks_read_check		= 1;
+int opt_pcap_queue_iface_tpacket_v3			= 0;
+int opt_pcap_queue_iface_tpacket_v3_block_size		= 1024 * 1024;
+int opt_pcap_queue_iface_tpacket_v3_block_timeout	= 10;
+int opt_pcap_queue_iface_fanout				= 0;
+int opt_load_generator					= 0;
+int opt_load_generator_threads				= 1;
+int opt_load_generator_cps				= 100;
+int opt_load_generator_calls				= 1000;
+int opt_load_generator_cps_ramp				= 0;
+double opt_load_generator_loss				= 0;
+string opt_load_generator_codecs			= "8";
+int opt_latency_stat					= 1;
+int opt_latency_stat_sampling				= 1024;
+int opt_pcap_queue_iface_prefilter			= 0;
 int opt_pcap_dispatch					= 0;
 int opt_pcap_queue_suppress_t1_thread			= 0;
 int opt_pcap_queue_block_timeout			= 0;
+int opt_pcap_queue_block_pool				= 1;
+int opt_pcap_queue_load_shedding			= 0;
+int opt_pcap_queue_load_shedding_payload		= 70;
+int opt_pcap_queue_load_shedding_unrecorded		= 85;
 bool opt_pcap_queue_pcap_stat_per_one_interface		= true;
 bool opt_pcap_queues_mirror_nonblock_mode 		= true;
 bool opt_pcap_queues_mirror_require_confirmation	= true;
 bool opt_pcap_queues_mirror_use_checksum		= true;
+int opt_pcap_queues_mirror_window			= 0;
+int opt_pcap_queues_mirror_stripes			= 1;
+int opt_pcap_queues_mirror_receiver_io_threads		= 0;
 
 size_t _opt_pcap_queue_block_offset_init_size		= opt_pcap_queue_block_max_size / AVG_PACKET_SIZE * 1.1;
 size_t _opt_pcap_queue_block_offset_inc_size		= opt_pcap_queue_block_max_size / AVG_PACKET_SIZE / 4;
@@ -221,6 +253,7 @@ size_t _opt_pcap_queue_block_restore_buffer_inc_size	= opt_pcap_queue_block_max_
 int pcap_drop_flag = 0;
 int enable_bad_packet_order_warning = 0;
 u_int64_t all_ringbuffers_size = 0;
+volatile int capture_prefilter_version = 0;
 double last_traffic = -1;
 
 static pcap_block_store_queue *blockStoreBypassQueue; 
@@ -231,6 +264,9 @@ static unsigned long sumBlocksCounterIn[3];
 static unsigned long sumBlocksCounterOut[3];
 static unsigned long long sumPacketsSize[3];
 static unsigned long long sumPacketsSizeCompress[3];
+static volatile unsigned long long sumCompressMethodSizeIn[pcap_block_store::zstd + 1][3];
+static volatile unsigned long long sumCompressMethodSizeOut[pcap_block_store::zstd + 1][3];
+static volatile unsigned long long sumCompressMethodTimeUS[pcap_block_store::zstd + 1][3];
 static unsigned long maxBypassBufferItems;
 static unsigned long maxBypassBufferSize;
 static unsigned long countBypassBufferSizeExceeded;
@@ -323,7 +359,7 @@ bool pcap_block_store::add_hp(pcap_pkthdr_plus *header, u_char *packet, int memc
 		this->full = true;
 		return(false);
 	}
-	if(!this->block) {
+	if(!this->block && !this->allocBlockFromPool(opt_pcap_queue_block_max_size)) {
 		while(true) {
 			this->block = new FILE_LINE(15004) u_char[opt_pcap_queue_block_max_size];
 			if(this->block) {
@@ -335,16 +371,20 @@ bool pcap_block_store::add_hp(pcap_pkthdr_plus *header, u_char *packet, int memc
 	}
 	if(!this->offsets_size) {
 		this->offsets_size = _opt_pcap_queue_block_offset_init_size;
-		this->offsets = new FILE_LINE(15005) uint32_t[this->offsets_size];
+		if(!this->allocOffsetsFromPool(this->offsets_size)) {
+			this->offsets = new FILE_LINE(15005) uint32_t[this->offsets_size];
+		}
 	}
 	if(this->count == this->offsets_size) {
 		uint32_t *offsets_old = this->offsets;
 		size_t offsets_size_old = this->offsets_size;
+		bool offsets_old_in_pool = this->offsets_in_pool;
 		this->offsets_size += _opt_pcap_queue_block_offset_inc_size;
 		this->offsets = new FILE_LINE(15006) uint32_t[this->offsets_size];
+		this->offsets_in_pool = false;
 		memcpy_heapsafe(this->offsets, offsets_old, sizeof(uint32_t) * offsets_size_old,
 				__FILE__, __LINE__);
-		delete [] offsets_old;
+		freeOffsetsBuffer(offsets_old, offsets_old_in_pool);
 	}
 	this->offsets[this->count] = this->size;
 	memcpy_heapsafe(this->block + this->size, this->block,
@@ -370,11 +410,13 @@ void pcap_block_store::inc_h(pcap_pkthdr_plus2 *header) {
 	if(this->count == this->offsets_size) {
 		uint32_t *offsets_old = this->offsets;
 		size_t offsets_size_old = this->offsets_size;
+		bool offsets_old_in_pool = this->offsets_in_pool;
 		this->offsets_size += _opt_pcap_queue_block_offset_inc_size;
 		this->offsets = new FILE_LINE(15007) uint32_t[this->offsets_size];
+		this->offsets_in_pool = false;
 		memcpy_heapsafe(this->offsets, offsets_old, sizeof(uint32_t) * offsets_size_old,
 				__FILE__, __LINE__);
-		delete [] offsets_old;
+		freeOffsetsBuffer(offsets_old, offsets_old_in_pool);
 	}
 	this->offsets[this->count] = this->size;
 	this->size += sizeof(pcap_pkthdr_plus2) + header->get_caplen();
@@ -383,7 +425,7 @@ void pcap_block_store::inc_h(pcap_pkthdr_plus2 *header) {
 }
 
 bool pcap_block_store::get_add_hp_pointers(pcap_pkthdr_plus2 **header, u_char **packet, unsigned min_size_for_packet) {
-	if(!this->block) {
+	if(!this->block && !this->allocBlockFromPool(opt_pcap_queue_block_max_size)) {
 		while(true) {
 			this->block = new FILE_LINE(15008) u_char[opt_pcap_queue_block_max_size];
 			if(this->block) {
@@ -400,7 +442,9 @@ bool pcap_block_store::get_add_hp_pointers(pcap_pkthdr_plus2 **header, u_char **
 	#endif
 	if(!this->offsets_size) {
 		this->offsets_size = _opt_pcap_queue_block_offset_init_size;
-		this->offsets = new FILE_LINE(15009) uint32_t[this->offsets_size];
+		if(!this->allocOffsetsFromPool(this->offsets_size)) {
+			this->offsets = new FILE_LINE(15009) uint32_t[this->offsets_size];
+		}
 	}
 	if(this->size + sizeof(pcap_pkthdr_plus2) + min_size_for_packet > opt_pcap_queue_block_max_size) {
 		this->full = true;
@@ -427,20 +471,16 @@ bool pcap_block_store::isTimeout() {
 }
 
 void pcap_block_store::destroy() {
-	if(this->offsets) {
-		delete [] this->offsets;
-		this->offsets = NULL;
-	}
-	if(this->block) {
-		delete [] this->block;
-		this->block = NULL;
-	}
+	this->freeOffsets();
+	this->freeBlock();
 	if(this->is_voip) {
 		delete [] this->is_voip;
 		this->is_voip = NULL;
 	}
 	this->size = 0;
 	this->size_compress = 0;
+	this->method_compress = compress_method_default;
+	this->dictionary_id = 0;
 	this->size_packets = 0;
 	this->count = 0;
 	this->offsets_size = 0;
@@ -466,15 +506,57 @@ bool pcap_block_store::isEmptyRestoreBuffer() {
 
 void pcap_block_store::freeBlock() {
 	if(this->block) {
-		delete [] this->block;
+		freeBlockBuffer(this->block, this->block_in_pool);
 		this->block = NULL;
+		this->block_in_pool = false;
+	}
+}
+
+void pcap_block_store::freeOffsets() {
+	if(this->offsets) {
+		freeOffsetsBuffer(this->offsets, this->offsets_in_pool);
+		this->offsets = NULL;
+		this->offsets_in_pool = false;
+	}
+}
+
+bool pcap_block_store::allocBlockFromPool(size_t size) {
+	this->block = cPcapBlockPool::allocBlock(size);
+	this->block_in_pool = this->block != NULL;
+	return(this->block_in_pool);
+}
+
+bool pcap_block_store::allocOffsetsFromPool(size_t count) {
+	this->offsets = cPcapBlockPool::allocOffsets(count);
+	this->offsets_in_pool = this->offsets != NULL;
+	return(this->offsets_in_pool);
+}
+
+void pcap_block_store::freeBlockBuffer(u_char *block, bool in_pool) {
+	if(in_pool) {
+		cPcapBlockPool::freeBlock(block);
+	} else {
+		delete [] block;
+	}
+}
+
+void pcap_block_store::freeOffsetsBuffer(uint32_t *offsets, bool in_pool) {
+	if(in_pool) {
+		cPcapBlockPool::freeOffsets(offsets);
+	} else {
+		delete [] offsets;
 	}
 }
 
-u_char* pcap_block_store::getSaveBuffer(uint32_t block_counter) {
+u_char* pcap_block_store::getSaveBuffer(uint32_t block_counter, u_char *saveBuffer) {
 	size_t sizeSaveBuffer = this->getSizeSaveBuffer();
-	u_char *saveBuffer = new FILE_LINE(15010) u_char[sizeSaveBuffer];
+	// external buffer (aligned for direct io) is not checked by heapsafe
+	u_char *saveBufferBegin = saveBuffer ? NULL : (saveBuffer = new FILE_LINE(15010) u_char[sizeSaveBuffer]);
+	size_t sizeHeader = this->getSizeSaveBufferHeader();
 	pcap_block_store_header header;
+	if(sizeHeader > sizeof(header)) {
+		header.version = PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD;
+	}
 	header.hm = this->hm;
 	header.size = this->size;
 	header.size_compress = this->size_compress;
@@ -484,15 +566,23 @@ u_char* pcap_block_store::getSaveBuffer(uint32_t block_counter) {
 	header.counter = block_counter;
 	strcpy(header.ifname, this->ifname);
 	header.time_s = getTimeS();
-	memcpy_heapsafe(saveBuffer, saveBuffer,
+	memcpy_heapsafe(saveBuffer, saveBufferBegin,
 			&header, NULL,
 			sizeof(header),
 			__FILE__, __LINE__);
-	memcpy_heapsafe(saveBuffer + sizeof(header), saveBuffer,
+	if(sizeHeader > sizeof(header)) {
+		pcap_block_store_header_zstd header_zstd;
+		header_zstd.dictionary_id = this->dictionary_id;
+		memcpy_heapsafe(saveBuffer + sizeof(header), saveBufferBegin,
+				&header_zstd, NULL,
+				sizeof(header_zstd),
+				__FILE__, __LINE__);
+	}
+	memcpy_heapsafe(saveBuffer + sizeHeader, saveBufferBegin,
 			this->offsets, this->offsets,
 			sizeof(uint32_t) * this->count,
 			__FILE__, __LINE__);
-	memcpy_heapsafe(saveBuffer + sizeof(pcap_block_store_header) + this->count * sizeof(uint32_t), saveBuffer,
+	memcpy_heapsafe(saveBuffer + sizeHeader + this->count * sizeof(uint32_t), saveBufferBegin,
 			this->block, this->block,
 			this->getUseSize(),
 			__FILE__, __LINE__);
@@ -507,28 +597,34 @@ void pcap_block_store::restoreFromSaveBuffer(u_char *saveBuffer) {
 	this->hm = (header_mode)header->hm;
 	this->size = header->size;
 	this->size_compress = header->size_compress;
+	if(header->version == PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD) {
+		this->method_compress = zstd;
+		this->dictionary_id = ((pcap_block_store_header_zstd*)(saveBuffer + sizeof(pcap_block_store_header)))->dictionary_id;
+	} else {
+		// version 6 block is compressed by the configured method, sender falls back from zstd to snappy
+		this->method_compress = !this->size_compress ? compress_method_default :
+					opt_pcap_queue_compress_method == zstd ? snappy : opt_pcap_queue_compress_method;
+		this->dictionary_id = 0;
+	}
+	size_t sizeHeader = header->getSize();
 	this->count = header->count;
 	this->dlink = header->dlink;
 	this->sensor_id = header->sensor_id;
 	strcpy_null_term(this->ifname, header->ifname);
 	this->block_counter = header->counter;
 	this->require_confirmation = header->require_confirmation;
-	if(this->offsets) {
-		delete [] this->offsets;
-	}
-	if(this->block) {
-		delete [] this->block;
-	}
+	this->freeOffsets();
+	this->freeBlock();
 	this->offsets_size = this->count;
 	this->offsets = new FILE_LINE(15011) uint32_t[this->offsets_size];
 	memcpy_heapsafe(this->offsets, this->offsets,
-			saveBuffer + sizeof(pcap_block_store_header), saveBuffer,
+			saveBuffer + sizeHeader, saveBuffer,
 			sizeof(uint32_t) * this->count,
 			__FILE__, __LINE__);
 	size_t sizeBlock = this->getUseSize();
 	this->block = new FILE_LINE(15012) u_char[sizeBlock];
 	memcpy_heapsafe(this->block, this->block,
-			saveBuffer + sizeof(pcap_block_store_header) + this->count * sizeof(uint32_t), saveBuffer,
+			saveBuffer + sizeHeader + this->count * sizeof(uint32_t), saveBuffer,
 			sizeBlock,
 			__FILE__, __LINE__);
 	this->full = true;
@@ -563,7 +659,8 @@ int pcap_block_store::addRestoreChunk(u_char *buffer, size_t size, size_t *offse
 		return(-3);
 	}
 	if(this->restoreBufferSize >= sizeof(pcap_block_store_header) &&
-	   ((pcap_block_store_header*)this->restoreBuffer)->version != PCAP_BLOCK_STORE_HEADER_VERSION) {
+	   ((pcap_block_store_header*)this->restoreBuffer)->version != PCAP_BLOCK_STORE_HEADER_VERSION &&
+	   ((pcap_block_store_header*)this->restoreBuffer)->version != PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD) {
 		return(-6);
 	}
 	if(!restoreFromStore &&
@@ -665,16 +762,35 @@ bool pcap_block_store::compress() {
 		case 9: if(!((__counter++) % 6)) return(true); break;
 		}
 	}
+	size_t sizeIn = this->size;
+	u_int64_t startTimeUS = getTimeUS();
+	bool rslt = false;
 	switch(opt_pcap_queue_compress_method) {
+	case zstd:
+		#ifdef HAVE_LIBZSTD
+		if(this->compress_zstd()) {
+			rslt = true;
+			break;
+		}
+		#endif //HAVE_LIBZSTD
+		rslt = this->compress_snappy();
+		break;
 	case lz4:
 		#ifdef HAVE_LIBLZ4
-		return(this->compress_lz4());
+		rslt = this->compress_lz4();
+		break;
 		#endif //HAVE_LIBLZ4
 	case snappy:
 	default:
-		return(this->compress_snappy());
+		rslt = this->compress_snappy();
+		break;
 	}
-	return(true);
+	if(rslt && this->method_compress <= zstd) {
+		__sync_fetch_and_add(&sumCompressMethodSizeIn[this->method_compress][0], sizeIn);
+		__sync_fetch_and_add(&sumCompressMethodSizeOut[this->method_compress][0], this->size_compress);
+		__sync_fetch_and_add(&sumCompressMethodTimeUS[this->method_compress][0], getTimeUS() - startTimeUS);
+	}
+	return(rslt);
 }
 
 bool pcap_block_store::compress_snappy() {
@@ -687,14 +803,15 @@ bool pcap_block_store::compress_snappy() {
 	snappy_status snappyRslt = snappy_compress((char*)this->block, this->size, (char*)snappyBuff, &snappyBuffSize);
 	switch(snappyRslt) {
 		case SNAPPY_OK:
-			delete [] this->block;
+			this->freeBlock();
 			#if HEAPSAFE
 				this->block = (u_char*)realloc_object(snappyBuff, snappyBuffSize, __FILE__, __LINE__, 16015);
 			#else
 				this->block = (u_char*)realloc(snappyBuff, snappyBuffSize);
 			#endif
 			this->size_compress = snappyBuffSize;
-			sumPacketsSizeCompress[0] += this->size_compress;
+			this->method_compress = snappy;
+			__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
 			return(true);
 		case SNAPPY_INVALID_INPUT:
 			syslog(LOG_ERR, "packetbuffer: snappy_compress: invalid input");
@@ -720,13 +837,14 @@ bool pcap_block_store::compress_lz4() {
 	}
 	int lz4_size = LZ4_compress((char*)this->block, (char*)lz4Buff, this->size);
 	if(lz4_size > 0) {
-		delete [] this->block;
+		this->freeBlock();
 		this->block = new FILE_LINE(15016) u_char[lz4_size];
 		memcpy_heapsafe(this->block, lz4Buff, lz4_size,
 				__FILE__, __LINE__);
 		delete [] lz4Buff;
 		this->size_compress = lz4_size;
-		sumPacketsSizeCompress[0] += this->size_compress;
+		this->method_compress = lz4;
+		__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
 		return(true);
 	} else {
 		syslog(LOG_ERR, "packetbuffer: lz4_compress: error");
@@ -736,11 +854,49 @@ bool pcap_block_store::compress_lz4() {
 	return(false);
 }
 
+bool pcap_block_store::compress_zstd() {
+	#ifdef HAVE_LIBZSTD
+	ZSTD_CDict *cdict = cZstdSipDictionary::getCDict();
+	if(!cdict) {
+		return(false);
+	}
+	ZSTD_CCtx *cctx = cZstdSipDictionary::getThreadCCtx();
+	if(!cctx) {
+		syslog(LOG_ERR, "packetbuffer: zstd_compress: context allocation failed");
+		return(false);
+	}
+	size_t zstdBuffSize = ZSTD_compressBound(this->size);
+	u_char *zstdBuff = new FILE_LINE(0) u_char[zstdBuffSize];
+	size_t zstd_size = ZSTD_compress_usingCDict(cctx, zstdBuff, zstdBuffSize, this->block, this->size, cdict);
+	if(!ZSTD_isError(zstd_size)) {
+		this->freeBlock();
+		this->block = new FILE_LINE(0) u_char[zstd_size];
+		memcpy_heapsafe(this->block, zstdBuff, zstd_size,
+				__FILE__, __LINE__);
+		delete [] zstdBuff;
+		this->size_compress = zstd_size;
+		this->method_compress = zstd;
+		this->dictionary_id = cZstdSipDictionary::getId();
+		__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
+		return(true);
+	} else {
+		syslog(LOG_ERR, "packetbuffer: zstd_compress: %s", ZSTD_getErrorName(zstd_size));
+	}
+	delete [] zstdBuff;
+	#endif //HAVE_LIBZSTD
+	return(false);
+}
+
 bool pcap_block_store::uncompress(compress_method method) {
 	if(!this->size_compress) {
 		return(true);
 	}
-	switch(method == compress_method_default ? opt_pcap_queue_compress_method : method) {
+	if(method == compress_method_default) {
+		method = this->method_compress ? (compress_method)this->method_compress : opt_pcap_queue_compress_method;
+	}
+	switch(method) {
+	case zstd:
+		return(this->uncompress_zstd());
 	case lz4:
 		#ifdef HAVE_LIBLZ4
 		return(this->uncompress_lz4());
@@ -757,12 +913,17 @@ bool pcap_block_store::uncompress_snappy() {
 		return(true);
 	}
 	size_t snappyBuffSize = this->size;
-	u_char *snappyBuff = new FILE_LINE(15017) u_char[snappyBuffSize];
+	u_char *snappyBuff = cPcapBlockPool::allocBlock(snappyBuffSize);
+	bool snappyBuffInPool = snappyBuff != NULL;
+	if(!snappyBuff) {
+		snappyBuff = new FILE_LINE(15017) u_char[snappyBuffSize];
+	}
 	snappy_status snappyRslt = snappy_uncompress((char*)this->block, this->size_compress, (char*)snappyBuff, &snappyBuffSize);
 	switch(snappyRslt) {
 		case SNAPPY_OK:
-			delete [] this->block;
+			this->freeBlock();
 			this->block = snappyBuff;
+			this->block_in_pool = snappyBuffInPool;
 			this->size_compress = 0;
 			return(true);
 		case SNAPPY_INVALID_INPUT:
@@ -775,7 +936,7 @@ bool pcap_block_store::uncompress_snappy() {
 			syslog(LOG_ERR, "packetbuffer: snappy_uncompress: unknown error");
 			break;
 	}
-	delete [] snappyBuff;
+	freeBlockBuffer(snappyBuff, snappyBuffInPool);
 	return(false);
 }
 
@@ -787,20 +948,67 @@ bool pcap_block_store::uncompress_lz4() {
 		return(true);
 	}
 	size_t lz4BuffSize = this->size;
-	u_char *lz4Buff = new FILE_LINE(15018) u_char[lz4BuffSize];
+	u_char *lz4Buff = cPcapBlockPool::allocBlock(lz4BuffSize);
+	bool lz4BuffInPool = lz4Buff != NULL;
+	if(!lz4Buff) {
+		lz4Buff = new FILE_LINE(15018) u_char[lz4BuffSize];
+	}
 	if(LZ4_decompress_fast((char*)this->block, (char*)lz4Buff, this->size) >= 0) {
-		delete [] this->block;
+		this->freeBlock();
 		this->block = lz4Buff;
+		this->block_in_pool = lz4BuffInPool;
 		this->size_compress = 0;
 		return(true);
 	} else {
 		syslog(LOG_ERR, "packetbuffer: lz4_uncompress: error");
 	}
-	delete [] lz4Buff;
+	freeBlockBuffer(lz4Buff, lz4BuffInPool);
 	#endif //HAVE_LIBLZ4
 	return(false);
 }
 
+bool pcap_block_store::uncompress_zstd() {
+	if(!this->size_compress) {
+		return(true);
+	}
+	#ifdef HAVE_LIBZSTD
+	ZSTD_DDict *ddict = cZstdSipDictionary::getDDict();
+	if(!ddict || this->dictionary_id != cZstdSipDictionary::getId()) {
+		syslog(LOG_ERR, "packetbuffer: zstd_uncompress: dictionary id mismatch (block %u / local %u)",
+		       this->dictionary_id, cZstdSipDictionary::getId());
+		return(false);
+	}
+	ZSTD_DCtx *dctx = cZstdSipDictionary::getThreadDCtx();
+	if(!dctx) {
+		syslog(LOG_ERR, "packetbuffer: zstd_uncompress: context allocation failed");
+		return(false);
+	}
+	size_t zstdBuffSize = this->size;
+	u_char *zstdBuff = cPcapBlockPool::allocBlock(zstdBuffSize);
+	bool zstdBuffInPool = zstdBuff != NULL;
+	if(!zstdBuff) {
+		zstdBuff = new FILE_LINE(0) u_char[zstdBuffSize];
+	}
+	size_t zstd_size = ZSTD_decompress_usingDDict(dctx, zstdBuff, zstdBuffSize, this->block, this->size_compress, ddict);
+	if(!ZSTD_isError(zstd_size) && zstd_size == this->size) {
+		this->freeBlock();
+		this->block = zstdBuff;
+		this->block_in_pool = zstdBuffInPool;
+		this->size_compress = 0;
+		this->method_compress = compress_method_default;
+		this->dictionary_id = 0;
+		return(true);
+	} else {
+		syslog(LOG_ERR, "packetbuffer: zstd_uncompress: %s", 
+		       ZSTD_isError(zstd_size) ? ZSTD_getErrorName(zstd_size) : "bad size");
+	}
+	freeBlockBuffer(zstdBuff, zstdBuffInPool);
+	#else
+	syslog(LOG_ERR, "packetbuffer: zstd_uncompress: zstd is not supported in this build");
+	#endif //HAVE_LIBZSTD
+	return(false);
+}
+
 
 pcap_block_store_queue::pcap_block_store_queue() {
 	extern volatile int terminating;
@@ -828,6 +1036,8 @@ pcap_file_store::pcap_file_store(u_int id, const char *folder) {
 	this->fileHandlePop = NULL;
 	this->fileBufferPush = NULL;
 	this->fileBufferPop = NULL;
+	this->directFilePush = NULL;
+	this->directFilePop = NULL;
 	this->fileSize = 0;
 	this->fileSizeFlushed = 0;
 	this->countPush = 0;
@@ -842,6 +1052,9 @@ pcap_file_store::~pcap_file_store() {
 }
 
 bool pcap_file_store::push(pcap_block_store *blockStore) {
+	if(opt_pcap_queue_file_direct_io) {
+		return(this->push_direct(blockStore));
+	}
 	if(!this->fileHandlePush && !this->open(typeHandlePush)) {
 		return(false);
 	}
@@ -874,11 +1087,17 @@ bool pcap_file_store::push(pcap_block_store *blockStore) {
 	return(false);
 }
 
-bool pcap_file_store::pop(pcap_block_store *blockStore) {
+bool pcap_file_store::pop(pcap_block_store *blockStore, bool *notReady) {
+	if(notReady) {
+		*notReady = false;
+	}
 	if(!blockStore->idFileStore) {
 		syslog(LOG_ERR, "packetbuffer: invalid file store id");
 		return(false);
 	}
+	if(opt_pcap_queue_file_direct_io) {
+		return(this->pop_direct(blockStore, notReady));
+	}
 	if(!this->fileHandlePop && !this->open(typeHandlePop)) {
 		return(false);
 	}
@@ -916,13 +1135,136 @@ bool pcap_file_store::pop(pcap_block_store *blockStore) {
 	return(rsltRestoreChunk > 0);
 }
 
+bool pcap_file_store::push_direct(pcap_block_store *blockStore) {
+	if(!this->directFilePush && !this->open(typeHandlePush)) {
+		return(false);
+	}
+	size_t oldFileSize = this->fileSize;
+	size_t sizeSaveBuffer = blockStore->getSizeSaveBuffer();
+	size_t sizeWrite = cAsyncDirectFile::alignSize(sizeSaveBuffer);
+	u_char *writeBuffer = cAsyncDirectFile::allocBuffer(sizeWrite);
+	if(!writeBuffer) {
+		syslog(LOG_ERR, "packetbuffer: alloc write buffer for %s failed", this->getFilePathName().c_str());
+		return(false);
+	}
+	blockStore->getSaveBuffer(0, writeBuffer);
+	memset(writeBuffer + sizeSaveBuffer, 0, sizeWrite - sizeSaveBuffer);
+	this->lock_sync_flush_file();
+	// write buffer is released by directFilePush after completion
+	bool rsltWrite = this->directFilePush->write(writeBuffer, sizeWrite, oldFileSize);
+	if(rsltWrite) {
+		this->fileSize += sizeWrite;
+	}
+	this->unlock_sync_flush_file();
+	if(rsltWrite) {
+		blockStore->freeBlock();
+		blockStore->idFileStore = this->id;
+		blockStore->filePosition = oldFileSize;
+		++this->countPush;
+		return(true);
+	}
+	return(false);
+}
+
+bool pcap_file_store::pop_direct(pcap_block_store *blockStore, bool *notReady) {
+	if(!this->directFilePop && !this->open(typeHandlePop)) {
+		return(false);
+	}
+	int rsltRestoreChunk = 0;
+	u_char *pendingBuffer = NULL;
+	size_t pendingBufferSize = 0;
+	this->lock_sync_flush_file();
+	if(this->fileSizeFlushed <= blockStore->filePosition) {
+		this->fileSizeFlushed = this->directFilePush ? 
+					 this->directFilePush->getCompletedSize() : 
+					 this->fileSize;
+		if(this->fileSizeFlushed <= blockStore->filePosition) {
+			// block is not completely written yet - take it from write buffer instead of waiting in output thread
+			u_char *writeBuffer = this->directFilePush ?
+					       this->directFilePush->getPendingWriteBuffer(blockStore->filePosition, &pendingBufferSize) :
+					       NULL;
+			if(!writeBuffer) {
+				// written out of order and the previous write is still in progress
+				this->unlock_sync_flush_file();
+				if(notReady) {
+					*notReady = true;
+				}
+				return(false);
+			}
+			pendingBuffer = new FILE_LINE(0) u_char[pendingBufferSize];
+			memcpy(pendingBuffer, writeBuffer, pendingBufferSize);
+		}
+	}
+	size_t fileSize = this->fileSizeFlushed;
+	this->unlock_sync_flush_file();
+	if(pendingBuffer) {
+		blockStore->destroyRestoreBuffer();
+		rsltRestoreChunk = blockStore->addRestoreChunk(pendingBuffer, pendingBufferSize, NULL, true);
+		delete [] pendingBuffer;
+		if(rsltRestoreChunk < 0) {
+			syslog(LOG_ERR, "packetbuffer: restore block from write buffer of %s failed - %s", 
+			       this->getFilePathName().c_str(),
+			       blockStore->addRestoreChunk_getErrorString(rsltRestoreChunk).c_str());
+		}
+	}
+	pcap_block_store::pcap_block_store_header *header = pendingBufferSize ? NULL :
+		(pcap_block_store::pcap_block_store_header*)this->directFilePop->read(blockStore->filePosition, sizeof(pcap_block_store::pcap_block_store_header), fileSize);
+	if(header) {
+		size_t sizeSaveBuffer = header->getSize() + 
+					header->count * sizeof(uint32_t) + 
+					(header->size_compress ? header->size_compress : header->size);
+		u_char *saveBuffer = sizeSaveBuffer <= opt_pcap_queue_block_max_size * 10 ?
+				      this->directFilePop->read(blockStore->filePosition, sizeSaveBuffer, fileSize) :
+				      NULL;
+		if(saveBuffer) {
+			// read window is not allocated by heapsafe new - restore from copy
+			u_char *restoreBuffer = new FILE_LINE(0) u_char[sizeSaveBuffer];
+			memcpy(restoreBuffer, saveBuffer, sizeSaveBuffer);
+			blockStore->destroyRestoreBuffer();
+			rsltRestoreChunk = blockStore->addRestoreChunk(restoreBuffer, sizeSaveBuffer, NULL, true);
+			delete [] restoreBuffer;
+			if(rsltRestoreChunk < 0) {
+				syslog(LOG_ERR, "packetbuffer: restore block from %s failed - %s", 
+				       this->getFilePathName().c_str(),
+				       blockStore->addRestoreChunk_getErrorString(rsltRestoreChunk).c_str());
+			}
+		}
+	}
+	++this->countPop;
+	blockStore->destroyRestoreBuffer();
+	if(this->countPop == this->countPush && this->isFull()) {
+		this->close(typeHandlePop);
+	}
+	return(rsltRestoreChunk > 0);
+}
+
 bool pcap_file_store::open(eTypeHandle typeHandle) {
-	if((!(typeHandle & typeHandlePush) || this->fileHandlePush) &&
-	   (!(typeHandle & typeHandlePop) || this->fileHandlePop)) {
+	if((!(typeHandle & typeHandlePush) || this->fileHandlePush || this->directFilePush) &&
+	   (!(typeHandle & typeHandlePop) || this->fileHandlePop || this->directFilePop)) {
 		return(true);
 	}
 	bool rslt = true;
 	string filePathName = this->getFilePathName();
+	if(opt_pcap_queue_file_direct_io) {
+		if(typeHandle & typeHandlePush) {
+			remove(filePathName.c_str());
+			this->directFilePush = new FILE_LINE(0) cAsyncDirectFile;
+			if(!this->directFilePush->open(filePathName.c_str(), true, opt_pcap_queue_file_store_max_size + opt_pcap_queue_block_max_size)) {
+				delete this->directFilePush;
+				this->directFilePush = NULL;
+				rslt = false;
+			}
+		}
+		if(typeHandle & typeHandlePop) {
+			this->directFilePop = new FILE_LINE(0) cAsyncDirectFile;
+			if(!this->directFilePop->open(filePathName.c_str(), false)) {
+				delete this->directFilePop;
+				this->directFilePop = NULL;
+				rslt = false;
+			}
+		}
+		return(rslt);
+	}
 	if(typeHandle & typeHandlePush) {
 		remove(filePathName.c_str());
 		this->fileHandlePush = fopen(filePathName.c_str(), "wb");
@@ -970,6 +1312,20 @@ bool pcap_file_store::open(eTypeHandle typeHandle) {
 }
 
 bool pcap_file_store::close(eTypeHandle typeHandle) {
+	if(typeHandle & typeHandlePush &&
+	   this->directFilePush != NULL) {
+		this->lock_sync_flush_file();
+		if(this->directFilePush) {
+			delete this->directFilePush;
+			this->directFilePush = NULL;
+		}
+		this->unlock_sync_flush_file();
+	}
+	if(typeHandle & typeHandlePop &&
+	   this->directFilePop != NULL) {
+		delete this->directFilePop;
+		this->directFilePop = NULL;
+	}
 	if(typeHandle & typeHandlePush &&
 	   this->fileHandlePush != NULL) {
 		this->lock_sync_flush_file();
@@ -1100,7 +1456,11 @@ bool pcap_store_queue::push(pcap_block_store *blockStore, bool deleteBlockStoreI
 		if(locked_fileStore) {
 			this->unlock_fileStore();
 		}
-		if(!buffersControl.check__pcap_store_queue__push()) {
+		cPacketbufferShedding::updateLevel();
+		if(!buffersControl.check__pcap_store_queue__push() &&
+		   // without rtp the block can use the reserve
+		   !(this->stripRtp(blockStore) &&
+		     buffersControl.check__pcap_store_queue__push_reserve())) {
 			u_int64_t actTime = getTimeMS();
 			if(actTime - 1000 > this->lastTimeLogErrMemoryIsFull) {
 				syslog(LOG_ERR, "packetbuffer: MEMORY IS FULL");
@@ -1122,6 +1482,22 @@ bool pcap_store_queue::push(pcap_block_store *blockStore, bool deleteBlockStoreI
 	return(true);
 }
 
+bool pcap_store_queue::stripRtp(pcap_block_store *blockStore) {
+	if(!cPacketbufferShedding::isEnable()) {
+		return(false);
+	}
+	// block compressed in t1 (or received compressed from sender) is stripped in uncompressed form and compressed again
+	bool compressed = blockStore->size_compress > 0;
+	if(compressed && !blockStore->uncompress()) {
+		return(false);
+	}
+	bool rslt = cPacketbufferShedding::stripRtp(blockStore, compressed);
+	if(compressed) {
+		blockStore->compress();
+	}
+	return(rslt);
+}
+
 bool pcap_store_queue::pop(pcap_block_store **blockStore) {
 	*blockStore = NULL;
 	this->lock_queue();
@@ -1141,7 +1517,16 @@ bool pcap_store_queue::pop(pcap_block_store **blockStore) {
 			while(!__config_ENABLE_TOGETHER_READ_WRITE_FILE && !_fileStore->full) {
 				USLEEP_C(100, usleepCounter++);
 			}
-			if(!_fileStore->pop(*blockStore)) {
+			bool notReady;
+			if(!_fileStore->pop(*blockStore, &notReady)) {
+				if(notReady) {
+					// write of the block to file is not completed - try it later
+					this->lock_queue();
+					this->queueStore.push_front(*blockStore);
+					this->unlock_queue();
+					*blockStore = NULL;
+					return(true);
+				}
 				delete *blockStore;
 				return(false);
 			}
@@ -1216,6 +1601,128 @@ uint64_t pcap_store_queue::getFileStoreUseSize(bool lock) {
 }
 
 
+void *_pcap_block_store_compress_pool_workerThreadFunction(void *arg) {
+	pcap_block_store_compress_pool::sWorker *worker = (pcap_block_store_compress_pool::sWorker*)arg;
+	return(worker->pool->workerThreadFunction(worker));
+}
+
+pcap_block_store_compress_pool::pcap_block_store_compress_pool(eTypePool typePool, unsigned workers) {
+	this->typePool = typePool;
+	this->workersCount = max(workers, 1u);
+	this->slotsCount = max(this->workersCount * 4, 8u);
+	this->slots = new FILE_LINE(0) sSlot[this->slotsCount];
+	for(unsigned i = 0; i < this->slotsCount; i++) {
+		this->slots[i].blockStore = NULL;
+		this->slots[i].ok = false;
+		this->slots[i].state = _slot_empty;
+	}
+	this->writePos = 0;
+	this->readPos = 0;
+	this->claimPos = 0;
+	this->depth = 0;
+	this->workers = new FILE_LINE(0) sWorker[this->workersCount];
+	for(unsigned i = 0; i < this->workersCount; i++) {
+		this->workers[i].thread_handle = 0;
+		this->workers[i].threadId = 0;
+		memset(this->workers[i].threadPstatData, 0, sizeof(this->workers[i].threadPstatData));
+		this->workers[i].pool = this;
+	}
+	this->terminating = false;
+	this->_sync_claim = 0;
+}
+
+pcap_block_store_compress_pool::~pcap_block_store_compress_pool() {
+	this->stop();
+	for(unsigned i = 0; i < this->slotsCount; i++) {
+		if(this->slots[i].blockStore) {
+			delete this->slots[i].blockStore;
+		}
+	}
+	delete [] this->slots;
+	delete [] this->workers;
+}
+
+void pcap_block_store_compress_pool::start() {
+	for(unsigned i = 0; i < this->workersCount; i++) {
+		vm_pthread_create((string(this->typePool == _compress ? "pb compress " : "pb uncompress ") + intToString(i + 1)).c_str(),
+				  &this->workers[i].thread_handle, NULL, _pcap_block_store_compress_pool_workerThreadFunction, &this->workers[i], __FILE__, __LINE__);
+	}
+}
+
+void pcap_block_store_compress_pool::stop() {
+	this->terminating = true;
+	for(unsigned i = 0; i < this->workersCount; i++) {
+		if(this->workers[i].thread_handle) {
+			pthread_join(this->workers[i].thread_handle, NULL);
+			this->workers[i].thread_handle = 0;
+			this->workers[i].threadId = 0;
+		}
+	}
+}
+
+string pcap_block_store_compress_pool::getStatString(bool preparePstatData) {
+	ostringstream outStr;
+	outStr << fixed
+	       << "q:" << this->depth << "/" << this->slotsCount;
+	for(unsigned i = 0; i < this->workersCount; i++) {
+		sWorker *worker = &this->workers[i];
+		if(!worker->threadId) {
+			continue;
+		}
+		if(preparePstatData) {
+			if(worker->threadPstatData[0].cpu_total_time) {
+				worker->threadPstatData[1] = worker->threadPstatData[0];
+			}
+			pstat_get_data(worker->threadId, worker->threadPstatData);
+		}
+		if(worker->threadPstatData[0].cpu_total_time &&
+		   worker->threadPstatData[1].cpu_total_time) {
+			double ucpu_usage, scpu_usage;
+			pstat_calc_cpu_usage_pct(
+				&worker->threadPstatData[0], &worker->threadPstatData[1],
+				&ucpu_usage, &scpu_usage);
+			outStr << (i ? "/" : " ") << setprecision(1) << (ucpu_usage + scpu_usage);
+		}
+	}
+	return(outStr.str());
+}
+
+void *pcap_block_store_compress_pool::workerThreadFunction(sWorker *worker) {
+	worker->threadId = get_unix_tid();
+	syslog(LOG_NOTICE, "start thread t1 %s/%i", this->typePool == _compress ? "compress" : "uncompress", worker->threadId);
+	unsigned int usleepCounter = 0;
+	while(!this->terminating && !is_terminating()) {
+		sSlot *slot = this->claimSlot();
+		if(!slot) {
+			USLEEP_C(100, usleepCounter++);
+			continue;
+		}
+		slot->ok = this->typePool == _compress ?
+			    slot->blockStore->compress() :
+			    slot->blockStore->uncompress();
+		__sync_synchronize();
+		slot->state = _slot_done;
+		usleepCounter = 0;
+	}
+	return(NULL);
+}
+
+pcap_block_store_compress_pool::sSlot *pcap_block_store_compress_pool::claimSlot() {
+	if(this->slots[this->claimPos].state != _slot_ready) {
+		return(NULL);
+	}
+	sSlot *slot = NULL;
+	lock_claim();
+	if(this->slots[this->claimPos].state == _slot_ready) {
+		slot = &this->slots[this->claimPos];
+		slot->state = _slot_processing;
+		this->claimPos = (this->claimPos + 1) % this->slotsCount;
+	}
+	unlock_claim();
+	return(slot);
+}
+
+
 PcapQueue::PcapQueue(eTypeQueue typeQueue, const char *nameQueue) {
 	this->typeQueue = typeQueue;
 	this->nameQueue = nameQueue;
@@ -1333,6 +1840,14 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 	sumPacketsSize[1] = sumPacketsSize[0];
 	sumPacketsSizeCompress[2] = sumPacketsSizeCompress[0] - sumPacketsSizeCompress[1];
 	sumPacketsSizeCompress[1] = sumPacketsSizeCompress[0];
+	for(unsigned i = 0; i <= pcap_block_store::zstd; i++) {
+		sumCompressMethodSizeIn[i][2] = sumCompressMethodSizeIn[i][0] - sumCompressMethodSizeIn[i][1];
+		sumCompressMethodSizeIn[i][1] = sumCompressMethodSizeIn[i][0];
+		sumCompressMethodSizeOut[i][2] = sumCompressMethodSizeOut[i][0] - sumCompressMethodSizeOut[i][1];
+		sumCompressMethodSizeOut[i][1] = sumCompressMethodSizeOut[i][0];
+		sumCompressMethodTimeUS[i][2] = sumCompressMethodTimeUS[i][0] - sumCompressMethodTimeUS[i][1];
+		sumCompressMethodTimeUS[i][1] = sumCompressMethodTimeUS[i][0];
+	}
 
 	extern int opt_cpu_limit_warning_t0;
 	extern int opt_cpu_limit_new_thread;
@@ -1444,6 +1959,9 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 			if(opt_ipaccount) {
 				outStr << "ipacc_buffer[" << lengthIpaccBuffer() << "/" << sizeIpaccBuffer() << "] ";
 			}
+			if(opt_dup_check && sverb.dedup) {
+				outStr << "dedup[" << cDedupTable::getStatString() << "] ";
+			}
 			if (opt_rrd) {
 				rrd_set_value(RRD_VALUE_inv, calltable->calls_list_count());
 				rrd_set_value(RRD_VALUE_reg, calltable->registers_listMAP.size());
@@ -1880,7 +2398,15 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 				syslog(LOG_NOTICE, "cleanspool resumed");
 			}
 		}
-		outStr << setprecision(0) << useAsyncWriteBuffer << "] ";
+		outStr << setprecision(0) << useAsyncWriteBuffer;
+		if(buffersControl.get__pcap_block_pool__allocSize()) {
+			outStr << "|pool:" << setprecision(0) << buffersControl.getPercUsePool() << "/"
+			       << (buffersControl.get__pcap_block_pool__allocSize() / 1024 / 1024) << "MB";
+		}
+		outStr << "] ";
+		if(cPacketbufferShedding::isEnable()) {
+			outStr << cPacketbufferShedding::getStatString();
+		}
 		if(opt_rrd) {
 			rrd_set_value(RRD_VALUE_ratio, useAsyncWriteBuffer);
 		}
@@ -1919,7 +2445,12 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 		}
 		double compress = this->pcapStat_get_compress();
 		if(compress >= 0) {
-			outStr << "comp[" << setprecision(0) << compress << "] ";
+			outStr << "comp[" << setprecision(0) << compress;
+			string compressMethods = this->pcapStat_get_compress_methods(statPeriod);
+			if(!compressMethods.empty()) {
+				outStr << " " << compressMethods;
+			}
+			outStr << "] ";
 		}
 		double speed = this->pcapStat_get_speed_mb_s(statPeriod);
 		if(speed >= 0) {
@@ -2033,6 +2564,10 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 			}
 		}
 	}
+	string compressPoolStat = this->getCompressPoolStat(true);
+	if(compressPoolStat.length()) {
+		outStrStat << compressPoolStat << " ";
+	}
 	if(sverb.log_profiler) {
 		lapTime.push_back(getTimeMS_rdtsc());
 		lapTimeDescr.push_back("t1");
@@ -2071,12 +2606,24 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 				if(defrag_cpu >= 0) {
 					outStrStat << "/defrag:" << setprecision(1) << defrag_cpu;
 				}
+				for(unsigned i = 0; i < pcapQueueQ_outThread_defrag->getShardsCount(); i++) {
+					double defrag_shard_cpu = pcapQueueQ_outThread_defrag->getShardCpuUsagePerc(i, true);
+					if(defrag_shard_cpu >= 0) {
+						outStrStat << "/df" << (i + 1) << ":" << setprecision(1) << defrag_shard_cpu;
+					}
+				}
 			}
 			if(pcapQueueQ_outThread_dedup) {
 				double dedup_cpu = pcapQueueQ_outThread_dedup->getCpuUsagePerc(true);
 				if(dedup_cpu >= 0) {
 					outStrStat << "/dedup:" << setprecision(1) << dedup_cpu;
 				}
+				for(unsigned i = 0; i < pcapQueueQ_outThread_dedup->getShardsCount(); i++) {
+					double dedup_shard_cpu = pcapQueueQ_outThread_dedup->getShardCpuUsagePerc(i, true);
+					if(dedup_shard_cpu >= 0) {
+						outStrStat << "/dd" << (i + 1) << ":" << setprecision(1) << dedup_shard_cpu;
+					}
+				}
 			}
 			if(opt_ipaccount) {
 				double ipacc_cpu = this->getCpuUsagePerc(destroyBlocksThread, true);
@@ -2523,6 +3070,20 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 		}
 		oldCountersTlb = counters["tlb"].second;
 	}
+	if(opt_load_generator) {
+		bool loadGeneratorDropsBegin = false;
+		outStrStat << cLoadGenerator::getStatString(statPeriod, &loadGeneratorDropsBegin) << " ";
+		if(loadGeneratorDropsBegin) {
+			syslog(LOG_NOTICE, "load generator: drops begin - %s", outStrStat.str().c_str());
+		}
+	}
+	if(opt_latency_stat) {
+		cLatencyStat::evaluate();
+		string latencyStatString = cLatencyStat::getStatString();
+		if(!latencyStatString.empty()) {
+			outStrStat << latencyStatString << " ";
+		}
+	}
 	outStrStat << "v" << RTPSENSOR_VERSION << " ";
 	//outStrStat << pcapStatCounter << " ";
 	if (opt_rrd) {
@@ -2746,6 +3307,23 @@ double PcapQueue::pcapStat_get_compress() {
 	}
 }
 
+string PcapQueue::pcapStat_get_compress_methods(int statPeriod) {
+	static const char *methodNames[] = { "", "snappy", "lz4", "zstd" };
+	ostringstream outStr;
+	outStr << fixed;
+	for(unsigned i = pcap_block_store::snappy; i <= pcap_block_store::zstd; i++) {
+		if(sumCompressMethodSizeIn[i][2]) {
+			if(outStr.tellp()) {
+				outStr << " ";
+			}
+			outStr << methodNames[i] << ":"
+			       << setprecision(0) << (100.0 * sumCompressMethodSizeOut[i][2] / sumCompressMethodSizeIn[i][2]) << "%/"
+			       << setprecision(1) << (sumCompressMethodTimeUS[i][2] / 1e4 / statPeriod) << "%c";
+		}
+	}
+	return(outStr.str());
+}
+
 double PcapQueue::pcapStat_get_speed_mb_s(int statPeriod) {
 	if(sumPacketsSize[2]) {
 		return(((double)sumPacketsSize[2])/statPeriod/(1024*1024)*8);
@@ -2908,6 +3486,15 @@ PcapQueue_readFromInterface_base::PcapQueue_readFromInterface_base(const char *i
 	this->filterDataUse = false;
 	this->pcapDumpHandle = NULL;
 	this->pcapLinklayerHeaderType = 0;
+	this->tpacketRing = NULL;
+	this->loadGenerator = NULL;
+	this->loadGeneratorIndex = -1;
+	this->fanoutGroup = 0;
+	this->fanoutIndex = 0;
+	this->prefilterUse = false;
+	this->prefilterVersion = 0;
+	this->prefilterCheckCounter = 0;
+	this->prefilterLastCheckMS = 0;
 	// CONFIG
 	extern int opt_promisc;
 	extern int opt_ringbuffer;
@@ -2917,6 +3504,7 @@ PcapQueue_readFromInterface_base::PcapQueue_readFromInterface_base(const char *i
 	this->pcap_buffer_size = opt_ringbuffer * 1024 * 1024;
 	//
 	memset(&this->last_ps, 0, sizeof(this->last_ps));
+	this->last_tpacket_freezes = 0;
 	this->countPacketDrop = 0;
 	this->lastPacketTimeUS = 0;
 	this->lastTimeLogErrPcapNextExNullPacket = 0;
@@ -2943,6 +3531,12 @@ PcapQueue_readFromInterface_base::PcapQueue_readFromInterface_base(const char *i
 }
 
 PcapQueue_readFromInterface_base::~PcapQueue_readFromInterface_base() {
+	if(this->tpacketRing) {
+		delete this->tpacketRing;
+	}
+	if(this->loadGenerator) {
+		delete this->loadGenerator;
+	}
 	if(this->pcapHandle) {
 		pcap_close(this->pcapHandle);
 		syslog(LOG_NOTICE, "packetbuffer terminating: pcap_close pcapHandle (%s)", interfaceName.c_str());
@@ -2960,6 +3554,15 @@ void PcapQueue_readFromInterface_base::setInterfaceName(const char *interfaceNam
 	this->interfaceName = interfaceName;
 }
 
+void PcapQueue_readFromInterface_base::setFanout(u_int16_t fanoutGroup, int fanoutIndex) {
+	this->fanoutGroup = fanoutGroup;
+	this->fanoutIndex = fanoutIndex;
+}
+
+void PcapQueue_readFromInterface_base::setLoadGenerator(int index) {
+	this->loadGeneratorIndex = index;
+}
+
 bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 	*error = "";
 	static volatile int _sync_start_capture = 0;
@@ -3002,68 +3605,119 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 		__sync_lock_release(&_sync_start_capture);
 		return(true);
 	}
+	if(this->loadGeneratorIndex >= 0) {
+		this->loadGenerator = new FILE_LINE(0) cLoadGenerator(this->loadGeneratorIndex, opt_load_generator_threads,
+								      opt_load_generator_cps, opt_load_generator_calls,
+								      opt_load_generator_codecs.c_str(), opt_load_generator_loss,
+								      opt_load_generator_cps_ramp);
+		// pcap handle only for dumping and pcap_handle index
+		this->pcapHandle = pcap_open_dead(DLT_EN10MB, this->pcap_snaplen);
+		this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
+		this->pcapLinklayerHeaderType = DLT_EN10MB;
+		global_pcap_handle = this->pcapHandle;
+		global_pcap_handle_index = this->pcapHandleIndex;
+		global_pcap_dlink = this->pcapLinklayerHeaderType;
+		syslog(LOG_NOTICE, "packetbuffer - %s: load generator %i calls/s, %i concurrent calls, codecs %s, loss %.2lf%%",
+		       this->getInterfaceName().c_str(),
+		       opt_load_generator_cps / max(opt_load_generator_threads, 1), opt_load_generator_calls / max(opt_load_generator_threads, 1),
+		       opt_load_generator_codecs.c_str(), opt_load_generator_loss);
+		__sync_lock_release(&_sync_start_capture);
+		return(true);
+	}
 	if(VERBOSE) {
 		syslog(LOG_NOTICE, "packetbuffer - %s: capturing", this->getInterfaceName().c_str());
 	}
 	if(pcap_lookupnet(this->interfaceName.c_str(), &this->interfaceNet, &this->interfaceMask, errbuf) == -1) {
 		this->interfaceMask = PCAP_NETMASK_UNKNOWN;
 	}
-	if((this->pcapHandle = pcap_create(this->interfaceName.c_str(), errbuf)) == NULL) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_create failed: %s", this->getInterfaceName().c_str(), errbuf); 
-		goto failed;
-	}
-	this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
-	global_pcap_handle = this->pcapHandle;
-	global_pcap_handle_index = this->pcapHandleIndex;
-	int status;
-	if((status = pcap_set_snaplen(this->pcapHandle, this->pcap_snaplen)) != 0) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_snaplen failed", this->getInterfaceName().c_str()); 
-		goto failed;
-	}
-	if((status = pcap_set_promisc(this->pcapHandle, this->pcap_promisc)) != 0) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_promisc failed", this->getInterfaceName().c_str()); 
-		goto failed;
-	}
-	if((status = pcap_set_timeout(this->pcapHandle, this->pcap_timeout)) != 0) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_timeout failed", this->getInterfaceName().c_str()); 
-		goto failed;
-	}
-	if((status = pcap_set_buffer_size(this->pcapHandle, this->pcap_buffer_size)) != 0) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_buffer_size failed", this->getInterfaceName().c_str()); 
-		goto failed;
-	}
-	rssBeforeActivate = getRss() / 1024 / 1024;
-	if((status = pcap_activate(this->pcapHandle)) != 0) {
-		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: libpcap error: %s", this->getInterfaceName().c_str(), pcap_geterr(this->pcapHandle)); 
-		cLogSensor::log(cLogSensor::error, errorstr);
-		if(opt_fork) {
-			ostringstream outStr;
-			outStr << this->getInterfaceName() << ": libpcap error: " << pcap_geterr(this->pcapHandle);
-			daemonizeOutput(outStr.str());
+	if(opt_pcap_queue_iface_tpacket_v3 && opt_pcap_queue_use_blocks) {
+		this->tpacketRing = new FILE_LINE(0) cTPacketV3Ring(this->interfaceName.c_str(),
+								    this->pcap_buffer_size, opt_pcap_queue_iface_tpacket_v3_block_size,
+								    opt_pcap_queue_iface_tpacket_v3_block_timeout,
+								    this->pcap_snaplen, this->pcap_promisc);
+		string tpacketError;
+		if(!this->tpacketRing->open(&tpacketError)) {
+			syslog(LOG_NOTICE, "packetbuffer - %s: TPACKET_V3 ring failed (%s) - using libpcap", this->getInterfaceName().c_str(), tpacketError.c_str());
+			delete this->tpacketRing;
+			this->tpacketRing = NULL;
+		} else if(this->fanoutGroup &&
+			  !this->tpacketRing->joinFanout(this->fanoutGroup, &tpacketError)) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: %s", this->getInterfaceName().c_str(), tpacketError.c_str());
+			goto failed;
 		}
-		goto failed;
 	}
-	if(rssBeforeActivate) {
-		for(int i = 0; i < 50; i++) {
-			USLEEP(100);
-			rssAfterActivate = getRss() / 1024 / 1024;
-			if(!rssAfterActivate ||
-			   rssAfterActivate > rssBeforeActivate + this->pcap_buffer_size * 0.9 / 1024 / 1024) {
-				break;
-			}
+	if(this->tpacketRing) {
+		// pcap handle only for filter compilation, dumping and pcap_handle index
+		this->pcapHandle = pcap_open_dead(this->tpacketRing->getLinkType(), this->pcap_snaplen);
+		this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
+		global_pcap_handle = this->pcapHandle;
+		global_pcap_handle_index = this->pcapHandleIndex;
+		all_ringbuffers_size += this->tpacketRing->getRingLength();
+	} else {
+		if((this->pcapHandle = pcap_create(this->interfaceName.c_str(), errbuf)) == NULL) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_create failed: %s", this->getInterfaceName().c_str(), errbuf); 
+			goto failed;
+		}
+		this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
+		global_pcap_handle = this->pcapHandle;
+		global_pcap_handle_index = this->pcapHandleIndex;
+		int status;
+		if((status = pcap_set_snaplen(this->pcapHandle, this->pcap_snaplen)) != 0) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_snaplen failed", this->getInterfaceName().c_str()); 
+			goto failed;
 		}
-		if(rssAfterActivate && rssAfterActivate > rssBeforeActivate &&
-		   rssAfterActivate < rssBeforeActivate + this->pcap_buffer_size * 0.9 / 1024 / 1024) {
-			syslog(LOG_NOTICE, "packetbuffer - %s: ringbuffer has only %lu MB which means that your kernel does not support ringbuffer (<2.6.32) or you have invalid ringbuffer setting", this->getInterfaceName().c_str(), rssAfterActivate - rssBeforeActivate); 
+		if((status = pcap_set_promisc(this->pcapHandle, this->pcap_promisc)) != 0) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_promisc failed", this->getInterfaceName().c_str()); 
+			goto failed;
+		}
+		if((status = pcap_set_timeout(this->pcapHandle, this->pcap_timeout)) != 0) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_timeout failed", this->getInterfaceName().c_str()); 
+			goto failed;
+		}
+		if((status = pcap_set_buffer_size(this->pcapHandle, this->pcap_buffer_size)) != 0) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_set_buffer_size failed", this->getInterfaceName().c_str()); 
+			goto failed;
+		}
+		rssBeforeActivate = getRss() / 1024 / 1024;
+		if((status = pcap_activate(this->pcapHandle)) != 0) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: libpcap error: %s", this->getInterfaceName().c_str(), pcap_geterr(this->pcapHandle)); 
+			cLogSensor::log(cLogSensor::error, errorstr);
 			if(opt_fork) {
 				ostringstream outStr;
-				outStr << this->getInterfaceName() << ": ringbuffer has only " << (rssAfterActivate - rssBeforeActivate) << " MB which means that your kernel does not support ringbuffer (<2.6.32) or you have invalid ringbuffer setting";
+				outStr << this->getInterfaceName() << ": libpcap error: " << pcap_geterr(this->pcapHandle);
 				daemonizeOutput(outStr.str());
 			}
+			goto failed;
+		}
+		if(rssBeforeActivate) {
+			for(int i = 0; i < 50; i++) {
+				USLEEP(100);
+				rssAfterActivate = getRss() / 1024 / 1024;
+				if(!rssAfterActivate ||
+				   rssAfterActivate > rssBeforeActivate + this->pcap_buffer_size * 0.9 / 1024 / 1024) {
+					break;
+				}
+			}
+			if(rssAfterActivate && rssAfterActivate > rssBeforeActivate &&
+			   rssAfterActivate < rssBeforeActivate + this->pcap_buffer_size * 0.9 / 1024 / 1024) {
+				syslog(LOG_NOTICE, "packetbuffer - %s: ringbuffer has only %lu MB which means that your kernel does not support ringbuffer (<2.6.32) or you have invalid ringbuffer setting", this->getInterfaceName().c_str(), rssAfterActivate - rssBeforeActivate); 
+				if(opt_fork) {
+					ostringstream outStr;
+					outStr << this->getInterfaceName() << ": ringbuffer has only " << (rssAfterActivate - rssBeforeActivate) << " MB which means that your kernel does not support ringbuffer (<2.6.32) or you have invalid ringbuffer setting";
+					daemonizeOutput(outStr.str());
+				}
+			}
+			if(rssAfterActivate > rssBeforeActivate) {
+				all_ringbuffers_size += (rssAfterActivate - rssBeforeActivate) * 1024 * 1024;
+			}
+		}
+		if(this->fanoutGroup) {
+			string fanoutError;
+			if(!packet_fanout_join(pcap_fileno(this->pcapHandle), this->fanoutGroup, &fanoutError)) {
+				snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: %s", this->getInterfaceName().c_str(), fanoutError.c_str());
+				goto failed;
+			}
 		}
-		if(rssAfterActivate > rssBeforeActivate) {
-			all_ringbuffers_size += (rssAfterActivate - rssBeforeActivate) * 1024 * 1024;
-		}
 	}
 	if(opt_mirrorip) {
 		if(opt_mirrorip_dst[0] == '\0') {
@@ -3074,12 +3728,17 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 			mirrorip = new FILE_LINE(15024) MirrorIP(opt_mirrorip_src, opt_mirrorip_dst);
 		}
 	}
-	if(*user_filter != '\0') {
+	this->prefilterUse = opt_pcap_queue_iface_prefilter;
+	this->prefilterVersion = capture_prefilter_version;
+	this->prefilter = this->prefilterUse ? capture_prefilter_expression() : "";
+	this->prefilterLastCheckMS = getTimeMS_rdtsc();
+	if(*user_filter != '\0' || !this->prefilter.empty()) {
 		// Compile and apply the filter
+		string capture_filter = this->getCaptureFilter();
 		struct bpf_program fp;
-		if (pcap_compile(this->pcapHandle, &fp, user_filter, 0, this->interfaceMask) == -1) {
+		if (pcap_compile(this->pcapHandle, &fp, capture_filter.c_str(), 0, this->interfaceMask) == -1) {
 			char user_filter_err[2048];
-			snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", user_filter, strlen(user_filter) > 2000 ? "..." : "");
+			snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", capture_filter.c_str(), capture_filter.length() > 2000 ? "..." : "");
 			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not parse filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, pcap_geterr(this->pcapHandle));
 			if(opt_fork) {
 				ostringstream outStr;
@@ -3088,17 +3747,26 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 			}
 			goto failed;
 		}
-		if (pcap_setfilter(this->pcapHandle, &fp) == -1) {
+		string setfilter_err;
+		if (this->tpacketRing ?
+		     !this->tpacketRing->setFilter(&fp, &setfilter_err) :
+		     pcap_setfilter(this->pcapHandle, &fp) == -1) {
 			char user_filter_err[2048];
-			snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", user_filter, strlen(user_filter) > 2000 ? "..." : "");
-			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not install filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, pcap_geterr(this->pcapHandle));
+			snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", capture_filter.c_str(), capture_filter.length() > 2000 ? "..." : "");
+			if(!this->tpacketRing) {
+				setfilter_err = pcap_geterr(this->pcapHandle);
+			}
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not install filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, setfilter_err.c_str());
 			if(opt_fork) {
 				ostringstream outStr;
-				outStr << this->getInterfaceName() << ": can not install filter " << user_filter_err << ": " << pcap_geterr(this->pcapHandle);
+				outStr << this->getInterfaceName() << ": can not install filter " << user_filter_err << ": " << setfilter_err;
 				daemonizeOutput(outStr.str());
 			}
 			goto failed;
 		}
+		if(!this->prefilter.empty()) {
+			syslog(LOG_NOTICE, "packetbuffer - %s: capture prefilter: %s", this->getInterfaceName().c_str(), this->prefilter.c_str());
+		}
 	}
 	this->pcapLinklayerHeaderType = pcap_datalink(this->pcapHandle);
 	if(!this->pcapLinklayerHeaderType) {
@@ -3130,6 +3798,7 @@ inline int PcapQueue_readFromInterface_base::pcap_next_ex_iface(pcap_t *pcapHand
 		*packet = NULL;
 		return(0);
 	}
+	this->checkPrefilter();
 	int res = ::pcap_next_ex(pcapHandle, header, (const u_char**)packet);
 	if(!packet && res != -2) {
 		if(VERBOSE) {
@@ -3334,23 +4003,28 @@ inline int PcapQueue_readFromInterface_base::pcap_next_ex_iface(pcap_t *pcapHand
 			syslog(LOG_NOTICE, "find oneshot libpcap buffer : %s", libpcap_buffer ? "success" : "failed");
 		}
 	}
+	return(check_protocol(*header, *packet, checkProtocol, checkProtocolData));
+}
+
+inline int PcapQueue_readFromInterface_base::check_protocol(pcap_pkthdr* header, u_char* packet,
+							    bool checkProtocol, sCheckProtocolData *checkProtocolData) {
 	if(checkProtocol || filter_ip) {
 		sCheckProtocolData _checkProtocolData;
 		if(!checkProtocolData) {
 			checkProtocolData = &_checkProtocolData;
 		}
-		if(!parseEtherHeader(pcapLinklayerHeaderType, *packet,
+		if(!parseEtherHeader(pcapLinklayerHeaderType, packet,
 				     checkProtocolData->header_sll, checkProtocolData->header_eth, NULL,
 				     checkProtocolData->header_ip_offset, checkProtocolData->protocol, checkProtocolData->vlan) ||
 		   !(checkProtocolData->protocol == ETHERTYPE_IP ||
 		     (VM_IPV6_B && checkProtocolData->protocol == ETHERTYPE_IPV6)) ||
-		   !(((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->version == 4 ||
-		     (VM_IPV6_B && ((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->version == 6)) ||
-		   ((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->get_tot_len() + checkProtocolData->header_ip_offset > (*header)->len) {
+		   !(((iphdr2*)(packet + checkProtocolData->header_ip_offset))->version == 4 ||
+		     (VM_IPV6_B && ((iphdr2*)(packet + checkProtocolData->header_ip_offset))->version == 6)) ||
+		   ((iphdr2*)(packet + checkProtocolData->header_ip_offset))->get_tot_len() + checkProtocolData->header_ip_offset > header->len) {
 			return(-11);
 		}
 		if(filter_ip) {
-			iphdr2 *iphdr = (iphdr2*)(*packet + checkProtocolData->header_ip_offset);
+			iphdr2 *iphdr = (iphdr2*)(packet + checkProtocolData->header_ip_offset);
 			if(!filter_ip->checkIP(iphdr->get_saddr()) && !filter_ip->checkIP(iphdr->get_daddr())) {
 				return(-11);
 			}
@@ -3359,6 +4033,58 @@ inline int PcapQueue_readFromInterface_base::pcap_next_ex_iface(pcap_t *pcapHand
 	return(1);
 }
 
+string PcapQueue_readFromInterface_base::getCaptureFilter() {
+	if(this->prefilter.empty()) {
+		return(user_filter);
+	}
+	if(*user_filter == '\0') {
+		return(this->prefilter);
+	}
+	return(string("(") + user_filter + ") and (" + this->prefilter + ")");
+}
+
+void PcapQueue_readFromInterface_base::updatePrefilter() {
+	bool reload = this->prefilterVersion != capture_prefilter_version;
+	u_int64_t actTimeMS = getTimeMS_rdtsc();
+	if(!reload && actTimeMS < this->prefilterLastCheckMS + 10000) {
+		return;
+	}
+	this->prefilterVersion = capture_prefilter_version;
+	this->prefilterLastCheckMS = actTimeMS;
+	string prefilter = capture_prefilter_expression();
+	if(prefilter == this->prefilter) {
+		return;
+	}
+	string prefilter_old = this->prefilter;
+	this->prefilter = prefilter;
+	string capture_filter = this->getCaptureFilter();
+	static volatile int _sync_compile = 0;
+	while(__sync_lock_test_and_set(&_sync_compile, 1));
+	struct bpf_program fp;
+	string error;
+	bool ok = false;
+	if(pcap_compile(this->pcapHandle, &fp, capture_filter.c_str(), 0, this->interfaceMask) == -1) {
+		error = pcap_geterr(this->pcapHandle);
+	} else {
+		if(this->tpacketRing) {
+			ok = this->tpacketRing->setFilter(&fp, &error);
+		} else if(pcap_setfilter(this->pcapHandle, &fp) == 0) {
+			ok = true;
+		} else {
+			error = pcap_geterr(this->pcapHandle);
+		}
+		pcap_freecode(&fp);
+	}
+	__sync_lock_release(&_sync_compile);
+	if(ok) {
+		syslog(LOG_NOTICE, "packetbuffer - %s: capture prefilter changed: %s", this->getInterfaceName().c_str(), 
+		       this->prefilter.empty() ? "none" : this->prefilter.c_str());
+	} else {
+		this->prefilter = prefilter_old;
+		syslog(LOG_ERR, "packetbuffer - %s: can not change capture prefilter: %s", this->getInterfaceName().c_str(), error.c_str());
+	}
+}
+
 void PcapQueue_readFromInterface_base::restoreOneshotBuffer() {
 	if(libpcap_buffer_old && libpcap_buffer) {
 		*libpcap_buffer = libpcap_buffer_old;
@@ -3406,8 +4132,8 @@ string PcapQueue_readFromInterface_base::pcapStatString_interface(int /*statPeri
 	ostringstream outStr;
 	if(this->pcapHandle) {
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		u_int64_t tpacket_freezes = 0;
+		if(this->getPcapStat(&ps, &tpacket_freezes)) {
 			if(ps.ps_recv >= this->last_ps.ps_recv) {
 				extern int opt_pcap_ifdrop_limit;
 				bool pcapdrop = false;
@@ -3434,12 +4160,16 @@ string PcapQueue_readFromInterface_base::pcapStatString_interface(int /*statPeri
 						outStr << " ifdrop:" << (ps.ps_ifdrop - this->last_ps.ps_ifdrop) << " " 
 						       << setprecision(1) << ((double)(ps.ps_ifdrop - this->last_ps.ps_ifdrop) / (ps.ps_recv - this->last_ps.ps_recv) * 100) << "%%";
 					}
+					if(this->tpacketRing && tpacket_freezes > this->last_tpacket_freezes) {
+						outStr << " ringfreeze:" << (tpacket_freezes - this->last_tpacket_freezes);
+					}
 					outStr << endl
 					       << "     increase --ring-buffer (kernel >= 2.6.31 and libpcap >= 1.0.0)" 
 					       << endl;
 				}
 			}
 			this->last_ps = ps;
+			this->last_tpacket_freezes = tpacket_freezes;
 		}
 	}
 	return(outStr.str());
@@ -3450,10 +4180,13 @@ string PcapQueue_readFromInterface_base::pcapDropCountStat_interface() {
 	if(this->pcapHandle) {
 		outStr << this->getInterfaceName(true) << " : " << "pdropsCount [" << this->countPacketDrop << "]";
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		u_int64_t tpacket_freezes = 0;
+		if(this->getPcapStat(&ps, &tpacket_freezes)) {
 			outStr << " ringdrop [" << ps.ps_drop << "]"
 			       << " ifdrop [" << ps.ps_ifdrop << "]";
+			if(this->tpacketRing) {
+				outStr << " ringfreeze [" << tpacket_freezes << "]";
+			}
 		}
 	}
 	return(outStr.str());
@@ -3475,16 +4208,38 @@ string PcapQueue_readFromInterface_base::getStatPacketDrop() {
 void PcapQueue_readFromInterface_base::initStat_interface() {
 	if(this->pcapHandle) {
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		u_int64_t tpacket_freezes = 0;
+		if(this->getPcapStat(&ps, &tpacket_freezes)) {
 			this->last_ps = ps;
+			this->last_tpacket_freezes = tpacket_freezes;
 		}
 		this->countPacketDrop = 0;
 	}
 }
 
+bool PcapQueue_readFromInterface_base::getPcapStat(pcap_stat *ps, u_int64_t *freezes) {
+	if(this->loadGenerator) {
+		u_int64_t packets, drops;
+		this->loadGenerator->getStat(&packets, &drops);
+		memset(ps, 0, sizeof(*ps));
+		ps->ps_recv = packets;
+		ps->ps_drop = drops;
+		return(true);
+	}
+	if(this->tpacketRing) {
+		u_int64_t packets, drops;
+		this->tpacketRing->getStat(&packets, &drops, freezes);
+		memset(ps, 0, sizeof(*ps));
+		ps->ps_recv = packets;
+		ps->ps_drop = drops;
+		return(true);
+	}
+	return(pcap_stats(this->pcapHandle, ps) == 0);
+}
+
 string PcapQueue_readFromInterface_base::getInterfaceName(bool simple) {
-	return((simple ? "" : "interface ") + this->interfaceName);
+	return((simple ? "" : "interface ") + this->interfaceName +
+	       (!simple && this->fanoutGroup ? " fanout " + intToString(this->fanoutIndex + 1) : ""));
 }
 
 void PcapQueue_readFromInterface_base::terminatingAtEndOfReadPcap() {
@@ -3561,8 +4316,14 @@ void PcapQueue_readFromInterface_base::terminatingAtEndOfReadPcap() {
 
 PcapQueue_readFromInterfaceThread::PcapQueue_readFromInterfaceThread(const char *interfaceName, eTypeInterfaceThread typeThread,
 								     PcapQueue_readFromInterfaceThread *readThread,
-								     PcapQueue_readFromInterfaceThread *prevThread)
+								     PcapQueue_readFromInterfaceThread *prevThread,
+								     u_int16_t fanoutGroup, int fanoutIndex,
+								     int loadGeneratorIndex)
  : PcapQueue_readFromInterface_base(interfaceName) {
+	this->setFanout(fanoutGroup, fanoutIndex);
+	this->setLoadGenerator(loadGeneratorIndex);
+	// qrings and detach buffers are placed to node of interface
+	int prevAllocNode = cNumaAffinity::setAllocNode(cNumaAffinity::getInterfaceNode(this->interfaceName.c_str()));
 	this->threadHandle = 0;
 	this->threadId = 0;
 	this->threadInitOk = 0;
@@ -3614,6 +4375,7 @@ PcapQueue_readFromInterfaceThread::PcapQueue_readFromInterfaceThread(const char
 			}
 		}
 	}
+	cNumaAffinity::restoreAllocNode(prevAllocNode);
 	this->counter = 0;
 	this->counter_pop_usleep = 0;
 	this->pop_usleep_sum = 0;
@@ -3819,6 +4581,7 @@ inline void PcapQueue_readFromInterfaceThread::push(sHeaderPacket **header_packe
 }
 
 inline void PcapQueue_readFromInterfaceThread::push_block(pcap_block_store *block) {
+	cPacketbufferShedding::updateLevel();
 	if(!buffersControl.check__pcap_store_queue__push()) {
 		if(!(opt_pcap_queue_store_queue_max_disk_size &&
 		     !opt_pcap_queue_disk_folder.empty())) {
@@ -3839,6 +4602,9 @@ inline void PcapQueue_readFromInterfaceThread::push_block(pcap_block_store *bloc
 		}
 		USLEEP_C(100, usleepCounter++);
 	}
+	if(block->count) {
+		cLatencyStat::add(cLatencyStat::_ls_block, getTimeUS(block->get_header(0)->get_tv_sec(), block->get_header(0)->get_tv_usec()));
+	}
 	qring_blocks[_writeIndex] = block;
 	qring_blocks_used[_writeIndex] = 1;
 	writeIndex = 0;
@@ -3849,6 +4615,11 @@ inline void PcapQueue_readFromInterfaceThread::push_block(pcap_block_store *bloc
 	}
 }
 
+inline bool PcapQueue_readFromInterfaceThread::can_push_block() {
+	return(buffersControl.check__pcap_store_queue__push() &&
+	       !qring_blocks_used[writeit % qringmax]);
+}
+
 inline void PcapQueue_readFromInterfaceThread::tryForcePush() {
 	if(writeIndexCount && force_push && writeIndex) {
 		/*
@@ -4001,6 +4772,7 @@ void PcapQueue_readFromInterfaceThread::cancelThread() {
 
 void *PcapQueue_readFromInterfaceThread::threadFunction(void */*arg*/, unsigned int /*arg2*/) {
 	this->threadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getInterfaceNode(this->interfaceName.c_str()));
 	if(VERBOSE) {
 		ostringstream outStr;
 		outStr << "start thread t0i_" 
@@ -4554,6 +5326,14 @@ void PcapQueue_readFromInterfaceThread::threadFunction_blocks() {
 	while(!(is_terminating() || this->threadDoTerminate)) {
 		switch(this->typeThread) {
 		case read: {
+			if(this->tpacketRing) {
+				this->readBlock_tpacket(&block);
+				break;
+			}
+			if(this->loadGenerator) {
+				this->readBlock_generator(&block);
+				break;
+			}
 			while(!block ||
 			      !block->get_add_hp_pointers(&pcap_header_plus2, &pcap_packet, pcap_snaplen) ||
 			      (block->count && force_push)) {
@@ -4625,6 +5405,9 @@ void PcapQueue_readFromInterfaceThread::threadFunction_blocks() {
 			if(!_useOneshotBuffer) {
 				memcpy(pcap_packet, pcap_next_ex_packet, pcap_next_ex_header->caplen);
 			}
+			cPacketbufferShedding::cutRtpPayload(pcap_header_plus2, pcap_packet,
+							     opt_pcap_queue_use_blocks_read_check ? checkProtocolData.header_ip_offset : (u_int)-1,
+							     pcapLinklayerHeaderType);
 			block->inc_h(pcap_header_plus2);
 			//cout << '.' << flush;
 			break;
@@ -4657,6 +5440,130 @@ void PcapQueue_readFromInterfaceThread::threadFunction_blocks() {
 	this->threadTerminated = true;
 }
 
+void PcapQueue_readFromInterfaceThread::readBlock_tpacket(pcap_block_store **block) {
+	if(this->prefilterUse) {
+		this->updatePrefilter();
+	}
+	if(!this->tpacketRing->nextBlock(100)) {
+		if(*block && (*block)->count && force_push) {
+			this->push_block(*block);
+			*block = NULL;
+			force_push = false;
+		}
+		return;
+	}
+	cTPacketV3Ring::sPacket packet;
+	pcap_pkthdr_plus2 *pcap_header_plus2 = NULL;
+	u_char *pcap_packet = NULL;
+	sCheckProtocolData checkProtocolData;
+	while(this->tpacketRing->nextPacket(&packet)) {
+		bool insertVlan = packet.vlan && packet.header.caplen >= 2 * ETHER_ADDR_LEN;
+		if(insertVlan) {
+			packet.header.caplen += 4;
+			packet.header.len += 4;
+		}
+		if(packet.header.caplen > this->pcap_snaplen) {
+			packet.header.caplen = this->pcap_snaplen;
+		}
+		while(!*block ||
+		      !(*block)->get_add_hp_pointers(&pcap_header_plus2, &pcap_packet, this->pcap_snaplen) ||
+		      ((*block)->count && force_push)) {
+			if(*block) {
+				this->push_block(*block);
+			}
+			*block = new FILE_LINE(0) pcap_block_store(pcap_block_store::plus2);
+			force_push = false;
+		}
+		// the only copy - straight from the kernel ring to the block store
+		if(insertVlan) {
+			memcpy(pcap_packet, packet.data, 2 * ETHER_ADDR_LEN);
+			*(u_int16_t*)(pcap_packet + 2 * ETHER_ADDR_LEN) = htons(packet.vlan_tpid);
+			*(u_int16_t*)(pcap_packet + 2 * ETHER_ADDR_LEN + 2) = htons(packet.vlan_tci);
+			memcpy(pcap_packet + 2 * ETHER_ADDR_LEN + 4, packet.data + 2 * ETHER_ADDR_LEN, packet.header.caplen - 2 * ETHER_ADDR_LEN - 4);
+		} else {
+			memcpy(pcap_packet, packet.data, packet.header.caplen);
+		}
+		if(this->check_protocol(&packet.header, pcap_packet,
+					opt_pcap_queue_use_blocks_read_check, &checkProtocolData) <= 0) {
+			continue;
+		}
+		sumPacketsSize[0] += packet.header.caplen;
+		pcap_header_plus2->clear();
+		if(opt_pcap_queue_use_blocks_read_check) {
+			pcap_header_plus2->detect_headers = 0x01;
+			pcap_header_plus2->header_ip_first_offset = checkProtocolData.header_ip_offset;
+			pcap_header_plus2->eth_protocol = checkProtocolData.protocol;
+			pcap_header_plus2->pid.vlan = checkProtocolData.vlan;
+			pcap_header_plus2->pid.flags = 0;
+		}
+		pcap_header_plus2->convertFromStdHeader(&packet.header);
+		pcap_header_plus2->header_ip_offset = 0;
+		pcap_header_plus2->dlink = pcapLinklayerHeaderType;
+		cPacketbufferShedding::cutRtpPayload(pcap_header_plus2, pcap_packet,
+						     opt_pcap_queue_use_blocks_read_check ? checkProtocolData.header_ip_offset : (u_int)-1,
+						     pcapLinklayerHeaderType);
+		(*block)->inc_h(pcap_header_plus2);
+	}
+	this->tpacketRing->releaseBlock();
+}
+
+void PcapQueue_readFromInterfaceThread::readBlock_generator(pcap_block_store **block) {
+	u_int64_t nowUS = getTimeUS();
+	pcap_pkthdr header;
+	pcap_pkthdr_plus2 *pcap_header_plus2 = NULL;
+	u_char *pcap_packet = NULL;
+	sCheckProtocolData checkProtocolData;
+	unsigned counter = 0;
+	while(counter < 10000) {
+		while(!*block ||
+		      !(*block)->get_add_hp_pointers(&pcap_header_plus2, &pcap_packet, this->pcap_snaplen)) {
+			if(*block) {
+				// like a full NIC ring - packets which can not be passed on are lost
+				if(this->can_push_block()) {
+					this->push_block(*block);
+				} else {
+					this->loadGenerator->addDrops((*block)->count);
+					delete *block;
+				}
+			}
+			*block = new FILE_LINE(0) pcap_block_store(pcap_block_store::plus2);
+			force_push = false;
+		}
+		if(!this->loadGenerator->nextPacket(nowUS, &header, pcap_packet, this->pcap_snaplen)) {
+			break;
+		}
+		++counter;
+		if(this->check_protocol(&header, pcap_packet,
+					opt_pcap_queue_use_blocks_read_check, &checkProtocolData) <= 0) {
+			continue;
+		}
+		sumPacketsSize[0] += header.caplen;
+		pcap_header_plus2->clear();
+		if(opt_pcap_queue_use_blocks_read_check) {
+			pcap_header_plus2->detect_headers = 0x01;
+			pcap_header_plus2->header_ip_first_offset = checkProtocolData.header_ip_offset;
+			pcap_header_plus2->eth_protocol = checkProtocolData.protocol;
+			pcap_header_plus2->pid.vlan = checkProtocolData.vlan;
+			pcap_header_plus2->pid.flags = 0;
+		}
+		pcap_header_plus2->convertFromStdHeader(&header);
+		pcap_header_plus2->header_ip_offset = 0;
+		pcap_header_plus2->dlink = pcapLinklayerHeaderType;
+		cPacketbufferShedding::cutRtpPayload(pcap_header_plus2, pcap_packet,
+						     opt_pcap_queue_use_blocks_read_check ? checkProtocolData.header_ip_offset : (u_int)-1,
+						     pcapLinklayerHeaderType);
+		(*block)->inc_h(pcap_header_plus2);
+	}
+	if(!counter) {
+		if(*block && (*block)->count && force_push) {
+			this->push_block(*block);
+			*block = NULL;
+			force_push = false;
+		}
+		USLEEP(100);
+	}
+}
+
 void PcapQueue_readFromInterfaceThread::processBlock(pcap_block_store *block) {
 	unsigned counter = 0;
 	int ppf = 0;
@@ -4867,9 +5774,31 @@ bool PcapQueue_readFromInterface::init() {
 	   !opt_pcap_queue_iface_separate_threads) {
 		return(true);
 	}
+	if(opt_load_generator) {
+		// synthetic traffic instead of interfaces - one generator in each read thread
+		for(int i = 0; i < max(opt_load_generator_threads, 1) && this->readThreadsCount < READ_THREADS_MAX - 1; i++) {
+			this->readThreads[this->readThreadsCount] = new FILE_LINE(0) PcapQueue_readFromInterfaceThread(("loadgen" + intToString(i + 1)).c_str(), PcapQueue_readFromInterfaceThread::read, NULL, NULL,
+																  0, 0, i);
+			++this->readThreadsCount;
+		}
+		return(this->readThreadsCount > 0);
+	}
 	vector<string> interfaces = split(this->interfaceName.c_str(), split(",|;| |\t|\r|\n", "|"), true);
 	for(size_t i = 0; i < interfaces.size(); i++) {
-		if(this->readThreadsCount < READ_THREADS_MAX - 1) {
+		if(opt_pcap_queue_iface_fanout > 1 && !opt_pb_read_from_file[0]) {
+			// more read threads in one PACKET_FANOUT_HASH group - the kernel keeps each flow on one socket
+			u_int16_t fanoutGroup = ((getpid() << 4) + i) & 0xFFFF;
+			if(!fanoutGroup) {
+				fanoutGroup = 1;
+			}
+			for(int j = 0; j < opt_pcap_queue_iface_fanout; j++) {
+				if(this->readThreadsCount < READ_THREADS_MAX - 1) {
+					this->readThreads[this->readThreadsCount] = new FILE_LINE(0) PcapQueue_readFromInterfaceThread(interfaces[i].c_str(), PcapQueue_readFromInterfaceThread::read, NULL, NULL,
+																		  fanoutGroup, j);
+					++this->readThreadsCount;
+				}
+			}
+		} else if(this->readThreadsCount < READ_THREADS_MAX - 1) {
 			this->readThreads[this->readThreadsCount] = new FILE_LINE(15047) PcapQueue_readFromInterfaceThread(interfaces[i].c_str());
 			++this->readThreadsCount;
 		}
@@ -4885,6 +5814,7 @@ bool PcapQueue_readFromInterface::initThread(void *arg, unsigned int arg2, strin
 
 void* PcapQueue_readFromInterface::threadFunction(void *arg, unsigned int arg2) {
 	this->mainThreadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	if(VERBOSE || DEBUG_VERBOSE) {
 		ostringstream outStr;
 		outStr << "start thread t0 (" << this->nameQueue << ") - pid: " << this->mainThreadId << endl;
@@ -5282,6 +6212,7 @@ void PcapQueue_readFromInterface::threadFunction_blocks() {
 
 void *PcapQueue_readFromInterface::writeThreadFunction(void *arg, unsigned int arg2) {
 	this->writeThreadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	if(VERBOSE || DEBUG_VERBOSE) {
 		ostringstream outStr;
 		outStr << "start thread t0 (" << this->nameQueue << " / write" << ") - pid: " << this->writeThreadId << endl;
@@ -5708,6 +6639,9 @@ void PcapQueue_readFromInterface::check_bypass_buffer() {
 }
 
 void PcapQueue_readFromInterface::push_blockstore(pcap_block_store **block_store) {
+	if((*block_store)->count) {
+		cLatencyStat::add(cLatencyStat::_ls_block, getTimeUS((*block_store)->get_header(0)->get_tv_sec(), (*block_store)->get_header(0)->get_tv_usec()));
+	}
 	if(!opt_pcap_queue_compress && this->instancePcapFifo && opt_pcap_queue_suppress_t1_thread) {
 		this->instancePcapFifo->addBlockStoreToPcapStoreQueue(*block_store);
 	} else if(this->block_qring) {
@@ -5757,8 +6691,22 @@ PcapQueue_readFromFifo::PcapQueue_readFromFifo(const char *nameQueue, const char
 	this->blockStoreTrash_sync = 0;
 	this->socketHostIP.clear();
 	this->socketHandle = 0;
+	for(int i = 0; i < PCAP_QUEUE_MIRROR_STRIPES_MAX - 1; i++) {
+		this->socketHandleStripes[i] = 0;
+	}
+	this->mirrorWindowSession = 0;
+	for(int i = 0; i < PCAP_QUEUE_MIRROR_STRIPES_MAX; i++) {
+		this->socketPeerZstd[i] = false;
+		this->socketPeerWindow[i] = false;
+		this->mirrorWindowLastAckMS[i] = 0;
+	}
+	this->_sync_mirrorWindowLastCounter = 0;
 	this->clientSocket = NULL;
+	this->clientSocketPeerZstd = false;
+	this->blockCompressPool = NULL;
+	this->blockUncompressPool = NULL;
 	this->_sync_packetServerConnections = 0;
+	this->packetServerIoThreadsTerminate = false;
 	this->lastCheckFreeSizeCachedir_timeMS = 0;
 	this->_last_ts.tv_sec = 0;
 	this->_last_ts.tv_usec = 0;
@@ -5771,6 +6719,7 @@ PcapQueue_readFromFifo::PcapQueue_readFromFifo(const char *nameQueue, const char
 
 PcapQueue_readFromFifo::~PcapQueue_readFromFifo() {
 	if(this->packetServerDirection == directionRead) {
+		this->stopIoThreads();
 		this->cleanupConnections(true);
 		syslog(LOG_NOTICE, "packetbuffer terminating (%s): cleanupConnections", nameQueue.c_str());
 	}
@@ -5789,6 +6738,10 @@ PcapQueue_readFromFifo::~PcapQueue_readFromFifo() {
 		}
 		syslog(LOG_NOTICE, "packetbuffer terminating (%s): socketClose", nameQueue.c_str());
 	}
+	for(unsigned i = 1; i < PCAP_QUEUE_MIRROR_STRIPES_MAX; i++) {
+		this->socketClose(i);
+	}
+	this->socketWindowClear();
 	if(this->destroyBlocksThreadHandle) {
 		pthread_join(this->destroyBlocksThreadHandle, NULL);
 	}
@@ -5801,6 +6754,12 @@ PcapQueue_readFromFifo::~PcapQueue_readFromFifo() {
 	if(this->clientSocket) {
 		delete this->clientSocket;
 	}
+	if(this->blockCompressPool) {
+		delete this->blockCompressPool;
+	}
+	if(this->blockUncompressPool) {
+		delete this->blockUncompressPool;
+	}
 	this->cleanupBlockStoreTrash(true);
 	syslog(LOG_NOTICE, "packetbuffer terminating (%s): cleanupBlockStoreTrash", nameQueue.c_str());
 }
@@ -5897,6 +6856,9 @@ bool PcapQueue_readFromFifo::createDestroyBlocksThread() {
 }
 
 bool PcapQueue_readFromFifo::createSocketServerThread() {
+	if(opt_pcap_queues_mirror_receiver_io_threads > 0) {
+		this->startIoThreads();
+	}
 	vm_pthread_create("pb - server",
 			  &this->socketServerThreadHandle, NULL, _PcapQueue_readFromFifo_socketServerThreadFunction, this, __FILE__, __LINE__);
 	return(true);
@@ -5913,6 +6875,7 @@ bool PcapQueue_readFromFifo::initThread(void *arg, unsigned int arg2, string *er
 
 void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 	int tid = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	if(this->packetServerDirection == directionRead && arg2) {
 		if(arg2 == (unsigned int)-1) {
 			this->nextThreadsId[socketServerThread - nextThread1] = tid;
@@ -5949,17 +6912,8 @@ void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 		return(NULL);
 	}
 	if(this->packetServerDirection == directionRead && arg2) {
-		pcap_block_store *blockStore = new FILE_LINE(15051) pcap_block_store;
-		size_t bufferSize = 1000;
-		u_char *buffer = new FILE_LINE(15052) u_char[bufferSize * 2];
-		size_t bufferLen;
-		size_t offsetBufferSyncRead;
-		size_t offsetBuffer;
 		size_t readLen;
-		bool syncBeginBlock = true;
 		bool forceStop = false;
-		unsigned countErrors = 0;
-		u_int64_t lastTimeErrorLogMS = 0;
 		while(!TERMINATING && !forceStop) {
 			if(arg2 == (unsigned int)-1) {
 				int socketClient;
@@ -5973,248 +6927,36 @@ void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 					}
 				}
 			} else {
-				int sensorId = 0;
-				string sensorName;
-				string sensorTime;
-				bool detectSensorName = false;
-				bool detectSensorTime = false;
-				bufferLen = 0;
-				offsetBufferSyncRead = 0;
-				int require_confirmation = -1;
+				sPacketServerConnection *connection = this->packetServerConnections[arg2];
 				unsigned counterEmptyData = 0;
 				while(!TERMINATING && !forceStop) {
-					readLen = bufferSize;
-					if(!this->socketRead(buffer + offsetBufferSyncRead, &readLen, arg2)) {
+					readLen = connection->bufferSize;
+					if(!this->socketRead(connection->buffer + connection->offsetBufferSyncRead, &readLen, arg2)) {
 						syslog(LOG_NOTICE, "close connection from %s:%i", 
-						       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-						       this->packetServerConnections[arg2]->socketClientPort.getPort());
-						this->packetServerConnections[arg2]->active = false;
+						       connection->socketClientIP.getString().c_str(), 
+						       connection->socketClientPort.getPort());
+						connection->active = false;
 						forceStop = true;
 						break;
 					}
-					if(!(opt_pcap_queue_store_queue_max_disk_size &&
-					     !opt_pcap_queue_disk_folder.empty())) {
-						double heapPerc = buffersControl.getPercUsePB();
-						if(heapPerc > 90) {
-							syslog(LOG_NOTICE, "enforce close connection (heap is almost full) from %s:%i", 
-							       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-							       this->packetServerConnections[arg2]->socketClientPort.getPort());
-							this->packetServerConnections[arg2]->active = false;
-							forceStop = true;
-							USLEEP(500000);
-							break;
-						} else if(heapPerc > 85) {
-							USLEEP(10000);
-						} else if(heapPerc > 80) {
-							USLEEP(1000);
-						}
+					if(!this->connectionCheckHeap(connection)) {
+						connection->active = false;
+						forceStop = true;
+						break;
 					}
 					if(readLen) {
 						counterEmptyData = 0;
-						bufferLen += readLen;
-						if(syncBeginBlock) {
-							if(!detectSensorName) {
-								char *pointToSensorIdName = (char*)memmem(buffer, bufferLen, "sensor_id_name: ", 16);
-								if(pointToSensorIdName) {
-									pointToSensorIdName += 16;
-									unsigned int offset = 0;
-									bool separator = 0;
-									bool nullTerm = false;
-									sensorName = "";
-									while((unsigned)(pointToSensorIdName - (char*)buffer + offset) < bufferLen &&
-									      (pointToSensorIdName[offset] == 0 ||
-									       (pointToSensorIdName[offset] >= ' ' && (unsigned char)pointToSensorIdName[offset] < 128))) {
-										if(pointToSensorIdName[offset] == 0) {
-											if(separator) {
-												nullTerm = true;
-											}
-											break;
-										}
-										if(offset == 0) {
-											sensorId = atoi(pointToSensorIdName + offset);
-										} else if(separator) {
-											sensorName = sensorName + pointToSensorIdName[offset];
-										} else if(pointToSensorIdName[offset] == ':') {
-											separator = true;
-										}
-										++offset;
-									}
-									if(sensorId > 0 && sensorName.length() && nullTerm) {
-										extern SensorsMap sensorsMap;
-										sensorsMap.setSensorName(sensorId, sensorName.c_str());
-										syslog(LOG_NOTICE, "detect sensor name: '%s' for sensor id: %i", sensorName.c_str(), sensorId);
-										detectSensorName = true;
-									}
-								}
-							}
-							if(!detectSensorTime) {
-								char *pointToSensorTime = (char*)memmem(buffer, bufferLen, "sensor_time: ", 13);
-								if(pointToSensorTime) {
-									pointToSensorTime += 13;
-									unsigned int offset = 0;
-									bool nullTerm = false;
-									while((unsigned)(pointToSensorTime - (char*)buffer + offset) < bufferLen &&
-									      (pointToSensorTime[offset] == 0 ||
-									       (pointToSensorTime[offset] >= ' ' && (unsigned char)pointToSensorTime[offset] < 128))) {
-										if(pointToSensorTime[offset] == 0) {
-											nullTerm = true;
-											break;
-										}
-										sensorTime = sensorTime + pointToSensorTime[offset];
-										++offset;
-									}
-									if(sensorTime.length() && nullTerm) {
-										syslog(LOG_NOTICE, "reported sensor time: %s for sensor id: %i", sensorTime.c_str(), sensorId);
-										time_t actualTimeSec = time(NULL);
-										time_t sensorTimeSec = stringToTime(sensorTime.c_str());
-										extern int opt_mirror_connect_maximum_time_diff_s;
-										int timeDiff = abs((int64_t)actualTimeSec - (int64_t)sensorTimeSec) % 3600;
-										if(timeDiff > opt_mirror_connect_maximum_time_diff_s) {
-											cLogSensor::log(cLogSensor::error, 
-													"sensor is not allowed to connect because of different time",
-													"Time difference between mirror receiver and sender (id_sensor:%i) is too big (%is). Please synchronise time on both mirror receiver and sender. Or increase configuration parameter mirror_connect_maximum_time_diff_s on mirror receiver.",
-													sensorId,
-													timeDiff);
-											string message = "bad time";
-											send(this->packetServerConnections[arg2]->socketClient, message.c_str(), message.length(), 0);	
-											this->packetServerConnections[arg2]->active = false;
-											forceStop = true;
-											break;
-										} else {
-											string message = "ok";
-											send(this->packetServerConnections[arg2]->socketClient, message.c_str(), message.length(), 0);
-										}
-										detectSensorTime = true;
-									}
-								}
-							}
-							u_char *pointToBeginBlock = (u_char*)memmem(buffer, bufferLen, PCAP_BLOCK_STORE_HEADER_STRING, PCAP_BLOCK_STORE_HEADER_STRING_LEN);
-							if(pointToBeginBlock) {
-								if(pointToBeginBlock > buffer) {
-									u_char *buffer2 = new FILE_LINE(15053) u_char[bufferSize * 2];
-									memcpy_heapsafe(buffer2, buffer2,
-											pointToBeginBlock, buffer,
-											bufferLen - (pointToBeginBlock - buffer),
-											__FILE__, __LINE__);
-									bufferLen -= (pointToBeginBlock - buffer);
-									delete [] buffer;
-									buffer = buffer2;
-								}
-								syncBeginBlock = false;
-								blockStore->destroyRestoreBuffer();
-								if(DEBUG_VERBOSE) {
-									cout << "SYNCED" << endl;
-								}
-								syslog(LOG_INFO, "synchronize ok in connection %s - %i",
-								       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-								       this->packetServerConnections[arg2]->socketClientPort.getPort());
-							} else {
-								if(offsetBufferSyncRead) {
-									u_char *buffer2 = new FILE_LINE(15054) u_char[bufferSize * 2];
-									memcpy_heapsafe(buffer2, buffer2,
-											buffer + offsetBufferSyncRead, buffer,
-											readLen,
-											__FILE__, __LINE__);
-									delete [] buffer;
-									buffer = buffer2;
-								}
-								offsetBufferSyncRead = readLen;
-								bufferLen = readLen;
-								continue;
-							}
-						}
-						offsetBuffer = 0;
-						while(offsetBuffer < bufferLen) {
-							string error;
-							int rsltAddRestoreChunk = blockStore->addRestoreChunk(buffer, bufferLen, &offsetBuffer, false, &error); 
-							if(rsltAddRestoreChunk > 0) {
-								string *check_headers_error = NULL;
-								if(!blockStore->check_offsets()) {
-									error = "bad offsets";
-								} else if(!blockStore->size_compress && !blockStore->check_headers(&check_headers_error)) {
-									error = "bad headers";
-									if(check_headers_error) {
-										error += " - " + *check_headers_error;
-										delete check_headers_error;
-									}
-								} else {
-									if(require_confirmation < 0) {
-										require_confirmation = blockStore->require_confirmation;
-									}
-									if(require_confirmation > 0 &&
-									   send(this->packetServerConnections[arg2]->socketClient, "block_ok", 8, 0) != 8) {
-										error = "send ok to sender failed";
-									} else {
-										if(this->packetServerConnections[arg2]->block_counter == blockStore->block_counter) {
-											blockStore->destroyRestoreBuffer();
-										} else {
-											if(this->packetServerConnections[arg2]->block_counter &&
-											   this->packetServerConnections[arg2]->block_counter + 1 != blockStore->block_counter) {
-												syslog(LOG_ERR, "loss packetbuffer block in conection %s - %i",
-												       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-												       this->packetServerConnections[arg2]->socketClientPort.getPort());
-											}
-											this->packetServerConnections[arg2]->block_counter = blockStore->block_counter;
-											blockStore->sensor_ip = this->packetServerConnections[arg2]->socketClientIP;
-											unsigned int usleepCounter = 0;
-											while(!this->pcapStoreQueue.push(blockStore, false)) {
-												if(TERMINATING || forceStop) {
-													break;
-												} else {
-													USLEEP_C(100, usleepCounter++);
-												}
-											}
-											sumPacketsCounterIn[0] += blockStore->count;
-											sumPacketsSize[0] += blockStore->size_packets ? blockStore->size_packets : blockStore->size;
-											sumPacketsSizeCompress[0] += blockStore->size_compress;
-											++sumBlocksCounterIn[0];
-											blockStore = new FILE_LINE(15055) pcap_block_store;
-										}
-									}
-								}
-							} else if(rsltAddRestoreChunk < 0) {
-								if(error.empty()) {
-									error = blockStore->addRestoreChunk_getErrorString(rsltAddRestoreChunk);
-								}
-							} else {
-								offsetBuffer = bufferLen;
-							}
-							if(!error.empty()) {
-								send(this->packetServerConnections[arg2]->socketClient, error.c_str(), error.length(), 0);
-								blockStore->destroyRestoreBuffer();
-								syncBeginBlock = true;
-								u_int64_t actTimeMS = getTimeMS();
-								if(!lastTimeErrorLogMS ||
-								   actTimeMS > lastTimeErrorLogMS + 1000) {
-									cLogSensor::log(cLogSensor::error, 
-											"error in receiving packets from mirror sender",
-											"connection from %s, error: %s", 
-											this->packetServerConnections[arg2]->socketClientIP.getString().c_str(),
-											error.c_str());
-									lastTimeErrorLogMS = actTimeMS;
-								}
-								++countErrors;
-								if(countErrors > 20) {
-									syslog(LOG_NOTICE, "enforce close connection (too errors) from %s:%i", 
-									       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-									       this->packetServerConnections[arg2]->socketClientPort.getPort());
-									this->packetServerConnections[arg2]->active = false;
-									forceStop = true;
-								}
-								break;
-							} else {
-								countErrors = 0;
-							}
+						if(!this->connectionProcessData(connection, readLen)) {
+							connection->active = false;
+							forceStop = true;
 						}
-						bufferLen = 0;
-						offsetBufferSyncRead = 0;
 					} else {
 						++counterEmptyData;
 						if(counterEmptyData > 300) {
 							syslog(LOG_NOTICE, "enforce close connection (too empty data) from %s:%i", 
-							       this->packetServerConnections[arg2]->socketClientIP.getString().c_str(), 
-							       this->packetServerConnections[arg2]->socketClientPort.getPort());
-							this->packetServerConnections[arg2]->active = false;
+							       connection->socketClientIP.getString().c_str(), 
+							       connection->socketClientPort.getPort());
+							connection->active = false;
 							forceStop = true;
 						} else {
 							USLEEP(100);
@@ -6223,8 +6965,8 @@ void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 				}
 			}
 		}
-		delete [] buffer;
-		delete blockStore;
+	} else if(opt_pcap_queue_compress && opt_pcap_queue_compress_threads > 0) {
+		this->compressBlocksByPool();
 	} else {
 		if(opt_pcap_queue_compress || !opt_pcap_queue_suppress_t1_thread) {
 			pcap_block_store *blockStore;
@@ -6261,6 +7003,7 @@ void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 
 void *PcapQueue_readFromFifo::writeThreadFunction(void *arg, unsigned int arg2) {
 	this->writeThreadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	if(VERBOSE || DEBUG_VERBOSE) {
 		ostringstream outStr;
 		outStr << "start thread t2 (" << this->nameQueue << " / write" << ") - pid: " << this->writeThreadId << endl;
@@ -6277,6 +7020,12 @@ void *PcapQueue_readFromFifo::writeThreadFunction(void *arg, unsigned int arg2)
 		vm_terminate_error("packetbuffer initializing failed");
 		return(NULL);
 	}
+	if(opt_pcap_queue_compress_threads > 0 && !this->isMirrorSender() &&
+	   (opt_pcap_queue_compress || this->isMirrorReceiver() || is_server())) {
+		this->blockUncompressPool = new FILE_LINE(0) pcap_block_store_compress_pool(pcap_block_store_compress_pool::_uncompress, 
+											    opt_pcap_queue_compress_threads);
+		this->blockUncompressPool->start();
+	}
 	pcap_block_store *blockStore;
 	// dequeu - method 1
 	map<pcap_block_store*, size_t> listBlockStore;
@@ -6298,7 +7047,11 @@ void *PcapQueue_readFromFifo::writeThreadFunction(void *arg, unsigned int arg2)
 		if(DEBUG_SLEEP && access((this->pcapStoreQueue.fileStoreFolder + "/__/sleep").c_str(), F_OK ) != -1) {
 			sleep(1);
 		}
-		this->pcapStoreQueue.pop(&blockStore);
+		if(this->blockUncompressPool) {
+			blockStore = this->popUncompressedBlock();
+		} else {
+			this->pcapStoreQueue.pop(&blockStore);
+		}
 		if(blockStore) {
 			if(opt_cachedir[0]) {
 				this->checkFreeSizeCachedir();
@@ -6740,6 +7493,30 @@ string PcapQueue_readFromFifo::getCpuUsage(bool writeThread, bool preparePstatDa
 	if(!writeThread && this->packetServerDirection == directionRead) {
 		bool empty = true;
 		ostringstream outStr;
+		if(this->packetServerIoThreads.size()) {
+			for(unsigned i = 0; i < this->packetServerIoThreads.size(); i++) {
+				sPacketServerIoThread *ioThread = this->packetServerIoThreads[i];
+				if(preparePstatData) {
+					if(ioThread->threadPstatData[0].cpu_total_time) {
+						ioThread->threadPstatData[1] = ioThread->threadPstatData[0];
+					}
+					pstat_get_data(ioThread->threadId, ioThread->threadPstatData);
+				}
+				if(ioThread->threadPstatData[0].cpu_total_time &&
+				   ioThread->threadPstatData[1].cpu_total_time) {
+					double ucpu_usage, scpu_usage;
+					pstat_calc_cpu_usage_pct(
+						&ioThread->threadPstatData[0], &ioThread->threadPstatData[1],
+						&ucpu_usage, &scpu_usage);
+					outStr << (empty ? "t1CPU[" : "/") << fixed << setprecision(1) << (ucpu_usage + scpu_usage) << "%";
+					empty = false;
+				}
+			}
+			if(!empty) {
+				outStr << "]";
+			}
+			return(outStr.str());
+		}
 		this->lock_packetServerConnections();
 		map<unsigned int, sPacketServerConnection*>::iterator iter;
 		for(iter = this->packetServerConnections.begin(); iter != this->packetServerConnections.end(); ++iter) {
@@ -6777,14 +7554,43 @@ string PcapQueue_readFromFifo::getCpuUsage(bool writeThread, bool preparePstatDa
 	return("");
 }
 
+string PcapQueue_readFromFifo::getCompressPoolStat(bool preparePstatData) {
+	ostringstream outStr;
+	if(this->blockCompressPool) {
+		outStr << "zipCPU[" << this->blockCompressPool->getStatString(preparePstatData) << "%]";
+	}
+	if(this->blockUncompressPool) {
+		if(outStr.tellp()) {
+			outStr << " ";
+		}
+		outStr << "unzipCPU[" << this->blockUncompressPool->getStatString(preparePstatData) << "%]";
+	}
+	return(outStr.str());
+}
+
 bool PcapQueue_readFromFifo::socketWritePcapBlock(pcap_block_store *blockStore) {
 	++block_counter;
 	if(is_client_packetbuffer_sender()) {
 		return(socketWritePcapBlockBySnifferClient(blockStore));
 	}
+	if(opt_pcap_queues_mirror_require_confirmation && opt_pcap_queues_mirror_window > 1) {
+		if(!this->socketHandle && !this->socketConnectWait()) {
+			return(false);
+		}
+		// the receiver without support of windowed confirmation gets blocks one by one
+		if(this->socketPeerWindow[0] || this->mirrorWindow.size()) {
+			return(this->socketWritePcapBlockWindow(blockStore));
+		}
+	}
 	bool rslt = false;
 	unsigned counterSleep = 0;
 	while(!TERMINATING) {
+		if(!this->socketHandle && !this->socketConnectWait()) {
+			break;
+		}
+		if(!this->socketPrepareBlockCompress(blockStore, this->socketPeerZstd[0])) {
+			break;
+		}
 		size_t sizeSaveBuffer = blockStore->getSizeSaveBuffer();
 		u_char *saveBuffer = blockStore->getSaveBuffer(block_counter);
 		if(!opt_pcap_queues_mirror_require_confirmation ||
@@ -6861,6 +7667,8 @@ bool PcapQueue_readFromFifo::socketWritePcapBlockBySnifferClient(pcap_block_stor
 			JsonItem jsonRsaKey;
 			jsonRsaKey.parse(rsltRsaKey);
 			string rsa_key = jsonRsaKey.getValue("rsa_key");
+			this->clientSocketPeerZstd = cZstdSipDictionary::getId() &&
+						     atoll(jsonRsaKey.getValue("zstd_dictionary_id").c_str()) == cZstdSipDictionary::getId();
 			this->clientSocket->set_rsa_pub_key(rsa_key);
 			this->clientSocket->generate_aes_keys();
 			JsonExport json_keys;
@@ -6894,6 +7702,9 @@ bool PcapQueue_readFromFifo::socketWritePcapBlockBySnifferClient(pcap_block_stor
 				continue;
 			}
 		}
+		if(!this->socketPrepareBlockCompress(blockStore, this->clientSocketPeerZstd)) {
+			break;
+		}
 		bool okSendBlock = true;
 		size_t sizeSaveBuffer = blockStore->getSizeSaveBuffer();
 		u_char *saveBuffer = blockStore->getSaveBuffer(block_counter);
@@ -6935,86 +7746,467 @@ bool PcapQueue_readFromFifo::socketWritePcapBlockBySnifferClient(pcap_block_stor
 	return(ok);
 }
 
-bool PcapQueue_readFromFifo::socketGetHost() {
-	this->socketHostIP.clear();
-	while(!this->socketHostIP.isSet()) {
-		this->socketHostIP = cResolver::resolve_n(this->packetServerIpPort.get_ip().c_str());
-		if(!this->socketHostIP.isSet()) {
-			syslog(LOG_ERR, "packetbuffer %s: cannot resolv: %s: host [%s] - trying again", this->nameQueue.c_str(), hstrerror(h_errno), this->packetServerIpPort.get_ip().c_str());  
-			sleep(1);
+bool PcapQueue_readFromFifo::socketWritePcapBlockWindow(pcap_block_store *blockStore) {
+	unsigned stripe = block_counter % this->getMirrorStripes();
+	// block is serialized for capabilities of receiver of its stripe
+	if(!*this->getSocketHandle(stripe) && !this->socketConnectWait(stripe)) {
+		return(false);
+	}
+	while(!TERMINATING) {
+		if(this->mirrorWindow.size() >= (unsigned)opt_pcap_queues_mirror_window) {
+			this->socketWindowReadAcks(true);
+			continue;
+		}
+		// the receiver of stripe without support of windowed confirmation gets blocks one by one
+		if(!this->socketPeerWindow[stripe]) {
+			bool existsUnconfirmed = false;
+			for(deque<sMirrorWindowItem>::iterator iter = this->mirrorWindow.begin(); iter != this->mirrorWindow.end(); iter++) {
+				if(iter->stripe == stripe) {
+					existsUnconfirmed = true;
+					break;
+				}
+			}
+			if(existsUnconfirmed) {
+				this->socketWindowReadAcks(true);
+				continue;
+			}
 		}
+		break;
 	}
-	if(DEBUG_VERBOSE) {
-		cout << "socketGetHost [" << this->packetServerIpPort.get_ip() << "] : OK" << endl;
+	if(TERMINATING) {
+		return(false);
+	}
+	if(!this->socketPrepareBlockCompress(blockStore, this->socketPeerZstd[stripe])) {
+		return(false);
+	}
+	sMirrorWindowItem item;
+	item.size = blockStore->getSizeSaveBuffer();
+	item.saveBuffer = blockStore->getSaveBuffer(block_counter);
+	item.counter = block_counter;
+	item.stripe = stripe;
+	item.sendTimeMS = 0;
+	if(buffersControl.getPercUsePB() > 70) {
+		((pcap_block_store::pcap_block_store_header*)item.saveBuffer)->time_s = 0;
 	}
+	this->mirrorWindow.push_back(item);
+	if(!this->socketWindowSend(&this->mirrorWindow.back())) {
+		this->socketWindowReconnect(item.stripe);
+	}
+	this->socketWindowReadAcks(false);
 	return(true);
 }
 
-bool PcapQueue_readFromFifo::socketReadyForConnect() {
-	return(true);
+bool PcapQueue_readFromFifo::socketWindowSend(sMirrorWindowItem *item) {
+	if(!*this->getSocketHandle(item->stripe)) {
+		return(false);
+	}
+	item->sendTimeMS = getTimeMS_rdtsc();
+	return(this->socketWrite(item->saveBuffer, item->size, true, item->stripe));
 }
 
-bool PcapQueue_readFromFifo::socketConnect() {
-	if(!this->socketHostIP.isSet()) {
-		this->socketGetHost();
-	}
-	if((this->socketHandle = socket_create(this->socketHostIP, SOCK_STREAM, IPPROTO_TCP)) == -1) {
-		syslog(LOG_ERR, "packetbuffer %s: cannot create socket - trying again", this->nameQueue.c_str());
-		return(false);
+void PcapQueue_readFromFifo::socketWindowPrepareResend(sMirrorWindowItem *item) {
+	// the stripe can be connected to other receiver (restarted or older) than the one the block was serialized for
+	pcap_block_store::pcap_block_store_header *header = (pcap_block_store::pcap_block_store_header*)item->saveBuffer;
+	if(!header->size_compress || header->version != PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD || this->socketPeerZstd[item->stripe]) {
+		return;
 	}
-	if(socket_connect(this->socketHandle, this->socketHostIP, this->packetServerIpPort.get_port()) == -1) {
-		syslog(LOG_ERR, "packetbuffer %s: failed to connect to server [%s] error:[%s] - trying again", this->nameQueue.c_str(), this->socketHostIP.getString().c_str(), strerror(errno));
-		this->socketClose();
-		return(false);
+	pcap_block_store *blockStore = new FILE_LINE(0) pcap_block_store;
+	bool ok = blockStore->addRestoreChunk(item->saveBuffer, item->size, NULL, true) == 1 &&
+		  this->socketPrepareBlockCompress(blockStore, false);
+	if(ok) {
+		delete [] item->saveBuffer;
+		item->size = blockStore->getSizeSaveBuffer();
+		item->saveBuffer = blockStore->getSaveBuffer(item->counter);
+	} else {
+		syslog(LOG_ERR, "packetbuffer %s: failed recompress zstd block for receiver of connection %u without zstd support", 
+		       this->nameQueue.c_str(), item->stripe);
 	}
-	int flag = 1;
-	setsockopt(this->socketHandle, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(int));
-	if(opt_pcap_queues_mirror_nonblock_mode) {
-		int flags = fcntl(this->socketHandle, F_GETFL, 0);
-		if(flags >= 0) {
-			fcntl(this->socketHandle, F_SETFL, flags | O_NONBLOCK);
+	delete blockStore;
+}
+
+bool PcapQueue_readFromFifo::socketWindowReconnect(unsigned stripe) {
+	bool connectionFailed = *this->getSocketHandle(stripe) != 0;
+	while(!TERMINATING) {
+		this->socketClose(stripe);
+		if(!this->socketConnectWait(stripe)) {
+			return(false);
 		}
+		this->mirrorWindowAckBuffer[stripe].clear();
+		// all unconfirmed blocks of the stripe are sent again in original order
+		unsigned countResend = 0;
+		bool okResend = true;
+		for(deque<sMirrorWindowItem>::iterator iter = this->mirrorWindow.begin(); iter != this->mirrorWindow.end(); iter++) {
+			if(iter->stripe == stripe) {
+				this->socketWindowPrepareResend(&(*iter));
+				((pcap_block_store::pcap_block_store_header*)iter->saveBuffer)->time_s = 0;
+				if(!this->socketWindowSend(&(*iter))) {
+					okResend = false;
+					break;
+				}
+				++countResend;
+			}
+		}
+		if(okResend) {
+			if(connectionFailed) {
+				syslog(LOG_NOTICE, "packetbuffer %s: connection %u restored - %u unconfirmed blocks sent again", 
+				       this->nameQueue.c_str(), stripe, countResend);
+			}
+			return(true);
+		}
+		connectionFailed = true;
 	}
-	if(DEBUG_VERBOSE) {
-		cout << this->nameQueue << " - socketConnect: " << this->packetServerIpPort.get_ip() << " : OK" << endl;
-	}
-	char dataSensorIdName[1024];
-	snprintf(dataSensorIdName, sizeof(dataSensorIdName), "sensor_id_name: %i:%s", opt_id_sensor, opt_name_sensor);
-	if(!socketWrite((u_char*)dataSensorIdName, strlen(dataSensorIdName) + 1, true)) {
-		syslog(LOG_ERR, "packetbuffer write sensor_id_name failed - trying again");
-		this->socketClose();
-		return(false);
+	return(false);
+}
+
+void PcapQueue_readFromFifo::socketWindowReadAcks(bool wait) {
+	unsigned stripes = this->getMirrorStripes();
+	pollfd fds[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	unsigned fdsStripe[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	unsigned countFds = 0;
+	for(unsigned i = 0; i < stripes; i++) {
+		int socketHandle = *this->getSocketHandle(i);
+		if(socketHandle) {
+			fds[countFds].fd = socketHandle;
+			fds[countFds].events = POLLIN;
+			fds[countFds].revents = 0;
+			fdsStripe[countFds] = i;
+			++countFds;
+		}
+	}
+	if(countFds && poll(fds, countFds, wait ? 100 : 0) > 0) {
+		for(unsigned i = 0; i < countFds; i++) {
+			if(!fds[i].revents) {
+				continue;
+			}
+			unsigned stripe = fdsStripe[i];
+			char recv_data[1000];
+			ssize_t recvLen = recv(fds[i].fd, recv_data, sizeof(recv_data), MSG_DONTWAIT);
+			if(recvLen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+				continue;
+			}
+			if(recvLen <= 0) {
+				syslog(LOG_ERR, "packetbuffer %s: connection %u closed by receiver - try send unconfirmed blocks again", 
+				       this->nameQueue.c_str(), stripe);
+				this->socketWindowReconnect(stripe);
+				continue;
+			}
+			this->mirrorWindowAckBuffer[stripe].append(recv_data, recvLen);
+			if(!this->socketWindowParseAcks(stripe)) {
+				this->socketWindowReconnect(stripe);
+			}
+		}
 	}
-	char dataTime[40];
-	snprintf(dataTime, sizeof(dataTime), "sensor_time: %s", sqlDateTimeString(time(NULL)).c_str());
-	if(!socketWrite((u_char*)dataTime, strlen(dataTime) + 1, true)) {
-		syslog(LOG_ERR, "packetbuffer write sensor_time failed - trying again");
-		this->socketClose();
-		return(false);
+	if(wait && this->mirrorWindow.size()) {
+		sMirrorWindowItem *oldest = &this->mirrorWindow.front();
+		u_int64_t lastActivityMS = max(oldest->sendTimeMS, this->mirrorWindowLastAckMS[oldest->stripe]);
+		if(getTimeMS_rdtsc() > lastActivityMS + PCAP_QUEUE_MIRROR_WINDOW_ACK_TIMEOUT_MS) {
+			syslog(LOG_ERR, "packetbuffer %s: no response from receiver in connection %u - try send unconfirmed blocks again", 
+			       this->nameQueue.c_str(), oldest->stripe);
+			this->socketWindowReconnect(oldest->stripe);
+		}
 	}
-	char recv_data[100] = "";
-	size_t recv_data_len = sizeof(recv_data);
-	bool rsltRead = this->_socketRead(this->socketHandle, (u_char*)recv_data, &recv_data_len, 4);
-	if(rsltRead) {
-		if(recv_data_len > 0 &&
-		   memmem(recv_data, recv_data_len,  "bad time", 8)) {
-			syslog(LOG_ERR, "different time between receiver and sender - trying again");
-			this->socketClose();
+}
+
+bool PcapQueue_readFromFifo::socketWindowParseAcks(unsigned stripe) {
+	string *buffer = &this->mirrorWindowAckBuffer[stripe];
+	while(buffer->length()) {
+		if(!buffer->compare(0, 10, "block_ack:")) {
+			size_t posEnd = buffer->find(';');
+			if(posEnd == string::npos) {
+				break;
+			}
+			this->socketWindowAck(stripe, strtoul(buffer->c_str() + 10, NULL, 10));
+			buffer->erase(0, posEnd + 1);
+		} else if(!buffer->compare(0, 8, "block_ok")) {
+			// receiver confirming blocks one by one
+			this->socketWindowAck(stripe, 0, true);
+			buffer->erase(0, 8);
+		} else if(!strncmp("block_ack:", buffer->c_str(), buffer->length()) ||
+			  !strncmp("block_ok", buffer->c_str(), buffer->length())) {
+			break;
+		} else {
+			syslog(LOG_ERR, "packetbuffer %s: response from receiver in connection %u: %s - try send unconfirmed blocks again", 
+			       this->nameQueue.c_str(), stripe, buffer->substr(0, 100).c_str());
+			buffer->clear();
 			return(false);
 		}
-	} else {
-		this->socketClose();
-		return(false);
 	}
 	return(true);
 }
 
-bool PcapQueue_readFromFifo::socketListen() {
-	if((this->socketHandle = socket_create(str_2_vmIP(this->packetServerIpPort.get_ip().c_str()), SOCK_STREAM, IPPROTO_TCP)) == -1) {
-		syslog(LOG_NOTICE, "packetbuffer %s: cannot create socket", this->nameQueue.c_str());
-		return(false);
+void PcapQueue_readFromFifo::socketWindowAck(unsigned stripe, u_int32_t counter, bool oldest) {
+	// confirmation is cumulative - it confirms all previous blocks sent in the stripe
+	for(deque<sMirrorWindowItem>::iterator iter = this->mirrorWindow.begin(); iter != this->mirrorWindow.end(); ) {
+		if(iter->stripe == stripe && (oldest || iter->counter <= counter)) {
+			delete [] iter->saveBuffer;
+			iter = this->mirrorWindow.erase(iter);
+			if(oldest) {
+				break;
+			}
+		} else {
+			iter++;
+		}
 	}
-	if(opt_pcap_queues_mirror_nonblock_mode) {
+	this->mirrorWindowLastAckMS[stripe] = getTimeMS_rdtsc();
+}
+
+void PcapQueue_readFromFifo::socketWindowClear() {
+	for(deque<sMirrorWindowItem>::iterator iter = this->mirrorWindow.begin(); iter != this->mirrorWindow.end(); iter++) {
+		delete [] iter->saveBuffer;
+	}
+	this->mirrorWindow.clear();
+}
+
+bool PcapQueue_readFromFifo::mirrorWindowIsDuplicate(const string &key, u_int32_t counter) {
+	bool rslt = false;
+	while(__sync_lock_test_and_set(&this->_sync_mirrorWindowLastCounter, 1));
+	map<string, sMirrorWindowCounter>::iterator iter = this->mirrorWindowLastCounter.find(key);
+	if(iter != this->mirrorWindowLastCounter.end() && counter <= iter->second.counter) {
+		rslt = true;
+	}
+	__sync_lock_release(&this->_sync_mirrorWindowLastCounter);
+	return(rslt);
+}
+
+void PcapQueue_readFromFifo::mirrorWindowSetCounter(const string &key, u_int32_t counter) {
+	while(__sync_lock_test_and_set(&this->_sync_mirrorWindowLastCounter, 1));
+	this->mirrorWindowLastCounter[key].counter = counter;
+	__sync_lock_release(&this->_sync_mirrorWindowLastCounter);
+}
+
+void PcapQueue_readFromFifo::mirrorWindowConnectionOpen(const string &key) {
+	while(__sync_lock_test_and_set(&this->_sync_mirrorWindowLastCounter, 1));
+	map<string, sMirrorWindowCounter>::iterator iter = this->mirrorWindowLastCounter.find(key);
+	if(iter != this->mirrorWindowLastCounter.end()) {
+		iter->second.closeTimeMS = 0;
+	}
+	__sync_lock_release(&this->_sync_mirrorWindowLastCounter);
+}
+
+void PcapQueue_readFromFifo::mirrorWindowConnectionClose(const string &key) {
+	u_int64_t actTimeMS = getTimeMS_rdtsc();
+	while(__sync_lock_test_and_set(&this->_sync_mirrorWindowLastCounter, 1));
+	map<string, sMirrorWindowCounter>::iterator iter = this->mirrorWindowLastCounter.find(key);
+	if(iter != this->mirrorWindowLastCounter.end()) {
+		iter->second.closeTimeMS = actTimeMS;
+	}
+	// keys of closed connections are kept for a while - the sender reconnects and sends unconfirmed blocks again
+	for(iter = this->mirrorWindowLastCounter.begin(); iter != this->mirrorWindowLastCounter.end(); ) {
+		if(iter->second.closeTimeMS &&
+		   iter->second.closeTimeMS + PCAP_QUEUE_MIRROR_WINDOW_CLOSED_KEEP_MS < actTimeMS) {
+			this->mirrorWindowLastCounter.erase(iter++);
+		} else {
+			++iter;
+		}
+	}
+	__sync_lock_release(&this->_sync_mirrorWindowLastCounter);
+}
+
+unsigned PcapQueue_readFromFifo::getMirrorStripes() {
+	return(min(max(opt_pcap_queues_mirror_stripes, 1), PCAP_QUEUE_MIRROR_STRIPES_MAX));
+}
+
+void PcapQueue_readFromFifo::compressBlocksByPool() {
+	this->blockCompressPool = new FILE_LINE(0) pcap_block_store_compress_pool(pcap_block_store_compress_pool::_compress, 
+										  opt_pcap_queue_compress_threads);
+	this->blockCompressPool->start();
+	pcap_block_store *blockStoreOut = NULL;
+	unsigned int usleepCounter = 0;
+	while(!TERMINATING) {
+		bool activity = false;
+		if(!blockStoreOut) {
+			bool ok;
+			// failed compression leaves the block uncompressed
+			blockStoreOut = this->blockCompressPool->pop(&ok);
+		}
+		if(blockStoreOut) {
+			size_t blockSize = blockStoreOut->size;
+			size_t blockSizePackets = blockStoreOut->size_packets;
+			if(this->pcapStoreQueue.push(blockStoreOut, false)) {
+				sumPacketsSize[0] += blockSizePackets ? blockSizePackets : blockSize;
+				blockStoreOut = NULL;
+				activity = true;
+			}
+		}
+		if(!this->blockCompressPool->isFull()) {
+			pcap_block_store *blockStoreIn = blockStoreBypassQueue->pop(false);
+			if(blockStoreIn) {
+				size_t blockSize = blockStoreIn->size;
+				this->blockCompressPool->push(blockStoreIn);
+				blockStoreBypassQueue->pop(true, blockSize);
+				activity = true;
+			}
+		}
+		if(activity) {
+			usleepCounter = 0;
+		} else {
+			USLEEP_C(100, usleepCounter++);
+		}
+	}
+	this->blockCompressPool->stop();
+	if(blockStoreOut) {
+		delete blockStoreOut;
+	}
+}
+
+pcap_block_store *PcapQueue_readFromFifo::popUncompressedBlock() {
+	while(!this->blockUncompressPool->isFull()) {
+		pcap_block_store *blockStoreIn;
+		this->pcapStoreQueue.pop(&blockStoreIn);
+		if(!blockStoreIn) {
+			break;
+		}
+		this->blockUncompressPool->push(blockStoreIn);
+	}
+	bool ok;
+	pcap_block_store *blockStore = this->blockUncompressPool->pop(&ok);
+	if(blockStore && !ok) {
+		delete blockStore;
+		blockStore = NULL;
+	}
+	return(blockStore);
+}
+
+bool PcapQueue_readFromFifo::socketPrepareBlockCompress(pcap_block_store *blockStore, bool peerZstd) {
+	// the peer without the same zstd dictionary gets the block compressed by snappy
+	if(blockStore->size_compress && blockStore->method_compress == pcap_block_store::zstd && !peerZstd) {
+		if(!blockStore->uncompress()) {
+			syslog(LOG_ERR, "packetbuffer %s: failed uncompress zstd block for peer without zstd support - block dropped", this->nameQueue.c_str());
+			return(false);
+		}
+		blockStore->compress_snappy();
+	}
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::socketGetHost() {
+	this->socketHostIP.clear();
+	while(!this->socketHostIP.isSet()) {
+		this->socketHostIP = cResolver::resolve_n(this->packetServerIpPort.get_ip().c_str());
+		if(!this->socketHostIP.isSet()) {
+			syslog(LOG_ERR, "packetbuffer %s: cannot resolv: %s: host [%s] - trying again", this->nameQueue.c_str(), hstrerror(h_errno), this->packetServerIpPort.get_ip().c_str());  
+			sleep(1);
+		}
+	}
+	if(DEBUG_VERBOSE) {
+		cout << "socketGetHost [" << this->packetServerIpPort.get_ip() << "] : OK" << endl;
+	}
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::socketReadyForConnect() {
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::socketConnect(unsigned stripe) {
+	if(!this->socketHostIP.isSet()) {
+		this->socketGetHost();
+	}
+	int *socketHandle = this->getSocketHandle(stripe);
+	if((*socketHandle = socket_create(this->socketHostIP, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+		*socketHandle = 0;
+		syslog(LOG_ERR, "packetbuffer %s: cannot create socket - trying again", this->nameQueue.c_str());
+		return(false);
+	}
+	if(socket_connect(*socketHandle, this->socketHostIP, this->packetServerIpPort.get_port()) == -1) {
+		syslog(LOG_ERR, "packetbuffer %s: failed to connect to server [%s] error:[%s] - trying again", this->nameQueue.c_str(), this->socketHostIP.getString().c_str(), strerror(errno));
+		this->socketClose(stripe);
+		return(false);
+	}
+	int flag = 1;
+	setsockopt(*socketHandle, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(int));
+	if(opt_pcap_queues_mirror_nonblock_mode) {
+		int flags = fcntl(*socketHandle, F_GETFL, 0);
+		if(flags >= 0) {
+			fcntl(*socketHandle, F_SETFL, flags | O_NONBLOCK);
+		}
+	}
+	if(DEBUG_VERBOSE) {
+		cout << this->nameQueue << " - socketConnect: " << this->packetServerIpPort.get_ip() << " : OK" << endl;
+	}
+	char dataSensorIdName[1024];
+	snprintf(dataSensorIdName, sizeof(dataSensorIdName), "sensor_id_name: %i:%s", opt_id_sensor, opt_name_sensor);
+	if(!socketWrite((u_char*)dataSensorIdName, strlen(dataSensorIdName) + 1, true, stripe)) {
+		syslog(LOG_ERR, "packetbuffer write sensor_id_name failed - trying again");
+		this->socketClose(stripe);
+		return(false);
+	}
+	this->socketPeerZstd[stripe] = false;
+	if(opt_pcap_queue_compress_method == pcap_block_store::zstd && cZstdSipDictionary::getId()) {
+		char dataCompress[100];
+		snprintf(dataCompress, sizeof(dataCompress), "sensor_compress: zstd:%u", cZstdSipDictionary::getId());
+		if(!socketWrite((u_char*)dataCompress, strlen(dataCompress) + 1, true, stripe)) {
+			syslog(LOG_ERR, "packetbuffer write sensor_compress failed - trying again");
+			this->socketClose(stripe);
+			return(false);
+		}
+	}
+	this->socketPeerWindow[stripe] = false;
+	if(opt_pcap_queues_mirror_require_confirmation && opt_pcap_queues_mirror_window > 1) {
+		if(!this->mirrorWindowSession) {
+			this->mirrorWindowSession = max((u_int32_t)(getTimeUS() ^ getpid()), (u_int32_t)1);
+		}
+		char dataWindow[100];
+		snprintf(dataWindow, sizeof(dataWindow), "sensor_window: %u:%u:%u", opt_pcap_queues_mirror_window, this->mirrorWindowSession, stripe);
+		if(!socketWrite((u_char*)dataWindow, strlen(dataWindow) + 1, true, stripe)) {
+			syslog(LOG_ERR, "packetbuffer write sensor_window failed - trying again");
+			this->socketClose(stripe);
+			return(false);
+		}
+	}
+	char dataTime[40];
+	snprintf(dataTime, sizeof(dataTime), "sensor_time: %s", sqlDateTimeString(time(NULL)).c_str());
+	if(!socketWrite((u_char*)dataTime, strlen(dataTime) + 1, true, stripe)) {
+		syslog(LOG_ERR, "packetbuffer write sensor_time failed - trying again");
+		this->socketClose(stripe);
+		return(false);
+	}
+	char recv_data[100] = "";
+	size_t recv_data_len = sizeof(recv_data);
+	bool rsltRead = this->_socketRead(*socketHandle, (u_char*)recv_data, &recv_data_len, 4);
+	if(rsltRead) {
+		if(recv_data_len > 0 &&
+		   memmem(recv_data, recv_data_len,  "bad time", 8)) {
+			syslog(LOG_ERR, "different time between receiver and sender - trying again");
+			this->socketClose(stripe);
+			return(false);
+		}
+		this->socketPeerZstd[stripe] = recv_data_len > 0 &&
+					       memmem(recv_data, recv_data_len,  "ok zstd", 7);
+		if(opt_pcap_queue_compress_method == pcap_block_store::zstd && !this->socketPeerZstd[stripe]) {
+			syslog(LOG_NOTICE, "packetbuffer %s: receiver of connection %u does not support zstd dictionary - fallback to snappy", this->nameQueue.c_str(), stripe);
+		}
+		this->socketPeerWindow[stripe] = recv_data_len > 0 &&
+						 memmem(recv_data, recv_data_len,  "window", 6);
+		if(opt_pcap_queues_mirror_require_confirmation && opt_pcap_queues_mirror_window > 1 && !this->socketPeerWindow[stripe]) {
+			syslog(LOG_NOTICE, "packetbuffer %s: receiver of connection %u does not support windowed confirmation - blocks are confirmed one by one", this->nameQueue.c_str(), stripe);
+		}
+	} else {
+		this->socketClose(stripe);
+		return(false);
+	}
+	this->mirrorWindowLastAckMS[stripe] = getTimeMS_rdtsc();
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::socketConnectWait(unsigned stripe) {
+	while(!this->socketConnect(stripe)) {
+		for(int i = 0; i < 20; i++) {
+			USLEEP(100000);
+			if(TERMINATING) {
+				return(false);
+			}
+		}
+	}
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::socketListen() {
+	if((this->socketHandle = socket_create(str_2_vmIP(this->packetServerIpPort.get_ip().c_str()), SOCK_STREAM, IPPROTO_TCP)) == -1) {
+		syslog(LOG_NOTICE, "packetbuffer %s: cannot create socket", this->nameQueue.c_str());
+		return(false);
+	}
+	if(opt_pcap_queues_mirror_nonblock_mode) {
 		int flags = fcntl(this->socketHandle, F_GETFL, 0);
 		if(flags >= 0) {
 			fcntl(this->socketHandle, F_SETFL, flags | O_NONBLOCK);
@@ -7078,38 +8270,30 @@ bool PcapQueue_readFromFifo::socketAwaitConnection(int *socketClient, vmIP *sock
 	return(*socketClient >= 0);
 }
 
-bool PcapQueue_readFromFifo::socketClose() {
-	if(this->socketHandle) {
-		close(this->socketHandle);
-		this->socketHandle = 0;
+bool PcapQueue_readFromFifo::socketClose(unsigned stripe) {
+	int *socketHandle = this->getSocketHandle(stripe);
+	if(*socketHandle) {
+		close(*socketHandle);
+		*socketHandle = 0;
 	}
 	return(true);
 }
 
-bool PcapQueue_readFromFifo::socketWrite(u_char *data, size_t dataLen, bool disableAutoConnect) {
-	if(!this->socketHandle && !disableAutoConnect) {
-		while(!this->socketConnect()) {
-			for(int i = 0; i < 20; i++) {
-				USLEEP(100000);
-				if(TERMINATING) {
-					return(false);
-				}
-			}
+bool PcapQueue_readFromFifo::socketWrite(u_char *data, size_t dataLen, bool disableAutoConnect, unsigned stripe) {
+	int *socketHandle = this->getSocketHandle(stripe);
+	if(!*socketHandle && !disableAutoConnect) {
+		if(!this->socketConnectWait(stripe)) {
+			return(false);
 		}
 	}
 	size_t dataLenWrited = 0;
 	while(dataLenWrited < dataLen && !TERMINATING) {
 		size_t _dataLenWrited = dataLen - dataLenWrited;
-		if(!this->_socketWrite(this->socketHandle, data + dataLenWrited, &_dataLenWrited)) {
+		if(!this->_socketWrite(*socketHandle, data + dataLenWrited, &_dataLenWrited)) {
 			if(!disableAutoConnect) {
-				this->socketClose();
-				while(!this->socketConnect()) {
-					for(int i = 0; i < 20; i++) {
-						USLEEP(100000);
-						if(TERMINATING) {
-							return(false);
-						}
-					}
+				this->socketClose(stripe);
+				if(!this->socketConnectWait(stripe)) {
+					return(false);
 				}
 			} else {
 				return(false);
@@ -7236,6 +8420,42 @@ void PcapQueue_readFromFifo::createConnection(int socketClient, vmIP socketClien
 	connection->active = true;
 	this->packetServerConnections[id] = connection;
 	this->unlock_packetServerConnections();
+	if(this->packetServerIoThreads.size()) {
+		sPacketServerIoThread *ioThread = NULL;
+		size_t ioThreadConnections = 0;
+		for(unsigned i = 0; i < this->packetServerIoThreads.size(); i++) {
+			this->packetServerIoThreads[i]->lock_connections();
+			size_t connections = this->packetServerIoThreads[i]->connections.size();
+			this->packetServerIoThreads[i]->unlock_connections();
+			if(!ioThread || connections < ioThreadConnections) {
+				ioThread = this->packetServerIoThreads[i];
+				ioThreadConnections = connections;
+			}
+		}
+		int flags = fcntl(socketClient, F_GETFL, 0);
+		if(flags >= 0) {
+			fcntl(socketClient, F_SETFL, flags | O_NONBLOCK);
+		}
+		connection->ioThread = ioThread->index;
+		connection->lastReadTimeMS = getTimeMS_rdtsc();
+		ioThread->lock_connections();
+		ioThread->connections.insert(connection);
+		ioThread->unlock_connections();
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = connection;
+		connection->epollEvents = event.events;
+		if(epoll_ctl(ioThread->epollFd, EPOLL_CTL_ADD, socketClient, &event) < 0) {
+			syslog(LOG_ERR, "packetbuffer %s: epoll_ctl for connection from %s failed: %s", 
+			       this->nameQueue.c_str(), socketClientIP.getString().c_str(), strerror(errno));
+			ioThread->lock_connections();
+			ioThread->connections.erase(connection);
+			ioThread->unlock_connections();
+			connection->active = false;
+		}
+		return;
+	}
 	vm_pthread_create_autodestroy(("pb - client " + connection->socketClientIP.getString()).c_str(), 
 				      &connection->threadHandle, NULL, _PcapQueue_readFromFifo_connectionThreadFunction, connection, __FILE__, __LINE__);
 }
@@ -7252,6 +8472,9 @@ void PcapQueue_readFromFifo::cleanupConnections(bool all) {
 			iter->second->active = false;
 		}
 		if(!iter->second->active) {
+			if(iter->second->mirrorWindow) {
+				this->mirrorWindowConnectionClose(iter->second->mirrorWindowKey);
+			}
 			delete iter->second; 
 			this->packetServerConnections.erase(iter++);
 		} else {
@@ -7261,6 +8484,499 @@ void PcapQueue_readFromFifo::cleanupConnections(bool all) {
 	this->unlock_packetServerConnections();
 }
 
+bool PcapQueue_readFromFifo::connectionProcessData(sPacketServerConnection *connection, size_t readLen) {
+	size_t offsetBuffer;
+	bool forceStop = false;
+	connection->bufferLen += readLen;
+	if(connection->syncBeginBlock) {
+		if(!connection->detectSensorName) {
+			char *pointToSensorIdName = (char*)memmem(connection->buffer, connection->bufferLen, "sensor_id_name: ", 16);
+			if(pointToSensorIdName) {
+				pointToSensorIdName += 16;
+				unsigned int offset = 0;
+				bool separator = 0;
+				bool nullTerm = false;
+				connection->sensorName = "";
+				while((unsigned)(pointToSensorIdName - (char*)connection->buffer + offset) < connection->bufferLen &&
+				      (pointToSensorIdName[offset] == 0 ||
+				       (pointToSensorIdName[offset] >= ' ' && (unsigned char)pointToSensorIdName[offset] < 128))) {
+					if(pointToSensorIdName[offset] == 0) {
+						if(separator) {
+							nullTerm = true;
+						}
+						break;
+					}
+					if(offset == 0) {
+						connection->sensorId = atoi(pointToSensorIdName + offset);
+					} else if(separator) {
+						connection->sensorName = connection->sensorName + pointToSensorIdName[offset];
+					} else if(pointToSensorIdName[offset] == ':') {
+						separator = true;
+					}
+					++offset;
+				}
+				if(connection->sensorId > 0 && connection->sensorName.length() && nullTerm) {
+					extern SensorsMap sensorsMap;
+					sensorsMap.setSensorName(connection->sensorId, connection->sensorName.c_str());
+					syslog(LOG_NOTICE, "detect sensor name: '%s' for sensor id: %i", connection->sensorName.c_str(), connection->sensorId);
+					connection->detectSensorName = true;
+				}
+			}
+		}
+		if(!connection->detectSensorTime) {
+			char *pointToSensorTime = (char*)memmem(connection->buffer, connection->bufferLen, "sensor_time: ", 13);
+			if(pointToSensorTime) {
+				pointToSensorTime += 13;
+				unsigned int offset = 0;
+				bool nullTerm = false;
+				while((unsigned)(pointToSensorTime - (char*)connection->buffer + offset) < connection->bufferLen &&
+				      (pointToSensorTime[offset] == 0 ||
+				       (pointToSensorTime[offset] >= ' ' && (unsigned char)pointToSensorTime[offset] < 128))) {
+					if(pointToSensorTime[offset] == 0) {
+						nullTerm = true;
+						break;
+					}
+					connection->sensorTime = connection->sensorTime + pointToSensorTime[offset];
+					++offset;
+				}
+				if(connection->sensorTime.length() && nullTerm) {
+					syslog(LOG_NOTICE, "reported sensor time: %s for sensor id: %i", connection->sensorTime.c_str(), connection->sensorId);
+					time_t actualTimeSec = time(NULL);
+					time_t sensorTimeSec = stringToTime(connection->sensorTime.c_str());
+					extern int opt_mirror_connect_maximum_time_diff_s;
+					int timeDiff = abs((int64_t)actualTimeSec - (int64_t)sensorTimeSec) % 3600;
+					if(timeDiff > opt_mirror_connect_maximum_time_diff_s) {
+						cLogSensor::log(cLogSensor::error, 
+								"sensor is not allowed to connect because of different time",
+								"Time difference between mirror receiver and sender (id_sensor:%i) is too big (%is). Please synchronise time on both mirror receiver and sender. Or increase configuration parameter mirror_connect_maximum_time_diff_s on mirror receiver.",
+								connection->sensorId,
+								timeDiff);
+						string message = "bad time";
+						this->connectionSend(connection, message.c_str(), message.length());
+						return(false);
+					} else {
+						string message = "ok";
+						char *pointToSensorCompress = (char*)memmem(connection->buffer, connection->bufferLen, "sensor_compress: zstd:", 22);
+						if(pointToSensorCompress &&
+						   memchr(pointToSensorCompress, 0, connection->bufferLen - (pointToSensorCompress - (char*)connection->buffer))) {
+							u_int32_t sensorDictionaryId = strtoul(pointToSensorCompress + 22, NULL, 10);
+							if(sensorDictionaryId && sensorDictionaryId == cZstdSipDictionary::getId()) {
+								message = "ok zstd";
+							} else {
+								syslog(LOG_NOTICE, "sensor id: %i uses zstd dictionary %u unknown in receiver - fallback to snappy", 
+								       connection->sensorId, sensorDictionaryId);
+							}
+						}
+						char *pointToSensorWindow = (char*)memmem(connection->buffer, connection->bufferLen, "sensor_window: ", 15);
+						if(pointToSensorWindow &&
+						   memchr(pointToSensorWindow, 0, connection->bufferLen - (pointToSensorWindow - (char*)connection->buffer))) {
+							unsigned sensorWindow = 0, sensorWindowSession = 0, sensorWindowStripe = 0;
+							if(sscanf(pointToSensorWindow + 15, "%u:%u:%u", &sensorWindow, &sensorWindowSession, &sensorWindowStripe) == 3) {
+								connection->mirrorWindow = true;
+								connection->mirrorWindowKey = connection->socketClientIP.getString() + "/" +
+										  intToString(sensorWindowSession) + "/" + intToString(sensorWindowStripe);
+								this->mirrorWindowConnectionOpen(connection->mirrorWindowKey);
+								message += " window";
+							}
+						}
+						this->connectionSend(connection, message.c_str(), message.length());
+					}
+					connection->detectSensorTime = true;
+				}
+			}
+		}
+		u_char *pointToBeginBlock = (u_char*)memmem(connection->buffer, connection->bufferLen, PCAP_BLOCK_STORE_HEADER_STRING, PCAP_BLOCK_STORE_HEADER_STRING_LEN);
+		if(pointToBeginBlock) {
+			if(pointToBeginBlock > connection->buffer) {
+				u_char *buffer2 = new FILE_LINE(15053) u_char[connection->bufferSize * 2];
+				memcpy_heapsafe(buffer2, buffer2,
+						pointToBeginBlock, connection->buffer,
+						connection->bufferLen - (pointToBeginBlock - connection->buffer),
+						__FILE__, __LINE__);
+				connection->bufferLen -= (pointToBeginBlock - connection->buffer);
+				delete [] connection->buffer;
+				connection->buffer = buffer2;
+			}
+			connection->syncBeginBlock = false;
+			connection->blockStore->destroyRestoreBuffer();
+			if(DEBUG_VERBOSE) {
+				cout << "SYNCED" << endl;
+			}
+			syslog(LOG_INFO, "synchronize ok in connection %s - %i",
+			       connection->socketClientIP.getString().c_str(), 
+			       connection->socketClientPort.getPort());
+		} else {
+			if(connection->offsetBufferSyncRead) {
+				u_char *buffer2 = new FILE_LINE(15054) u_char[connection->bufferSize * 2];
+				memcpy_heapsafe(buffer2, buffer2,
+						connection->buffer + connection->offsetBufferSyncRead, connection->buffer,
+						readLen,
+						__FILE__, __LINE__);
+				delete [] connection->buffer;
+				connection->buffer = buffer2;
+			}
+			connection->offsetBufferSyncRead = readLen;
+			connection->bufferLen = readLen;
+			return(true);
+		}
+	}
+	offsetBuffer = 0;
+	while(offsetBuffer < connection->bufferLen) {
+		string error;
+		int rsltAddRestoreChunk = connection->blockStore->addRestoreChunk(connection->buffer, connection->bufferLen, &offsetBuffer, false, &error); 
+		if(rsltAddRestoreChunk > 0) {
+			string *check_headers_error = NULL;
+			if(!connection->blockStore->check_offsets()) {
+				error = "bad offsets";
+			} else if(!connection->blockStore->size_compress && !connection->blockStore->check_headers(&check_headers_error)) {
+				error = "bad headers";
+				if(check_headers_error) {
+					error += " - " + *check_headers_error;
+					delete check_headers_error;
+				}
+			} else {
+				if(connection->require_confirmation < 0) {
+					connection->require_confirmation = connection->blockStore->require_confirmation;
+				}
+				if(!connection->mirrorWindow && connection->require_confirmation > 0 &&
+				   !this->connectionSend(connection, "block_ok", 8)) {
+					error = "send ok to sender failed";
+				} else {
+					u_int32_t block_counter = connection->blockStore->block_counter;
+					bool confirm = connection->mirrorWindow;
+					if(connection->mirrorWindow ?
+					    this->mirrorWindowIsDuplicate(connection->mirrorWindowKey, block_counter) :
+					    connection->block_counter == connection->blockStore->block_counter) {
+						connection->blockStore->destroyRestoreBuffer();
+					} else {
+						if(!connection->mirrorWindow &&
+						   connection->block_counter &&
+						   connection->block_counter + 1 != connection->blockStore->block_counter) {
+							syslog(LOG_ERR, "loss packetbuffer block in conection %s - %i",
+							       connection->socketClientIP.getString().c_str(), 
+							       connection->socketClientPort.getPort());
+						}
+						connection->block_counter = connection->blockStore->block_counter;
+						connection->blockStore->sensor_ip = connection->socketClientIP;
+						if(!this->pcapStoreQueue.push(connection->blockStore, false)) {
+							if(connection->ioThread >= 0) {
+								// io thread serves other connections too - it does not wait for space in store queue,
+								// reading from the connection is paused and the block is pushed by connectionPushPendingBlock
+								connection->pushPending = true;
+								connection->pushPendingConfirm = confirm;
+								connection->bufferLen -= offsetBuffer;
+								memmove(connection->buffer, connection->buffer + offsetBuffer, connection->bufferLen);
+								connection->offsetBufferSyncRead = 0;
+								return(true);
+							}
+							unsigned int usleepCounter = 0;
+							while(!this->pcapStoreQueue.push(connection->blockStore, false)) {
+								if(TERMINATING) {
+									confirm = false;
+									break;
+								} else {
+									USLEEP_C(100, usleepCounter++);
+								}
+							}
+						}
+						this->connectionBlockPushed(connection, confirm);
+					}
+					if(confirm && !this->connectionSendBlockAck(connection, block_counter)) {
+						error = "send ack to sender failed";
+					}
+				}
+			}
+		} else if(rsltAddRestoreChunk < 0) {
+			if(error.empty()) {
+				error = connection->blockStore->addRestoreChunk_getErrorString(rsltAddRestoreChunk);
+			}
+		} else {
+			offsetBuffer = connection->bufferLen;
+		}
+		if(!error.empty()) {
+			this->connectionSend(connection, error.c_str(), error.length());
+			connection->blockStore->destroyRestoreBuffer();
+			connection->syncBeginBlock = true;
+			u_int64_t actTimeMS = getTimeMS();
+			if(!connection->lastTimeErrorLogMS ||
+			   actTimeMS > connection->lastTimeErrorLogMS + 1000) {
+				cLogSensor::log(cLogSensor::error, 
+						"error in receiving packets from mirror sender",
+						"connection from %s, error: %s", 
+						connection->socketClientIP.getString().c_str(),
+						error.c_str());
+				connection->lastTimeErrorLogMS = actTimeMS;
+			}
+			++connection->countErrors;
+			if(connection->countErrors > 20) {
+				syslog(LOG_NOTICE, "enforce close connection (too errors) from %s:%i", 
+				       connection->socketClientIP.getString().c_str(), 
+				       connection->socketClientPort.getPort());
+				forceStop = true;
+			}
+			break;
+		} else {
+			connection->countErrors = 0;
+		}
+	}
+	connection->bufferLen = 0;
+	connection->offsetBufferSyncRead = 0;
+	return(!forceStop);
+}
+
+bool PcapQueue_readFromFifo::connectionCheckHeap(sPacketServerConnection *connection) {
+	if(!(opt_pcap_queue_store_queue_max_disk_size &&
+	     !opt_pcap_queue_disk_folder.empty())) {
+		double heapPerc = buffersControl.getPercUsePB();
+		if(heapPerc > 90) {
+			syslog(LOG_NOTICE, "enforce close connection (heap is almost full) from %s:%i", 
+			       connection->socketClientIP.getString().c_str(), 
+			       connection->socketClientPort.getPort());
+			return(false);
+		}
+		// io thread must not sleep - it serves other connections too, it is slowed down by full store queue (pushPending)
+		if(connection->ioThread < 0) {
+			if(heapPerc > 85) {
+				USLEEP(10000);
+			} else if(heapPerc > 80) {
+				USLEEP(1000);
+			}
+		}
+	}
+	return(true);
+}
+
+void PcapQueue_readFromFifo::connectionBlockPushed(sPacketServerConnection *connection, bool confirm) {
+	if(connection->mirrorWindow && confirm) {
+		this->mirrorWindowSetCounter(connection->mirrorWindowKey, connection->blockStore->block_counter);
+	}
+	sumPacketsCounterIn[0] += connection->blockStore->count;
+	sumPacketsSize[0] += connection->blockStore->size_packets ? connection->blockStore->size_packets : connection->blockStore->size;
+	sumPacketsSizeCompress[0] += connection->blockStore->size_compress;
+	++sumBlocksCounterIn[0];
+	connection->blockStore = new FILE_LINE(15055) pcap_block_store;
+}
+
+bool PcapQueue_readFromFifo::connectionPushPendingBlock(sPacketServerConnection *connection) {
+	if(!this->pcapStoreQueue.push(connection->blockStore, false)) {
+		return(true);
+	}
+	u_int32_t block_counter = connection->blockStore->block_counter;
+	bool confirm = connection->pushPendingConfirm;
+	connection->pushPending = false;
+	connection->lastReadTimeMS = getTimeMS_rdtsc();
+	this->connectionBlockPushed(connection, confirm);
+	if(confirm && !this->connectionSendBlockAck(connection, block_counter)) {
+		return(false);
+	}
+	// rest of data read together with the block
+	return(this->connectionProcessData(connection, 0));
+}
+
+bool PcapQueue_readFromFifo::connectionSend(sPacketServerConnection *connection, const char *data, size_t dataLen) {
+	if(connection->ioThread < 0) {
+		return(send(connection->socketClient, data, dataLen, 0) == (ssize_t)dataLen);
+	}
+	// non-blocking socket - the rest of reply is queued and sent on EPOLLOUT
+	size_t sentLen = 0;
+	if(connection->sendBuffer.empty()) {
+		ssize_t rsltSend = send(connection->socketClient, data, dataLen, MSG_NOSIGNAL);
+		if(rsltSend < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				return(false);
+			}
+		} else {
+			sentLen = rsltSend;
+		}
+	}
+	if(sentLen < dataLen) {
+		if(connection->sendBuffer.length() + (dataLen - sentLen) > PCAP_QUEUE_CONNECTION_SEND_BUFFER_MAX) {
+			syslog(LOG_NOTICE, "packetbuffer %s: too many unsent replies to %s:%i", 
+			       this->nameQueue.c_str(),
+			       connection->socketClientIP.getString().c_str(), 
+			       connection->socketClientPort.getPort());
+			return(false);
+		}
+		connection->sendBuffer.append(data + sentLen, dataLen - sentLen);
+		this->ioThreadUpdateEvents(connection);
+	}
+	return(true);
+}
+
+bool PcapQueue_readFromFifo::connectionSendBlockAck(sPacketServerConnection *connection, u_int32_t block_counter) {
+	// cumulative confirmation - confirms also all previous blocks of the connection
+	char ack[30];
+	snprintf(ack, sizeof(ack), "block_ack:%u;", block_counter);
+	return(this->connectionSend(connection, ack, strlen(ack)));
+}
+
+bool PcapQueue_readFromFifo::connectionFlushSend(sPacketServerConnection *connection) {
+	while(!connection->sendBuffer.empty()) {
+		ssize_t rsltSend = send(connection->socketClient, connection->sendBuffer.data(), connection->sendBuffer.length(), MSG_NOSIGNAL);
+		if(rsltSend < 0) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				break;
+			}
+			return(false);
+		}
+		connection->sendBuffer.erase(0, rsltSend);
+	}
+	this->ioThreadUpdateEvents(connection);
+	return(true);
+}
+
+void PcapQueue_readFromFifo::startIoThreads() {
+	for(int i = 0; i < opt_pcap_queues_mirror_receiver_io_threads; i++) {
+		sPacketServerIoThread *ioThread = new FILE_LINE(0) sPacketServerIoThread(this, i);
+		ioThread->epollFd = epoll_create(1);
+		if(ioThread->epollFd < 0) {
+			syslog(LOG_ERR, "packetbuffer %s: epoll_create failed: %s", this->nameQueue.c_str(), strerror(errno));
+			delete ioThread;
+			break;
+		}
+		this->packetServerIoThreads.push_back(ioThread);
+		vm_pthread_create(("pb - receiver io " + intToString(i + 1)).c_str(),
+				  &ioThread->threadHandle, NULL, _PcapQueue_readFromFifo_ioThreadFunction, ioThread, __FILE__, __LINE__);
+	}
+	if(!this->packetServerIoThreads.size()) {
+		syslog(LOG_NOTICE, "packetbuffer %s: receiver io threads not started - use thread per connection", this->nameQueue.c_str());
+	}
+}
+
+void PcapQueue_readFromFifo::stopIoThreads() {
+	this->packetServerIoThreadsTerminate = true;
+	for(unsigned i = 0; i < this->packetServerIoThreads.size(); i++) {
+		sPacketServerIoThread *ioThread = this->packetServerIoThreads[i];
+		if(ioThread->threadHandle) {
+			pthread_join(ioThread->threadHandle, NULL);
+		}
+		close(ioThread->epollFd);
+		delete ioThread;
+	}
+	this->packetServerIoThreads.clear();
+}
+
+void *PcapQueue_readFromFifo::ioThreadFunction(sPacketServerIoThread *ioThread) {
+	ioThread->threadId = get_unix_tid();
+	if(VERBOSE || DEBUG_VERBOSE) {
+		ostringstream outStr;
+		outStr << "start thread t1 (" << this->nameQueue << " receiver io " << (ioThread->index + 1) << ") - pid: " << ioThread->threadId << endl;
+		if(DEBUG_VERBOSE) {
+			cout << outStr.str();
+		} else {
+			syslog(LOG_NOTICE, "%s", outStr.str().c_str());
+		}
+	}
+	const int maxEvents = 64;
+	epoll_event events[maxEvents];
+	u_int64_t lastCheckEmptyDataMS = 0;
+	bool existsPushPending = false;
+	while(!TERMINATING && !this->packetServerIoThreadsTerminate) {
+		int countEvents = epoll_wait(ioThread->epollFd, events, maxEvents, existsPushPending ? 10 : 100);
+		for(int i = 0; i < countEvents; i++) {
+			sPacketServerConnection *connection = (sPacketServerConnection*)events[i].data.ptr;
+			bool closeConnection = false;
+			if((events[i].events & EPOLLOUT) &&
+			   !this->connectionFlushSend(connection)) {
+				closeConnection = true;
+			}
+			// limited number of reads per event - other connections of the thread must not starve
+			for(unsigned pass = 0; pass < 100 && !closeConnection && !connection->pushPending; pass++) {
+				ssize_t readLen = recv(connection->socketClient, connection->buffer + connection->offsetBufferSyncRead, connection->bufferSize, 0);
+				if(readLen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+					break;
+				}
+				if(readLen <= 0) {
+					syslog(LOG_NOTICE, "close connection from %s:%i", 
+					       connection->socketClientIP.getString().c_str(), 
+					       connection->socketClientPort.getPort());
+					closeConnection = true;
+					break;
+				}
+				connection->lastReadTimeMS = getTimeMS_rdtsc();
+				if(!this->connectionCheckHeap(connection) ||
+				   !this->connectionProcessData(connection, readLen)) {
+					closeConnection = true;
+				}
+				if((size_t)readLen < connection->bufferSize) {
+					break;
+				}
+			}
+			if(closeConnection) {
+				this->ioThreadCloseConnection(ioThread, connection);
+			} else if(connection->pushPending) {
+				this->ioThreadUpdateEvents(connection);
+			}
+		}
+		existsPushPending = false;
+		list<sPacketServerConnection*> pushPendingConnections;
+		ioThread->lock_connections();
+		for(set<sPacketServerConnection*>::iterator iter = ioThread->connections.begin(); iter != ioThread->connections.end(); iter++) {
+			if((*iter)->pushPending) {
+				pushPendingConnections.push_back(*iter);
+			}
+		}
+		ioThread->unlock_connections();
+		for(list<sPacketServerConnection*>::iterator iter = pushPendingConnections.begin(); iter != pushPendingConnections.end(); iter++) {
+			if(!this->connectionPushPendingBlock(*iter)) {
+				this->ioThreadCloseConnection(ioThread, *iter);
+				continue;
+			}
+			this->ioThreadUpdateEvents(*iter);
+			if((*iter)->pushPending) {
+				existsPushPending = true;
+			}
+		}
+		u_int64_t actTimeMS = getTimeMS_rdtsc();
+		if(actTimeMS > lastCheckEmptyDataMS + 1000) {
+			list<sPacketServerConnection*> emptyDataConnections;
+			ioThread->lock_connections();
+			for(set<sPacketServerConnection*>::iterator iter = ioThread->connections.begin(); iter != ioThread->connections.end(); iter++) {
+				if(!(*iter)->pushPending &&
+				   actTimeMS > (*iter)->lastReadTimeMS + 300 * 1000) {
+					emptyDataConnections.push_back(*iter);
+				}
+			}
+			ioThread->unlock_connections();
+			for(list<sPacketServerConnection*>::iterator iter = emptyDataConnections.begin(); iter != emptyDataConnections.end(); iter++) {
+				syslog(LOG_NOTICE, "enforce close connection (too empty data) from %s:%i", 
+				       (*iter)->socketClientIP.getString().c_str(), 
+				       (*iter)->socketClientPort.getPort());
+				this->ioThreadCloseConnection(ioThread, *iter);
+			}
+			lastCheckEmptyDataMS = actTimeMS;
+		}
+	}
+	return(NULL);
+}
+
+void PcapQueue_readFromFifo::ioThreadCloseConnection(sPacketServerIoThread *ioThread, sPacketServerConnection *connection) {
+	epoll_ctl(ioThread->epollFd, EPOLL_CTL_DEL, connection->socketClient, NULL);
+	ioThread->lock_connections();
+	ioThread->connections.erase(connection);
+	ioThread->unlock_connections();
+	// connection is deleted in cleanupConnections after it is inactive
+	connection->active = false;
+}
+
+void PcapQueue_readFromFifo::ioThreadUpdateEvents(sPacketServerConnection *connection) {
+	if(connection->ioThread < 0) {
+		return;
+	}
+	u_int32_t events = (connection->pushPending ? 0 : EPOLLIN) |
+			   (connection->sendBuffer.empty() ? 0 : EPOLLOUT);
+	if(events == connection->epollEvents) {
+		return;
+	}
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = events;
+	event.data.ptr = connection;
+	if(epoll_ctl(this->packetServerIoThreads[connection->ioThread]->epollFd, EPOLL_CTL_MOD, connection->socketClient, &event) == 0) {
+		connection->epollEvents = events;
+	}
+}
+
 int PcapQueue_readFromFifo::processPacket(sHeaderPacketPQout *hp, eHeaderPacketPQoutState hp_state) {
  
 	/*
@@ -7308,6 +9024,7 @@ int PcapQueue_readFromFifo::processPacket(sHeaderPacketPQout *hp, eHeaderPacketP
 	++packet_counter_all;
 	
 	pcap_pkthdr *header = hp->header->convertToStdHeader();
+	cLatencyStat::add(cLatencyStat::_ls_t2, getTimeUS(header));
 	
 	if(header->caplen > header->len) {
 		extern BogusDumper *bogusDumper;
@@ -7566,12 +9283,18 @@ void *_PcapQueue_readFromFifo_connectionThreadFunction(void *arg) {
 	return(connection->parent->threadFunction(connection->parent, connection->id));
 }
 
+void *_PcapQueue_readFromFifo_ioThreadFunction(void *arg) {
+	PcapQueue_readFromFifo::sPacketServerIoThread *ioThread = (PcapQueue_readFromFifo::sPacketServerIoThread*)arg;
+	return(ioThread->parent->ioThreadFunction(ioThread));
+}
+
 
 inline void *_PcapQueue_outputThread_outThreadFunction(void *arg) {
 	return(((PcapQueue_outputThread*)arg)->outThreadFunction());
 }
 
-PcapQueue_outputThread::PcapQueue_outputThread(eTypeOutputThread typeOutputThread, PcapQueue_readFromFifo *pcapQueue) {
+PcapQueue_outputThread::PcapQueue_outputThread(eTypeOutputThread typeOutputThread, PcapQueue_readFromFifo *pcapQueue,
+					       unsigned shards, PcapQueue_outputThread *shardParent, unsigned shardIndex) {
 	extern unsigned int opt_preprocess_packets_qring_length;
 	extern unsigned int opt_preprocess_packets_qring_item_length;
 	this->typeOutputThread = typeOutputThread;
@@ -7586,7 +9309,7 @@ PcapQueue_outputThread::PcapQueue_outputThread(eTypeOutputThread typeOutputThrea
 	this->writeit = 0;
 	this->qring = new FILE_LINE(15059) sBatchHP*[this->qring_length];
 	for(unsigned int i = 0; i < this->qring_length; i++) {
-		this->qring[i] = new FILE_LINE(15060) sBatchHP(this->qring_batch_item_length);
+		this->qring[i] = new FILE_LINE(15060) sBatchHP(this->qring_batch_item_length, shardParent != NULL);
 		this->qring[i]->used = 0;
 	}
 	this->qring_push_index = 0;
@@ -7595,11 +9318,26 @@ PcapQueue_outputThread::PcapQueue_outputThread(eTypeOutputThread typeOutputThrea
 	this->outThreadId = 0;
 	this->defrag_counter = 0;
 	this->ipfrag_lastprune = 0;
-	if(typeOutputThread == dedup) {
-		this->dedup_buffer = new FILE_LINE(16003) u_char[65536 * MD5_DIGEST_LENGTH]; // 1M
-		memset(this->dedup_buffer, 0, 65536 * MD5_DIGEST_LENGTH * sizeof(u_char));
+	this->shardsCount = shards > 1 ? shards : 1;
+	this->shardParent = shardParent;
+	this->shardIndex = shardIndex;
+	this->shard_push_seq = 0;
+	this->merge_readit = 0;
+	this->merge_batch_index = 0;
+	if(this->shardsCount > 1) {
+		// flow sharded workers - this thread only merges their output back to the input order
+		this->shardThreads = new FILE_LINE(0) PcapQueue_outputThread*[this->shardsCount];
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			this->shardThreads[i] = new FILE_LINE(0) PcapQueue_outputThread(typeOutputThread, pcapQueue, 1, this, i);
+		}
+	} else {
+		this->shardThreads = NULL;
+	}
+	if(typeOutputThread == dedup && this->shardsCount == 1) {
+		extern int opt_dup_check_window_ms;
+		this->dedupTable = new FILE_LINE(16003) cDedupTable(14, opt_dup_check_window_ms); // 16k sets x 4 ways - 1M
 	} else {
-		this->dedup_buffer = NULL;
+		this->dedupTable = NULL;
 	}
 	this->initThreadOk = false;
 	this->terminatingThread = false;
@@ -7614,12 +9352,23 @@ PcapQueue_outputThread::~PcapQueue_outputThread() {
 	if(typeOutputThread == defrag) {
 		ipfrag_prune(0, true, &ipfrag_data, -1, 0);
 	}
-	if(typeOutputThread == dedup) {
-		delete [] dedup_buffer;
+	if(dedupTable) {
+		delete dedupTable;
+	}
+	if(shardThreads) {
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			delete this->shardThreads[i];
+		}
+		delete [] this->shardThreads;
 	}
 }
 
 void PcapQueue_outputThread::start() {
+	if(this->shardThreads) {
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			this->shardThreads[i]->start();
+		}
+	}
 	vm_pthread_create(("t2 out thread " + getNameOutputThread()).c_str(),
 			  &this->out_thread_handle, NULL, _PcapQueue_outputThread_outThreadFunction, this, __FILE__, __LINE__);
 }
@@ -7631,9 +9380,18 @@ void PcapQueue_outputThread::stop() {
 		this->initThreadOk = false;
 		this->terminatingThread = false;
 	}
+	if(this->shardThreads) {
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			this->shardThreads[i]->stop();
+		}
+	}
 }
 
-void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
+void PcapQueue_outputThread::push(sHeaderPacketPQout *hp, u_int64_t seq) {
+	if(this->shardThreads) {
+		this->shardThreads[this->getShard(hp)]->push(hp, ++this->shard_push_seq);
+		return;
+	}
 	if(hp && hp->block_store && !hp->block_store_locked) {
 		hp->block_store->lock_packet(hp->block_store_index, 1 /*pb lock flag*/);
 		hp->block_store_locked = true;
@@ -7646,6 +9404,10 @@ void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
 	
 	if(!qring_push_index) {
 		unsigned int usleepCounter = 0;
+		if(this->shardParent && this->qring[this->writeit]->used != 0) {
+			// merge thread can wait for packets in unfinished batches of other shards
+			this->shardParent->push_batch();
+		}
 		while(this->qring[this->writeit]->used != 0) {
 			if(is_terminating()) {
 				return;
@@ -7657,6 +9419,9 @@ void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
 		qring_active_push_item = qring[qring_push_index - 1];
 	}
 	qring_active_push_item->batch[qring_push_index_count] = *hp;
+	if(qring_active_push_item->seq) {
+		qring_active_push_item->seq[qring_push_index_count] = seq;
+	}
 	++qring_push_index_count;
 	if(qring_push_index_count == qring_active_push_item->max_count) {
 		qring_active_push_item->count = qring_push_index_count;
@@ -7672,6 +9437,12 @@ void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
 }
 
 void PcapQueue_outputThread::push_batch() {
+	if(this->shardThreads) {
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			this->shardThreads[i]->push_batch();
+		}
+		return;
+	}
 	if(qring_push_index && qring_push_index_count) {
 		qring_active_push_item->count = qring_push_index_count;
 		qring_active_push_item->used = 1;
@@ -7687,9 +9458,14 @@ void PcapQueue_outputThread::push_batch() {
 
 void *PcapQueue_outputThread::outThreadFunction() {
 	this->initThreadOk = true;
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	extern unsigned int opt_preprocess_packets_qring_usleep;
 	this->outThreadId = get_unix_tid();
 	syslog(LOG_NOTICE, "start thread t2_%s/%i", this->getNameOutputThread().c_str(), this->outThreadId);
+	if(this->shardThreads) {
+		this->mergeShards();
+		return(NULL);
+	}
 	sBatchHP *batch;
 	unsigned int usleepCounter = 0;
 	unsigned long usleepSumTime = 0;
@@ -7700,15 +9476,28 @@ void *PcapQueue_outputThread::outThreadFunction() {
 			for(unsigned batch_index = 0; batch_index < batch->count; batch_index++) {
 				switch(typeOutputThread) {
 				case defrag:
+					// in shard the result is taken over by merge thread
 					this->processDefrag(&batch->batch[batch_index]);
 					break;
 				case dedup:
-					this->processDedup(&batch->batch[batch_index]);
+					if(this->shardParent) {
+						// result is taken over by merge thread - duplicates are only marked
+						if(this->checkDedup(&batch->batch[batch_index])) {
+							batch->batch[batch_index].destroy_or_unlock_blockstore();
+							batch->batch[batch_index].header = NULL;
+						}
+					} else {
+						this->processDedup(&batch->batch[batch_index]);
+					}
 					break;
 				}
 			}
-			batch->count = 0;
-			batch->used = 0;
+			if(this->shardParent) {
+				batch->used = 2;
+			} else {
+				batch->count = 0;
+				batch->used = 0;
+			}
 			if((this->readit + 1) == this->qring_length) {
 				this->readit = 0;
 			} else {
@@ -7719,7 +9508,7 @@ void *PcapQueue_outputThread::outThreadFunction() {
 			usleepSumTime_lastPush = 0;
 		} else {
 			usleepSumTime += USLEEP_C(opt_preprocess_packets_qring_usleep, usleepCounter++);
-			if(usleepSumTime > usleepSumTime_lastPush + 100000) {
+			if(usleepSumTime > usleepSumTime_lastPush + 100000 && !this->shardParent) {
 				switch(typeOutputThread) {
 				case defrag:
 					if(pcapQueueQ_outThread_dedup) {
@@ -7739,19 +9528,25 @@ void *PcapQueue_outputThread::outThreadFunction() {
 
 void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 	uint32_t headerTimeS = hp->header->get_tv_sec();
-	if(hp->block_store && hp->block_store->hm == pcap_block_store::plus2) {
-		hp->header->header_ip_offset = ((pcap_pkthdr_plus2*)hp->header)->header_ip_first_offset;
-	} else {
-		sll_header *header_sll;
-		ether_header *header_eth;
-		u_int header_ip_offset = 0;
-		int protocol;
-		u_int16_t vlan;
-		parseEtherHeader(hp->dlt, hp->packet,
-				 header_sll, header_eth, NULL,
-				 header_ip_offset, protocol, vlan);
-		hp->header->header_ip_offset = header_ip_offset;
+	if(!this->defragPacket(hp)) {
+		if(this->shardParent) {
+			// packet is queued or dropped - merge thread skips it
+			hp->header = NULL;
+		}
+	} else if(!this->shardParent &&
+		  this->pcapQueue->processPacket(hp, _hppq_out_state_defrag) == 0) {
+		hp->destroy_or_unlock_blockstore();
 	}
+	if((ipfrag_lastprune + 2) < headerTimeS) {
+		if(ipfrag_lastprune) {
+			ipfrag_prune(headerTimeS, false, &this->ipfrag_data, -1, 2);
+		}
+		ipfrag_lastprune = headerTimeS;
+	}
+}
+
+bool PcapQueue_outputThread::defragPacket(sHeaderPacketPQout *hp) {
+	hp->header->header_ip_offset = this->getHeaderIpOffset(hp);
 	iphdr2 *header_ip = (iphdr2*)(hp->packet + hp->header->header_ip_offset);
 	u_int16_t frag_data = header_ip->get_frag_data();
 	if(header_ip->is_more_frag(frag_data) || header_ip->get_frag_offset(frag_data)) {
@@ -7763,7 +9558,7 @@ void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 				lastTimeLogErrBadIpHeader = actTime;
 			}
 			hp->destroy_or_unlock_blockstore();
-			return;
+			return(false);
 		}
 		// packet is fragmented
 		int rsltDefrag = handle_defrag(header_ip, (void*)hp, &this->ipfrag_data);
@@ -7779,7 +9574,7 @@ void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 			if(rsltDefrag < 0) {
 				hp->destroy_or_unlock_blockstore();
 			}
-			return;
+			return(false);
 		}
 	}
 	unsigned headers_ip_counter = 0;
@@ -7793,7 +9588,7 @@ void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 			break;
 		} else if(next_header_ip_offset < 0) {
 			hp->destroy_or_unlock_blockstore();
-			return;
+			return(false);
 		} else {
 			header_ip = (iphdr2*)((u_char*)header_ip + next_header_ip_offset);
 			hp->header->header_ip_offset += next_header_ip_offset;
@@ -7820,29 +9615,33 @@ void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 					if(rsltDefrag < 0) {
 						hp->destroy_or_unlock_blockstore();
 					}
-					return;
+					return(false);
 				}
 			}
 		}
 	}
-	
-	if(this->pcapQueue->processPacket(hp, _hppq_out_state_defrag) == 0) {
-		hp->destroy_or_unlock_blockstore();
-	}
-	
-	if((ipfrag_lastprune + 2) < headerTimeS) {
-		if(ipfrag_lastprune) {
-			ipfrag_prune(headerTimeS, false, &this->ipfrag_data, -1, 2);
-		}
-		ipfrag_lastprune = headerTimeS;
+	return(true);
+}
+
+u_int PcapQueue_outputThread::getHeaderIpOffset(sHeaderPacketPQout *hp) {
+	if(hp->block_store && hp->block_store->hm == pcap_block_store::plus2) {
+		return(((pcap_pkthdr_plus2*)hp->header)->header_ip_first_offset);
 	}
+	sll_header *header_sll;
+	ether_header *header_eth;
+	u_int header_ip_offset = 0;
+	int protocol;
+	u_int16_t vlan;
+	parseEtherHeader(hp->dlt, hp->packet,
+			 header_sll, header_eth, NULL,
+			 header_ip_offset, protocol, vlan);
+	return(header_ip_offset);
 }
 
-void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
-	uint16_t *_md5 = NULL;
-	uint16_t __md5[MD5_DIGEST_LENGTH / (sizeof(uint16_t) / sizeof(unsigned char))];
+u_int64_t PcapQueue_outputThread::getDedupHash(sHeaderPacketPQout *hp) {
+	u_int64_t hash = 0;
 	if(hp->block_store && hp->block_store->hm == pcap_block_store::plus2 && ((pcap_pkthdr_plus2*)hp->header)->md5[0]) {
-		_md5 = ((pcap_pkthdr_plus2*)hp->header)->md5;
+		hash = dedup_hash_from_md5(((pcap_pkthdr_plus2*)hp->header)->md5);
 	} else {
 		if(hp->header->header_ip_offset) {
 			iphdr2 *header_ip = (iphdr2*)(hp->packet + hp->header->header_ip_offset);
@@ -7858,8 +9657,6 @@ void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
 				datalen = get_sctp_data_len(header_ip, &data, hp->packet, hp->header->get_caplen());
 			}
 			if(data && datalen) {
-				MD5_CTX md5_ctx;
-				MD5_Init(&md5_ctx);
 				if(opt_dup_check_ipheader) {
 					u_int8_t header_ip_ttl_orig = 0;
 					u_int8_t header_ip_check_orig = 0;
@@ -7869,34 +9666,158 @@ void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
 						header_ip->set_ttl(0);
 						header_ip->set_check(0);
 					}
-					MD5_Update(&md5_ctx, header_ip, MIN(datalen + (data - (char*)header_ip), header_ip->get_tot_len()));
+					hash = dedup_hash(header_ip, MIN(datalen + (data - (char*)header_ip), header_ip->get_tot_len()));
 					if(opt_dup_check_ipheader_ignore_ttl) {
 						header_ip->set_ttl(header_ip_ttl_orig);
 						header_ip->set_check(header_ip_check_orig);
 					}
 				} else {
-					MD5_Update(&md5_ctx, data, datalen);
+					hash = dedup_hash(data, datalen);
 				}
-				MD5_Final((unsigned char*)__md5, &md5_ctx);
-				_md5 = __md5;
 			}
 		}
 	}
-	if(_md5) {
-		if(memcmp(_md5, this->dedup_buffer + (_md5[0] * MD5_DIGEST_LENGTH), MD5_DIGEST_LENGTH) == 0) {
+	return(hash);
+}
+
+bool PcapQueue_outputThread::checkDedup(sHeaderPacketPQout *hp) {
+	u_int64_t hash = this->getDedupHash(hp);
+	if(hash) {
+		if(this->dedupTable->check(hash, hp->header->get_tv_sec() * 1000000ull + hp->header->get_tv_usec())) {
 			if(sverb.dedup) {
 				cout << "*** DEDUP 2" << endl;
 			}
-			hp->destroy_or_unlock_blockstore();
-			return;
+			return(true);
 		}
-		memcpy(this->dedup_buffer + (_md5[0] * MD5_DIGEST_LENGTH), _md5, MD5_DIGEST_LENGTH);
+	}
+	return(false);
+}
+
+void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
+	if(this->checkDedup(hp)) {
+		hp->destroy_or_unlock_blockstore();
+		return;
 	}
 	if(this->pcapQueue->processPacket(hp, _hppq_out_state_dedup) == 0) {
 		hp->destroy_or_unlock_blockstore();
 	}
 }
 
+unsigned PcapQueue_outputThread::getShard(sHeaderPacketPQout *hp) {
+	u_int32_t hash = 0;
+	if(this->typeOutputThread == defrag) {
+		// fragments of one datagram must go to the same shard
+		u_int header_ip_offset = this->getHeaderIpOffset(hp);
+		if(header_ip_offset + sizeof(iphdr2) <= hp->header->get_caplen()) {
+			hash = ((iphdr2*)(hp->packet + header_ip_offset))->get_saddr().getHashNumber();
+			hash ^= hash >> 16;
+			hash *= 0x45D9F3B;
+			hash ^= hash >> 16;
+		}
+		return(hash % this->shardsCount);
+	}
+	// duplicates of one packet must go to the same shard - dispatch uses only cheap key (hash from t0 or ip/port tuple),
+	// content hash is calculated in shard (checkDedup)
+	if(hp->block_store && hp->block_store->hm == pcap_block_store::plus2 && ((pcap_pkthdr_plus2*)hp->header)->md5[0]) {
+		u_int64_t md_hash = dedup_hash_from_md5(((pcap_pkthdr_plus2*)hp->header)->md5);
+		hash = (u_int32_t)(md_hash >> 32) ^ (u_int32_t)md_hash;
+		hash ^= hash >> 16;
+		hash *= 0x45D9F3B;
+		hash ^= hash >> 16;
+	} else if(hp->header->header_ip_offset &&
+		  hp->header->header_ip_offset + sizeof(iphdr2) <= hp->header->get_caplen()) {
+		iphdr2 *header_ip = (iphdr2*)(hp->packet + hp->header->header_ip_offset);
+		if(opt_dup_check_ipheader) {
+			hash = header_ip->get_saddr().getHashNumber() ^ header_ip->get_daddr().getHashNumber();
+		}
+		u_int16_t frag_data = header_ip->get_frag_data();
+		if(!header_ip->is_more_frag(frag_data) && !header_ip->get_frag_offset(frag_data) &&
+		   (u_int32_t)(hp->header->header_ip_offset + header_ip->get_hdr_size() + 4) <= hp->header->get_caplen()) {
+			if(header_ip->get_protocol() == IPPROTO_UDP) {
+				udphdr2 *header_udp = (udphdr2*)((char*)header_ip + header_ip->get_hdr_size());
+				hash ^= (header_udp->get_source().getPort() << 16) ^ header_udp->get_dest().getPort();
+			} else if(header_ip->get_protocol() == IPPROTO_TCP) {
+				tcphdr2 *header_tcp = (tcphdr2*)((char*)header_ip + header_ip->get_hdr_size());
+				hash ^= (header_tcp->get_source().getPort() << 16) ^ header_tcp->get_dest().getPort();
+			}
+		}
+		hash ^= hash >> 16;
+		hash *= 0x45D9F3B;
+		hash ^= hash >> 16;
+	}
+	return(hash % this->shardsCount);
+}
+
+sHeaderPacketPQout *PcapQueue_outputThread::getMergeHead(u_int64_t *seq) {
+	sBatchHP *batch = this->qring[this->merge_readit];
+	if(batch->used != 2) {
+		return(NULL);
+	}
+	*seq = batch->seq[this->merge_batch_index];
+	return(&batch->batch[this->merge_batch_index]);
+}
+
+void PcapQueue_outputThread::nextMergeHead() {
+	sBatchHP *batch = this->qring[this->merge_readit];
+	if(++this->merge_batch_index >= batch->count) {
+		this->merge_batch_index = 0;
+		batch->count = 0;
+		batch->used = 0;
+		if((this->merge_readit + 1) == this->qring_length) {
+			this->merge_readit = 0;
+		} else {
+			this->merge_readit++;
+		}
+	}
+}
+
+void PcapQueue_outputThread::mergeShards() {
+	// shards get packets with sequence numbers in order of t2 (timestamp order);
+	// the next sequence is always at the head of one of the shards
+	extern unsigned int opt_preprocess_packets_qring_usleep;
+	u_int64_t merge_seq = 1;
+	unsigned shard = 0;
+	unsigned usleepCounter = 0;
+	unsigned long usleepSumTime = 0;
+	unsigned long usleepSumTime_lastPush = 0;
+	while(!is_terminating() && !this->terminatingThread) {
+		sHeaderPacketPQout *hp = NULL;
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			u_int64_t seq;
+			hp = this->shardThreads[shard]->getMergeHead(&seq);
+			if(hp && seq == merge_seq) {
+				break;
+			}
+			hp = NULL;
+			if(++shard == this->shardsCount) {
+				shard = 0;
+			}
+		}
+		if(hp) {
+			if(hp->header &&
+			   this->pcapQueue->processPacket(hp, typeOutputThread == defrag ? _hppq_out_state_defrag : _hppq_out_state_dedup) == 0) {
+				hp->destroy_or_unlock_blockstore();
+			}
+			this->shardThreads[shard]->nextMergeHead();
+			++merge_seq;
+			usleepCounter = 0;
+			usleepSumTime = 0;
+			usleepSumTime_lastPush = 0;
+		} else {
+			usleepSumTime += USLEEP_C(opt_preprocess_packets_qring_usleep, usleepCounter++);
+			if(usleepSumTime > usleepSumTime_lastPush + 100000) {
+				if(typeOutputThread == defrag && pcapQueueQ_outThread_dedup) {
+					pcapQueueQ_outThread_dedup->push_batch();
+				} else {
+					preProcessPacket[PreProcessPacket::ppt_detach]->push_batch();
+				}
+				usleepSumTime_lastPush = usleepSumTime;
+			}
+		}
+	}
+}
+
+
 void PcapQueue_outputThread::preparePstatData() {
 	if(this->outThreadId) {
 		if(this->threadPstatData[0].cpu_total_time) {
@@ -7944,6 +9865,150 @@ int getThreadingMode() {
 	}
 }
 
+static void capture_prefilter_add_ports(string *expr, char *port_matrix) {
+	for(unsigned i = 1; i <= 65535; i++) {
+		if(port_matrix[i]) {
+			unsigned j;
+			for(j = i; j < 65535 && port_matrix[j + 1]; j++);
+			if(!expr->empty()) {
+				*expr += " or ";
+			}
+			*expr += j > i ?
+				  "portrange " + intToString(i) + "-" + intToString(j) :
+				  "port " + intToString(i);
+			i = j;
+		}
+	}
+}
+
+/*
+ * Kernel prefilter which passes only UDP which may be processed - SIP, MGCP, audiocodes, tunnels and RTP.
+ * Everything else (TCP, non-IP, VLAN tagged, fragments, other protocols) passes unchanged.
+ * Empty result means that prefilter can not be used with current configuration.
+ */
+string capture_prefilter_expression() {
+	extern int opt_ipaccount;
+	extern int opt_mirrorall;
+	extern int opt_mgcp;
+	extern bool opt_audiocodes;
+	extern unsigned opt_udp_port_mgcp_gateway;
+	extern unsigned opt_udp_port_mgcp_callagent;
+	extern unsigned opt_udp_port_audiocodes;
+	extern unsigned opt_udp_port_l2tp;
+	extern unsigned opt_udp_port_tzsp;
+	extern unsigned opt_udp_port_vxlan;
+	extern unsigned opt_kamailio_port;
+	extern char *ssl_client_random_portmatrix;
+	extern bool ssl_client_random_enable;
+	extern char *prefilter_rtp_portmatrix;
+	if(opt_ipaccount || opt_mirrorall) {
+		return("");
+	}
+	char *udp_portmatrix = new FILE_LINE(0) char[65537];
+	memcpy(udp_portmatrix, sipportmatrix, 65537);
+	if(opt_mgcp) {
+		udp_portmatrix[opt_udp_port_mgcp_gateway & 0xFFFF] = 1;
+		udp_portmatrix[opt_udp_port_mgcp_callagent & 0xFFFF] = 1;
+	}
+	if(opt_audiocodes) {
+		udp_portmatrix[opt_udp_port_audiocodes & 0xFFFF] = 1;
+	}
+	udp_portmatrix[opt_udp_port_l2tp & 0xFFFF] = 1;
+	udp_portmatrix[opt_udp_port_tzsp & 0xFFFF] = 1;
+	udp_portmatrix[opt_udp_port_vxlan & 0xFFFF] = 1;
+	if(opt_kamailio_port) {
+		udp_portmatrix[opt_kamailio_port & 0xFFFF] = 1;
+	}
+	if(ssl_client_random_enable) {
+		for(unsigned i = 0; i < 65536; i++) {
+			if(ssl_client_random_portmatrix[i]) {
+				udp_portmatrix[i] = 1;
+			}
+		}
+	}
+	string udp_ports;
+	capture_prefilter_add_ports(&udp_ports, udp_portmatrix);
+	delete [] udp_portmatrix;
+	string rtp_ports;
+	capture_prefilter_add_ports(&rtp_ports, prefilter_rtp_portmatrix);
+	// fragments always pass - ports are known only in the first fragment (and its ports are not at fixed offset for ipv6):
+	//  ipv4 - nonzero more fragments flag or fragment offset
+	//  ipv6 - fragment extension header directly after ipv6 header (next header 44), e.g. fragmented INVITE over udp
+	//         is 'ip6[6] == 44' in all its fragments while 'udp port 5060' compares fragment header instead of udp header
+	string expr = "not (ip or ip6) or not udp or (ip[6:2] & 0x1fff != 0) or (ip6 and ip6[6] == 44)";
+	if(!udp_ports.empty()) {
+		expr += " or (udp and (" + udp_ports + "))";
+	}
+	if(!rtp_ports.empty()) {
+		expr += " or (udp and (" + rtp_ports + "))";
+	} else {
+		expr += " or (udp src portrange 1024-65535 and udp dst portrange 1024-65535)";
+	}
+	return(expr);
+}
+
+void capture_prefilter_reload() {
+	__sync_fetch_and_add(&capture_prefilter_version, 1);
+}
+
+void test_packetbuffer_shedding_strip() {
+	// block rtp,rtp,rtp,sip,rtp,... compressed as in t1 must be stripped to the first packet and sip - reserve is usable with compression
+	int opt_pcap_queue_compress_orig = opt_pcap_queue_compress;
+	int opt_pcap_queue_compress_ratio_orig = opt_pcap_queue_compress_ratio;
+	opt_pcap_queue_compress = 1;
+	opt_pcap_queue_compress_ratio = 100;
+	sipportmatrix[5060] = 1;
+	if(!cPacketbufferShedding::isEnable()) {
+		cPacketbufferShedding::init(0, 0);
+	}
+	pcap_block_store *block = new FILE_LINE(0) pcap_block_store;
+	block->dlink = DLT_EN10MB;
+	const unsigned packets = 10;
+	const unsigned sip_index = 3;
+	u_char packet[14 + 20 + 8 + 172];
+	for(unsigned i = 0; i < packets; i++) {
+		memset(packet, 0, sizeof(packet));
+		((ether_header*)packet)->ether_type = htons(ETHERTYPE_IP);
+		u_char *ip = packet + 14;
+		ip[0] = 0x45;
+		*(u_int16_t*)(ip + 2) = htons(sizeof(packet) - 14);
+		ip[8] = 64;
+		ip[9] = IPPROTO_UDP;
+		*(u_int32_t*)(ip + 12) = htonl(0x0A000001);
+		*(u_int32_t*)(ip + 16) = htonl(0x0A000002);
+		u_char *udp = ip + 20;
+		*(u_int16_t*)(udp + 0) = htons(i == sip_index ? 5060 : 10000);
+		*(u_int16_t*)(udp + 2) = htons(i == sip_index ? 5060 : 20000);
+		*(u_int16_t*)(udp + 4) = htons(sizeof(packet) - 14 - 20);
+		u_char *data = udp + 8;
+		if(i == sip_index) {
+			memcpy(data, "INVITE sip:test@test SIP/2.0\r\n", 31);
+		} else {
+			data[0] = 0x80;
+			*(u_int16_t*)(data + 2) = htons(i);
+		}
+		pcap_pkthdr_plus header;
+		header.header_fix_size.ts_tv_sec = 1;
+		header.header_fix_size.ts_tv_usec = i;
+		header.header_fix_size.caplen = sizeof(packet);
+		header.header_fix_size.len = sizeof(packet);
+		header.header_ip_offset = 14;
+		header.dlink = DLT_EN10MB;
+		block->add_hp(&header, packet);
+	}
+	bool ok = block->count == packets;
+	ok = ok && block->compress() && block->size_compress;
+	ok = ok && pcap_store_queue::stripRtp(block);
+	ok = ok && block->size_compress;
+	ok = ok && block->uncompress();
+	ok = ok && block->count == 2;
+	ok = ok && ntohs(*(u_int16_t*)(block->get_packet(1) + 14 + 20 + 2)) == 5060;
+	cout << "packetbuffer shedding - strip rtp from compressed block: " << (ok ? "OK" : "FAILED") << endl;
+	delete block;
+	opt_pcap_queue_compress = opt_pcap_queue_compress_orig;
+	opt_pcap_queue_compress_ratio = opt_pcap_queue_compress_ratio_orig;
+}
+
 void setThreadingMode(int threadingMode) {
 	opt_pcap_queue_iface_separate_threads = 0;
 	opt_pcap_queue_iface_dedup_separate_threads = 0;
@@ -8,7 +8,9 @@
 #include <pcap.h>
 #include <deque>
 #include <queue>
+#include <set>
 #include <string>
+#include <vector>
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
@@ -20,10 +22,18 @@
 #include "pstat.h"
 #include "ip_frag.h"
 #include "header_packet.h"
+#include "tpacket_ring.h"
+#include "load_generator.h"
+#include "dedup.h"
+#include "async_direct_file.h"
 
 #define READ_THREADS_MAX 20
 #define DLT_TYPES_MAX 10
 #define PCAP_QUEUE_NEXT_THREADS_MAX 3
+#define PCAP_QUEUE_MIRROR_STRIPES_MAX 8
+#define PCAP_QUEUE_MIRROR_WINDOW_ACK_TIMEOUT_MS 10000
+#define PCAP_QUEUE_MIRROR_WINDOW_CLOSED_KEEP_MS 60000
+#define PCAP_QUEUE_CONNECTION_SEND_BUFFER_MAX (64 * 1024)
 
 class pcap_block_store_queue {
 public:
@@ -84,7 +94,7 @@ public:
 	pcap_file_store(u_int id = 0, const char *folder = NULL);
 	~pcap_file_store();
 	bool push(pcap_block_store *blockStore);
-	bool pop(pcap_block_store *blockStore);
+	bool pop(pcap_block_store *blockStore, bool *notReady = NULL);
 	bool isFull(bool forceSetFull = false) {
 		if(this->full) {
 			return(true);
@@ -106,6 +116,8 @@ public:
 	}
 	std::string getFilePathName();
 private:
+	bool push_direct(pcap_block_store *blockStore);
+	bool pop_direct(pcap_block_store *blockStore, bool *notReady);
 	bool open(eTypeHandle typeHandle);
 	bool close(eTypeHandle typeHandle);
 	bool destroy();
@@ -122,6 +134,8 @@ private:
 	FILE *fileHandlePop;
 	u_char *fileBufferPush;
 	u_char *fileBufferPop;
+	cAsyncDirectFile *directFilePush;
+	cAsyncDirectFile *directFilePop;
 	size_t fileSize;
 	size_t fileSizeFlushed;
 	size_t countPush;
@@ -142,6 +156,8 @@ public:
 		return(this->queueStore.size());
 	}
 	void init();
+	// strips rtp from block (also compressed) if packetbuffer load shedding is enabled
+	static bool stripRtp(pcap_block_store *blockStore);
 private:
 	pcap_file_store *findFileStoreById(u_int id);
 	void cleanupFileStore();
@@ -179,6 +195,98 @@ private:
 friend class PcapQueue_readFromFifo;
 };
 
+/*
+ * Pool of threads compressing (or uncompressing) finished blocks in parallel.
+ * Blocks are taken in push order from ring of slots by any free worker,
+ * pop returns them in the same order only when the head slot is done.
+ * push and pop have to be called from one thread.
+ */
+class pcap_block_store_compress_pool {
+public:
+	enum eTypePool {
+		_compress,
+		_uncompress
+	};
+	enum eSlotState {
+		_slot_empty,
+		_slot_ready,
+		_slot_processing,
+		_slot_done
+	};
+	struct sSlot {
+		pcap_block_store *blockStore;
+		bool ok;
+		volatile int state;
+	};
+	struct sWorker {
+		pthread_t thread_handle;
+		int threadId;
+		pstat_data threadPstatData[2];
+		pcap_block_store_compress_pool *pool;
+	};
+public:
+	pcap_block_store_compress_pool(eTypePool typePool, unsigned workers);
+	~pcap_block_store_compress_pool();
+	void start();
+	void stop();
+	bool push(pcap_block_store *blockStore) {
+		sSlot *slot = &this->slots[this->writePos];
+		if(slot->state != _slot_empty) {
+			return(false);
+		}
+		slot->blockStore = blockStore;
+		slot->ok = false;
+		__sync_synchronize();
+		slot->state = _slot_ready;
+		this->writePos = (this->writePos + 1) % this->slotsCount;
+		__sync_fetch_and_add(&this->depth, 1);
+		return(true);
+	}
+	pcap_block_store *pop(bool *ok) {
+		sSlot *slot = &this->slots[this->readPos];
+		if(slot->state != _slot_done) {
+			return(NULL);
+		}
+		pcap_block_store *blockStore = slot->blockStore;
+		*ok = slot->ok;
+		slot->blockStore = NULL;
+		__sync_synchronize();
+		slot->state = _slot_empty;
+		this->readPos = (this->readPos + 1) % this->slotsCount;
+		__sync_fetch_and_sub(&this->depth, 1);
+		return(blockStore);
+	}
+	bool isFull() {
+		return(this->slots[this->writePos].state != _slot_empty);
+	}
+	unsigned getDepth() {
+		return(this->depth);
+	}
+	string getStatString(bool preparePstatData);
+private:
+	void *workerThreadFunction(sWorker *worker);
+	sSlot *claimSlot();
+	void lock_claim() {
+		while(__sync_lock_test_and_set(&this->_sync_claim, 1));
+	}
+	void unlock_claim() {
+		__sync_lock_release(&this->_sync_claim);
+	}
+private:
+	eTypePool typePool;
+	sSlot *slots;
+	unsigned slotsCount;
+	unsigned writePos;
+	unsigned readPos;
+	volatile unsigned claimPos;
+	volatile unsigned depth;
+	sWorker *workers;
+	unsigned workersCount;
+	volatile bool terminating;
+	volatile int _sync_claim;
+friend void *_pcap_block_store_compress_pool_workerThreadFunction(void *arg);
+};
+
 enum eHeaderPacketPQoutState {
 	_hppq_out_state_NA = 0,
 	_hppq_out_state_defrag = 1,
@@ -285,6 +393,7 @@ protected:
 	}
 	virtual string pcapStatString_packets(int statPeriod);
 	virtual double pcapStat_get_compress();
+	string pcapStat_get_compress_methods(int statPeriod);
 	virtual double pcapStat_get_speed_mb_s(int statPeriod);
 	virtual string pcapStatString_bypass_buffer(int /*statPeriod*/) { return(""); }
 	virtual unsigned long pcapStat_get_bypass_buffer_size_exeeded() { return(0); }
@@ -308,6 +417,7 @@ protected:
 	void prepareProcPstatData();
 	double getCpuUsagePerc(eTypeThread typeThread = mainThread, bool preparePstatData = false);
 	virtual string getCpuUsage(bool /*writeThread*/ = false, bool /*preparePstatData*/ = false) { return(""); }
+	virtual string getCompressPoolStat(bool /*preparePstatData*/ = false) { return(""); }
 	long unsigned int getVsizeUsage(bool preparePstatData = false);
 	long unsigned int getRssUsage(bool preparePstatData = false);
 	virtual bool isMirrorSender() {
@@ -373,14 +483,14 @@ struct pcapProcessData {
 		#pragma GCC diagnostic pop
 		#endif
 		extern int opt_dup_check;
+		extern int opt_dup_check_window_ms;
 		if(opt_dup_check) {
-			this->prevmd5s = new FILE_LINE(16003) unsigned char[65536 * MD5_DIGEST_LENGTH]; // 1M
-			memset(this->prevmd5s, 0, 65536 * MD5_DIGEST_LENGTH * sizeof(unsigned char));
+			this->dedupTable = new FILE_LINE(16003) cDedupTable(14, opt_dup_check_window_ms); // 16k sets x 4 ways - 1M
 		}
 	}
 	~pcapProcessData() {
-		if(this->prevmd5s) {
-			delete [] this->prevmd5s;
+		if(this->dedupTable) {
+			delete this->dedupTable;
 		}
 		ipfrag_prune(0, true, &ipfrag_data, -1, 0);
 	}
@@ -398,8 +508,7 @@ struct pcapProcessData {
 	int istcp;
 	int isother;
 	sPacketInfoData pid;
-	unsigned char *prevmd5s;
-	MD5_CTX ctx;
+	cDedupTable *dedupTable;
 	u_int ipfrag_lastprune;
 	ipfrag_data_s ipfrag_data;
 };
@@ -417,10 +526,24 @@ public:
 	PcapQueue_readFromInterface_base(const char *interfaceName = NULL);
 	virtual ~PcapQueue_readFromInterface_base();
 	void setInterfaceName(const char *interfaceName);
+	void setFanout(u_int16_t fanoutGroup, int fanoutIndex);
+	void setLoadGenerator(int index);
 protected:
 	virtual bool startCapture(string *error);
 	inline int pcap_next_ex_iface(pcap_t *pcapHandle, pcap_pkthdr** header, u_char** packet,
 				      bool checkProtocol = false, sCheckProtocolData *checkProtocolData = NULL);
+	inline int check_protocol(pcap_pkthdr* header, u_char* packet,
+				  bool checkProtocol, sCheckProtocolData *checkProtocolData);
+	inline void checkPrefilter() {
+		extern volatile int capture_prefilter_version;
+		if(this->prefilterUse &&
+		   (!(++this->prefilterCheckCounter % 10000) ||
+		    this->prefilterVersion != capture_prefilter_version)) {
+			this->updatePrefilter();
+		}
+	}
+	string getCaptureFilter();
+	void updatePrefilter();
 	void restoreOneshotBuffer();
 	inline int pcap_dispatch(pcap_t *pcapHandle);
 	inline int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
@@ -431,6 +554,7 @@ protected:
 	virtual ulong getCountPacketDrop();
 	virtual string getStatPacketDrop();
 	virtual void initStat_interface();
+	bool getPcapStat(pcap_stat *ps, u_int64_t *freezes = NULL);
 	virtual string getInterfaceName(bool simple = false);
 	inline bool useOneshotBuffer() {
 		return(libpcap_buffer);
@@ -454,11 +578,22 @@ protected:
 	int pcapLinklayerHeaderType;
 	size_t pcap_snaplen;
 	pcapProcessData ppd;
+	cTPacketV3Ring *tpacketRing;
+	cLoadGenerator *loadGenerator;
+	int loadGeneratorIndex;
+	u_int16_t fanoutGroup;
+	int fanoutIndex;
+	bool prefilterUse;
+	string prefilter;
+	int prefilterVersion;
+	u_int32_t prefilterCheckCounter;
+	u_int64_t prefilterLastCheckMS;
 private:
 	int pcap_promisc;
 	int pcap_timeout;
 	int pcap_buffer_size;
 	pcap_stat last_ps;
+	u_int64_t last_tpacket_freezes;
 	u_long countPacketDrop;
 	u_int64_t lastPacketTimeUS;
 	u_int64_t lastTimeLogErrPcapNextExNullPacket;
@@ -612,7 +747,9 @@ public:
 	};
 	PcapQueue_readFromInterfaceThread(const char *interfaceName, eTypeInterfaceThread typeThread = read,
 					  PcapQueue_readFromInterfaceThread *readThread = NULL,
-					  PcapQueue_readFromInterfaceThread *prevThread = NULL);
+					  PcapQueue_readFromInterfaceThread *prevThread = NULL,
+					  u_int16_t fanoutGroup = 0, int fanoutIndex = 0,
+					  int loadGeneratorIndex = -1);
 	~PcapQueue_readFromInterfaceThread();
 protected:
 	inline void push(sHeaderPacket **header_packet);
@@ -674,6 +811,9 @@ private:
 	void *threadFunction(void *arg, unsigned int arg2);
 	void threadFunction_blocks();
 	void processBlock(pcap_block_store *block);
+	void readBlock_tpacket(pcap_block_store **block);
+	void readBlock_generator(pcap_block_store **block);
+	inline bool can_push_block();
 	void preparePstatData();
 	double getCpuUsagePerc(bool preparePstatData = false);
 	double getQringFillingPerc() {
@@ -806,11 +946,31 @@ public:
 			this->threadId = 0;
 			memset(this->threadPstatData, 0, sizeof(this->threadPstatData));
 			this->block_counter = 0;
+			this->ioThread = -1;
+			this->lastReadTimeMS = 0;
+			this->epollEvents = 0;
+			this->pushPending = false;
+			this->pushPendingConfirm = false;
+			this->blockStore = new FILE_LINE(15051) pcap_block_store;
+			this->bufferSize = 1000;
+			this->buffer = new FILE_LINE(15052) u_char[this->bufferSize * 2];
+			this->bufferLen = 0;
+			this->offsetBufferSyncRead = 0;
+			this->syncBeginBlock = true;
+			this->countErrors = 0;
+			this->lastTimeErrorLogMS = 0;
+			this->sensorId = 0;
+			this->detectSensorName = false;
+			this->detectSensorTime = false;
+			this->require_confirmation = -1;
+			this->mirrorWindow = false;
 		}
 		~sPacketServerConnection() {
 			if(this->socketClient) {
 				close(this->socketClient);
 			}
+			delete [] this->buffer;
+			delete this->blockStore;
 		}
 		int socketClient;
 		vmIP socketClientIP;
@@ -822,6 +982,55 @@ public:
 		int threadId;
 		pstat_data threadPstatData[2];
 		u_int32_t block_counter;
+		int ioThread;
+		u_int64_t lastReadTimeMS;
+		// io thread (non-blocking socket) - replies not sent yet, block waiting for space in store queue
+		string sendBuffer;
+		u_int32_t epollEvents;
+		bool pushPending;
+		bool pushPendingConfirm;
+		// receiving state
+		pcap_block_store *blockStore;
+		size_t bufferSize;
+		u_char *buffer;
+		size_t bufferLen;
+		size_t offsetBufferSyncRead;
+		bool syncBeginBlock;
+		unsigned countErrors;
+		u_int64_t lastTimeErrorLogMS;
+		int sensorId;
+		string sensorName;
+		string sensorTime;
+		bool detectSensorName;
+		bool detectSensorTime;
+		int require_confirmation;
+		bool mirrorWindow;
+		string mirrorWindowKey;
+	};
+	struct sPacketServerIoThread {
+		sPacketServerIoThread(PcapQueue_readFromFifo *parent, unsigned int index) {
+			this->parent = parent;
+			this->index = index;
+			this->epollFd = -1;
+			this->threadHandle = 0;
+			this->threadId = 0;
+			memset(this->threadPstatData, 0, sizeof(this->threadPstatData));
+			this->_sync_connections = 0;
+		}
+		void lock_connections() {
+			while(__sync_lock_test_and_set(&this->_sync_connections, 1));
+		}
+		void unlock_connections() {
+			__sync_lock_release(&this->_sync_connections);
+		}
+		PcapQueue_readFromFifo *parent;
+		unsigned int index;
+		int epollFd;
+		pthread_t threadHandle;
+		int threadId;
+		pstat_data threadPstatData[2];
+		set<sPacketServerConnection*> connections;
+		volatile int _sync_connections;
 	};
 	struct sPacketTimeInfo {
 		pcap_block_store *blockStore;
@@ -838,6 +1047,22 @@ public:
 		u_int64_t utime_last;
 		u_int64_t at;
 	};
+	struct sMirrorWindowItem {
+		u_char *saveBuffer;
+		size_t size;
+		u_int32_t counter;
+		unsigned stripe;
+		u_int64_t sendTimeMS;
+	};
+	struct sMirrorWindowCounter {
+		sMirrorWindowCounter() {
+			counter = 0;
+			closeTimeMS = 0;
+		}
+		u_int32_t counter;
+		// time of closing connection with the key - the key is kept for blocks sent again after reconnect
+		u_int64_t closeTimeMS;
+	};
 public:
 	PcapQueue_readFromFifo(const char *nameQueue, const char *fileStoreFolder);
 	virtual ~PcapQueue_readFromFifo();
@@ -909,15 +1134,32 @@ protected:
 	double pcapStat_get_disk_buffer_perc();
 	double pcapStat_get_disk_buffer_mb();
 	string getCpuUsage(bool writeThread = false, bool preparePstatData = false);
+	string getCompressPoolStat(bool preparePstatData = false);
 	bool socketWritePcapBlock(pcap_block_store *blockStore);
 	bool socketWritePcapBlockBySnifferClient(pcap_block_store *blockStore);
+	bool socketWritePcapBlockWindow(pcap_block_store *blockStore);
+	bool socketWindowSend(sMirrorWindowItem *item);
+	void socketWindowPrepareResend(sMirrorWindowItem *item);
+	bool socketWindowReconnect(unsigned stripe);
+	void socketWindowReadAcks(bool wait);
+	bool socketWindowParseAcks(unsigned stripe);
+	void socketWindowAck(unsigned stripe, u_int32_t counter, bool oldest = false);
+	void socketWindowClear();
+	bool mirrorWindowIsDuplicate(const string &key, u_int32_t counter);
+	void mirrorWindowSetCounter(const string &key, u_int32_t counter);
+	void mirrorWindowConnectionOpen(const string &key);
+	void mirrorWindowConnectionClose(const string &key);
+	bool socketPrepareBlockCompress(pcap_block_store *blockStore, bool peerZstd);
+	void compressBlocksByPool();
+	pcap_block_store *popUncompressedBlock();
 	bool socketGetHost();
 	bool socketReadyForConnect();
-	bool socketConnect();
+	bool socketConnect(unsigned stripe = 0);
+	bool socketConnectWait(unsigned stripe = 0);
 	bool socketListen();
 	bool socketAwaitConnection(int *socketClient, vmIP *socketClientIP, vmPort *socketClientPort);
-	bool socketClose();
-	bool socketWrite(u_char *data, size_t dataLen, bool disableAutoConnect = false);
+	bool socketClose(unsigned stripe = 0);
+	bool socketWrite(u_char *data, size_t dataLen, bool disableAutoConnect = false, unsigned stripe = 0);
 	bool _socketWrite(int socket, u_char *data, size_t *dataLen, int timeout = 1);
 	bool socketRead(u_char *data, size_t *dataLen, int idConnection);
 	bool _socketRead(int socket, u_char *data, size_t *dataLen, int timeout = 1);
@@ -927,9 +1169,25 @@ protected:
 	bool isMirrorReceiver() {
 		return(this->packetServerDirection == directionRead);
 	}
+	int *getSocketHandle(unsigned stripe) {
+		return(stripe ? &this->socketHandleStripes[stripe - 1] : &this->socketHandle);
+	}
+	unsigned getMirrorStripes();
 private:
 	void createConnection(int socketClient, vmIP socketClientIP, vmPort socketClientPort);
 	void cleanupConnections(bool all = false);
+	bool connectionProcessData(sPacketServerConnection *connection, size_t readLen);
+	bool connectionCheckHeap(sPacketServerConnection *connection);
+	void connectionBlockPushed(sPacketServerConnection *connection, bool confirm);
+	bool connectionPushPendingBlock(sPacketServerConnection *connection);
+	bool connectionSend(sPacketServerConnection *connection, const char *data, size_t dataLen);
+	bool connectionSendBlockAck(sPacketServerConnection *connection, u_int32_t block_counter);
+	bool connectionFlushSend(sPacketServerConnection *connection);
+	void startIoThreads();
+	void stopIoThreads();
+	void *ioThreadFunction(sPacketServerIoThread *ioThread);
+	void ioThreadCloseConnection(sPacketServerIoThread *ioThread, sPacketServerConnection *connection);
+	void ioThreadUpdateEvents(sPacketServerConnection *connection);
 	inline int processPacket(sHeaderPacketPQout *hp, eHeaderPacketPQoutState hp_state);
 	void pushBatchProcessPacket();
 	void checkFreeSizeCachedir();
@@ -967,15 +1225,31 @@ private:
 	volatile int blockStoreTrash_sync;
 	vmIP socketHostIP;
 	int socketHandle;
+	int socketHandleStripes[PCAP_QUEUE_MIRROR_STRIPES_MAX - 1];
+	// capabilities of receiver negotiated by each connection (index is stripe, 0 is socketHandle)
+	bool socketPeerZstd[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	bool socketPeerWindow[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	u_int32_t mirrorWindowSession;
+	deque<sMirrorWindowItem> mirrorWindow;
+	string mirrorWindowAckBuffer[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	u_int64_t mirrorWindowLastAckMS[PCAP_QUEUE_MIRROR_STRIPES_MAX];
+	map<string, sMirrorWindowCounter> mirrorWindowLastCounter;
+	volatile int _sync_mirrorWindowLastCounter;
 	cSocketBlock *clientSocket;
+	bool clientSocketPeerZstd;
+	pcap_block_store_compress_pool *blockCompressPool;
+	pcap_block_store_compress_pool *blockUncompressPool;
 	map<unsigned int, sPacketServerConnection*> packetServerConnections;
 	volatile int _sync_packetServerConnections;
+	vector<sPacketServerIoThread*> packetServerIoThreads;
+	volatile bool packetServerIoThreadsTerminate;
 	u_int64_t lastCheckFreeSizeCachedir_timeMS;
 	volatile timeval _last_ts;
 	u_int32_t block_counter;
 friend void *_PcapQueue_readFromFifo_destroyBlocksThreadFunction(void *arg);
 friend void *_PcapQueue_readFromFifo_socketServerThreadFunction(void *arg);
 friend void *_PcapQueue_readFromFifo_connectionThreadFunction(void *arg);
+friend void *_PcapQueue_readFromFifo_ioThreadFunction(void *arg);
 friend class PcapQueue_outputThread;
 };
 
@@ -986,28 +1260,34 @@ public:
 		dedup
 	};
 	struct sBatchHP {
-		sBatchHP(unsigned max_count) {
+		sBatchHP(unsigned max_count, bool use_seq = false) {
 			count = 0;
 			used = 0;
 			batch = new FILE_LINE(16008) sHeaderPacketPQout[max_count];
+			seq = use_seq ? new FILE_LINE(0) u_int64_t[max_count] : NULL;
 			this->max_count = max_count;
 		}
 		~sBatchHP() {
 			delete [] batch;
+			if(seq) {
+				delete [] seq;
+			}
 		}
 		sHeaderPacketPQout *batch;
+		u_int64_t *seq;
 		volatile unsigned count;
 		volatile int used;
 		unsigned max_count;
 	};
-	PcapQueue_outputThread(eTypeOutputThread typeOutputThread, PcapQueue_readFromFifo *pcapQueue);
+	PcapQueue_outputThread(eTypeOutputThread typeOutputThread, PcapQueue_readFromFifo *pcapQueue,
+			       unsigned shards = 1, PcapQueue_outputThread *shardParent = NULL, unsigned shardIndex = 0);
 	~PcapQueue_outputThread();
 	void start();
 	void stop();
 	void terminate() {
 		this->stop();
 	}
-	inline void push(sHeaderPacketPQout *hp);
+	inline void push(sHeaderPacketPQout *hp, u_int64_t seq = 0);
 	void push_batch();
 	void *outThreadFunction();
 	inline void processDefrag(sHeaderPacketPQout *hp);
@@ -1015,14 +1295,31 @@ public:
 	string getNameOutputThread() {
 		switch(typeOutputThread) {
 		case defrag:
-			return("defrag");
+			return(shardParent ? "defrag" + intToString(shardIndex + 1) :
+			       shardsCount > 1 ? "defrag_merge" : "defrag");
 		case dedup:
-			return("dedup");
+			return(shardParent ? "dedup" + intToString(shardIndex + 1) :
+			       shardsCount > 1 ? "dedup_merge" : "dedup");
 		}
 		return("");
 	}
 	void preparePstatData();
 	double getCpuUsagePerc(bool preparePstatData);
+	unsigned getShardsCount() {
+		return(shardsCount);
+	}
+	double getShardCpuUsagePerc(unsigned shard, bool preparePstatData) {
+		return(shard < shardsCount && shardThreads ? shardThreads[shard]->getCpuUsagePerc(preparePstatData) : -1);
+	}
+private:
+	inline bool defragPacket(sHeaderPacketPQout *hp);
+	inline u_int getHeaderIpOffset(sHeaderPacketPQout *hp);
+	inline u_int64_t getDedupHash(sHeaderPacketPQout *hp);
+	inline bool checkDedup(sHeaderPacketPQout *hp);
+	inline unsigned getShard(sHeaderPacketPQout *hp);
+	inline sHeaderPacketPQout *getMergeHead(u_int64_t *seq);
+	inline void nextMergeHead();
+	void mergeShards();
 private:
 	eTypeOutputThread typeOutputThread;
 	PcapQueue_readFromFifo *pcapQueue;
@@ -1040,7 +1337,14 @@ private:
 	ipfrag_data_s ipfrag_data;
 	unsigned ipfrag_lastprune;
 	unsigned defrag_counter;
-	u_char *dedup_buffer;
+	cDedupTable *dedupTable;
+	PcapQueue_outputThread **shardThreads;
+	unsigned shardsCount;
+	PcapQueue_outputThread *shardParent;
+	unsigned shardIndex;
+	u_int64_t shard_push_seq;
+	volatile unsigned int merge_readit;
+	unsigned merge_batch_index;
 	volatile bool initThreadOk;
 	volatile bool terminatingThread;
 friend inline void *_PcapQueue_outputThread_outThreadFunction(void *arg);
@@ -1051,6 +1355,9 @@ void PcapQueue_init();
 void PcapQueue_term();
 int getThreadingMode();
 void setThreadingMode(int threadingMode);
+string capture_prefilter_expression();
+void capture_prefilter_reload();
+void test_packetbuffer_shedding_strip();
 
 u_int16_t register_pcap_handle(pcap_t *handle);
 inline pcap_t *get_pcap_handle(u_int16_t index) {
@@ -16,6 +16,7 @@
 #define PCAP_BLOCK_STORE_HEADER_STRING		"pcap_block_store"
 #define PCAP_BLOCK_STORE_HEADER_STRING_LEN	16
 #define PCAP_BLOCK_STORE_HEADER_VERSION		6
+#define PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD	7	// header is followed by pcap_block_store_header_zstd
 
 #define FLAG_AUDIOCODES 1
 #define FLAG_FRAGMENTED 2
@@ -144,7 +145,8 @@ struct pcap_block_store {
 	enum compress_method {
 		compress_method_default,
 		snappy,
-		lz4
+		lz4,
+		zstd
 	};
 	struct pcap_pkthdr_pcap {
 		pcap_pkthdr_pcap() {
@@ -178,6 +180,10 @@ struct pcap_block_store {
 			this->require_confirmation = opt_pcap_queues_mirror_require_confirmation;
 			this->time_s = 0;
 		}
+		size_t getSize() {
+			return(sizeof(pcap_block_store_header) + 
+			       (this->version == PCAP_BLOCK_STORE_HEADER_VERSION_ZSTD ? sizeof(pcap_block_store_header_zstd) : 0));
+		}
 		char title[PCAP_BLOCK_STORE_HEADER_STRING_LEN];
 		uint8_t version;
 		uint32_t size;
@@ -192,10 +198,15 @@ struct pcap_block_store {
 		uint8_t require_confirmation;
 		uint32_t time_s;
 	};
+	struct pcap_block_store_header_zstd {
+		uint32_t dictionary_id;
+	};
 	pcap_block_store(header_mode hm = plus) {
 		this->hm = hm;
 		this->offsets = NULL;
+		this->offsets_in_pool = false;
 		this->block = NULL;
+		this->block_in_pool = false;
 		this->is_voip = NULL;
 		this->destroy();
 		this->restoreBuffer = NULL;
@@ -245,13 +256,23 @@ struct pcap_block_store {
 	void destroyRestoreBuffer();
 	bool isEmptyRestoreBuffer();
 	void freeBlock();
+	void freeOffsets();
+	inline bool allocBlockFromPool(size_t size);
+	inline bool allocOffsetsFromPool(size_t count);
+	static void freeBlockBuffer(u_char *block, bool in_pool);
+	static void freeOffsetsBuffer(uint32_t *offsets, bool in_pool);
+	size_t getSizeSaveBufferHeader() {
+		// block without zstd keeps layout of version 6 - it can be received by older receiver
+		return(sizeof(pcap_block_store_header) + 
+		       (this->size_compress && this->method_compress == zstd ? sizeof(pcap_block_store_header_zstd) : 0));
+	}
 	size_t getSizeSaveBuffer() {
-		return(sizeof(pcap_block_store_header) + this->count * sizeof(uint32_t) + this->getUseSize());
+		return(this->getSizeSaveBufferHeader() + this->count * sizeof(uint32_t) + this->getUseSize());
 	}
 	int getSizeSaveBufferFromRestoreBuffer() {
 		if(this->restoreBufferSize >= sizeof(pcap_block_store_header)) {
 			pcap_block_store_header *header = (pcap_block_store_header*)this->restoreBuffer;
-			return(sizeof(pcap_block_store_header) + header->count * sizeof(uint32_t) + 
+			return(header->getSize() + header->count * sizeof(uint32_t) + 
 			       (header->size_compress ? header->size_compress : header->size));
 		}
 		return(-1);
@@ -259,16 +280,18 @@ struct pcap_block_store {
 	size_t getUseSize() {
 		return(this->size_compress ? this->size_compress : this->size);
 	}
-	u_char *getSaveBuffer(uint32_t block_counter = 0);
+	u_char *getSaveBuffer(uint32_t block_counter = 0, u_char *saveBuffer = NULL);
 	void restoreFromSaveBuffer(u_char *saveBuffer);
 	int addRestoreChunk(u_char *buffer, size_t size, size_t *offset = NULL, bool restoreFromStore = false, string *error = NULL);
 	string addRestoreChunk_getErrorString(int errorCode);
 	inline bool compress();
 	bool compress_snappy();
 	bool compress_lz4();
+	bool compress_zstd();
 	inline bool uncompress(compress_method method = compress_method_default);
 	bool uncompress_snappy();
 	bool uncompress_lz4();
+	bool uncompress_zstd();
 	bool check_offsets() {
 		for(size_t i = 0; i < this->offsets_size - 1; i++) {
 			if(this->offsets[i] >= this->offsets[i + 1]) {
@@ -368,8 +391,12 @@ struct pcap_block_store {
 	header_mode hm;
 	uint32_t *offsets;
 	u_char *block;
+	bool offsets_in_pool;
+	bool block_in_pool;
 	size_t size;
 	size_t size_compress;
+	u_int8_t method_compress;
+	u_int32_t dictionary_id;
 	size_t size_packets;
 	size_t count;
 	size_t offsets_size;
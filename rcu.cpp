@@ -0,0 +1,107 @@
+#include <string.h>
+#include <syslog.h>
+
+#include "tools.h"
+#include "rcu.h"
+
+
+#define RCU_RECLAIM_BATCH 64
+
+
+volatile int cRcu::readersCount = 0;
+volatile int cRcu::readersUsed[RCU_READERS_MAX];
+pthread_key_t cRcu::readerKey;
+volatile int cRcu::readerKeyInit = 0;
+__thread int cRcu::readerSlot = -1;
+
+
+cRcu::cRcu() {
+	memset((void*)readers, 0, sizeof(readers));
+	epoch = 1;
+}
+
+cRcu::~cRcu() {
+	while(!retired.empty()) {
+		retired.front().destroy(retired.front().item);
+		retired.pop_front();
+	}
+}
+
+void cRcu::retire(void *item, void (*destroy)(void*)) {
+	sRetired retiredItem;
+	retiredItem.item = item;
+	retiredItem.destroy = destroy;
+	retiredItem.epoch = epoch;
+	retired.push_back(retiredItem);
+	if(retired.size() >= RCU_RECLAIM_BATCH) {
+		reclaim();
+	}
+}
+
+void cRcu::reclaim() {
+	if(retired.empty()) {
+		return;
+	}
+	__sync_fetch_and_add(&epoch, 1);
+	__sync_synchronize();
+	u_int64_t minEpoch = getMinReaderEpoch();
+	while(!retired.empty() && retired.front().epoch < minEpoch) {
+		retired.front().destroy(retired.front().item);
+		retired.pop_front();
+	}
+}
+
+void cRcu::synchronize() {
+	u_int64_t syncEpoch = advanceEpoch();
+	while(!isQuiescent(syncEpoch)) {
+		USLEEP(10);
+	}
+}
+
+void cRcu::registerReader() {
+	if(readerKeyInit != 2) {
+		if(__sync_bool_compare_and_swap(&readerKeyInit, 0, 1)) {
+			pthread_key_create(&readerKey, unregisterReader);
+			readerKeyInit = 2;
+		} else {
+			while(readerKeyInit != 2) {
+				USLEEP(10);
+			}
+		}
+	}
+	for(int i = 0; i < RCU_READERS_MAX; i++) {
+		if(!readersUsed[i] && __sync_bool_compare_and_swap(&readersUsed[i], 0, 1)) {
+			while(readersCount <= i) {
+				__sync_bool_compare_and_swap(&readersCount, readersCount, i + 1);
+			}
+			readerSlot = i;
+			pthread_setspecific(readerKey, (void*)(long)(i + 1));
+			return;
+		}
+	}
+	readerSlot = -2;
+	static volatile int syslogOverflow = 0;
+	if(__sync_bool_compare_and_swap(&syslogOverflow, 0, 1)) {
+		syslog(LOG_NOTICE, "rcu: too many reader threads, next threads use lock of writers");
+	}
+}
+
+void cRcu::unregisterReader(void *slot) {
+	// epoch of slot is zero - read sections are not left open at end of thread
+	__sync_lock_release(&readersUsed[(long)slot - 1]);
+}
+
+u_int64_t cRcu::getMinReaderEpoch() {
+	u_int64_t minEpoch = (u_int64_t)-1;
+	int count = readersCount;
+	if(count > RCU_READERS_MAX) {
+		count = RCU_READERS_MAX;
+	}
+	for(int i = 0; i < count; i++) {
+		u_int64_t readerEpoch = readers[i].epoch;
+		if(readerEpoch && readerEpoch < minEpoch) {
+			minEpoch = readerEpoch;
+		}
+	}
+	return(minEpoch);
+}
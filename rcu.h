@@ -0,0 +1,90 @@
+#ifndef RCU_H
+#define RCU_H
+
+
+#include <deque>
+#include <pthread.h>
+#include <sys/types.h>
+
+
+#define RCU_READERS_MAX 256
+
+
+/*
+ * Epoch based reclamation for structures with lock-free readers.
+ * Reader marks own slot with actual epoch for time of read section (read sections are not nested).
+ * Writers (serialized by own lock) unlink items and retire them - retired item is freed
+ * in batch after all readers which could see it left read section.
+ * Slot of thread is released at exit of thread. Threads over RCU_READERS_MAX have no slot - readLock returns false
+ * and the caller has to use lock of writers.
+ */
+class cRcu {
+public:
+	cRcu();
+	~cRcu();
+	inline bool readLock() {
+		int slot = getReaderSlot();
+		if(slot < 0) {
+			return(false);
+		}
+		readers[slot].epoch = epoch;
+		__sync_synchronize();
+		return(true);
+	}
+	inline bool readUnlock() {
+		int slot = readerSlot;
+		if(slot < 0) {
+			return(false);
+		}
+		__sync_lock_release(&readers[slot].epoch);
+		return(true);
+	}
+	// caller holds lock of writers
+	void retire(void *item, void (*destroy)(void*));
+	void reclaim();
+	// waits until readers active at time of call left read section
+	void synchronize();
+	// non-blocking variant of synchronize - isQuiescent(advanceEpoch()) becomes true after readers active at time of advanceEpoch left read section
+	u_int64_t advanceEpoch() {
+		u_int64_t newEpoch = __sync_add_and_fetch(&epoch, 1);
+		__sync_synchronize();
+		return(newEpoch);
+	}
+	bool isQuiescent(u_int64_t epoch) {
+		return(getMinReaderEpoch() >= epoch);
+	}
+	size_t getRetiredCount() {
+		return(retired.size());
+	}
+private:
+	static inline int getReaderSlot() {
+		if(readerSlot == -1) {
+			registerReader();
+		}
+		return(readerSlot);
+	}
+	static void registerReader();
+	static void unregisterReader(void *slot);
+	u_int64_t getMinReaderEpoch();
+private:
+	struct sReader {
+		volatile u_int64_t epoch;
+		char pad[56];
+	};
+	struct sRetired {
+		void *item;
+		void (*destroy)(void*);
+		u_int64_t epoch;
+	};
+	sReader readers[RCU_READERS_MAX];
+	volatile u_int64_t epoch;
+	std::deque<sRetired> retired;
+	static volatile int readersCount;
+	static volatile int readersUsed[RCU_READERS_MAX];
+	static pthread_key_t readerKey;
+	static volatile int readerKeyInit;
+	static __thread int readerSlot;
+};
+
+
+#endif //RCU_H
@@ -43,6 +43,7 @@ public:
 	}
 	bool push(typeItem *item, bool waitForFree, bool useLock = false) {
 		if(useLock) lock();
+		unsigned int usleepCounter = 0;
 		while(free[writeit] != 1) {
 			if(waitForFree) {
 				if(term_rqueue && *term_rqueue) {
@@ -50,7 +51,7 @@ public:
 					return(false);
 				}
 				if(useLock) unlock();
-				USLEEP(pushUsleep);
+				ADAPTIVE_WAIT(pushWait, &free[writeit], 0, pushUsleep, usleepCounter++);
 				if(useLock) lock();
 			} else {
 				if(useLock) unlock();
@@ -73,18 +74,20 @@ public:
 				writeit++;
 			}
 		#endif
+		popWait.notify();
 		if(useLock) unlock();
 		return(true);
 	}
 	bool pop(typeItem *item, bool waitForFree, bool useLock = false) {
 		if(useLock) lock();
+		unsigned int usleepCounter = 0;
 		while(free[readit] != 0) {
 			if(waitForFree) {
 				if(term_rqueue && *term_rqueue) {
 					if(useLock) unlock();
 					return(false);
 				}
-				USLEEP(popUsleep);
+				ADAPTIVE_WAIT(popWait, &free[readit], 1, popUsleep, usleepCounter++);
 			} else {
 				if(useLock) unlock();
 				return(false);
@@ -106,6 +109,7 @@ public:
 				readit++;
 			}
 		#endif
+		pushWait.notify();
 		if(useLock) unlock();
 		return(true);
 	}
@@ -125,6 +129,7 @@ public:
 				readit++;
 			}
 		#endif
+		pushWait.notify();
 		return(true);
 	}
 	bool get(typeItem *item) {
@@ -150,6 +155,7 @@ public:
 				readit++;
 			}
 		#endif
+		pushWait.notify();
 	}
 	void lock() {
 		__SYNC_LOCK(this->_sync_lock);
@@ -173,6 +179,8 @@ private:
 	v_u_int32_t readit;
 	v_u_int32_t writeit;
 	volatile int _sync_lock;
+	cAdaptiveWait pushWait;
+	cAdaptiveWait popWait;
 };
 
 
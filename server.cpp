@@ -5,6 +5,7 @@
 #include "server.h"
 #include "sql_db.h"
 #include "pcap_queue.h"
+#include "zstd_sip_dictionary.h"
 
 
 extern int opt_id_sensor;
@@ -926,7 +927,7 @@ void cSnifferServerConnection::cp_packetbuffer_block() {
 	while(!pcapQueueQ || !pcapQueueQ->threadInitIsOk()) {
 		USLEEP(10000);
 	}
-	if(!rsaAesInit()) {
+	if(!rsaAesInit(cZstdSipDictionary::getId())) {
 		delete this;
 		return;
 	}
@@ -986,10 +987,13 @@ void cSnifferServerConnection::cp_manager_command(string command) {
 	delete this;
 }
 
-bool cSnifferServerConnection::rsaAesInit() {
+bool cSnifferServerConnection::rsaAesInit(u_int32_t zstdDictionaryId) {
 	socket->generate_rsa_keys();
 	JsonExport json_rsa_key;
 	json_rsa_key.add("rsa_key", socket->get_rsa_pub_key());
+	if(zstdDictionaryId) {
+		json_rsa_key.add("zstd_dictionary_id", (int64_t)zstdDictionaryId);
+	}
 	if(!socket->writeBlock(json_rsa_key.getJson())) {
 		socket->setError("failed send rsa key");
 		return(false);
@@ -303,7 +303,7 @@ protected:
 	void cp_packetbuffer_block();
 	void cp_manager_command(string command);
 private:
-	bool rsaAesInit();
+	bool rsaAesInit(u_int32_t zstdDictionaryId = 0);
 	eTypeConnection convTypeConnection(string typeConnection);
 	void updateSensorState(int32_t sensor_id);
 	void lock_tasks() {
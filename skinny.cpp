@@ -1498,6 +1498,7 @@ void *handle_skinny2(pcap_pkthdr *header, const u_char *packet, vmIP saddr, vmPo
 		case SKINNY_ONHOOK:
 			strcpy(call->lastSIPresponse, "ON HOOK");
 			call->destroy_call_at = header->ts.tv_sec + 5;
+			calltable->cleanupTimerUpdate(call);
 			if(!is_read_from_file_by_pb()) {
 				call->removeFindTables(NULL, true);
 			}
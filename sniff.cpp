@@ -76,6 +76,10 @@ and insert them into Call class.
 #include "websocket.h"
 #include "options.h"
 #include "sniff_inline.h"
+#include "offline_pcap_reader.h"
+#include "latency_stat.h"
+#include "numa_affinity.h"
+#include "packetbuffer_shedding.h"
 
 #if HAVE_LIBTCMALLOC    
 #include <gperftools/malloc_extension.h>
@@ -108,6 +112,7 @@ extern pthread_mutex_t readpacket_thread_queue_lock;
 unsigned int defrag_counter = 0;
 unsigned int duplicate_counter = 0;
 extern struct pcap_stat pcapstat;
+extern cOfflinePcapReader *offlinePcapReader;
 int pcapstatresCount = 0;
 
 volatile unsigned int glob_last_packet_time;
@@ -711,6 +716,7 @@ void save_packet(Call *call, packet_s_process *packetS, int type, u_int8_t force
 	if(call->flags & FLAG_SKIPCDR) {
 		return;
 	}
+	cLatencyStat::add(cLatencyStat::_ls_save, packetS->getTimeUS());
 	if(packetS->pid.flags & FLAG_AUDIOCODES) {
 		forceVirtualUdp = true;
 	}
@@ -1032,6 +1038,19 @@ inline char * gettag(const void *ptr, unsigned long len, ParsePacket::ppContents
 			return(NULL);
 		}
 	}
+	const char *parseData = parseContents ? parseContents->getParseData() : NULL;
+	bool ptrInParseData = parseData &&
+			      (const char*)ptr > parseData && (const char*)ptr < parseData + parseContents->parseDataLength;
+	if(ptrInParseData) {
+		// the first occurrence of header is behind ptr - answer from index of message
+		u_int32_t l_pp;
+		const char *rc_pp = parseContents->getContentData(tag, &l_pp);
+		if(rc_pp && l_pp > 0 &&
+		   rc_pp >= (const char*)ptr && rc_pp < (const char*)ptr + len) {
+			*gettaglen = l_pp;
+			return((char*)rc_pp);
+		}
+	}
 	unsigned long register r, l, tl;
 	char *rc = NULL;
 	char *tmp;
@@ -1059,6 +1078,17 @@ inline char * gettag(const void *ptr, unsigned long len, ParsePacket::ppContents
 		//check if position ok
 		if(limitLen && *limitLen > 0) {
 			_limitLen = *limitLen;
+		} else if(ptrInParseData && parseContents->doubleEndLine && (const char*)ptr < parseContents->doubleEndLine) {
+			// end of message from index of message (without rescan of content-length)
+			if(parseContents->contentLength >= 0) {
+				const char *endMessage = parseContents->doubleEndLine + 4 + parseContents->contentLength;
+				if(endMessage > (const char*)ptr && (unsigned long)(endMessage - (const char*)ptr) < len) {
+					_limitLen = endMessage - (const char*)ptr;
+					if(limitLen) {
+						*limitLen = _limitLen;
+					}
+				}
+			}
 		} else {
 			const char *contentLengthString = "Content-Length: ";
 			char *contentLengthPos = strcasestr(tmp, contentLengthString);
@@ -2214,6 +2244,7 @@ void unlock_add_remove_rtp_threads() {
 void *rtp_read_thread_func(void *arg) {
 	rtp_read_thread *read_thread = (rtp_read_thread*)arg;
 	read_thread->threadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getRtpThreadNode(read_thread->threadNum));
 	read_thread->last_use_time_s = getTimeMS_rdtsc() / 1000;
 	unsigned int usleepCounter = 0;
 	unsigned long usleepSumTime = 0;
@@ -2228,6 +2259,7 @@ void *rtp_read_thread_func(void *arg) {
 				read_thread->last_use_time_s = getTimeMS_rdtsc() / 1000;
 				bool rslt_read_rtp = false;
 				rtp_packet_pcap_queue *rtpp_pq = &batch->batch[batch_index];
+				cLatencyStat::add(cLatencyStat::_ls_rtp, rtpp_pq->packet->getTimeUS());
 				if(!sverb.disable_read_rtp) {
 					if(rtpp_pq->is_rtcp) {
 						rslt_read_rtp = rtpp_pq->call->read_rtcp(rtpp_pq->packet, rtpp_pq->iscaller, rtpp_pq->save_packet);
@@ -2258,6 +2290,7 @@ void *rtp_read_thread_func(void *arg) {
 					read_thread->readit++;
 				}
 			#endif
+			read_thread->qringPushWait.notify();
 			usleepCounter = 0;
 			usleepSumTime = 0;
 			usleepSumTime_lastPush = 0;
@@ -2277,7 +2310,7 @@ void *rtp_read_thread_func(void *arg) {
 				}
 			}
 			// no packet to read, wait and try again
-			usleepSumTime += USLEEP_C(rtp_qring_usleep, usleepCounter++);
+			usleepSumTime += ADAPTIVE_WAIT_C(read_thread->qringPopWait, &read_thread->qring[read_thread->readit]->used, 0, rtp_qring_usleep, usleepCounter++);
 		}
 	}
 	
@@ -2885,6 +2918,7 @@ inline Call *new_invite_register(packet_s_process *packetS, int sip_method, char
 						if(registerMAPIT != ((Calltable*)calltable)->registers_listMAP.end()) {
 							((Calltable*)calltable)->registers_listMAP.erase(registerMAPIT);
 						}
+						((Calltable*)calltable)->cleanupTimerRelease(call, &((Calltable*)calltable)->registers_timer_wheel);
 						((Calltable*)calltable)->unlock_registers_listMAP();
 						delete call;
 						return(NULL);
@@ -4273,6 +4307,10 @@ endsip_save_packet:
 	}
 
 endsip:
+	if(call) {
+		calltable->cleanupTimerUpdate(call);
+	}
+	
 	if(_save_sip_history && call) {
 		bool save_request = IS_SIP_RESXXX(packetS->sip_method) ?
 				     lastSIPresponseNum && _save_sip_history_all_responses :
@@ -4378,6 +4416,7 @@ void process_packet_sip_alone_bye(packet_s_process *packetS) {
 	   call->existsByeCseq(&packetS->cseq)) {
 		call->lastSIPresponseNum = packetS->lastSIPresponseNum;
 	}
+	calltable->cleanupTimerUpdate(call);
 }
 
 void process_packet_sip_register(packet_s_process *packetS) {
@@ -4685,6 +4724,7 @@ endsip:
 	
 	if(call) {
 		call->last_sip_method = packetS->sip_method;
+		calltable->cleanupTimerUpdate(call);
 	}
 	
 	if(logPacketSipMethodCall_enable) {
@@ -5009,7 +5049,7 @@ bool process_packet_rtp(packet_s_process_0 *packetS) {
 		packet_s_process_rtp_call_info call_info[MAX_LENGTH_CALL_INFO];
 		int call_info_length = 0;
 		bool call_info_find_by_dest = false;
-		calltable->lock_calls_hash();
+		bool hash_lockfree = calltable->lock_calls_hash_read();
 		node_call_rtp *n_call = NULL;
 		if((n_call = calltable->hashfind_by_ip_port(packetS->daddr_(), packetS->dest_(), false))) {
 			call_info_find_by_dest = true;
@@ -5049,7 +5089,8 @@ bool process_packet_rtp(packet_s_process_0 *packetS) {
 				     packetS->getTimeUS() > call->seencancelandok_time_usec) &&
 				   !(opt_ignore_rtp_after_auth_failed &&
 				     call->seenauthfailed && call->seenauthfailed_time_usec &&
-				     packetS->getTimeUS() > call->seenauthfailed_time_usec)) {
+				     packetS->getTimeUS() > call->seenauthfailed_time_usec) &&
+				   !cPacketbufferShedding::skipRtpUnrecorded((call->flags & FLAG_SAVERTP) || call_rtp->is_rtcp)) {
 					/*
 					if(packetS->getTimeUS() < (call->first_packet_time * 1000000ull + call->first_packet_usec) + (0 * 60 + 0) * 1000000ull) {
 						continue;
@@ -5083,7 +5124,7 @@ bool process_packet_rtp(packet_s_process_0 *packetS) {
 				}
 			}
 		}
-		calltable->unlock_calls_hash();
+		calltable->unlock_calls_hash_read(hash_lockfree);
 		if(call_info_length) {
 			if(call_info_length > 1) {
 				packetS->set_use_reuse_counter();
@@ -6315,7 +6356,134 @@ inline void ipfrag_delete_node(ip_frag_s *node, int pushToStack_queue_index) {
 		((sHeaderPacketPQout*)node->header_packet_pqout)->destroy_or_unlock_blockstore();
 		delete ((sHeaderPacketPQout*)node->header_packet_pqout);
 	}
-	delete node;
+}
+
+ip_frag_s *ip_frag_queue::insert(u_int32_t offset) {
+	// fragments come mostly in order - search position from the end
+	unsigned pos = this->count;
+	while(pos > 0 && this->frags[pos - 1].offset > offset) {
+		--pos;
+	}
+	if(pos > 0 && this->frags[pos - 1].offset == offset) {
+		return(NULL);
+	}
+	if(this->count == this->capacity) {
+		unsigned new_capacity = this->capacity * 2;
+		ip_frag_s *new_frags = new FILE_LINE(0) ip_frag_s[new_capacity];
+		memcpy(new_frags, this->frags, sizeof(ip_frag_s) * this->count);
+		if(this->frags != this->slots) {
+			delete [] this->frags;
+		}
+		this->frags = new_frags;
+		this->capacity = new_capacity;
+	}
+	memmove(this->frags + pos + 1, this->frags + pos, sizeof(ip_frag_s) * (this->count - pos));
+	++this->count;
+	this->frags[pos].offset = offset;
+	return(&this->frags[pos]);
+}
+
+ipfrag_data_s::ipfrag_data_s() {
+	this->table_size = IPFRAG_TABLE_INIT_SIZE;
+	this->table = new FILE_LINE(0) ip_frag_queue*[this->table_size];
+	memset(this->table, 0, sizeof(ip_frag_queue*) * this->table_size);
+	this->count = 0;
+}
+
+ipfrag_data_s::~ipfrag_data_s() {
+	for(unsigned i = 0; i < this->table_size; i++) {
+		if(this->table[i]) {
+			delete this->table[i];
+		}
+	}
+	delete [] this->table;
+	for(unsigned i = 0; i < this->free_queues.size(); i++) {
+		delete this->free_queues[i];
+	}
+}
+
+ip_frag_queue *ipfrag_data_s::get(ip_frag_key *key) {
+	u_int32_t hash = key->hash();
+	unsigned mask = this->table_size - 1;
+	unsigned pos = hash & mask;
+	while(this->table[pos]) {
+		if(this->table[pos]->hash == hash && this->table[pos]->key == *key) {
+			return(this->table[pos]);
+		}
+		pos = (pos + 1) & mask;
+	}
+	if((this->count + 1) * 2 > this->table_size) {
+		this->resize(this->table_size * 2);
+		mask = this->table_size - 1;
+		pos = hash & mask;
+		while(this->table[pos]) {
+			pos = (pos + 1) & mask;
+		}
+	}
+	ip_frag_queue *queue;
+	if(this->free_queues.size()) {
+		queue = this->free_queues.back();
+		this->free_queues.pop_back();
+	} else {
+		queue = new FILE_LINE(26016) ip_frag_queue;
+	}
+	queue->key = *key;
+	queue->hash = hash;
+	this->table[pos] = queue;
+	++this->count;
+	return(queue);
+}
+
+void ipfrag_data_s::remove(ip_frag_queue *queue) {
+	unsigned mask = this->table_size - 1;
+	unsigned pos = queue->hash & mask;
+	while(this->table[pos] != queue) {
+		if(!this->table[pos]) {
+			return;
+		}
+		pos = (pos + 1) & mask;
+	}
+	// backward shift - following items of the cluster are moved to keep them reachable without tombstones
+	unsigned hole = pos;
+	unsigned next = pos;
+	while(true) {
+		next = (next + 1) & mask;
+		if(!this->table[next]) {
+			break;
+		}
+		unsigned home = this->table[next]->hash & mask;
+		if(((next - home) & mask) >= ((next - hole) & mask)) {
+			this->table[hole] = this->table[next];
+			hole = next;
+		}
+	}
+	this->table[hole] = NULL;
+	--this->count;
+	queue->reset();
+	if(this->free_queues.size() < IPFRAG_TABLE_INIT_SIZE) {
+		this->free_queues.push_back(queue);
+	} else {
+		delete queue;
+	}
+}
+
+void ipfrag_data_s::resize(unsigned new_size) {
+	ip_frag_queue **old_table = this->table;
+	unsigned old_size = this->table_size;
+	this->table = new FILE_LINE(0) ip_frag_queue*[new_size];
+	memset(this->table, 0, sizeof(ip_frag_queue*) * new_size);
+	this->table_size = new_size;
+	unsigned mask = new_size - 1;
+	for(unsigned i = 0; i < old_size; i++) {
+		if(old_table[i]) {
+			unsigned pos = old_table[i]->hash & mask;
+			while(this->table[pos]) {
+				pos = (pos + 1) & mask;
+			}
+			this->table[pos] = old_table[i];
+		}
+	}
+	delete [] old_table;
 }
 
 /*
@@ -6333,25 +6501,24 @@ inline int _ipfrag_dequeue(ip_frag_queue *queue,
 	if(!queue->size()) return 1;
 
 	// prepare newpacket structure and header structure
-	u_int32_t totallen = queue->begin()->second->header_ip_offset;
+	u_int32_t totallen = queue->begin()->header_ip_offset;
 	unsigned i = 0;
-	for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-		totallen += it->second->len;
+	for (ip_frag_s *node = queue->begin(); node != queue->end(); ++node) {
+		totallen += node->len;
 		if(i) {
-			totallen -= it->second->iphdr_len;
+			totallen -= node->iphdr_len;
 		}
 		i++;
 	}
-	if(totallen > 0xFFFF + queue->begin()->second->header_ip_offset) {
+	if(totallen > 0xFFFF + queue->begin()->header_ip_offset) {
 		if(sverb.defrag_overflow) {
-			ip_frag_queue_it_t it = queue->begin();
-			if(it != queue->end()) {
-				ip_frag_s *node = it->second;
+			ip_frag_s *node = queue->begin();
+			if(node != queue->end()) {
 				iphdr2 *iph = (iphdr2*)((u_char*)HPP(node->header_packet) + node->header_ip_offset);
 				syslog(LOG_NOTICE, "ipfrag overflow: %i src ip: %s dst ip: %s", totallen, iph->get_saddr().getString().c_str(), iph->get_daddr().getString().c_str());
 			}
 		}
-		totallen = 0xFFFF + queue->begin()->second->header_ip_offset;
+		totallen = 0xFFFF + queue->begin()->header_ip_offset;
 	}
 	
 	unsigned int additionallen = 0;
@@ -6361,8 +6528,7 @@ inline int _ipfrag_dequeue(ip_frag_queue *queue,
 	
 	if(header_packet) {
 		*header_packet = CREATE_HP(totallen);
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
+		for (ip_frag_s *node = queue->begin(); node != queue->end(); ++node) {
 			if(i == 0) {
 				// for first packet copy ethernet header and ip header
 				if(node->header_ip_offset) {
@@ -6402,8 +6568,7 @@ inline int _ipfrag_dequeue(ip_frag_queue *queue,
 		header_packet_pqout->block_store = NULL;
 		header_packet_pqout->block_store_index = 0;
 		header_packet_pqout->block_store_locked = false;
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
+		for (ip_frag_s *node = queue->begin(); node != queue->end(); ++node) {
 			if(i == 0) {
 				// for first packet copy ethernet header and ip header
 				if(node->header_ip_offset) {
@@ -6495,12 +6660,9 @@ inline int _ipfrag_add(ip_frag_queue *queue,
 		queue->has_last = true;
 	}
 
-	if(!queue->count(offset_d)) {
-		// this offset number is not yet in the queue - add packet to queue which automatically sort it into right position
-
-		// create node
-		ip_frag_s *node = new FILE_LINE(26014) ip_frag_s;
-
+	// add packet to queue (sorted by offset) if this offset number is not yet in the queue
+	ip_frag_s *node = queue->insert(offset_d);
+	if(node) {
 		if(header_packet) {
 			node->ts = HPH(*header_packet)->ts.tv_sec;
 			node->header_packet = *header_packet;
@@ -6518,9 +6680,6 @@ inline int _ipfrag_add(ip_frag_queue *queue,
 		node->len = len;
 		node->offset = offset_d;
 		node->iphdr_len = header_ip->get_hdr_size();
-
-		// add to queue (which will sort it automatically
-		(*queue)[offset_d] = node;
 	} else {
 		// node with that offset already exists - discard
 		return -1;
@@ -6529,15 +6688,14 @@ inline int _ipfrag_add(ip_frag_queue *queue,
 	// now check if packets in queue are complete - if yes - defragment - if not, do nithing
 	int ok = true;
 	unsigned int lastoffset = 0;
-	if(queue->has_last and queue->begin()->second->offset == 0) {
+	if(queue->has_last and queue->begin()->offset == 0) {
 		// queue has first and last packet - check if there are all middle fragments
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
-			if((node->offset != lastoffset)) {
+		for (ip_frag_s *frag = queue->begin(); frag != queue->end(); ++frag) {
+			if((frag->offset != lastoffset)) {
 				ok = false;
 				break;
 			}
-			lastoffset += node->len - node->iphdr_len;
+			lastoffset += frag->len - frag->iphdr_len;
 		}
 	} else {
 		// queue does not contain a last packet and does not contain a first packet
@@ -6587,33 +6745,40 @@ inline int _handle_defrag(iphdr2 *header_ip,
 			  ipfrag_data_s *ipfrag_data,
 			  int pushToStack_queue_index) {
  
-	//copy header ip to tmp beacuse it can happen that during exectuion of this function the header_ip can be 
+	//copy key and length of header ip beacuse it can happen that during exectuion of this function the header_ip can be 
 	//overwriten in kernel ringbuffer if the ringbuffer is small and thus header_ip->saddr can have different value 
-	iphdr2 *header_ip_orig = (iphdr2*)new FILE_LINE(0) u_char[header_ip->get_hdr_size()];
-	memcpy(header_ip_orig, header_ip, header_ip->get_hdr_size());
-
-	// get queue from ip_frag_stream based on source ip address and ip->id identificator (2-dimensional map array)
-	ip_frag_queue *queue = ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()][header_ip_orig->get_frag_id()];
-	if(!queue) {
-		// queue does not exists yet - create it and assign to map 
-		queue = new FILE_LINE(26016) ip_frag_queue;
-		ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()][header_ip_orig->get_frag_id()] = queue;
+	ip_frag_key key;
+	key.saddr = header_ip->get_saddr();
+	key.daddr = header_ip->get_daddr();
+	#if VM_IPV6
+	if(header_ip->version == 6) {
+		// id and protocol from one pass over extension headers
+		ip6_frag *frag = (ip6_frag*)((ip6hdr2*)header_ip)->get_ext_header(IPPROTO_FRAGMENT);
+		key.id = frag ? ntohl(frag->ip6f_ident) : 0;
+		key.proto = frag ? frag->ip6f_nxt : 0;
+	} else {
+	#endif
+		key.id = header_ip->get_frag_id();
+		key.proto = header_ip->get_protocol();
+	#if VM_IPV6
 	}
+	#endif
+	u_int32_t tot_len = header_ip->get_tot_len();
+
+	// get queue from hash table based on source and destination ip address, ip->id identificator and protocol
+	ip_frag_queue *queue = ipfrag_data->get(&key);
 	int res = header_packet ?
 		   ipfrag_add(queue,
 			      header_packet, 
-			      (u_char*)header_ip - HPP(*header_packet), header_ip_orig->get_tot_len(),
+			      (u_char*)header_ip - HPP(*header_packet), tot_len,
 			      pushToStack_queue_index) :
 		   ipfrag_add(queue,
 			      header_packet_pqout, 
-			      (u_char*)header_ip - header_packet_pqout->packet, header_ip_orig->get_tot_len());
+			      (u_char*)header_ip - header_packet_pqout->packet, tot_len);
 	if(res > 0) {
-		// packet was created from all pieces - delete queue and remove it from map
-		ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()].erase(header_ip_orig->get_frag_id());
-		delete queue;
-	};
-	
-	delete header_ip_orig;
+		// packet was created from all pieces - release queue
+		ipfrag_data->remove(queue);
+	}
 	
 	return res;
 }
@@ -6635,26 +6800,27 @@ void ipfrag_prune(unsigned int tv_sec, bool all, ipfrag_data_s *ipfrag_data,
 	if(prune_limit < 0) {
 		prune_limit = 30;
 	}
-	ip_frag_queue *queue;
-	for (ipfrag_data->ip_frag_streamIT = ipfrag_data->ip_frag_stream.begin(); ipfrag_data->ip_frag_streamIT != ipfrag_data->ip_frag_stream.end(); ipfrag_data->ip_frag_streamIT++) {
-		for (ipfrag_data->ip_frag_streamITinner = (*ipfrag_data->ip_frag_streamIT).second.begin(); ipfrag_data->ip_frag_streamITinner != (*ipfrag_data->ip_frag_streamIT).second.end();) {
-			queue = ipfrag_data->ip_frag_streamITinner->second;
-			if(!queue->size()) {
-				ipfrag_data->ip_frag_streamIT->second.erase(ipfrag_data->ip_frag_streamITinner++);
-				delete queue;
-				continue;
-			}
-			if(all or ((tv_sec - queue->begin()->second->ts) > prune_limit)) {
-				for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-					ip_frag_s *node = it->second;
-					ipfrag_delete_node(node, pushToStack_queue_index);
-				}
-				ipfrag_data->ip_frag_streamIT->second.erase(ipfrag_data->ip_frag_streamITinner++);
-				delete queue;
-				continue;
-			}
-			ipfrag_data->ip_frag_streamITinner++;
+	if(!ipfrag_data->size()) {
+		return;
+	}
+	vector<ip_frag_queue*> prune_queues;
+	for(unsigned i = 0; i < ipfrag_data->table_size; i++) {
+		ip_frag_queue *queue = ipfrag_data->table[i];
+		if(!queue) {
+			continue;
+		}
+		if(!queue->size() ||
+		   all or ((tv_sec - queue->begin()->ts) > prune_limit)) {
+			prune_queues.push_back(queue);
+		}
+	}
+	// removing shifts items in table - queues are removed after walk
+	for(unsigned i = 0; i < prune_queues.size(); i++) {
+		ip_frag_queue *queue = prune_queues[i];
+		for(ip_frag_s *node = queue->begin(); node != queue->end(); ++node) {
+			ipfrag_delete_node(node, pushToStack_queue_index);
 		}
+		ipfrag_data->remove(queue);
 	}
 }
 
@@ -6691,7 +6857,9 @@ void readdump_libpcap(pcap_t *handle, u_int16_t handle_index) {
 	while (!is_terminating()) {
 		pcap_pkthdr *pcap_next_ex_header;
 		const u_char *pcap_next_ex_packet;
-		int res = pcap_next_ex(handle, &pcap_next_ex_header, &pcap_next_ex_packet);
+		int res = offlinePcapReader ?
+			   offlinePcapReader->next(&pcap_next_ex_header, &pcap_next_ex_packet) :
+			   pcap_next_ex(handle, &pcap_next_ex_header, &pcap_next_ex_packet);
 		
 		if(!pcap_next_ex_packet and res != -2) {
 			if(verbosity > 2) {
@@ -7677,10 +7845,12 @@ void *PreProcessPacket::outThreadFunction() {
 		 pthread_attr_destroy(&thAttr);
 	}
 	this->outThreadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	syslog(LOG_NOTICE, "start PreProcessPacket out thread %s/%i", this->getNameTypeThread().c_str(), this->outThreadId);
 	packet_s_process *packetS;
 	batch_packet_s *batch_detach;
 	batch_packet_s_process *batch;
+	cLatencyStat::eStage latencyStage = this->getLatencyStage();
 	unsigned int usleepCounter = 0;
 	u_int64_t usleepSumTimeForPushBatch = 0;
 	while(!this->term_preProcess) {
@@ -7690,6 +7860,7 @@ void *PreProcessPacket::outThreadFunction() {
 			if(this->typePreProcessThread == ppt_detach) {
 				batch_detach = this->qring_detach[this->readit];
 				for(unsigned batch_index = 0; batch_index < batch_detach->count; batch_index++) {
+					cLatencyStat::add(latencyStage, batch_detach->batch[batch_index]->getTimeUS());
 					this->process_DETACH_plus(batch_detach->batch[batch_index]);
 					batch_detach->batch[batch_index]->_packet_alloc = false;
 				}
@@ -7700,6 +7871,7 @@ void *PreProcessPacket::outThreadFunction() {
 					batch_detach->count = 0;
 					batch_detach->used = 0;
 				#endif
+				this->qringPushWait.notify();
 			} else {
 				batch = this->qring[this->readit];
 				__SYNC_LOCK(this->_sync_count);
@@ -7711,6 +7883,7 @@ void *PreProcessPacket::outThreadFunction() {
 					if(is_terminating()) {
 						PACKET_S_PROCESS_DESTROY(&packetS);
 					} else {
+						cLatencyStat::add(latencyStage, packetS->getTimeUS());
 						switch(this->typePreProcessThread) {
 						case ppt_detach:
 							break;
@@ -7775,6 +7948,7 @@ void *PreProcessPacket::outThreadFunction() {
 					batch->count = 0;
 					batch->used = 0;
 				#endif
+				this->qringPushWait.notify();
 			}
 			#if RQUEUE_SAFE
 				__SYNC_INCR(this->readit, this->qring_length);
@@ -7862,7 +8036,11 @@ void *PreProcessPacket::outThreadFunction() {
 				}
 				usleepSumTimeForPushBatch = 0;
 			}
-			usleepSumTimeForPushBatch += USLEEP_C(opt_preprocess_packets_qring_usleep, usleepCounter++);
+			usleepSumTimeForPushBatch += ADAPTIVE_WAIT_C(this->qringPopWait,
+								     this->typePreProcessThread == ppt_detach ?
+								      &this->qring_detach[this->readit]->used :
+								      &this->qring[this->readit]->used,
+								     0, opt_preprocess_packets_qring_usleep, usleepCounter++);
 		}
 	}
 	this->outThreadState = 0;
@@ -8522,7 +8700,8 @@ void PreProcessPacket::process_getLastSipResponse(packet_s_process **packetS_ref
 
 void PreProcessPacket::process_findCall(packet_s_process **packetS_ref) {
 	packet_s_process *packetS = *packetS_ref;
-	packetS->call = calltable->find_by_call_id(packetS->get_callid(), 0, packetS->callid_alternative, packetS->getTime_s());
+	packetS->call = calltable->find_by_call_id(packetS->get_callid(), 0, packetS->callid_alternative, packetS->getTime_s(),
+						   packetS->callid_hash);
 	if(packetS->call) {
 		if(pcap_drop_flag) {
 			packetS->call->pcap_drop = pcap_drop_flag;
@@ -8693,6 +8872,7 @@ void *ProcessRtpPacket::outThreadFunction() {
 		 pthread_attr_destroy(&thAttr);
 	}
 	this->outThreadId = get_unix_tid();
+	cNumaAffinity::bindThread(cNumaAffinity::getPrimaryNode());
 	syslog(LOG_NOTICE, "start ProcessRtpPacket %s out thread %i", this->type == hash ? "hash" : "distribute", this->outThreadId);
 	unsigned int usleepCounter = 0;
 	u_int64_t usleepSumTimeForPushBatch = 0;
@@ -8812,7 +8992,8 @@ void ProcessRtpPacket::rtp_batch(batch_packet_s_process *batch, unsigned count)
 		for(unsigned batch_index = 0; batch_index < count; batch_index++) {
 			this->hash_find_flag[batch_index] = 0;
 		}
-		calltable->lock_calls_hash();
+		// read section covers also next threads - they run only inside it
+		bool hash_lockfree = calltable->lock_calls_hash_read();
 		if(this->next_thread_handle[0]) {
 			for(int i = 0; i < MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS; i++) {
 				this->hash_thread_data[i].null();
@@ -8887,7 +9068,7 @@ void ProcessRtpPacket::rtp_batch(batch_packet_s_process *batch, unsigned count)
 				}
 			}
 		}
-		calltable->unlock_calls_hash();
+		calltable->unlock_calls_hash_read(hash_lockfree);
 		for(;batch_index_distribute < count; batch_index_distribute++) {
 			packet_s_process_0 *packetS = batch->batch[batch_index_distribute];
 			batch->batch[batch_index_distribute] = NULL;
@@ -8969,8 +9150,9 @@ void ProcessRtpPacket::find_hash(packet_s_process_0 *packetS, bool lock) {
 	packetS->blockstore_addflag(31 /*pb lock flag*/);
 	packetS->call_info_length = 0;
 	packetS->call_info_find_by_dest = false;
+	bool hash_lockfree = false;
 	if(lock) {
-		calltable->lock_calls_hash();
+		hash_lockfree = calltable->lock_calls_hash_read();
 	}
 	node_call_rtp *n_call = NULL;
 	if((n_call = calltable->hashfind_by_ip_port(packetS->daddr_(), packetS->dest_(), false))) {
@@ -9014,7 +9196,8 @@ void ProcessRtpPacket::find_hash(packet_s_process_0 *packetS, bool lock) {
 			     call->seenauthfailed && call->seenauthfailed_time_usec &&
 			     packetS->getTimeUS() > call->seenauthfailed_time_usec) &&
 			   !(opt_hash_modify_queue_length_ms && call->end_call_rtp) &&
-			   !(call->flags & FLAG_SKIPCDR)) {
+			   !(call->flags & FLAG_SKIPCDR) &&
+			   !cPacketbufferShedding::skipRtpUnrecorded((call->flags & FLAG_SAVERTP) || call_rtp->is_rtcp)) {
 				++counter_rtp_packets[1];
 				packetS->blockstore_addflag(34 /*pb lock flag*/);
 				packetS->call_info[packetS->call_info_length].call = call;
@@ -9045,7 +9228,7 @@ void ProcessRtpPacket::find_hash(packet_s_process_0 *packetS, bool lock) {
 		}
 	}
 	if(lock) {
-		calltable->unlock_calls_hash();
+		calltable->unlock_calls_hash_read(hash_lockfree);
 	}
 }
 
@@ -9165,11 +9348,13 @@ void rtp_read_thread::init_qring(size_t qring_length) {
 
 void rtp_read_thread::alloc_qring() {
 	if(!this->qring) {
+		int prevAllocNode = cNumaAffinity::setAllocNode(cNumaAffinity::getRtpThreadNode(this->threadNum));
 		this->qring = new FILE_LINE(26036) batch_packet_rtp*[this->qring_length];
 		for(unsigned int i = 0; i < this->qring_length; i++) {
 			this->qring[i] = new FILE_LINE(26037) batch_packet_rtp(this->qring_batch_item_length);
 			this->qring[i]->used = 0;
 		}
+		cNumaAffinity::restoreAllocNode(prevAllocNode);
 	}
 }
 
@@ -431,6 +431,7 @@ struct packet_s_process : public packet_s_process_0 {
 	u_int32_t sipDataLen;
 	char callid[128];
 	char *callid_long;
+	u_int32_t callid_hash;
 	vector<string> *callid_alternative;
 	int sip_method;
 	sCseq cseq;
@@ -461,6 +462,7 @@ struct packet_s_process : public packet_s_process_0 {
 		sipDataLen = 0;
 		callid[0] = 0;
 		callid_long = NULL;
+		callid_hash = 0;
 		callid_alternative = NULL;
 		sip_method = -1;
 		cseq.null();
@@ -501,6 +503,7 @@ struct packet_s_process : public packet_s_process_0 {
 			strncpy(callid, callid_input, callid_length);
 			callid[callid_length] = 0;
 		}
+		callid_hash = cCallIdTable::hash(get_callid(), strlen(get_callid()));
 	}
 	void set_callid_alternative(char *callid, unsigned callid_length) {
 		if(!callid_alternative) {
@@ -650,7 +653,7 @@ public:
 				batch_packet_rtp *current_batch = this->qring[this->writeit];
 				unsigned int usleepCounter = 0;
 				while(current_batch->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					ADAPTIVE_WAIT_C(this->qringPushWait, &current_batch->used, 1, 20, usleepCounter++);
 				}
 				memcpy(current_batch->batch, thread_buffer->batch, sizeof(rtp_packet_pcap_queue) * thread_buffer->count);
 				#if RQUEUE_SAFE
@@ -668,6 +671,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringPopWait.notify();
 				
 				/* destroy threadbuffer array - debug
 				end_thread_buffer_copy:
@@ -706,7 +710,7 @@ public:
 				packet->blockstore_addflag(62 /*pb lock flag*/);
 				unsigned int usleepCounter = 0;
 				while(this->qring[this->writeit]->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					ADAPTIVE_WAIT_C(this->qringPushWait, &this->qring[this->writeit]->used, 1, 20, usleepCounter++);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -740,6 +744,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringPopWait.notify();
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -774,6 +779,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringPopWait.notify();
 			qring_push_index = 0;
 			qring_push_index_count = 0;
 		}
@@ -801,7 +807,7 @@ public:
 			batch_packet_rtp *current_batch = this->qring[this->writeit];
 			unsigned int usleepCounter = 0;
 			while(current_batch->used != 0) {
-				USLEEP_C(20, usleepCounter++);
+				ADAPTIVE_WAIT_C(this->qringPushWait, &current_batch->used, 1, 20, usleepCounter++);
 			}
 			memcpy(current_batch->batch, thread_buffer->batch, sizeof(rtp_packet_pcap_queue) * thread_buffer->count);
 			#if RQUEUE_SAFE
@@ -819,6 +825,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringPopWait.notify();
 			thread_buffer->count = 0;
 			__sync_lock_release(&this->push_lock_sync);
 		}
@@ -846,6 +853,8 @@ public:
 	volatile u_int32_t calls;
 	volatile int push_lock_sync;
 	volatile int count_lock_sync;
+	cAdaptiveWait qringPushWait;
+	cAdaptiveWait qringPopWait;
 };
 
 #define MAXLIVEFILTERS 10
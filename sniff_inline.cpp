@@ -742,9 +742,9 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 	cout << "packet " << (++counter) << " " << HPH(*header_packet)->ts.tv_sec << "." << setw(6) << setfill('0') << HPH(*header_packet)->ts.tv_usec;
 	#endif
 	if(((ppf & ppf_calcMD5) || (ppf & ppf_dedup)) && ppd->header_ip) {
-		// check for duplicate packets (md5 is expensive operation - enable only if you really need it
+		// check for duplicate packets (hash of content seen in time window)
 		if(opt_dup_check && 
-		   ppd->prevmd5s != NULL && 
+		   ppd->dedupTable != NULL && 
 		   (((ppf & ppf_defragInPQout) && is_ip_frag == 1) ||
 		    (ppd->datalen > 0 && (opt_dup_check_ipheader || ppd->traillen < ppd->datalen))) &&
 		   !(ppd->istcp && opt_enable_http && (httpportmatrix[ppd->header_tcp->get_source()] || httpportmatrix[ppd->header_tcp->get_dest()])) &&
@@ -764,28 +764,31 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 					ppd->header_ip->set_check(0);
 					header_ip_set_orig = true;
 				}
-				MD5_Init(&ppd->ctx);
+				u_int64_t hash;
 				if((ppf & ppf_defragInPQout) && is_ip_frag == 1) {
 					u_int32_t caplen = header_packet ? HPH(*header_packet)->caplen : pcap_header_plus2->get_caplen();
-					MD5_Update(&ppd->ctx, ppd->header_ip, MIN(caplen - ppd->header_ip_offset, ppd->header_ip->get_tot_len()));
+					hash = dedup_hash(ppd->header_ip, MIN(caplen - ppd->header_ip_offset, ppd->header_ip->get_tot_len()));
 				} else if(opt_dup_check_ipheader) {
-					MD5_Update(&ppd->ctx, ppd->header_ip, MIN(ppd->datalen + (ppd->data - (char*)ppd->header_ip), ppd->header_ip->get_tot_len()));
+					hash = dedup_hash(ppd->header_ip, MIN(ppd->datalen + (ppd->data - (char*)ppd->header_ip), ppd->header_ip->get_tot_len()));
 				} else {
 					// check duplicates based only on data (without ip header and without UDP/TCP header). Duplicate packets 
 					// will be matched regardless on IP 
-					MD5_Update(&ppd->ctx, ppd->data, MAX(0, (unsigned long)ppd->datalen - ppd->traillen));
+					hash = dedup_hash(ppd->data, MAX(0, (unsigned long)ppd->datalen - ppd->traillen));
 				}
-				MD5_Final((unsigned char*)_md5, &ppd->ctx);
+				dedup_hash_to_md5(hash, _md5);
 				if(header_ip_set_orig) {
 					ppd->header_ip->set_ttl(header_ip_ttl_orig);
 					ppd->header_ip->set_check(header_ip_check_orig);
 				}
 				#ifdef DEDUP_DEBUG
-				cout << " " << MD5_String((unsigned char*)_md5);
+				cout << " " << hex << hash << dec;
 				#endif
 			}
 			if((ppf & ppf_dedup) && _md5[0]) {
-				if(memcmp(_md5, ppd->prevmd5s + (_md5[0] * MD5_DIGEST_LENGTH), MD5_DIGEST_LENGTH) == 0) {
+				u_int64_t time_us = header_packet ?
+						     HPH(*header_packet)->ts.tv_sec * 1000000ull + HPH(*header_packet)->ts.tv_usec :
+						     pcap_header_plus2->get_tv_sec() * 1000000ull + pcap_header_plus2->get_tv_usec();
+				if(ppd->dedupTable->check(dedup_hash_from_md5(_md5), time_us)) {
 					//printf("dropping duplicate md5[%s]\n", md5);
 					duplicate_counter++;
 					if(sverb.dedup) {
@@ -799,7 +802,6 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 					#endif
 					return(0);
 				}
-				memcpy(ppd->prevmd5s + (_md5[0] * MD5_DIGEST_LENGTH), _md5, MD5_DIGEST_LENGTH);
 			}
 		}
 	}
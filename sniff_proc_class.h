@@ -7,6 +7,7 @@
 #include "sniff.h"
 #include "calltable.h"
 #include "websocket.h"
+#include "latency_stat.h"
 
 
 class TcpReassemblySip {
@@ -414,7 +415,7 @@ public:
 			if(!qring_push_index) {
 				unsigned int usleepCounter = 0;
 				while(this->qring_detach[this->writeit]->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					ADAPTIVE_WAIT_C(this->qringPushWait, &this->qring_detach[this->writeit]->used, 1, 20, usleepCounter++);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -448,6 +449,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringPopWait.notify();
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -472,7 +474,7 @@ public:
 					if(usleepCounter == 0) {
 						++qringPushCounter_full;
 					}
-					USLEEP_C(20, usleepCounter++);
+					ADAPTIVE_WAIT_C(this->qringPushWait, &this->qring[this->writeit]->used, 1, 20, usleepCounter++);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -494,6 +496,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringPopWait.notify();
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -606,6 +609,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringPopWait.notify();
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -849,6 +853,33 @@ public:
 		}
 		return("");
 	}
+	cLatencyStat::eStage getLatencyStage() {
+		switch(typePreProcessThread) {
+		case ppt_detach:
+		#ifdef PREPROCESS_DETACH2
+		case ppt_detach2:
+		#endif
+			return(cLatencyStat::_ls_pp_detach);
+		case ppt_sip:
+			return(cLatencyStat::_ls_pp_sip);
+		case ppt_extend:
+			return(cLatencyStat::_ls_pp_extend);
+		case ppt_pp_call:
+			return(cLatencyStat::_ls_pp_call);
+		case ppt_pp_callx:
+			return(cLatencyStat::_ls_pp_callx);
+		case ppt_pp_register:
+			return(cLatencyStat::_ls_pp_register);
+		case ppt_pp_sip_other:
+			return(cLatencyStat::_ls_pp_sip_other);
+		case ppt_pp_rtp:
+			return(cLatencyStat::_ls_pp_rtp);
+		case ppt_pp_other:
+		case ppt_end_base:
+			break;
+		}
+		return(cLatencyStat::_ls_pp_other);
+	}
 	string getShortcatTypeThread() {
 		switch(typePreProcessThread) {
 		case ppt_detach:
@@ -933,6 +964,8 @@ private:
 	int outThreadId;
 	volatile int _sync_push;
 	volatile int _sync_count;
+	cAdaptiveWait qringPushWait;
+	cAdaptiveWait qringPopWait;
 	bool term_preProcess;
 	cHeapItemsPointerStack *stackSip;
 	cHeapItemsPointerStack *stackRtp;
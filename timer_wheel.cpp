@@ -0,0 +1,106 @@
+#include "tools.h"
+#include "timer_wheel.h"
+
+
+cTimerWheel::cTimerWheel() {
+	for(int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for(int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			slots[level][slot].prev = &slots[level][slot];
+			slots[level][slot].next = &slots[level][slot];
+		}
+	}
+	time = 0;
+	count = 0;
+	_sync = 0;
+}
+
+void cTimerWheel::add(sItem *item, u_int32_t expire) {
+	if(item->wheel) {
+		item->wheel->unlink(item);
+	}
+	item->expire = expire;
+	item->expired = false;
+	item->dirty = false;
+	link(item);
+}
+
+void cTimerWheel::remove(sItem *item) {
+	if(item->wheel == this) {
+		unlink(item);
+	}
+}
+
+void cTimerWheel::release(sItem *item) {
+	remove(item);
+	item->expired = false;
+	item->dirty = false;
+}
+
+void cTimerWheel::expire(u_int32_t time, std::vector<sItem*> *items) {
+	while(this->time <= time) {
+		if(!count) {
+			this->time = time + 1;
+			break;
+		}
+		for(int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+			if(!(this->time & ((1u << (level * TIMER_WHEEL_SLOT_BITS)) - 1))) {
+				cascade(level);
+			}
+		}
+		sItem *head = &slots[0][this->time & TIMER_WHEEL_SLOT_MASK];
+		while(head->next != head) {
+			sItem *item = head->next;
+			unlink(item);
+			item->expired = true;
+			item->dirty = false;
+			items->push_back(item);
+		}
+		++this->time;
+	}
+}
+
+void cTimerWheel::link(sItem *item) {
+	if(!time) {
+		time = item->expire;
+	}
+	u_int32_t expire = item->expire > time ? item->expire : time;
+	int level = 0;
+	while(level < TIMER_WHEEL_LEVELS &&
+	      (expire >> (level * TIMER_WHEEL_SLOT_BITS)) - (time >> (level * TIMER_WHEEL_SLOT_BITS)) >= TIMER_WHEEL_SLOTS) {
+		++level;
+	}
+	if(level == TIMER_WHEEL_LEVELS) {
+		// over range of wheel - item is taken at the end of range and expire is checked by owner
+		level = TIMER_WHEEL_LEVELS - 1;
+		expire = ((time >> (level * TIMER_WHEEL_SLOT_BITS)) + TIMER_WHEEL_SLOTS - 1) << (level * TIMER_WHEEL_SLOT_BITS);
+	}
+	sItem *head = &slots[level][(expire >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+	item->prev = head;
+	item->next = head->next;
+	head->next->prev = item;
+	head->next = item;
+	item->wheel = this;
+	++count;
+}
+
+void cTimerWheel::unlink(sItem *item) {
+	item->prev->next = item->next;
+	item->next->prev = item->prev;
+	item->prev = NULL;
+	item->next = NULL;
+	item->wheel = NULL;
+	--count;
+}
+
+void cTimerWheel::cascade(int level) {
+	sItem *head = &slots[level][(time >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+	sItem *item = head->next;
+	head->prev = head;
+	head->next = head;
+	while(item != head) {
+		sItem *next = item->next;
+		--count;
+		link(item);
+		item = next;
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+
+#include <vector>
+#include <sys/types.h>
+
+#include "sync.h"
+
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+
+/*
+ * Hierarchical timer wheel with resolution of one second (64 slots per level, 4 levels ~ 194 days).
+ * Items are linked into slots intrusively (item is member of owner) - add, remove and move are O(1).
+ * Items of higher level are cascaded into lower levels when wheel time reaches their slot.
+ * Owner of wheel serializes operations by lock/unlock.
+ */
+class cTimerWheel {
+public:
+	struct sItem {
+		sItem(void *data = NULL) {
+			prev = NULL;
+			next = NULL;
+			wheel = NULL;
+			expire = 0;
+			expired = false;
+			dirty = false;
+			this->data = data;
+		}
+		bool isScheduled() {
+			return(wheel != NULL);
+		}
+		sItem *prev;
+		sItem *next;
+		cTimerWheel *wheel;
+		u_int32_t expire;
+		// taken from wheel by expire and not yet added again or released
+		bool expired;
+		// deadline of expired item changed meanwhile
+		bool dirty;
+		void *data;
+	};
+public:
+	cTimerWheel();
+	void init(u_int32_t time) {
+		if(!this->time) {
+			this->time = time;
+		}
+	}
+	void add(sItem *item, u_int32_t expire);
+	void remove(sItem *item);
+	// removes item from wheel or releases item taken by expire
+	void release(sItem *item);
+	// takes items with expire <= time, expired items can be added again
+	void expire(u_int32_t time, std::vector<sItem*> *items);
+	size_t size() {
+		return(count);
+	}
+	void lock() {
+		__SYNC_LOCK_USLEEP(_sync, 10);
+	}
+	void unlock() {
+		__SYNC_UNLOCK(_sync);
+	}
+private:
+	void link(sItem *item);
+	void unlink(sItem *item);
+	void cascade(int level);
+private:
+	sItem slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	u_int32_t time;
+	size_t count;
+	volatile int _sync;
+};
+
+
+#endif //TIMER_WHEEL_H
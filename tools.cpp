@@ -54,6 +54,10 @@
 #include <algorithm> // for std::min
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef FREEBSD
 #include <malloc.h>
 #endif
@@ -2877,49 +2881,6 @@ void ListCheckString_wb::addBlack(const char *checkString) {
 }
 
 
-ParsePacket::ppNode::ppNode() {
-	for(int i = 0; i < 256; i++) {
-		nodes[i] = 0;
-	}
-	leaf = false;
-	typeNode = typeNode_std;
-	nodeIndex = 0;
-	isContentLength = false;
-}
-
-ParsePacket::ppNode::~ppNode() {
-	for(int i = 0; i < 256; i++) {
-		if(nodes[i]) {
-			delete nodes[i];
-		}
-	}
-}
-
-void ParsePacket::ppNode::addNode(const char *nodeName, eTypeNode typeNode, int nodeIndex, bool isContentLength) {
-	while(*nodeName == '\n') {
-		 ++nodeName;
-	}
-	if(*nodeName) {
-		unsigned char nodeChar = (unsigned char)*nodeName;
-		if(nodeChar >= 'A' && nodeChar <= 'Z') {
-			nodeChar -= 'A' - 'a';
-		}
-		ppNode *node = (ppNode*)nodes[nodeChar];
-		if(!node) {
-			node = new FILE_LINE(38005) ppNode;
-		}
-		node->addNode(nodeName + 1, typeNode, nodeIndex, isContentLength);
-		if(!nodes[nodeChar]) {
-			nodes[nodeChar] = node;
-		}
-	} else {
-		leaf = true;
-		this->typeNode = typeNode;
-		this->nodeIndex = nodeIndex;
-		this->isContentLength = isContentLength;
-	}
-}
-		
 void ParsePacket::ppNode::debugData(ppContentsX *contents, ParsePacket *parsePacket) {
 	if(leaf) {
 		if(typeNode == typeNode_std && contents->std[nodeIndex].length > 0) {
@@ -2933,19 +2894,89 @@ void ParsePacket::ppNode::debugData(ppContentsX *contents, ParsePacket *parsePac
 			     << " : L " << contents->custom[nodeIndex].length
 			     << endl;
 		}
-	} else {
-		for(int i = 0; i < 256; i++) {
-			if(nodes[i]) {
-				ppNode *node = (ppNode*)nodes[i];
-				node->debugData(contents, parsePacket);
+	}
+}
+
+struct sParsePacketBuildNode {
+	bool operator < (const sParsePacketBuildNode& other) const { 
+		return(this->bucket != other.bucket ? this->bucket < other.bucket :
+		       this->name.length() != other.name.length() ? this->name.length() < other.name.length() :
+		       this->order < other.order);
+	}
+	string name;
+	int bucket;
+	unsigned order;
+	ParsePacket::ppNodeDef *def;
+};
+
+void ParsePacket::ppTable::build(std::vector<ppNodeDef> *defs) {
+	vector<sParsePacketBuildNode> buildNodes;
+	for(unsigned i = 0; i < defs->size(); i++) {
+		const char *nodeName = (*defs)[i].name.c_str();
+		while(*nodeName == '\n') {
+			 ++nodeName;
+		}
+		string name;
+		for(const char *pos = nodeName; *pos; pos++) {
+			name += lowerChar(*pos);
+		}
+		if(name.empty() || name.length() > 255) {
+			syslog(LOG_WARNING, "ParsePacket: node with bad length of name is ignored (%s)", nodeName);
+			continue;
+		}
+		sParsePacketBuildNode buildNode;
+		buildNode.name = name;
+		buildNode.bucket = name.length() > 1 ? (int)getBucket(name[0], name[1]) : -1;
+		buildNode.order = i;
+		buildNode.def = &(*defs)[i];
+		buildNodes.push_back(buildNode);
+	}
+	std::sort(buildNodes.begin(), buildNodes.end());
+	count = buildNodes.size();
+	countDefs = defs->size();
+	namesSize = 0;
+	for(unsigned i = 0; i < count; i++) {
+		namesSize += buildNodes[i].name.length();
+	}
+	nodes = new FILE_LINE(38005) ppNode[count ? count : 1];
+	memset(nodes, 0, sizeof(ppNode) * (count ? count : 1));
+	names = new FILE_LINE(38006) char[namesSize ? namesSize : 1];
+	unsigned nameOffset = 0;
+	unsigned bucket = 0;
+	for(unsigned i = 0; i < count; i++) {
+		sParsePacketBuildNode *buildNode = &buildNodes[i];
+		ppNode *node = &nodes[i];
+		node->nameOffset = nameOffset;
+		node->nameLength = buildNode->name.length();
+		node->typeNode = buildNode->def->typeNode;
+		node->nodeIndex = buildNode->def->nodeIndex;
+		node->isContentLength = buildNode->def->isContentLength;
+		node->leaf = true;
+		memcpy(names + nameOffset, buildNode->name.c_str(), node->nameLength);
+		nameOffset += node->nameLength;
+		if(buildNode->bucket < 0) {
+			++countShort;
+		} else {
+			while(bucket <= (unsigned)buildNode->bucket) {
+				bucketFirst[bucket++] = i;
 			}
 		}
 	}
+	while(bucket <= ParsePacket_buckets) {
+		bucketFirst[bucket++] = count;
+	}
+}
+
+void ParsePacket::ppTable::debugData(ppContentsX *contents, ParsePacket *parsePacket) {
+	for(unsigned i = 0; i < count; i++) {
+		nodes[i].debugData(contents, parsePacket);
+	}
 }
 
 ParsePacket::ParsePacket() {
 	root = NULL;
 	rootCheckSip = NULL;
+	addNodesBatch = false;
 	timeSync_SIP_HEADERfilter = 0;
 	timeSync_custom_headers_cdr = 0;
 	timeSync_custom_headers_message = 0;
@@ -2957,12 +2988,7 @@ ParsePacket::~ParsePacket() {
 }
 	
 void ParsePacket::setStdParse() {
-	if(!root) {
-		root = new FILE_LINE(38006) ppNode;
-	}
-	if(!rootCheckSip) {
-		rootCheckSip = new FILE_LINE(38007) ppNode;
-	}
+	addNodesBatch = true;
 	addNode("content-length:", typeNode_std, true);
 	addNode("l:", typeNode_std, true);
 	addNode("INVITE ", typeNode_std);
@@ -3131,6 +3157,9 @@ void ParsePacket::setStdParse() {
 	
 	SIP_HEADERfilter::addNodes(this);
 	this->timeSync_SIP_HEADERfilter = SIP_HEADERfilter::getLoadTime();
+	
+	addNodesBatch = false;
+	buildTables();
 }
 
 void ParsePacket::addNode(const char *nodeName, eTypeNode typeNode, bool isContentLength) {
@@ -3145,10 +3174,15 @@ void ParsePacket::addNode(const char *nodeName, eTypeNode typeNode, bool isConte
 	   std::find(nodesCustom.begin(), nodesCustom.end(), nodeNameUpper) == nodesCustom.end()) {
 		if(listNodes->size() < (typeNode == typeNode_std ? ParsePacket_std_max : ParsePacket_custom_max)) {
 			listNodes->push_back(nodeNameUpper);
-			if(!root) {
-				root = new FILE_LINE(38008) ppNode;
+			ppNodeDef nodeDef;
+			nodeDef.name = nodeName;
+			nodeDef.typeNode = typeNode;
+			nodeDef.nodeIndex = listNodes->size() - 1;
+			nodeDef.isContentLength = isContentLength;
+			nodesDef.push_back(nodeDef);
+			if(!addNodesBatch) {
+				buildTables();
 			}
-			root->addNode(nodeName, typeNode, listNodes->size() - 1, isContentLength);
 		} else {
 			syslog(LOG_WARNING, "too much sip nodes for ParsePacket");
 		}
@@ -3158,13 +3192,59 @@ void ParsePacket::addNode(const char *nodeName, eTypeNode typeNode, bool isConte
 void ParsePacket::addNodeCheckSip(const char *nodeName) {
 	if(std::find(nodesCheckSip.begin(), nodesCheckSip.end(), nodeName) == nodesCheckSip.end()) {
 		nodesCheckSip.push_back(nodeName);
-		if(!rootCheckSip) {
-			rootCheckSip = new FILE_LINE(38009) ppNode;
+		ppNodeDef nodeDef;
+		nodeDef.name = nodeName;
+		nodeDef.typeNode = typeNode_checkSip;
+		nodeDef.nodeIndex = nodesCheckSip.size() - 1;
+		nodeDef.isContentLength = false;
+		nodesCheckSipDef.push_back(nodeDef);
+		if(!addNodesBatch) {
+			buildTables();
 		}
-		rootCheckSip->addNode(nodeName, typeNode_checkSip, nodesCheckSip.size() - 1, false);
 	}
 }
 
+void ParsePacket::buildTables() {
+	for(int i = 0; i < 2; i++) {
+		std::vector<ppNodeDef> *defs = i == 0 ? &nodesDef : &nodesCheckSipDef;
+		ppTable * volatile *table = i == 0 ? &root : &rootCheckSip;
+		if(*table && (*table)->countDefs == defs->size()) {
+			continue;
+		}
+		ppTable *newTable = new FILE_LINE(38007) ppTable;
+		newTable->build(defs);
+		__sync_synchronize();
+		ppTable *oldTable = *table;
+		*table = newTable;
+		if(oldTable) {
+			// previous version can be still used in other threads
+			rootsOld.push_back(oldTable);
+		}
+	}
+}
+
+// position of first cr or lf in data[from, to), to if not found
+static inline unsigned long parseData_findEndLine(const char *data, unsigned long from, unsigned long to) {
+#ifdef __SSE2__
+	__m128i cr = _mm_set1_epi8('\r');
+	__m128i lf = _mm_set1_epi8('\n');
+	while(from + 16 <= to) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + from));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+		if(mask) {
+			return(from + __builtin_ctz(mask));
+		}
+		from += 16;
+	}
+#endif
+	for(; from < to; from++) {
+		if(data[from] == '\r' || data[from] == '\n') {
+			break;
+		}
+	}
+	return(from);
+}
+
 u_int32_t ParsePacket::parseData(char *data, unsigned long datalen, ppContentsX *contents) {
 	extern CustomHeaders *custom_headers_cdr;
 	extern CustomHeaders *custom_headers_message;
@@ -3209,12 +3289,40 @@ u_int32_t ParsePacket::parseData(char *data, unsigned long datalen, ppContentsX
 	unsigned long rsltDataLen = datalen;
 	contents->sip = datalen ? isSipContent(data, datalen - 1) : false;
 	unsigned int namelength;
-	for(unsigned long i = 0; i < datalen; i++) {
-		if(!contents->doubleEndLine && 
-		   datalen > 3 &&
-		   data[i] == '\r' && i < datalen - 3 && 
-		   data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
-			contents->doubleEndLine = data + i;
+	unsigned long i = 0;
+	while(i < datalen) {
+		// i is at begin of line
+		unsigned long endLine;
+		ppNode *node = getNode(data + i, datalen - i - 1, &namelength);
+		if(node && !node->isSetNode(contents)) {
+			ppContentItemX *contentItem = node->getPointerToItem(contents);
+			contentItem->offset = i + namelength;
+			endLine = parseData_findEndLine(data, i + namelength, datalen);
+			contentItem->length = endLine - contentItem->offset;
+			contentItem->trim(data);
+			if(node->isContentLength && contentItem->length) {
+				if(contentItem->offset + contentItem->length == datalen) {
+					char tempLength[10];
+					int maxLengthLength = MIN(sizeof(tempLength) - 1, contentItem->length);
+					strncpy(tempLength, data + contentItem->offset, maxLengthLength);
+					tempLength[maxLengthLength] = 0;
+					contents->contentLength = atoi(tempLength);
+				} else {
+					contents->contentLength = atoi(data + contentItem->offset);
+				}
+			}
+		} else {
+			endLine = parseData_findEndLine(data, i, datalen);
+		}
+		char *lf = endLine < datalen ? (char*)memchr(data + endLine, '\n', datalen - endLine) : NULL;
+		if(!lf) {
+			break;
+		}
+		unsigned long lfPos = lf - data;
+		if(!contents->doubleEndLine &&
+		   lfPos > 0 && data[lfPos - 1] == '\r' &&
+		   lfPos + 2 < datalen && data[lfPos + 1] == '\r' && data[lfPos + 2] == '\n') {
+			contents->doubleEndLine = data + lfPos - 1;
 			if(contents->contentLength > -1) {
 				unsigned long modify_datalen = contents->doubleEndLine + 4 - data + contents->contentLength;
 				if(modify_datalen < datalen) {
@@ -3225,42 +3333,13 @@ u_int32_t ParsePacket::parseData(char *data, unsigned long datalen, ppContentsX
 				rsltDataLen = contents->doubleEndLine + 4 - data;
 				break;
 			}
-			i += 2;
-		} else if(i == 0 || data[i - 1] == '\n') {
-			ppNode *node = getNode(data + i, datalen - i - 1, &namelength);
-			if(node && !node->isSetNode(contents)) {
-				ppContentItemX *contentItem = node->getPointerToItem(contents);
-				contentItem->offset = i + namelength;
-				i += namelength;
-				bool endLine = false;
-				for(; i < datalen; i++) {
-					if(data[i] == '\r' || data[i] == '\n') {
-						endLine = true;
-						break;
-					}
-				}
-				if(endLine || i == datalen) {
-					contentItem->length = i - contentItem->offset;
-					contentItem->trim(data);
-					if(node->isContentLength && contentItem->length) {
-						if(contentItem->offset + contentItem->length == datalen) {
-							char tempLength[10];
-							int maxLengthLength = MIN(sizeof(tempLength) - 1, contentItem->length);
-							strncpy(tempLength, data + contentItem->offset, maxLengthLength);
-							tempLength[maxLengthLength] = 0;
-							contents->contentLength = atoi(tempLength);
-						} else {
-							contents->contentLength = atoi(data + contentItem->offset);
-						}
-					}
-					if(endLine) {
-						--i;
-					}
-				}
-			}
+			i = lfPos + 3;
+		} else {
+			i = lfPos + 1;
 		}
 	}
 	contents->parseDataPtr = data;
+	contents->parseDataLength = rsltDataLen;
 	return(rsltDataLen);
 }
 
@@ -3273,10 +3352,16 @@ void ParsePacket::free() {
 		delete rootCheckSip;
 		rootCheckSip = NULL;
 	}
+	for(unsigned i = 0; i < rootsOld.size(); i++) {
+		delete rootsOld[i];
+	}
+	rootsOld.clear();
 }
 
 void ParsePacket::debugData(ppContentsX *contents) {
-	root->debugData(contents, this);
+	if(root) {
+		root->debugData(contents, this);
+	}
 }
 
 
@@ -1878,6 +1878,7 @@ private:
 
 #define ParsePacket_std_max 100
 #define ParsePacket_custom_max 100
+#define ParsePacket_buckets 256
 
 class ParsePacket {
 public:
@@ -1913,6 +1914,7 @@ public:
 			doubleEndLine = NULL;
 			contentLength = -1;
 			parseDataPtr = NULL;
+			parseDataLength = 0;
 			sip = false;
 		}
 		u_int32_t parse(char *data, unsigned long datalen, bool clean) {
@@ -1965,55 +1967,14 @@ public:
 		char *doubleEndLine;
 		int32_t contentLength;
 		const char *parseDataPtr;
+		u_int32_t parseDataLength;
 		bool sip;
 	};
+	/*
+	 * Header name in hashed table. Names are lowercased and stored contiguously in pool of table,
+	 * node has 12 bytes - lookup of header name is bucket by first two chars and compare of few names.
+	 */
 	struct ppNode {
-		ppNode();
-		~ppNode();
-		void addNode(const char *nodeName, eTypeNode typeNode, int nodeIndex, bool isContentLength);
-		ppContentItemX *getContent(const char *nodeName, ppContentsX *contents, ppNode **node_rslt, u_int32_t *namelength_rslt = NULL, 
-					   u_int32_t namelength = 0, u_int32_t namelength_limit = UINT_MAX) {
-			if(!leaf) {
-				if(!*nodeName) {
-					return(NULL);
-				}
-				unsigned char nodeChar = (unsigned char)*nodeName;
-				if(nodeChar >= 'A' && nodeChar <= 'Z') {
-					nodeChar -= 'A' - 'a';
-				}
-				if(nodes[nodeChar]) {
-					++namelength;
-					if(namelength > namelength_limit) {
-						return(NULL);
-					}
-					ppNode *node = (ppNode*)nodes[nodeChar];
-					return(node->getContent(nodeName + 1, contents, node_rslt, namelength_rslt, 
-								namelength, namelength_limit));
-				} else {
-					return(NULL);
-				}
-			} else {
-				if(namelength_rslt) {
-					*namelength_rslt = namelength;
-				}
-				if(node_rslt) {
-					*node_rslt = this;
-				}
-				if(contents) {
-					switch(typeNode) {
-					case typeNode_std:
-						return(contents->std[nodeIndex].offset ? &contents->std[nodeIndex] : NULL);
-					case typeNode_custom:
-						return(contents->custom[nodeIndex].offset ? &contents->custom[nodeIndex] : NULL);
-					case typeNode_checkSip:
-						return(NULL);
-					}
-				} else {
-					return((ppContentItemX*)true);
-				}
-			}
-			return(NULL);
-		}
 		bool isSetNode(ppContentsX *contents) {
 			return((typeNode == typeNode_std && contents->std[this->nodeIndex].length) ||
 			       (typeNode == typeNode_custom && contents->custom[this->nodeIndex].length));
@@ -2023,12 +1984,99 @@ public:
 			       typeNode == typeNode_custom ? &contents->custom[this->nodeIndex] : NULL);
 		}
 		void debugData(ppContentsX *contents, ParsePacket *parsePacket);
-		volatile ppNode *nodes[256];
+		u_int32_t nameOffset;
+		u_int8_t nameLength;
+		u_int8_t typeNode;
+		bool isContentLength;
 		bool leaf;
+		u_int16_t nodeIndex;
+	};
+	struct ppNodeDef {
+		std::string name;
 		eTypeNode typeNode;
 		int nodeIndex;
 		bool isContentLength;
 	};
+	/*
+	 * Immutable table - after change of nodes the table is built again and replaced (readers in other threads
+	 * can use previous version until free).
+	 * Nodes of bucket are sorted by length of name - first match is the shortest name (as leaf in previous trie).
+	 * One char names are in front of buckets and are checked first.
+	 */
+	struct ppTable {
+		ppTable() {
+			nodes = NULL;
+			names = NULL;
+			count = 0;
+			countShort = 0;
+			countDefs = 0;
+			namesSize = 0;
+			memset(bucketFirst, 0, sizeof(bucketFirst));
+		}
+		~ppTable() {
+			if(nodes) {
+				delete [] nodes;
+			}
+			if(names) {
+				delete [] names;
+			}
+		}
+		void build(std::vector<ppNodeDef> *defs);
+		static inline unsigned char lowerChar(unsigned char c) {
+			return(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+		}
+		static inline unsigned getBucket(unsigned char c0, unsigned char c1) {
+			return((lowerChar(c0) * 31u + lowerChar(c1)) & (ParsePacket_buckets - 1));
+		}
+		inline bool cmpName(ppNode *node, const char *data) {
+			const char *name = names + node->nameOffset;
+			for(unsigned i = 0; i < node->nameLength; i++) {
+				if(lowerChar(data[i]) != (unsigned char)name[i]) {
+					return(false);
+				}
+			}
+			return(true);
+		}
+		ppNode *getNode(const char *data, u_int32_t datalength, u_int32_t *namelength_rslt) {
+			if(!datalength || !data[0]) {
+				return(NULL);
+			}
+			ppNode *node = NULL;
+			for(unsigned i = 0; i < countShort; i++) {
+				if(cmpName(&nodes[i], data)) {
+					node = &nodes[i];
+					break;
+				}
+			}
+			if(!node && datalength > 1) {
+				unsigned bucket = getBucket(data[0], data[1]);
+				for(unsigned i = bucketFirst[bucket]; i < bucketFirst[bucket + 1]; i++) {
+					if(nodes[i].nameLength > datalength) {
+						break;
+					}
+					if(cmpName(&nodes[i], data)) {
+						node = &nodes[i];
+						break;
+					}
+				}
+			}
+			if(node && namelength_rslt) {
+				*namelength_rslt = node->nameLength;
+			}
+			return(node);
+		}
+		unsigned getSize() {
+			return(sizeof(ppTable) + count * sizeof(ppNode) + namesSize);
+		}
+		void debugData(ppContentsX *contents, ParsePacket *parsePacket);
+		ppNode *nodes;
+		char *names;
+		unsigned count;
+		unsigned countShort;
+		unsigned countDefs;
+		unsigned namesSize;
+		u_int16_t bucketFirst[ParsePacket_buckets + 1];
+	};
 public:
 	ParsePacket();
 	~ParsePacket();
@@ -2036,30 +2084,34 @@ public:
 	void addNode(const char *nodeName, eTypeNode typeNode, bool isContentLength = false);
 	void addNodeCheckSip(const char *nodeName);
 	ppNode *getNode(const char *data, u_int32_t datalength, u_int32_t *namelength_rslt) {
-		ppNode *node;
-		if(root->getContent(data, NULL, &node, namelength_rslt, 
-				    0, datalength)) {
-			return(node);
-		}
-		return(NULL);
+		ppTable *table = root;
+		return(table ? table->getNode(data, datalength, namelength_rslt) : NULL);
 	}
 	bool isSipContent(const char *data, u_int32_t datalength) {
-		if(rootCheckSip &&
-		   rootCheckSip->getContent(data, NULL, NULL, NULL,
-					    0, datalength)) {
-			return(true);
-		}
-		return(false);
+		ppTable *table = rootCheckSip;
+		return(table && table->getNode(data, datalength, NULL));
 	}
 	u_int32_t parseData(char *data, unsigned long datalen, ppContentsX *contents);
 	void free();
 	void debugData(ppContentsX *contents);
+	unsigned getNodesCount() {
+		return(root ? root->count : 0);
+	}
+	unsigned getTableSize() {
+		return(root ? root->getSize() : 0);
+	}
+private:
+	void buildTables();
 private:
 	std::vector<string> nodesStd;
 	std::vector<string> nodesCheckSip;
 	std::vector<string> nodesCustom;
-	ppNode *root;
-	ppNode *rootCheckSip;
+	std::vector<ppNodeDef> nodesDef;
+	std::vector<ppNodeDef> nodesCheckSipDef;
+	ppTable * volatile root;
+	ppTable * volatile rootCheckSip;
+	std::vector<ppTable*> rootsOld;
+	bool addNodesBatch;
 	unsigned long timeSync_SIP_HEADERfilter;
 	unsigned long timeSync_custom_headers_cdr;
 	unsigned long timeSync_custom_headers_message;
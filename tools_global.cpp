@@ -4,6 +4,10 @@
 #include <syslog.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <limits.h>
+#ifndef FREEBSD
+#include <linux/futex.h>
+#endif
 
 #include "tools_global.h"
 
@@ -427,12 +431,25 @@ struct sUsleepStatsIdCnt {
 	}
 };
 
+struct sUsleepStatsSum {
+	u_int64_t usleep_count;
+	u_int64_t usleep_us;
+	u_int64_t futex_count;
+	u_int64_t futex_woken;
+	u_int64_t futex_us;
+	u_int64_t futex_replaced_usleep_count;
+	u_int64_t futex_replaced_usleep_us;
+};
+
 static map<sUsleepStatsId, unsigned int> usleepStats;
+static sUsleepStatsSum usleepStatsSum;
 static volatile int usleepStatsSync;
 
 void usleep_stats_add(unsigned int useconds, bool fix, const char *file, int line) {
 	if(sverb.usleep_stats) {
 		__SYNC_LOCK(usleepStatsSync);
+		++usleepStatsSum.usleep_count;
+		usleepStatsSum.usleep_us += useconds;
 		sUsleepStatsId id;
 		id.file = file;
 		id.line = line;
@@ -447,10 +464,45 @@ void usleep_stats_add(unsigned int useconds, bool fix, const char *file, int lin
 	}
 }
 
+// futex_wait_stats_add - parked time and sleeps (polling with usleep) which would be needed instead
+static void futex_wait_stats_add(unsigned int parked_useconds, unsigned int usleep_useconds, bool woken, const char *file, int line) {
+	__SYNC_LOCK(usleepStatsSync);
+	sUsleepStatsId id;
+	id.file = file;
+	id.line = line;
+	id.tid = get_unix_tid();
+	id.us = parked_useconds < 100 ?
+		 parked_useconds / 10 * 10 :
+		 parked_useconds / 100 * 100;
+	++usleepStats[id];
+	++usleepStatsSum.futex_count;
+	if(woken) {
+		++usleepStatsSum.futex_woken;
+	}
+	usleepStatsSum.futex_us += parked_useconds;
+	if(!usleep_useconds) {
+		usleep_useconds = 1;
+	}
+	unsigned int usleep_count = parked_useconds / usleep_useconds + 1;
+	usleepStatsSum.futex_replaced_usleep_count += usleep_count;
+	usleepStatsSum.futex_replaced_usleep_us += usleep_count * usleep_useconds;
+	__SYNC_UNLOCK(usleepStatsSync);
+}
+
 string usleep_stats(unsigned int useconds_lt) {
 	if(sverb.usleep_stats) {
 		list<sUsleepStatsIdCnt> _usleepStat;
+		ostringstream outStrSum;
 		__SYNC_LOCK(usleepStatsSync);
+		outStrSum << "usleep: " << usleepStatsSum.usleep_count << " calls, "
+			  << usleepStatsSum.usleep_us << "us" << endl;
+		if(usleepStatsSum.futex_count) {
+			outStrSum << "futex wait: " << usleepStatsSum.futex_count << " waits ("
+				  << usleepStatsSum.futex_woken << " woken by notify), "
+				  << usleepStatsSum.futex_us << "us parked; "
+				  << "polling would need " << usleepStatsSum.futex_replaced_usleep_count << " usleep calls, "
+				  << usleepStatsSum.futex_replaced_usleep_us << "us" << endl;
+		}
 		for(map<sUsleepStatsId, unsigned int>::iterator iter = usleepStats.begin(); iter != usleepStats.end(); iter++) {
 			if(useconds_lt && iter->first.us >= useconds_lt) {
 				continue;
@@ -464,6 +516,7 @@ string usleep_stats(unsigned int useconds_lt) {
 		if(_usleepStat.size()) {
 			_usleepStat.sort();
 			ostringstream outStr;
+			outStr << outStrSum.str();
 			list<sUsleepStatsIdCnt>::iterator iter = _usleepStat.end();
 			do {
 				--iter;
@@ -477,7 +530,7 @@ string usleep_stats(unsigned int useconds_lt) {
 			} while(iter != _usleepStat.begin());
 			return(outStr.str());
 		} else  {
-			return("usleep stat is empty\n");
+			return(outStrSum.str() + "usleep stat is empty\n");
 		}
 	} else {
 		return("usleep stat is not activated\n");
@@ -488,9 +541,42 @@ void usleep_stats_clear() {
 	if(sverb.usleep_stats) {
 		__SYNC_LOCK(usleepStatsSync);
 		usleepStats.clear();
+		memset(&usleepStatsSum, 0, sizeof(usleepStatsSum));
 		__SYNC_UNLOCK(usleepStatsSync);
 	}
 }
+
+void cAdaptiveWait::wake() {
+	__sync_add_and_fetch(&seq, 1);
+	#ifndef FREEBSD
+	syscall(SYS_futex, &seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+	#endif
+}
+
+unsigned int cAdaptiveWait::park(volatile int *flag, int while_value, unsigned int useconds, unsigned int counter, const char *file, int line) {
+	u_int64_t start_us = getTimeUS();
+	int _seq = seq;
+	__sync_add_and_fetch(&waiters, 1);
+	bool woken = false;
+	// waiters must be visible before check of flag - notify checks waiters after change of flag
+	if(*flag == while_value) {
+		#ifndef FREEBSD
+		timespec timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = ADAPTIVE_WAIT_PARK_MAX_US * 1000;
+		syscall(SYS_futex, &seq, FUTEX_WAIT_PRIVATE, _seq, &timeout, NULL, 0);
+		#else
+		usleep(ADAPTIVE_WAIT_PARK_MAX_US);
+		#endif
+		woken = seq != _seq;
+	}
+	__sync_sub_and_fetch(&waiters, 1);
+	unsigned int parked_us = getTimeUS() - start_us;
+	if(sverb.usleep_stats) {
+		futex_wait_stats_add(parked_us, usleep_adaptive_useconds(useconds, counter), woken, file, line);
+	}
+	return(parked_us);
+}
 #endif
 
 
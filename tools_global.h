@@ -228,7 +228,7 @@ inline u_int64_t getTimeNS() {
 #else
 #define USLEEP(us) usleep(us, __FILE__, __LINE__);
 #define USLEEP_C(us, c) usleep(us, c, __FILE__, __LINE__);
-inline unsigned int usleep(unsigned int useconds, unsigned int counter, const char *file, int line) {
+inline unsigned int usleep_adaptive_useconds(unsigned int useconds, unsigned int counter) {
  	unsigned int rslt_useconds = useconds;
 	if(useconds < 5000 && counter != (unsigned int)-1) {
 		unsigned int useconds_min = 0;
@@ -256,6 +256,10 @@ inline unsigned int usleep(unsigned int useconds, unsigned int counter, const ch
 			rslt_useconds = useconds_min;
 		}
 	}
+	return(rslt_useconds);
+}
+inline unsigned int usleep(unsigned int useconds, unsigned int counter, const char *file, int line) {
+ 	unsigned int rslt_useconds = usleep_adaptive_useconds(useconds, counter);
 	extern sVerbose sverb;
 	if(sverb.usleep_stats) {
 		void usleep_stats_add(unsigned int useconds, bool fix, const char *file, int line);
@@ -273,6 +277,63 @@ inline unsigned int usleep(unsigned int useconds, const char *file, int line) {
 	usleep(useconds);
 	return(useconds);
 }
+
+/*
+ * Wait for free / filled item of ring buffer (used flags of batch qrings and rqueue_quick).
+ * With qring_futex_wait the waiting thread spins a few rounds and then parks on futex,
+ * the other side calls notify after each change of flag - it is cheap (barrier and one load) if nobody
+ * is parked. Without qring_futex_wait it is the same as USLEEP / USLEEP_C. Parked time is limited so that callers
+ * can still check termination and do their periodic work by the returned sleep time.
+ */
+#define ADAPTIVE_WAIT_SPIN_ROUNDS 8
+#define ADAPTIVE_WAIT_SPIN_PAUSES 64
+#define ADAPTIVE_WAIT_PARK_MAX_US 10000
+#define ADAPTIVE_WAIT(wait_obj, flag, while_value, us, c) (wait_obj).wait(flag, while_value, us, c, true, __FILE__, __LINE__)
+#define ADAPTIVE_WAIT_C(wait_obj, flag, while_value, us, c) (wait_obj).wait(flag, while_value, us, c, false, __FILE__, __LINE__)
+
+class cAdaptiveWait {
+public:
+	cAdaptiveWait() {
+		seq = 0;
+		waiters = 0;
+	}
+	inline void notify() {
+		extern int opt_qring_futex_wait;
+		if(opt_qring_futex_wait) {
+			__sync_synchronize();
+			if(waiters) {
+				wake();
+			}
+		}
+	}
+	inline unsigned int wait(volatile int *flag, int while_value, unsigned int useconds, unsigned int counter, bool fix, const char *file, int line) {
+		extern int opt_qring_futex_wait;
+		#ifndef FREEBSD
+		if(opt_qring_futex_wait) {
+			if(counter < ADAPTIVE_WAIT_SPIN_ROUNDS) {
+				for(unsigned i = 0; i < ADAPTIVE_WAIT_SPIN_PAUSES && *flag == while_value; i++) {
+					#if defined(__i386__) or defined(__x86_64__)
+					__asm__ __volatile__("pause");
+					#else
+					__sync_synchronize();
+					#endif
+				}
+				return(0);
+			}
+			return(park(flag, while_value, useconds, fix ? (unsigned int)-1 : counter, file, line));
+		}
+		#endif
+		return(fix ?
+			usleep(useconds, file, line) :
+			usleep(useconds, counter, file, line));
+	}
+private:
+	void wake();
+	unsigned int park(volatile int *flag, int while_value, unsigned int useconds, unsigned int counter, const char *file, int line);
+private:
+	volatile int seq;
+	volatile int waiters;
+};
 #endif
 
 
@@ -0,0 +1,310 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#ifndef FREEBSD
+#include <net/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#endif
+
+#include "tpacket_ring.h"
+
+
+using namespace std;
+
+
+cTPacketV3Ring::cTPacketV3Ring(const char *interfaceName,
+			       u_int32_t ringSize, u_int32_t blockSize, u_int32_t blockTimeoutMS,
+			       u_int32_t snaplen, bool promisc) {
+	this->interfaceName = interfaceName;
+	this->ringSize = ringSize;
+	this->blockSize = blockSize;
+	this->blockTimeoutMS = blockTimeoutMS;
+	this->snaplen = snaplen;
+	this->promisc = promisc;
+	this->socket = -1;
+	this->ifindex = 0;
+	this->linkType = 0;
+	this->ring = NULL;
+	this->ringLength = 0;
+	this->blocksCount = 0;
+	this->blockIndex = 0;
+	this->block = NULL;
+	this->blockPacket = NULL;
+	this->blockPacketsLeft = 0;
+	this->stat_packets = 0;
+	this->stat_drops = 0;
+	this->stat_freezes = 0;
+	this->_sync_stat = 0;
+}
+
+cTPacketV3Ring::~cTPacketV3Ring() {
+	this->close();
+}
+
+#ifndef FREEBSD
+
+bool cTPacketV3Ring::open(string *error) {
+	char errorstr[1024];
+	this->ifindex = if_nametoindex(this->interfaceName.c_str());
+	if(!this->ifindex) {
+		snprintf(errorstr, sizeof(errorstr), "unknown interface %s", this->interfaceName.c_str());
+		*error = errorstr;
+		return(false);
+	}
+	this->socket = ::socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if(this->socket < 0) {
+		snprintf(errorstr, sizeof(errorstr), "socket(AF_PACKET) failed: %s", strerror(errno));
+		goto failed;
+	}
+	{
+	ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, this->interfaceName.c_str(), sizeof(ifr.ifr_name) - 1);
+	if(ioctl(this->socket, SIOCGIFHWADDR, &ifr) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "ioctl(SIOCGIFHWADDR) failed: %s", strerror(errno));
+		goto failed;
+	}
+	switch(ifr.ifr_hwaddr.sa_family) {
+	case ARPHRD_ETHER:
+	case ARPHRD_LOOPBACK:
+		this->linkType = DLT_EN10MB;
+		break;
+	default:
+		snprintf(errorstr, sizeof(errorstr), "unsupported link type %i", ifr.ifr_hwaddr.sa_family);
+		goto failed;
+	}
+	}
+	{
+	int version = TPACKET_V3;
+	if(setsockopt(this->socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "setsockopt(PACKET_VERSION) failed: %s", strerror(errno));
+		goto failed;
+	}
+	}
+	{
+	u_int32_t pageSize = getpagesize();
+	if(this->blockSize < pageSize) {
+		this->blockSize = pageSize;
+	}
+	this->blockSize = (this->blockSize + pageSize - 1) / pageSize * pageSize;
+	this->blocksCount = this->ringSize / this->blockSize;
+	if(this->blocksCount < 2) {
+		this->blocksCount = 2;
+	}
+	u_int32_t frameSize = TPACKET_ALIGN(TPACKET3_HDRLEN + this->snaplen);
+	if(frameSize > this->blockSize) {
+		frameSize = this->blockSize;
+	}
+	tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = this->blockSize;
+	req.tp_block_nr = this->blocksCount;
+	req.tp_frame_size = frameSize;
+	req.tp_frame_nr = this->blockSize / frameSize * this->blocksCount;
+	req.tp_retire_blk_tov = this->blockTimeoutMS;
+	req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	if(setsockopt(this->socket, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "setsockopt(PACKET_RX_RING) failed: %s", strerror(errno));
+		goto failed;
+	}
+	this->ringLength = (size_t)this->blockSize * this->blocksCount;
+	this->ring = (u_char*)mmap(NULL, this->ringLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, this->socket, 0);
+	if(this->ring == MAP_FAILED) {
+		this->ring = (u_char*)mmap(NULL, this->ringLength, PROT_READ | PROT_WRITE, MAP_SHARED, this->socket, 0);
+	}
+	if(this->ring == MAP_FAILED) {
+		this->ring = NULL;
+		snprintf(errorstr, sizeof(errorstr), "mmap of ring failed: %s", strerror(errno));
+		goto failed;
+	}
+	}
+	{
+	sockaddr_ll addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(ETH_P_ALL);
+	addr.sll_ifindex = this->ifindex;
+	if(bind(this->socket, (sockaddr*)&addr, sizeof(addr)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "bind failed: %s", strerror(errno));
+		goto failed;
+	}
+	}
+	if(this->promisc) {
+		packet_mreq mreq;
+		memset(&mreq, 0, sizeof(mreq));
+		mreq.mr_ifindex = this->ifindex;
+		mreq.mr_type = PACKET_MR_PROMISC;
+		if(setsockopt(this->socket, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+			snprintf(errorstr, sizeof(errorstr), "setsockopt(PACKET_ADD_MEMBERSHIP) failed: %s", strerror(errno));
+			goto failed;
+		}
+	}
+	{
+	// limit captured length already in kernel
+	sock_filter snaplenFilter = BPF_STMT(BPF_RET | BPF_K, this->snaplen);
+	sock_fprog snaplenProg;
+	snaplenProg.len = 1;
+	snaplenProg.filter = &snaplenFilter;
+	setsockopt(this->socket, SOL_SOCKET, SO_ATTACH_FILTER, &snaplenProg, sizeof(snaplenProg));
+	}
+	this->updateStat();
+	this->stat_packets = 0;
+	this->stat_drops = 0;
+	this->stat_freezes = 0;
+	syslog(LOG_NOTICE, "packetbuffer - %s: TPACKET_V3 ring %u blocks x %u kB",
+	       this->interfaceName.c_str(), this->blocksCount, this->blockSize / 1024);
+	return(true);
+failed:
+	this->close();
+	*error = errorstr;
+	return(false);
+}
+
+void cTPacketV3Ring::close() {
+	if(this->ring) {
+		munmap(this->ring, this->ringLength);
+		this->ring = NULL;
+	}
+	if(this->socket >= 0) {
+		::close(this->socket);
+		this->socket = -1;
+	}
+	this->block = NULL;
+	this->blockPacket = NULL;
+	this->blockPacketsLeft = 0;
+}
+
+bool cTPacketV3Ring::setFilter(bpf_program *program, string *error) {
+	sock_fprog prog;
+	prog.len = program->bf_len;
+	prog.filter = (sock_filter*)program->bf_insns;
+	if(setsockopt(this->socket, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+		*error = string("setsockopt(SO_ATTACH_FILTER) failed: ") + strerror(errno);
+		return(false);
+	}
+	return(true);
+}
+
+bool cTPacketV3Ring::joinFanout(u_int16_t group, string *error) {
+	return(packet_fanout_join(this->socket, group, error));
+}
+
+bool cTPacketV3Ring::nextBlock(int timeoutMS) {
+	if(this->block) {
+		this->releaseBlock();
+	}
+	if(!this->ring) {
+		return(false);
+	}
+	tpacket_block_desc *desc = (tpacket_block_desc*)(this->ring + (size_t)this->blockIndex * this->blockSize);
+	if(!(desc->hdr.bh1.block_status & TP_STATUS_USER)) {
+		pollfd pfd;
+		pfd.fd = this->socket;
+		pfd.events = POLLIN | POLLERR;
+		pfd.revents = 0;
+		if(poll(&pfd, 1, timeoutMS) <= 0 ||
+		   !(desc->hdr.bh1.block_status & TP_STATUS_USER)) {
+			return(false);
+		}
+	}
+	__sync_synchronize();
+	this->block = (u_char*)desc;
+	this->blockPacket = this->block + desc->hdr.bh1.offset_to_first_pkt;
+	this->blockPacketsLeft = desc->hdr.bh1.num_pkts;
+	return(true);
+}
+
+void cTPacketV3Ring::releaseBlock() {
+	if(!this->block) {
+		return;
+	}
+	__sync_synchronize();
+	((tpacket_block_desc*)this->block)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	this->block = NULL;
+	this->blockPacket = NULL;
+	this->blockPacketsLeft = 0;
+	this->blockIndex = (this->blockIndex + 1) % this->blocksCount;
+}
+
+void cTPacketV3Ring::updateStat() {
+	// kernel resets counters after each read
+	tpacket_stats_v3 stat;
+	socklen_t statLength = sizeof(stat);
+	if(this->socket >= 0 &&
+	   getsockopt(this->socket, SOL_PACKET, PACKET_STATISTICS, &stat, &statLength) == 0) {
+		this->stat_packets += stat.tp_packets;
+		this->stat_drops += stat.tp_drops;
+		this->stat_freezes += stat.tp_freeze_q_cnt;
+	}
+}
+
+bool packet_fanout_join(int socket, u_int16_t group, string *error) {
+	// flow hash of kernel is symmetric - both directions of a flow go to the same socket
+	int fanout = group | (PACKET_FANOUT_HASH << 16);
+	if(setsockopt(socket, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0) {
+		*error = string("setsockopt(PACKET_FANOUT) failed: ") + strerror(errno);
+		return(false);
+	}
+	return(true);
+}
+
+#else
+
+bool cTPacketV3Ring::open(string *error) {
+	*error = "TPACKET_V3 is supported only on linux";
+	return(false);
+}
+
+void cTPacketV3Ring::close() {
+}
+
+bool cTPacketV3Ring::setFilter(bpf_program */*program*/, string *error) {
+	*error = "TPACKET_V3 is supported only on linux";
+	return(false);
+}
+
+bool cTPacketV3Ring::joinFanout(u_int16_t /*group*/, string *error) {
+	*error = "TPACKET_V3 is supported only on linux";
+	return(false);
+}
+
+bool cTPacketV3Ring::nextBlock(int /*timeoutMS*/) {
+	return(false);
+}
+
+void cTPacketV3Ring::releaseBlock() {
+}
+
+void cTPacketV3Ring::updateStat() {
+}
+
+bool packet_fanout_join(int /*socket*/, u_int16_t /*group*/, string *error) {
+	*error = "PACKET_FANOUT is supported only on linux";
+	return(false);
+}
+
+#endif
+
+void cTPacketV3Ring::getStat(u_int64_t *packets, u_int64_t *drops, u_int64_t *freezes) {
+	this->lock_stat();
+	this->updateStat();
+	if(packets) {
+		*packets = this->stat_packets;
+	}
+	if(drops) {
+		*drops = this->stat_drops;
+	}
+	if(freezes) {
+		*freezes = this->stat_freezes;
+	}
+	this->unlock_stat();
+}
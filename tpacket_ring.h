@@ -0,0 +1,113 @@
+#ifndef TPACKET_RING_H
+#define TPACKET_RING_H
+
+
+#include <string>
+#include <pcap.h>
+#include <sys/types.h>
+
+#ifndef FREEBSD
+#include <linux/if_packet.h>
+#endif
+
+
+/*
+ * Native AF_PACKET TPACKET_V3 capture ring.
+ * The kernel fills whole blocks of packets into the mmaped ring and hands them
+ * over to user space at once; reader walks the frames of the block directly
+ * and returns the block to the kernel by releaseBlock().
+ */
+class cTPacketV3Ring {
+public:
+	struct sPacket {
+		pcap_pkthdr header;
+		u_char *data;
+		bool vlan;
+		u_int16_t vlan_tpid;
+		u_int16_t vlan_tci;
+	};
+public:
+	cTPacketV3Ring(const char *interfaceName,
+		       u_int32_t ringSize, u_int32_t blockSize, u_int32_t blockTimeoutMS,
+		       u_int32_t snaplen, bool promisc);
+	~cTPacketV3Ring();
+	bool open(std::string *error);
+	void close();
+	bool setFilter(bpf_program *program, std::string *error);
+	bool joinFanout(u_int16_t group, std::string *error);
+	bool nextBlock(int timeoutMS);
+	void releaseBlock();
+	inline bool nextPacket(sPacket *packet) {
+		#ifndef FREEBSD
+		if(!this->block || !this->blockPacketsLeft) {
+			return(false);
+		}
+		tpacket3_hdr *hdr = (tpacket3_hdr*)this->blockPacket;
+		packet->data = (u_char*)hdr + hdr->tp_mac;
+		packet->header.caplen = hdr->tp_snaplen;
+		packet->header.len = hdr->tp_len;
+		packet->header.ts.tv_sec = hdr->tp_sec;
+		packet->header.ts.tv_usec = hdr->tp_nsec / 1000;
+		packet->vlan = (hdr->tp_status & TP_STATUS_VLAN_VALID) || hdr->hv1.tp_vlan_tci;
+		if(packet->vlan) {
+			packet->vlan_tci = hdr->hv1.tp_vlan_tci;
+			#ifdef TP_STATUS_VLAN_TPID_VALID
+			packet->vlan_tpid = (hdr->tp_status & TP_STATUS_VLAN_TPID_VALID) && hdr->hv1.tp_vlan_tpid ?
+					     hdr->hv1.tp_vlan_tpid : 0x8100;
+			#else
+			packet->vlan_tpid = 0x8100;
+			#endif
+		}
+		this->blockPacket += hdr->tp_next_offset;
+		--this->blockPacketsLeft;
+		return(true);
+		#else
+		return(false);
+		#endif
+	}
+	void getStat(u_int64_t *packets, u_int64_t *drops, u_int64_t *freezes);
+	int getLinkType() {
+		return(this->linkType);
+	}
+	size_t getRingLength() {
+		return(this->ringLength);
+	}
+	std::string getInterfaceName() {
+		return(this->interfaceName);
+	}
+private:
+	void updateStat();
+	void lock_stat() {
+		while(__sync_lock_test_and_set(&this->_sync_stat, 1));
+	}
+	void unlock_stat() {
+		__sync_lock_release(&this->_sync_stat);
+	}
+private:
+	std::string interfaceName;
+	u_int32_t ringSize;
+	u_int32_t blockSize;
+	u_int32_t blockTimeoutMS;
+	u_int32_t snaplen;
+	bool promisc;
+	int socket;
+	int ifindex;
+	int linkType;
+	u_char *ring;
+	size_t ringLength;
+	u_int32_t blocksCount;
+	u_int32_t blockIndex;
+	u_char *block;
+	u_char *blockPacket;
+	u_int32_t blockPacketsLeft;
+	u_int64_t stat_packets;
+	u_int64_t stat_drops;
+	u_int64_t stat_freezes;
+	volatile int _sync_stat;
+};
+
+
+bool packet_fanout_join(int socket, u_int16_t group, std::string *error);
+
+
+#endif //TPACKET_RING_H
@@ -96,6 +96,11 @@
 #include "log_buffer.h"
 #include "heap_chunk.h"
 #include "charts.h"
+#include "offline_pcap_reader.h"
+#include "latency_stat.h"
+#include "numa_affinity.h"
+#include "pcap_block_pool.h"
+#include "packetbuffer_shedding.h"
 
 #if HAVE_LIBTCMALLOC_HEAPPROF
 #include <gperftools/heap-profiler.h>
@@ -290,6 +295,8 @@ volatile int readend = 0;
 int opt_dup_check = 0;
 int opt_dup_check_ipheader = 1;
 int opt_dup_check_ipheader_ignore_ttl = 1;
+int opt_dup_check_window_ms = 200;
+int opt_dup_check_threads = 1;
 int opt_fax_dup_seq_check = 0;
 int opt_fax_create_udptl_streams = 0;
 int rtptimeout = 300;
@@ -319,6 +326,7 @@ bool opt_ipacc_sniffer_agregate = false;
 bool opt_ipacc_agregate_only_customers_on_main_side = true;
 bool opt_ipacc_agregate_only_customers_on_any_side = true;
 int opt_udpfrag = 1;
+int opt_udpfrag_threads = 1;
 MirrorIP *mirrorip = NULL;
 int opt_cdronlyanswered = 0;
 int opt_cdronlyrtp = 0;
@@ -354,6 +362,8 @@ bool opt_read_from_file = false;
 char opt_read_from_file_fname[1024] = "";
 char opt_dedup_fname[1024] = "";
 bool opt_read_from_file_no_sip_reassembly = false;
+int opt_read_from_file_threads = 4;
+cOfflinePcapReader *offlinePcapReader = NULL;
 char opt_pb_read_from_file[256] = "";
 double opt_pb_read_from_file_speed = 0;
 int opt_pb_read_from_file_acttime = 0;
@@ -386,6 +396,7 @@ int opt_process_rtp_packets_hash_next_thread_sem_sync = 2;
 unsigned int opt_preprocess_packets_qring_length = 2000;
 unsigned int opt_preprocess_packets_qring_item_length = 0;
 unsigned int opt_preprocess_packets_qring_usleep = 10;
+int opt_qring_futex_wait = 0;
 bool opt_preprocess_packets_qring_force_push = true;
 unsigned int opt_process_rtp_packets_qring_length = 2000;
 unsigned int opt_process_rtp_packets_qring_item_length = 0;
@@ -577,6 +588,9 @@ int opt_jitter_forcemark_transit_threshold = 10;
 int opt_jitter_forcemark_delta_threshold = 500;
 bool opt_disable_rtp_warning = false;
 int opt_hash_modify_queue_length_ms = 0;
+bool opt_rtp_hash_lockfree = false;
+bool opt_cleanup_timer_wheel = false;
+bool opt_call_arena = false;
 bool opt_disable_process_sdp = false;
 
 char opt_php_path[1024];
@@ -597,7 +611,11 @@ extern uint64_t opt_pcap_queue_bypass_max_size;
 extern int opt_pcap_queue_compress;
 extern pcap_block_store::compress_method opt_pcap_queue_compress_method;
 extern int opt_pcap_queue_compress_ratio;
+extern string opt_pcap_queue_compress_zstd_dictionary;
+extern int opt_pcap_queue_compress_zstd_level;
+extern int opt_pcap_queue_compress_threads;
 extern string opt_pcap_queue_disk_folder;
+extern int opt_pcap_queue_file_direct_io;
 extern ip_port opt_pcap_queue_send_to_ip_port;
 extern ip_port opt_pcap_queue_receive_from_ip_port;
 extern int opt_pcap_queue_receive_dlt;
@@ -607,12 +625,33 @@ extern int opt_pcap_queue_dequeu_need_blocks;
 extern int opt_pcap_queue_dequeu_method;
 extern int opt_pcap_queue_use_blocks;
 extern int opt_pcap_queue_use_blocks_auto_enable;
+extern int opt_pcap_queue_iface_tpacket_v3;
+extern int opt_pcap_queue_iface_tpacket_v3_block_size;
+extern int opt_pcap_queue_iface_tpacket_v3_block_timeout;
+extern int opt_pcap_queue_iface_fanout;
+extern int opt_pcap_queue_iface_prefilter;
+extern int opt_load_generator;
+extern int opt_load_generator_threads;
+extern int opt_load_generator_cps;
+extern int opt_load_generator_calls;
+extern int opt_load_generator_cps_ramp;
+extern double opt_load_generator_loss;
+extern string opt_load_generator_codecs;
+extern int opt_latency_stat;
+extern int opt_latency_stat_sampling;
 extern int opt_pcap_queue_suppress_t1_thread;
 extern int opt_pcap_queue_block_timeout;
+extern int opt_pcap_queue_block_pool;
+extern int opt_pcap_queue_load_shedding;
+extern int opt_pcap_queue_load_shedding_payload;
+extern int opt_pcap_queue_load_shedding_unrecorded;
 extern bool opt_pcap_queue_pcap_stat_per_one_interface;
 extern bool opt_pcap_queues_mirror_nonblock_mode;
 extern bool opt_pcap_queues_mirror_require_confirmation;
 extern bool opt_pcap_queues_mirror_use_checksum;
+extern int opt_pcap_queues_mirror_window;
+extern int opt_pcap_queues_mirror_stripes;
+extern int opt_pcap_queues_mirror_receiver_io_threads;
 extern int opt_pcap_dispatch;
 extern int sql_noerror;
 int opt_cleandatabase_cdr = 0;
@@ -877,6 +916,7 @@ map<vmIPport, string> ssl_ipport;
 bool ssl_client_random_enable = false;
 char *ssl_client_random_portmatrix;
 bool ssl_client_random_portmatrix_set = false;
+char *prefilter_rtp_portmatrix;
 vector<vmIP> ssl_client_random_ip;
 vector<vmIPmask> ssl_client_random_net;
 int ssl_client_random_maxwait_ms = 0;
@@ -1098,6 +1138,7 @@ int opt_hugepages_overcommit_max = 0;
 int opt_hugepages_second_heap = 0;
 
 int opt_numa_balancing_set = numa_balancing_set_autodisable;
+int opt_numa_affinity = 0;
 
 int opt_mirror_connect_maximum_time_diff_s = 2;
 int opt_client_server_connect_maximum_time_diff_s = 2;
@@ -2580,6 +2621,7 @@ void reload_capture_rules() {
 	TELNUMfilter::prepareReload();
 	DOMAINfilter::prepareReload();
 	SIP_HEADERfilter::prepareReload();
+	capture_prefilter_reload();
 }
 
 #ifdef BACKTRACE
@@ -3136,6 +3178,8 @@ int main(int argc, char *argv[]) {
 	memset(ipaccountportmatrix, 0, 65537);
 	ssl_client_random_portmatrix = new FILE_LINE(0) char[65537];
 	memset(ssl_client_random_portmatrix, 0, 65537);
+	prefilter_rtp_portmatrix = new FILE_LINE(0) char[65537];
+	memset(prefilter_rtp_portmatrix, 0, 65537);
 
 	pthread_mutex_init(&mysqlconnect_lock, NULL);
 	pthread_mutex_init(&hostbyname_lock, NULL);
@@ -3939,6 +3983,7 @@ int main(int argc, char *argv[]) {
 	delete [] skinnyportmatrix;
 	delete [] ipaccountportmatrix;
 	delete [] ssl_client_random_portmatrix;
+	delete [] prefilter_rtp_portmatrix;
 	
 	delete regfailedcache;
 	
@@ -4026,6 +4071,20 @@ int main_init_read() {
 		char errbuf[PCAP_ERRBUF_SIZE];
 		if(opt_read_from_file_fname == string("/dev/stdin")) {
 			global_pcap_handle = pcap_open_offline("-", errbuf);
+		} else if(opt_read_from_file_threads > 0) {
+			offlinePcapReader = new FILE_LINE(0) cOfflinePcapReader(opt_read_from_file_threads);
+			string error;
+			if(offlinePcapReader->open(opt_read_from_file_fname, &error)) {
+				if(offlinePcapReader->getCountFiles() > 1) {
+					printf("Reading %u files merged by time\n", offlinePcapReader->getCountFiles());
+				}
+				// packets are returned by offlinePcapReader - handle is used only for dlt and dumps
+				global_pcap_handle = pcap_open_dead(offlinePcapReader->getDlt(), 65535);
+			} else {
+				strcpy_null_term(errbuf, error.c_str());
+				delete offlinePcapReader;
+				offlinePcapReader = NULL;
+			}
 		} else {
 			global_pcap_handle = pcap_open_offline_zip(opt_read_from_file_fname, errbuf);
 		}
@@ -4236,6 +4295,26 @@ int main_init_read() {
 		}
 	}
 
+	if(opt_pcap_queue_block_pool && buffersControl.getMaxBufferMem()) {
+		extern unsigned int HeapSafeCheck;
+		extern size_t _opt_pcap_queue_block_offset_init_size;
+		// pool buffers are outside heap - not compatible with heap checking
+		if(!HeapSafeCheck) {
+			cPcapBlockPool::init(opt_pcap_queue_block_max_size,
+					     _opt_pcap_queue_block_offset_init_size * sizeof(uint32_t),
+					     buffersControl.getMaxBufferMem());
+		}
+	}
+	if(opt_pcap_queue_load_shedding) {
+		cPacketbufferShedding::init(opt_pcap_queue_load_shedding_payload, opt_pcap_queue_load_shedding_unrecorded);
+	}
+	// typical call has two rtp streams
+	cCallArena::setEnable(opt_call_arena, 2 * sizeof(RTP));
+
+	if(opt_numa_affinity && !opt_scanpcapdir[0] && !is_read_from_file()) {
+		cNumaAffinity::init(&ifnamev, opt_numa_affinity == 2);
+	}
+
 	if(!is_sender() && !is_client_packetbuffer_sender()) {
 		// start reading threads
 		if(is_enable_rtp_threads()) {
@@ -4423,14 +4502,14 @@ int main_init_read() {
 		
 		if(opt_pcap_queue_use_blocks && !is_sender() && !is_client_packetbuffer_sender()) {
 			if(opt_udpfrag) {
-				pcapQueueQ_outThread_defrag = new FILE_LINE(0) PcapQueue_outputThread(PcapQueue_outputThread::defrag, pcapQueueQ);
+				pcapQueueQ_outThread_defrag = new FILE_LINE(0) PcapQueue_outputThread(PcapQueue_outputThread::defrag, pcapQueueQ, opt_udpfrag_threads);
 				pcapQueueQ_outThread_defrag->start();
 			}
 			if(opt_dup_check && 
 			   (is_receiver() || is_server() ?
 			     !opt_receiver_check_id_sensor :
 			     ifnamev.size() > 1)) {
-				pcapQueueQ_outThread_dedup = new FILE_LINE(0) PcapQueue_outputThread(PcapQueue_outputThread::dedup, pcapQueueQ);
+				pcapQueueQ_outThread_dedup = new FILE_LINE(0) PcapQueue_outputThread(PcapQueue_outputThread::dedup, pcapQueueQ, opt_dup_check_threads);
 				pcapQueueQ_outThread_dedup->start();
 			}
 		}
@@ -4636,6 +4715,10 @@ void main_term_read() {
 	if(is_read_from_file_simple() && global_pcap_handle) {
 		pcap_close(global_pcap_handle);
 	}
+	if(offlinePcapReader) {
+		delete offlinePcapReader;
+		offlinePcapReader = NULL;
+	}
 	if(global_pcap_handle_dead_EN10MB) {
 		pcap_close(global_pcap_handle_dead_EN10MB);
 	}
@@ -5185,6 +5268,197 @@ void test_parsepacket2() {
 	pp.debugData(&contents);
 }
 
+struct test_parsepacket_legacy_node {
+	test_parsepacket_legacy_node() {
+		memset(nodes, 0, sizeof(nodes));
+		leaf = false;
+	}
+	~test_parsepacket_legacy_node() {
+		for(int i = 0; i < 256; i++) {
+			if(nodes[i]) {
+				delete nodes[i];
+			}
+		}
+	}
+	unsigned add(const char *nodeName) {
+		if(!*nodeName) {
+			leaf = true;
+			return(0);
+		}
+		unsigned char nodeChar = tolower((unsigned char)*nodeName);
+		unsigned added = 0;
+		if(!nodes[nodeChar]) {
+			nodes[nodeChar] = new FILE_LINE(0) test_parsepacket_legacy_node;
+			added = 1;
+		}
+		return(added + nodes[nodeChar]->add(nodeName + 1));
+	}
+	test_parsepacket_legacy_node *get(const char *data, u_int32_t datalength, u_int32_t namelength = 0) {
+		if(leaf) {
+			return(this);
+		}
+		unsigned char nodeChar = tolower((unsigned char)*data);
+		if(!nodeChar || !nodes[nodeChar] || ++namelength > datalength) {
+			return(NULL);
+		}
+		return(nodes[nodeChar]->get(data + 1, datalength, namelength));
+	}
+	test_parsepacket_legacy_node *nodes[256];
+	bool leaf;
+};
+
+void test_parsepacket_bench(unsigned passes) {
+	const char *names[] = {
+		"content-length:", "l:", "INVITE ", "MESSAGE ", "call-id:", "i:", "from:", "f:", "to:", "t:",
+		"contact:", "m:", "remote-party-id:", "P-Asserted-Identity:", "geoposition:", "user-agent:",
+		"authorization:", "proxy-authorization:", "expires:", "x-voipmonitor-norecord:", "signal:", "signal=",
+		"x-voipmonitor-custom1:", "content-type:", "c:", "cseq:", "supported:", "proxy-authenticate:",
+		"via:", "v:", "reason:", "m=audio ", "a=rtpmap:", "o=", "c=IN IP4 ", "expires=", "username=\"",
+		"realm=\"", "CallID:", "LocalAddr:", "RemoteAddr:", "QualityEst:", "PacketLoss:",
+		"X-Custom-Header-1:", "X-Custom-Header-2:", "X-Custom-Header-3:", "X-Billing-Id:", "X-Account:"
+	};
+	char *str = (char*)"INVITE sip:800123456@sip.odorik.cz SIP/2.0\r\nVia: SIP/2.0/UDP 192.168.1.12:5061;rport;branch=z9hG4bK354557323\r\nFrom: <sip:706912@sip.odorik.cz>;tag=1645803335\r\nTo: <sip:800123456@sip.odorik.cz>\r\nCall-ID: 1781060762\r\nCSeq: 20 INVITE\r\nContact: <sip:jumbox@93.91.52.46>\r\nContent-Type: application/sdp\r\nAllow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\nMax-Forwards: 70\r\nUser-Agent: Linphone/3.6.1 (eXosip2/3.6.0)\r\nSubject: Phone call\r\nContent-Length: 453\r\n\r\nv=0\r\no=706912 1477 2440 IN IP4 93.91.52.46\r\ns=Talk\r\nc=IN IP4 93.91.52.46\r\nt=0 0\r\nm=audio 7078 RTP/AVP 125 112 111 110 96 3 0 8 101\r\na=rtpmap:125 opus/48000\r\na=fmtp:125 useinbandfec=1; usedtx=1\r\na=rtpmap:112 speex/32000\r\na=fmtp:112 vbr=on\r\na=rtpmap:111 speex/16000\r\na=fmtp:111 vbr=on\r\na=rtpmap:110 speex/8000\r\na=fmtp:110 vbr=on\r\na=rtpmap:96 GSM/11025\r\na=rtpmap:101 telephone-event/8000\r\na=fmtp:101 0-11\r\nm=video 9078 RTP/AVP 103\r\na=rtpmap:103 VP8/90000\r\n";
+	unsigned strLength = strlen(str);
+	ParsePacket pp;
+	test_parsepacket_legacy_node legacy;
+	unsigned legacyNodes = 1;
+	for(unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		pp.addNode(names[i], ParsePacket::typeNode_std, i < 2);
+		legacyNodes += legacy.add(names[i]);
+	}
+	vector<unsigned> lines;
+	for(unsigned i = 0; i < strLength; i++) {
+		if(i == 0 || str[i - 1] == '\n') {
+			lines.push_back(i);
+		}
+	}
+	unsigned found[2] = { 0, 0 };
+	u_int64_t time[2];
+	for(int pass_type = 0; pass_type < 2; pass_type++) {
+		u_int64_t start = getTimeNS();
+		for(unsigned pass = 0; pass < passes; pass++) {
+			for(unsigned i = 0; i < lines.size(); i++) {
+				if(pass_type == 0 ?
+				    legacy.get(str + lines[i], strLength - lines[i] - 1) != NULL :
+				    pp.getNode(str + lines[i], strLength - lines[i] - 1, NULL) != NULL) {
+					++found[pass_type];
+				}
+			}
+		}
+		time[pass_type] = getTimeNS() - start;
+	}
+	ParsePacket::ppContentsX contents;
+	u_int64_t start = getTimeNS();
+	for(unsigned pass = 0; pass < passes; pass++) {
+		contents.clean();
+		pp.parseData(str, strLength, &contents);
+	}
+	u_int64_t timeParseData = getTimeNS() - start;
+	cout << "headers: " << (sizeof(names) / sizeof(names[0])) << ", lines: " << lines.size() << ", passes: " << passes << endl
+	     << "legacy trie:  nodes " << legacyNodes << ", " << (legacyNodes * sizeof(test_parsepacket_legacy_node)) << " B, "
+	     << (double)time[0] / passes << " ns / message (found " << found[0] / passes << ")" << endl
+	     << "hashed table: nodes " << pp.getNodesCount() << ", " << pp.getTableSize() << " B, "
+	     << (double)time[1] / passes << " ns / message (found " << found[1] / passes << ")" << endl
+	     << "parseData: " << (double)timeParseData / passes << " ns / message" << endl;
+}
+
+struct test_rtp_hash_bench_data {
+	Calltable *table;
+	vector<Call*> *calls;
+	unsigned streams;
+	unsigned lookups;
+	volatile int *terminating;
+	u_int64_t found;
+	u_int64_t changes;
+};
+
+void *test_rtp_hash_bench_reader(void *_data) {
+	test_rtp_hash_bench_data *data = (test_rtp_hash_bench_data*)_data;
+	u_int32_t rand_state = (u_int32_t)(long)_data;
+	for(unsigned i = 0; i < data->lookups; i++) {
+		rand_state = rand_state * 1103515245 + 12345;
+		unsigned stream = (rand_state >> 8) % data->streams;
+		bool lockfree = data->table->lock_calls_hash_read();
+		for(node_call_rtp *n_call = data->table->hashfind_by_ip_port(vmIP(0x0A000000 + stream / 1000), vmPort(10000 + stream % 1000 * 2), false);
+		    n_call; n_call = n_call->next) {
+			if(n_call->call) {
+				++data->found;
+			}
+		}
+		data->table->unlock_calls_hash_read(lockfree);
+	}
+	return(NULL);
+}
+
+void *test_rtp_hash_bench_writer(void *_data) {
+	test_rtp_hash_bench_data *data = (test_rtp_hash_bench_data*)_data;
+	s_sdp_flags sdp_flags;
+	unsigned stream = 0;
+	while(!*data->terminating) {
+		Call *call = (*data->calls)[stream % data->calls->size()];
+		vmIP ip(0x0A000000 + stream / 1000);
+		vmPort port(10000 + stream % 1000 * 2);
+		data->table->hashRemove(call, ip, port, NULL);
+		data->table->hashAdd(ip, port, NULL, call, 0, 0, sdp_flags);
+		++data->changes;
+		stream = (stream + 7919) % data->streams;
+	}
+	return(NULL);
+}
+
+void test_rtp_hash_bench(unsigned readers, unsigned streams, unsigned lookups) {
+	vector<Call*> calls;
+	for(unsigned i = 0; i < 1000; i++) {
+		string call_id = "test_rtp_hash_bench_" + intToString(i);
+		calls.push_back(new FILE_LINE(0) Call(INVITE, (char*)call_id.c_str(), call_id.length(), NULL, getTimeUS()));
+	}
+	s_sdp_flags sdp_flags;
+	for(int lockfree = 0; lockfree < 2; lockfree++) {
+		opt_rtp_hash_lockfree = lockfree;
+		Calltable *table = new FILE_LINE(0) Calltable();
+		for(unsigned i = 0; i < streams; i++) {
+			table->hashAdd(vmIP(0x0A000000 + i / 1000), vmPort(10000 + i % 1000 * 2), NULL, calls[i % calls.size()], 0, 0, sdp_flags);
+		}
+		volatile int terminating = 0;
+		vector<test_rtp_hash_bench_data> data(readers + 1);
+		vector<pthread_t> threads(readers + 1);
+		for(unsigned i = 0; i <= readers; i++) {
+			data[i].table = table;
+			data[i].calls = &calls;
+			data[i].streams = streams;
+			data[i].lookups = lookups;
+			data[i].terminating = &terminating;
+			data[i].found = 0;
+			data[i].changes = 0;
+		}
+		u_int64_t start = getTimeNS();
+		vm_pthread_create("test rtp hash writer", &threads[readers], NULL, test_rtp_hash_bench_writer, &data[readers], __FILE__, __LINE__);
+		for(unsigned i = 0; i < readers; i++) {
+			vm_pthread_create("test rtp hash reader", &threads[i], NULL, test_rtp_hash_bench_reader, &data[i], __FILE__, __LINE__);
+		}
+		u_int64_t found = 0;
+		for(unsigned i = 0; i < readers; i++) {
+			pthread_join(threads[i], NULL);
+			found += data[i].found;
+		}
+		u_int64_t time = getTimeNS() - start;
+		terminating = 1;
+		pthread_join(threads[readers], NULL);
+		cout << (lockfree ? "lock-free" : "locked   ") << ": readers " << readers << ", streams " << streams << ", "
+		     << (u_int64_t)((double)readers * lookups / time * 1e9) << " lookups / s, "
+		     << (u_int64_t)((double)data[readers].changes / time * 1e9) << " changes / s "
+		     << "(found " << found << ")" << endl;
+		for(unsigned i = 0; i < calls.size(); i++) {
+			table->hashRemoveForce(calls[i]);
+		}
+		delete table;
+	}
+	opt_rtp_hash_lockfree = false;
+	for(unsigned i = 0; i < calls.size(); i++) {
+		delete calls[i];
+	}
+}
+
 void test_reg() {
 	cout << reg_match("123456789", "456", __FILE__, __LINE__) << endl;
 	cout << reg_replace("123456789", "(.*)(456)(.*)", "$1-$2-$3", __FILE__, __LINE__) << endl;
@@ -5853,6 +6127,31 @@ void test() {
 		}
 		} 
 		break;
+	case 14:
+		{
+		char *pointToSepOptTest = strchr(opt_test_str, '/');
+		test_parsepacket_bench(pointToSepOptTest ? atoi(pointToSepOptTest + 1) : 1000000);
+		}
+		break;
+	case 15:
+		{
+		// -X15/readers,streams,lookups
+		unsigned params[3] = { 4, 100000, 10000000 };
+		char *pointToSepOptTest = strchr(opt_test_str, '/');
+		if(pointToSepOptTest) {
+			vector<string> params_str = split(pointToSepOptTest + 1, ",");
+			for(unsigned i = 0; i < params_str.size() && i < 3; i++) {
+				if(atoi(params_str[i].c_str()) > 0) {
+					params[i] = atoi(params_str[i].c_str());
+				}
+			}
+		}
+		test_rtp_hash_bench(params[0], params[1], params[2]);
+		}
+		break;
+	case 16:
+		test_packetbuffer_shedding_strip();
+		break;
 	case 88:
 		setAllocNumb();
 		return;
@@ -6595,6 +6894,9 @@ void cConfig::addConfigItems() {
 			normal();
 			setDisableIfBegin("sniffer_mode!" + snifferMode_read_from_files_str);
 			addConfigItem(new FILE_LINE(42141) cConfigItem_string("scanpcapdir", opt_scanpcapdir, sizeof(opt_scanpcapdir)));
+				advanced();
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("read_from_file_threads", &opt_read_from_file_threads));
+			normal();
 			setDisableIfBegin("sniffer_mode!" + snifferMode_sender_str);
 			addConfigItem(new FILE_LINE(42142) cConfigItem_ip_port("mirror_destination", &opt_pcap_queue_send_to_ip_port));
 			addConfigItem((new FILE_LINE(42143) cConfigItem_string("mirror_destination_ip"))
@@ -6607,6 +6909,9 @@ void cConfig::addConfigItems() {
 			addConfigItem(new FILE_LINE(42145) cConfigItem_yesno("mirror_nonblock_mode", &opt_pcap_queues_mirror_nonblock_mode));
 			addConfigItem(new FILE_LINE(42146) cConfigItem_yesno("mirror_require_confirmation", &opt_pcap_queues_mirror_require_confirmation));
 			addConfigItem(new FILE_LINE(42147) cConfigItem_yesno("mirror_use_checksum", &opt_pcap_queues_mirror_use_checksum));
+			addConfigItem(new FILE_LINE(0) cConfigItem_integer("mirror_window_blocks", &opt_pcap_queues_mirror_window));
+			addConfigItem(new FILE_LINE(0) cConfigItem_integer("mirror_connections", &opt_pcap_queues_mirror_stripes));
+			addConfigItem(new FILE_LINE(0) cConfigItem_integer("mirror_receiver_io_threads", &opt_pcap_queues_mirror_receiver_io_threads));
 			setDisableIfEnd();
 				advanced();
 				addConfigItem(new FILE_LINE(42148) cConfigItem_string("capture_rules_telnum_file", opt_capture_rules_telnum_file, sizeof(opt_capture_rules_telnum_file)));
@@ -6633,6 +6938,7 @@ void cConfig::addConfigItems() {
 					addConfigItem(new FILE_LINE(42152) cConfigItem_integer("preprocess_packets_qring_length", &opt_preprocess_packets_qring_length));
 					addConfigItem(new FILE_LINE(42153) cConfigItem_integer("preprocess_packets_qring_item_length", &opt_preprocess_packets_qring_item_length));
 					addConfigItem(new FILE_LINE(42154) cConfigItem_integer("preprocess_packets_qring_usleep", &opt_preprocess_packets_qring_usleep));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("qring_futex_wait", &opt_qring_futex_wait));
 					addConfigItem(new FILE_LINE(42155) cConfigItem_yesno("preprocess_packets_qring_force_push", &opt_preprocess_packets_qring_force_push));
 					addConfigItem((new FILE_LINE(42156) cConfigItem_integer("process_rtp_packets_hash_next_thread", &opt_process_rtp_packets_hash_next_thread))
 						->setMaximum(MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS)
@@ -6658,6 +6964,28 @@ void cConfig::addConfigItems() {
 				->setNaDefaultValueStr());
 			addConfigItem((new FILE_LINE(42165) cConfigItem_integer("ringbuffer", &opt_ringbuffer))
 				->setMaximum(2000));
+				advanced();
+				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_tpacket_v3", &opt_pcap_queue_iface_tpacket_v3));
+					expert();
+					addConfigItem((new FILE_LINE(0) cConfigItem_integer("packetbuffer_tpacket_v3_block_size", &opt_pcap_queue_iface_tpacket_v3_block_size))
+						->setMultiple(1024));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_tpacket_v3_block_timeout", &opt_pcap_queue_iface_tpacket_v3_block_timeout));
+				advanced();
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("interface_fanout", &opt_pcap_queue_iface_fanout));
+				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("interface_prefilter", &opt_pcap_queue_iface_prefilter));
+				addConfigItem(new FILE_LINE(0) cConfigItem_ports("interface_prefilter_rtp_port", prefilter_rtp_portmatrix));
+					expert();
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("load_generator", &opt_load_generator));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("load_generator_threads", &opt_load_generator_threads));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("load_generator_cps", &opt_load_generator_cps));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("load_generator_calls", &opt_load_generator_calls));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("load_generator_cps_ramp", &opt_load_generator_cps_ramp));
+					addConfigItem(new FILE_LINE(0) cConfigItem_float("load_generator_loss", &opt_load_generator_loss));
+					addConfigItem(new FILE_LINE(0) cConfigItem_string("load_generator_codecs", &opt_load_generator_codecs));
+				advanced();
+				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("latency_stat", &opt_latency_stat));
+					expert();
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("latency_stat_sampling", &opt_latency_stat_sampling));
 		subgroup("scaling");
 				advanced();
 				addConfigItem((new FILE_LINE(42166) cConfigItem_integer("rtpthreads", &num_threads_set))
@@ -6680,6 +7008,10 @@ void cConfig::addConfigItems() {
 						->setMultiple(1024));
 					addConfigItem(new FILE_LINE(42176) cConfigItem_integer("packetbuffer_block_maxtime", &opt_pcap_queue_block_max_time_ms));
 					addConfigItem(new FILE_LINE(42177) cConfigItem_integer("packetbuffer_block_timeout", &opt_pcap_queue_block_timeout));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_block_pool", &opt_pcap_queue_block_pool));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_load_shedding", &opt_pcap_queue_load_shedding));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_load_shedding_payload", &opt_pcap_queue_load_shedding_payload));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_load_shedding_unrecorded", &opt_pcap_queue_load_shedding_unrecorded));
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_pcap_stat_per_one_interface", &opt_pcap_queue_pcap_stat_per_one_interface));
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_disable", &opt_pcap_queue_disable));
 		subgroup("file cache");
@@ -6687,6 +7019,7 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(42178) cConfigItem_integer("packetbuffer_file_totalmaxsize", &opt_pcap_queue_store_queue_max_disk_size))
 						->setMultiple(1024 * 1024));
 					addConfigItem(new FILE_LINE(42179) cConfigItem_string("packetbuffer_file_path", &opt_pcap_queue_disk_folder));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_file_direct_io", &opt_pcap_queue_file_direct_io));
 	group("data storing");
 		setDisableIfBegin("sniffer_mode=" + snifferMode_sender_str);
 		subgroup("main");
@@ -6822,6 +7155,9 @@ void cConfig::addConfigItems() {
 		addConfigItem(new FILE_LINE(42249) cConfigItem_yesno("dscp", &opt_dscp));
 				expert();
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("deduplicate_ipheader_ignore_ttl", &opt_dup_check_ipheader_ignore_ttl));
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("deduplicate_window_ms", &opt_dup_check_window_ms));
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("deduplicate_threads", &opt_dup_check_threads));
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("udpfrag_threads", &opt_udpfrag_threads));
 				addConfigItem(new FILE_LINE(42250) cConfigItem_string("tcpreassembly_http_log", opt_tcpreassembly_http_log, sizeof(opt_tcpreassembly_http_log)));
 				addConfigItem(new FILE_LINE(42251) cConfigItem_string("tcpreassembly_webrtc_log", opt_tcpreassembly_webrtc_log, sizeof(opt_tcpreassembly_webrtc_log)));
 				addConfigItem(new FILE_LINE(42252) cConfigItem_string("tcpreassembly_ssl_log", opt_tcpreassembly_ssl_log, sizeof(opt_tcpreassembly_ssl_log)));
@@ -6941,6 +7277,9 @@ void cConfig::addConfigItems() {
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("disable_sdp_multiplication_warning", &opt_disable_sdp_multiplication_warning));
 					expert();
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("hash_queue_length_ms", &opt_hash_modify_queue_length_ms));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("rtp_hash_lockfree", &opt_rtp_hash_lockfree));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("cleanup_timer_wheel", &opt_cleanup_timer_wheel));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("call_arena", &opt_call_arena));
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("disable_process_sdp", &opt_disable_process_sdp));
 		subgroup("REGISTER");
 			addConfigItem((new FILE_LINE(42290) cConfigItem_yesno("sip-register", &opt_sip_register))
@@ -7227,9 +7566,12 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(42443) cConfigItem_integer("packetbuffer_total_maxheap", &opt_pcap_queue_store_queue_max_memory_size))
 						->setMultiple(1024 * 1024));
 					addConfigItem((new FILE_LINE(42444) cConfigItem_yesno("packetbuffer_compress_method"))
-						->addValues("snappy:1|s:1|lz4:2|l:2")
+						->addValues("snappy:1|s:1|lz4:2|l:2|zstd:3|z:3")
 						->setDefaultValueStr("no"));
 					addConfigItem(new FILE_LINE(42445) cConfigItem_integer("packetbuffer_compress_ratio", &opt_pcap_queue_compress_ratio));
+					addConfigItem(new FILE_LINE(0) cConfigItem_string("packetbuffer_compress_zstd_dictionary", &opt_pcap_queue_compress_zstd_dictionary));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_compress_zstd_level", &opt_pcap_queue_compress_zstd_level));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_compress_threads", &opt_pcap_queue_compress_threads));
 						obsolete();
 						addConfigItem(new FILE_LINE(42446) cConfigItem_yesno("pcap_dispatch", &opt_pcap_dispatch));
 		subgroup("storing packets into pcap files, graph, audio");
@@ -7312,6 +7654,8 @@ void cConfig::addConfigItems() {
 						->addValues(("autodisable:" + intToString(numa_balancing_set_autodisable) + "|" + 
 							     "enable:" + intToString(numa_balancing_set_enable) + "|" +
 							     "disable:" + intToString(numa_balancing_set_disable)).c_str()));
+					addConfigItem((new FILE_LINE(0) cConfigItem_yesno("numa_affinity", &opt_numa_affinity))
+						->addValues("partition:2"));
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("abort_if_rss_gt_gb", &opt_abort_if_rss_gt_gb));
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("next_server_connections", &opt_next_server_connections));
 						obsolete();
@@ -7434,6 +7778,9 @@ void cConfig::evSetConfigItem(cConfigItem *configItem) {
 		case 2:
 			opt_pcap_queue_compress_method = pcap_block_store::lz4;
 			break;
+		case 3:
+			opt_pcap_queue_compress_method = pcap_block_store::zstd;
+			break;
 		}
 	}
 	if((configItem->config_name == "mirror_destination" && ((cConfigItem_ip_port*)configItem)->getValue()) || 
@@ -8549,12 +8896,38 @@ void set_context_config() {
 		opt_pcap_queue_use_blocks = false;
 	}
 	
+	if(opt_load_generator) {
+		if(opt_scanpcapdir[0] || is_read_from_file() || is_receiver() || is_server()) {
+			opt_load_generator = 0;
+		} else {
+			// packets are generated in read threads instead of capturing from interfaces
+			strcpy_null_term(ifname, "loadgen");
+			opt_pcap_queue_iface_tpacket_v3 = 0;
+			opt_pcap_queue_iface_fanout = 0;
+			opt_pcap_queue_iface_prefilter = 0;
+			opt_pcap_queue_use_blocks = 1;
+		}
+	}
+	
+	if(opt_latency_stat) {
+		if(opt_scanpcapdir[0] || is_read_from_file()) {
+			// timestamps of packets from files are not related to time of processing
+			opt_latency_stat = 0;
+		} else {
+			cLatencyStat::init(opt_latency_stat_sampling);
+		}
+	}
+	
 	ifnamev = split(ifname, split(",|;| |\t|\r|\n", "|"), true);
 	
+	if(opt_scanpcapdir[0] || opt_pb_read_from_file[0] || opt_pcap_queue_iface_fanout < 2) {
+		opt_pcap_queue_iface_fanout = 0;
+	}
+	
 	if(opt_pcap_queue_dequeu_window_length < 0) {
 		if(is_receiver() || is_server()) {
 			 opt_pcap_queue_dequeu_window_length = 2000;
-		} else if(ifnamev.size() > 1) {
+		} else if(ifnamev.size() > 1 || opt_pcap_queue_iface_fanout) {
 			 opt_pcap_queue_dequeu_window_length = 1000;
 		}
 	}
@@ -8609,13 +8982,19 @@ void set_context_config() {
 		}
 	}
 	
+	if(opt_pcap_queue_iface_tpacket_v3 && !opt_pcap_queue_use_blocks &&
+	   !opt_scanpcapdir[0] && !is_receiver()) {
+		opt_pcap_queue_use_blocks = 1;
+		syslog(LOG_NOTICE, "enabling pcap_queue_use_blocks because set packetbuffer_tpacket_v3");
+	}
+	
 	if(opt_dup_check && opt_pcap_queue_use_blocks && (is_receiver() || is_server())) {
 		opt_receiver_check_id_sensor = false;
 		syslog(LOG_NOTICE, "disabling receiver_check_id_sensor because set deduplicate in server/receiver mode");
 	}
 	
 	if(getThreadingMode() < 2 && 
-	   (ifnamev.size() > 1 || opt_pcap_queue_use_blocks)) {
+	   (ifnamev.size() > 1 || opt_pcap_queue_use_blocks || opt_pcap_queue_iface_fanout)) {
 		syslog(LOG_NOTICE, "set threading mode 2");
 		setThreadingMode(2);
 	}
@@ -9518,6 +9897,12 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "deduplicate_ipheader_ignore_ttl", NULL))) {
 		opt_dup_check_ipheader_ignore_ttl = yesno(value);
 	}
+	if((value = ini.GetValue("general", "deduplicate_window_ms", NULL))) {
+		opt_dup_check_window_ms = atoi(value);
+	}
+	if((value = ini.GetValue("general", "deduplicate_threads", NULL))) {
+		opt_dup_check_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "dscp", NULL))) {
 		opt_dscp = yesno(value);
 	}
@@ -10499,6 +10884,18 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "packetbuffer_block_timeout", NULL))) {
 		opt_pcap_queue_block_timeout = atoi(value);
 	}
+	if((value = ini.GetValue("general", "packetbuffer_block_pool", NULL))) {
+		opt_pcap_queue_block_pool = yesno(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_load_shedding", NULL))) {
+		opt_pcap_queue_load_shedding = yesno(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_load_shedding_payload", NULL))) {
+		opt_pcap_queue_load_shedding_payload = atoi(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_load_shedding_unrecorded", NULL))) {
+		opt_pcap_queue_load_shedding_unrecorded = atoi(value);
+	}
 	if((value = ini.GetValue("general", "packetbuffer_pcap_stat_per_one_interface", NULL))) {
 		opt_pcap_queue_pcap_stat_per_one_interface = yesno(value);
 	}
@@ -10515,6 +10912,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "packetbuffer_file_path", NULL))) {
 		opt_pcap_queue_disk_folder = value;
 	}
+	if((value = ini.GetValue("general", "packetbuffer_file_direct_io", NULL))) {
+		opt_pcap_queue_file_direct_io = yesno(value);
+	}
 	/*
 	DEFAULT VALUES
 	if((value = ini.GetValue("general", "packetbuffer_file_maxfilesize", NULL))) {
@@ -10535,11 +10935,22 @@ int eval_config(string inistr) {
 			opt_pcap_queue_compress_method = pcap_block_store::snappy;
 		} else if(!strcmp(_opt_pcap_queue_compress_method, "lz4")) {
 			opt_pcap_queue_compress_method = pcap_block_store::lz4;
+		} else if(!strcmp(_opt_pcap_queue_compress_method, "zstd")) {
+			opt_pcap_queue_compress_method = pcap_block_store::zstd;
 		}
 	}
 	if((value = ini.GetValue("general", "packetbuffer_compress_ratio", NULL))) {
 		opt_pcap_queue_compress_ratio = atoi(value);
 	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_zstd_dictionary", NULL))) {
+		opt_pcap_queue_compress_zstd_dictionary = value;
+	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_zstd_level", NULL))) {
+		opt_pcap_queue_compress_zstd_level = atoi(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_threads", NULL))) {
+		opt_pcap_queue_compress_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "mirror_destination_ip", NULL)) &&
 	   (value2 = ini.GetValue("general", "mirror_destination_port", NULL))) {
 		opt_pcap_queue_send_to_ip_port.set_ip(value);
@@ -10586,6 +10997,18 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "mirror_use_checksum", NULL))) {
 		opt_pcap_queues_mirror_use_checksum = yesno(value);
 	}
+	if((value = ini.GetValue("general", "mirror_window_blocks", NULL))) {
+		opt_pcap_queues_mirror_window = atoi(value);
+	}
+	if((value = ini.GetValue("general", "mirror_connections", NULL))) {
+		opt_pcap_queues_mirror_stripes = atoi(value);
+	}
+	if((value = ini.GetValue("general", "mirror_receiver_io_threads", NULL))) {
+		opt_pcap_queues_mirror_receiver_io_threads = atoi(value);
+	}
+	if((value = ini.GetValue("general", "read_from_file_threads", NULL))) {
+		opt_read_from_file_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "capture_rules_telnum_file", NULL))) {
 		strcpy_null_term(opt_capture_rules_telnum_file, value);
 	}
@@ -10704,6 +11127,51 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "auto_enable_use_blocks", NULL))) {
 		opt_pcap_queue_use_blocks_auto_enable = yesno(value);
 	}
+	if((value = ini.GetValue("general", "packetbuffer_tpacket_v3", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3 = yesno(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_tpacket_v3_block_size", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3_block_size = atol(value) * 1024;
+	}
+	if((value = ini.GetValue("general", "packetbuffer_tpacket_v3_block_timeout", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3_block_timeout = atoi(value);
+	}
+	if((value = ini.GetValue("general", "interface_fanout", NULL))) {
+		opt_pcap_queue_iface_fanout = atoi(value);
+	}
+	if((value = ini.GetValue("general", "interface_prefilter", NULL))) {
+		opt_pcap_queue_iface_prefilter = yesno(value);
+	}
+	if((value = ini.GetValue("general", "load_generator", NULL))) {
+		opt_load_generator = yesno(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_threads", NULL))) {
+		opt_load_generator_threads = atoi(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_cps", NULL))) {
+		opt_load_generator_cps = atoi(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_calls", NULL))) {
+		opt_load_generator_calls = atoi(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_cps_ramp", NULL))) {
+		opt_load_generator_cps_ramp = atoi(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_loss", NULL))) {
+		opt_load_generator_loss = atof(value);
+	}
+	if((value = ini.GetValue("general", "load_generator_codecs", NULL))) {
+		opt_load_generator_codecs = value;
+	}
+	if((value = ini.GetValue("general", "latency_stat", NULL))) {
+		opt_latency_stat = yesno(value);
+	}
+	if((value = ini.GetValue("general", "latency_stat_sampling", NULL))) {
+		opt_latency_stat_sampling = atoi(value);
+	}
+	if (ini.GetAllValues("general", "interface_prefilter_rtp_port", values)) {
+		parse_config_item_ports(&values, prefilter_rtp_portmatrix);
+	}
 	if((value = ini.GetValue("general", "pcap_dispatch", NULL))) {
 		opt_pcap_dispatch = yesno(value);
 	}
@@ -11070,6 +11538,15 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "hash_queue_length_ms", NULL))) {
 		opt_hash_modify_queue_length_ms = atoi(value);
 	}
+	if((value = ini.GetValue("general", "rtp_hash_lockfree", NULL))) {
+		opt_rtp_hash_lockfree = yesno(value);
+	}
+	if((value = ini.GetValue("general", "cleanup_timer_wheel", NULL))) {
+		opt_cleanup_timer_wheel = yesno(value);
+	}
+	if((value = ini.GetValue("general", "call_arena", NULL))) {
+		opt_call_arena = yesno(value);
+	}
 	if((value = ini.GetValue("general", "disable_process_sdp", NULL))) {
 		opt_disable_process_sdp = yesno(value);
 	}
@@ -11132,6 +11609,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "preprocess_packets_qring_usleep", NULL))) {
 		opt_preprocess_packets_qring_usleep = atol(value);
 	}
+	if((value = ini.GetValue("general", "qring_futex_wait", NULL))) {
+		opt_qring_futex_wait = yesno(value);
+	}
 	if((value = ini.GetValue("general", "preprocess_packets_qring_force_push", NULL))) {
 		opt_preprocess_packets_qring_force_push = yesno(value);
 	}
@@ -11169,6 +11649,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "udpfrag", NULL))) {
 		opt_udpfrag = yesno(value);
 	}
+	if((value = ini.GetValue("general", "udpfrag_threads", NULL))) {
+		opt_udpfrag_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "faxdetect", NULL))) {
 		opt_faxt30detect = yesno(value);
 	}
@@ -11324,6 +11807,9 @@ int eval_config(string inistr) {
 			opt_numa_balancing_set = yesno(value);
 		}
 	}
+	if((value = ini.GetValue("general", "numa_affinity", NULL))) {
+		opt_numa_affinity = !strcasecmp(value, "partition") ? 2 : yesno(value);
+	}
 	if((value = ini.GetValue("general", "abort_if_rss_gt_gb", NULL))) {
 		opt_abort_if_rss_gt_gb = atoi(value);
 	}
@@ -0,0 +1,236 @@
+#include <syslog.h>
+
+#include "tools.h"
+#include "zstd_sip_dictionary.h"
+
+#ifdef HAVE_LIBZSTD
+#include <zdict.h>
+#endif
+
+
+using namespace std;
+
+
+extern string opt_pcap_queue_compress_zstd_dictionary;
+extern int opt_pcap_queue_compress_zstd_level;
+
+
+// raw content dictionary - the most frequent strings are at the end (shortest offsets)
+static const char zstd_sip_dictionary_builtin[] =
+	"SIP/2.0 100 Trying\r\n"
+	"SIP/2.0 180 Ringing\r\n"
+	"SIP/2.0 183 Session Progress\r\n"
+	"SIP/2.0 401 Unauthorized\r\n"
+	"SIP/2.0 407 Proxy Authentication Required\r\n"
+	"SIP/2.0 486 Busy Here\r\n"
+	"SIP/2.0 487 Request Terminated\r\n"
+	"REGISTER sip:\r\n"
+	"OPTIONS sip:\r\n"
+	"CANCEL sip:\r\n"
+	"BYE sip:\r\n"
+	"ACK sip:\r\n"
+	"UPDATE sip:\r\n"
+	"SUBSCRIBE sip:\r\n"
+	"NOTIFY sip:\r\n"
+	"WWW-Authenticate: Digest realm=\"\", nonce=\"\", algorithm=MD5, qop=\"auth\"\r\n"
+	"Proxy-Authenticate: Digest realm=\"\", nonce=\"\", algorithm=MD5\r\n"
+	"Authorization: Digest username=\"\", realm=\"\", nonce=\"\", uri=\"sip:\", response=\"\", algorithm=MD5\r\n"
+	"Expires: 3600\r\n"
+	"Event: message-summary\r\n"
+	"Subscription-State: active;expires=\r\n"
+	"Reason: Q.850;cause=16;text=\"Normal call clearing\"\r\n"
+	"P-Asserted-Identity: <sip:>\r\n"
+	"Remote-Party-ID: <sip:>;party=calling;screen=no;privacy=off\r\n"
+	"Record-Route: <sip:;lr>\r\n"
+	"Route: <sip:;lr>\r\n"
+	"Session-Expires: 1800;refresher=uac\r\n"
+	"Min-SE: 90\r\n"
+	"Supported: replaces, timer, 100rel, path\r\n"
+	"Require: 100rel\r\n"
+	"RSeq: 1\r\n"
+	"RAck: 1 1 INVITE\r\n"
+	"Accept: application/sdp\r\n"
+	"Allow-Events: talk, hold, conference, refer, check-sync\r\n"
+	"Server: \r\n"
+	"User-Agent: \r\n"
+	"a=rtpmap:18 G729/8000\r\n"
+	"a=fmtp:18 annexb=no\r\n"
+	"a=rtpmap:9 G722/8000\r\n"
+	"a=rtpmap:3 GSM/8000\r\n"
+	"a=rtpmap:96 opus/48000/2\r\n"
+	"a=ptime:20\r\n"
+	"a=maxptime:150\r\n"
+	"a=sendonly\r\n"
+	"a=recvonly\r\n"
+	"a=inactive\r\n"
+	"a=rtcp:\r\n"
+	"m=image  udptl t38\r\n"
+	"v=0\r\n"
+	"o=- 0 0 IN IP4 \r\n"
+	"s=SIP Call\r\n"
+	"s=-\r\n"
+	"c=IN IP4 \r\n"
+	"t=0 0\r\n"
+	"m=audio  RTP/AVP 0 8 101\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:101 telephone-event/8000\r\n"
+	"a=fmtp:101 0-16\r\n"
+	"a=sendrecv\r\n"
+	"INVITE sip:\r\n"
+	"SIP/2.0 200 OK\r\n"
+	"Via: SIP/2.0/UDP :5060;rport;branch=z9hG4bK\r\n"
+	"Via: SIP/2.0/TCP :5060;branch=z9hG4bK\r\n"
+	"Max-Forwards: 70\r\n"
+	"From: <sip:@>;tag=\r\n"
+	"To: <sip:@>;tag=\r\n"
+	"Call-ID: \r\n"
+	"CSeq: 1 INVITE\r\n"
+	"CSeq: 2 BYE\r\n"
+	"CSeq: 1 ACK\r\n"
+	"Contact: <sip:@:5060;transport=udp>\r\n"
+	"Allow: INVITE, ACK, CANCEL, BYE, OPTIONS, INFO, UPDATE, PRACK, REFER, NOTIFY, MESSAGE, SUBSCRIBE\r\n"
+	"Content-Type: application/sdp\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n";
+
+volatile bool cZstdSipDictionary::initialized = false;
+u_int32_t cZstdSipDictionary::id = 0;
+#ifdef HAVE_LIBZSTD
+ZSTD_CDict *cZstdSipDictionary::cdict = NULL;
+ZSTD_DDict *cZstdSipDictionary::ddict = NULL;
+__thread cZstdSipDictionary::sThreadContexts *cZstdSipDictionary::threadContexts = NULL;
+pthread_key_t cZstdSipDictionary::threadContextsKey;
+bool cZstdSipDictionary::threadContextsKeyCreated = false;
+#endif
+volatile int cZstdSipDictionary::_sync = 0;
+
+bool cZstdSipDictionary::init(string *error) {
+	if(initialized) {
+		return(true);
+	}
+	#ifdef HAVE_LIBZSTD
+	lock();
+	if(initialized) {
+		unlock();
+		return(true);
+	}
+	SimpleBuffer dictionary;
+	if(!opt_pcap_queue_compress_zstd_dictionary.empty()) {
+		string errorLoad;
+		if(!file_get_contents(opt_pcap_queue_compress_zstd_dictionary.c_str(), &dictionary, &errorLoad) || !dictionary.size()) {
+			syslog(LOG_ERR, "packetbuffer: failed load zstd dictionary %s (%s) - use builtin SIP dictionary",
+			       opt_pcap_queue_compress_zstd_dictionary.c_str(), errorLoad.c_str());
+			dictionary.clear();
+		}
+	}
+	if(!dictionary.size()) {
+		dictionary.add((void*)zstd_sip_dictionary_builtin, sizeof(zstd_sip_dictionary_builtin) - 1);
+	}
+	// trained dictionary has its own id, raw content is identified by checksum
+	id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+	if(!id) {
+		id = max(checksum32buf(dictionary.data(), dictionary.size()), (u_int32_t)1);
+	}
+	cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), opt_pcap_queue_compress_zstd_level);
+	ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+	if(!cdict || !ddict) {
+		term();
+		unlock();
+		if(error) {
+			*error = "zstd dictionary initialization failed";
+		}
+		return(false);
+	}
+	if(!threadContextsKeyCreated) {
+		pthread_key_create(&threadContextsKey, releaseThreadContexts);
+		threadContextsKeyCreated = true;
+	}
+	syslog(LOG_NOTICE, "packetbuffer: zstd dictionary %s, id %u, %u B",
+	       opt_pcap_queue_compress_zstd_dictionary.empty() ? "builtin" : opt_pcap_queue_compress_zstd_dictionary.c_str(),
+	       id, dictionary.size());
+	initialized = true;
+	unlock();
+	return(true);
+	#else
+	if(error) {
+		*error = "zstd is not supported in this build";
+	}
+	return(false);
+	#endif
+}
+
+void cZstdSipDictionary::term() {
+	#ifdef HAVE_LIBZSTD
+	if(cdict) {
+		ZSTD_freeCDict(cdict);
+		cdict = NULL;
+	}
+	if(ddict) {
+		ZSTD_freeDDict(ddict);
+		ddict = NULL;
+	}
+	#endif
+	id = 0;
+	initialized = false;
+}
+
+u_int32_t cZstdSipDictionary::getId() {
+	return(init() ? id : 0);
+}
+
+#ifdef HAVE_LIBZSTD
+ZSTD_CDict *cZstdSipDictionary::getCDict() {
+	return(init() ? cdict : NULL);
+}
+
+ZSTD_DDict *cZstdSipDictionary::getDDict() {
+	return(init() ? ddict : NULL);
+}
+
+ZSTD_CCtx *cZstdSipDictionary::getThreadCCtx() {
+	sThreadContexts *contexts = getThreadContexts();
+	if(!contexts) {
+		return(NULL);
+	}
+	if(!contexts->cctx) {
+		contexts->cctx = ZSTD_createCCtx();
+	}
+	return(contexts->cctx);
+}
+
+ZSTD_DCtx *cZstdSipDictionary::getThreadDCtx() {
+	sThreadContexts *contexts = getThreadContexts();
+	if(!contexts) {
+		return(NULL);
+	}
+	if(!contexts->dctx) {
+		contexts->dctx = ZSTD_createDCtx();
+	}
+	return(contexts->dctx);
+}
+
+cZstdSipDictionary::sThreadContexts *cZstdSipDictionary::getThreadContexts() {
+	if(!threadContexts) {
+		if(!init()) {
+			return(NULL);
+		}
+		threadContexts = new FILE_LINE(0) sThreadContexts;
+		threadContexts->cctx = NULL;
+		threadContexts->dctx = NULL;
+		pthread_setspecific(threadContextsKey, threadContexts);
+	}
+	return(threadContexts);
+}
+
+void cZstdSipDictionary::releaseThreadContexts(void *contexts) {
+	sThreadContexts *_contexts = (sThreadContexts*)contexts;
+	if(_contexts->cctx) {
+		ZSTD_freeCCtx(_contexts->cctx);
+	}
+	if(_contexts->dctx) {
+		ZSTD_freeDCtx(_contexts->dctx);
+	}
+	delete _contexts;
+}
+#endif
@@ -0,0 +1,64 @@
+#ifndef ZSTD_SIP_DICTIONARY_H
+#define ZSTD_SIP_DICTIONARY_H
+
+
+#include <string>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "config.h"
+
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+
+/*
+ * Dictionary for zstd compression of packetbuffer blocks.
+ * Default is raw content of typical SIP/SDP messages compiled in, or a dictionary
+ * trained offline (zstd --train on captured SIP packets) loaded from
+ * packetbuffer_compress_zstd_dictionary. Both ends of a mirror connection must
+ * use the dictionary with the same id.
+ * Compression contexts are per thread and released at thread exit.
+ */
+class cZstdSipDictionary {
+public:
+	static bool init(std::string *error = NULL);
+	static void term();
+	static u_int32_t getId();
+	#ifdef HAVE_LIBZSTD
+	static ZSTD_CDict *getCDict();
+	static ZSTD_DDict *getDDict();
+	static ZSTD_CCtx *getThreadCCtx();
+	static ZSTD_DCtx *getThreadDCtx();
+	#endif
+private:
+	#ifdef HAVE_LIBZSTD
+	struct sThreadContexts {
+		ZSTD_CCtx *cctx;
+		ZSTD_DCtx *dctx;
+	};
+	static sThreadContexts *getThreadContexts();
+	static void releaseThreadContexts(void *contexts);
+	#endif
+	static void lock() {
+		while(__sync_lock_test_and_set(&_sync, 1));
+	}
+	static void unlock() {
+		__sync_lock_release(&_sync);
+	}
+private:
+	static volatile bool initialized;
+	static u_int32_t id;
+	#ifdef HAVE_LIBZSTD
+	static ZSTD_CDict *cdict;
+	static ZSTD_DDict *ddict;
+	static __thread sThreadContexts *threadContexts;
+	static pthread_key_t threadContextsKey;
+	static bool threadContextsKeyCreated;
+	#endif
+	static volatile int _sync;
+};
+
+
+#endif //ZSTD_SIP_DICTIONARY_H